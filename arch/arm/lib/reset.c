@@ -28,6 +28,9 @@ __weak void reset_misc(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	/* Blocks only held in the cache would be lost across the reset */
+	blkcache_flush_all();
+
 	puts ("resetting ...\n");
 
 	udelay (50000);				/* wait 50 ms */
@@ -78,6 +78,10 @@ typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
  * recv_packet_buffer - buffers of the packet returned as received
  * recv_packet_length - lengths of the packet returned as received
  * recv_packets - number of packets returned
+ * post_buf - buffer to receive the next packet into, see post_rx_buf()
+ * post_len - size of post_buf
+ * recv_posted - number of packets received into a posted buffer
+ * rx_csum - ETH_CSUM_... flags to report for received packets, see rx_csum()
  * tx_handler - function to generate responses to sent packets
  * priv - a pointer to some structure a test may want to keep track of
  */
@@ -88,6 +92,10 @@ struct eth_sandbox_priv {
 	uchar * recv_packet_buffer[PKTBUFSRX];
 	int recv_packet_length[PKTBUFSRX];
 	int recv_packets;
+	uchar *post_buf;
+	int post_len;
+	int recv_posted;
+	unsigned int rx_csum;
 	sandbox_eth_tx_hand_f *tx_handler;
 	void *priv;
 };
@@ -87,6 +87,9 @@ int blk_common_cmd(int argc, char * const argv[], enum if_type if_type,
 
 			n = blk_write_devnum(if_type, *cur_devnump, blk, cnt,
 					     (ulong *)addr);
+			/* Leave nothing written only to the block cache */
+			if (blkcache_flush(if_type, *cur_devnump))
+				n = 0;
 
 			printf("%ld blocks written: %s\n", n,
 			       n == cnt ? "OK" : "ERROR");
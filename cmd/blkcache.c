@@ -16,33 +16,68 @@ static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
+	       "partial hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
 	       "entries: %u\n"
+	       "dirty entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "max read-ahead: %u\n",
+	       stats.hits, stats.partial_hits, stats.misses, stats.evictions,
+	       stats.entries, stats.entries_dirty,
+	       stats.max_blocks_per_entry, stats.max_entries,
+	       stats.max_readahead);
+	printf("blocks read: " LBAFU "\n"
+	       "blocks read ahead: " LBAFU " (used " LBAFU ", wasted " LBAFU
+	       ")\n"
+	       "blocks written back: " LBAFU "\n",
+	       stats.blocks_read, stats.readahead, stats.readahead_hits,
+	       stats.readahead_wasted, stats.written_back);
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	unsigned blocks_per_entry, max_entries, readahead;
+	struct block_cache_stats stats;
+
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
+	blkcache_stats(&stats);
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	readahead = argc == 4 ? simple_strtoul(argv[3], 0, 0) :
+				stats.max_readahead;
+	blkcache_configure(blocks_per_entry, max_entries, readahead);
+	printf("changed to max of %u entries of %u blocks each, %u blocks read-ahead\n",
+	       max_entries, blocks_per_entry, readahead);
+	return 0;
+}
+
+static int blkc_flush(cmd_tbl_t *cmdtp, int flag,
+		      int argc, char * const argv[])
+{
+	struct blk_desc *desc;
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	if (blk_get_device_by_str(argv[1], argv[2], &desc) < 0)
+		return CMD_RET_FAILURE;
+
+	if (blkcache_flush(desc->if_type, desc->devnum))
+		return CMD_RET_FAILURE;
+
 	return 0;
 }
 
 static cmd_tbl_t cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(flush, 3, 0, blkc_flush, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -79,8 +114,9 @@ static int do_blkcache(cmd_tbl_t *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure blocks entries [readahead]\n"
+	"blkcache flush <interface> <dev> - write back cached blocks\n"
 );
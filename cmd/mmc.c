@@ -375,7 +375,8 @@ static int do_mmc_sparse_write(cmd_tbl_t *cmdtp, int flag,
 	sparse.mssg = NULL;
 	sprintf(dest, "0x" LBAF, sparse.start * sparse.blksz);
 
-	if (write_sparse_image(&sparse, dest, addr, NULL))
+	if (write_sparse_image(&sparse, dest, addr, NULL) ||
+	    blkcache_flush(dev_desc->if_type, dev_desc->devnum))
 		return CMD_RET_FAILURE;
 	else
 		return CMD_RET_SUCCESS;
@@ -386,6 +387,7 @@ static int do_mmc_sparse_write(cmd_tbl_t *cmdtp, int flag,
 static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 			int argc, char * const argv[])
 {
+	struct blk_desc *bd;
 	struct mmc *mmc;
 	u32 blk, cnt, n;
 	void *addr;
@@ -408,7 +410,11 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 		printf("Error: card is write protected!\n");
 		return CMD_RET_FAILURE;
 	}
-	n = blk_dwrite(mmc_get_blk_desc(mmc), blk, cnt, addr);
+	bd = mmc_get_blk_desc(mmc);
+	n = blk_dwrite(bd, blk, cnt, addr);
+	/* Leave nothing written only to the block cache */
+	if (blkcache_flush(bd->if_type, bd->devnum))
+		n = 0;
 	printf("%d blocks written: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
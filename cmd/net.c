@@ -9,6 +9,7 @@
  */
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <env.h>
 #include <net.h>
 
@@ -74,6 +75,22 @@ U_BOOT_CMD(
 );
 #endif
 
+#ifdef CONFIG_CMD_TFTPSTRIPE
+static int do_tftpstripe(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char *const argv[])
+{
+	return netboot_common(TFTPSTRIPE, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	tftpstripe,	3,	1,	do_tftpstripe,
+	"load file via several TFTP sessions at once",
+	"[loadAddress] [[hostIPaddr:]bootfilename]\n"
+	"The file is split into $tftpstripes parts fetched in parallel, on\n"
+	"the current device and on the devices listed in $tftpstripedev."
+);
+#endif
+
 
 #ifdef CONFIG_CMD_RARP
 int do_rarpb(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
@@ -114,6 +131,19 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"load a file via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -458,3 +488,90 @@ U_BOOT_CMD(
 );
 
 #endif  /* CONFIG_CMD_LINK_LOCAL */
+
+#if defined(CONFIG_CMD_NET_STATS)
+static const char * const net_stage_names[NET_STAGE_COUNT] = {
+	[NET_STAGE_POLL]	= "poll",
+	[NET_STAGE_RX]		= "rx",
+	[NET_STAGE_TX]		= "tx",
+	[NET_STAGE_CSUM]	= "csum",
+	[NET_STAGE_COPY]	= "copy",
+	[NET_STAGE_ARP]		= "arp",
+};
+
+/* Convert timer ticks to microseconds without overflowing ticks * 10^6 */
+static u64 net_ticks_to_us(u64 ticks, ulong tbclk)
+{
+	u32 rem;
+
+	if (!tbclk)
+		return 0;
+
+	rem = do_div(ticks, tbclk);
+
+	return ticks * 1000000 + lldiv((u64)rem * 1000000, tbclk);
+}
+
+static int do_net_stats(cmd_tbl_t *cmdtp, int flag, int argc,
+			char * const argv[])
+{
+	ulong tbclk = get_tbclk();
+	u64 us;
+	int i;
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "reset"))
+			return CMD_RET_USAGE;
+		memset(&net_stats, '\0', sizeof(net_stats));
+		return CMD_RET_SUCCESS;
+	}
+
+	printf("rx: %llu packets, %llu bytes, %llu dropped\n",
+	       (unsigned long long)net_stats.rx_packets,
+	       (unsigned long long)net_stats.rx_bytes,
+	       (unsigned long long)net_stats.rx_dropped);
+	printf("tx: %llu packets, %llu bytes, %llu errors\n",
+	       (unsigned long long)net_stats.tx_packets,
+	       (unsigned long long)net_stats.tx_bytes,
+	       (unsigned long long)net_stats.tx_errors);
+	printf("arp requests: %u, timeouts: %u, retransmits: %u\n",
+	       net_stats.arp_requests, net_stats.timeouts,
+	       net_stats.retransmits);
+
+	/* poll includes rx for legacy drivers; rx includes csum and copy */
+	printf("\n%-8s %12s %14s\n", "stage", "calls", "time (us)");
+	for (i = 0; i < NET_STAGE_COUNT; i++) {
+		us = net_ticks_to_us(net_stats.ticks[i], tbclk);
+		printf("%-8s %12llu %14llu\n", net_stage_names[i],
+		       (unsigned long long)net_stats.calls[i],
+		       (unsigned long long)us);
+	}
+
+	return CMD_RET_SUCCESS;
+}
+
+static cmd_tbl_t cmd_net_sub[] = {
+	U_BOOT_CMD_MKENT(stats, 2, 0, do_net_stats, "", ""),
+};
+
+static int do_net(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	cmd_tbl_t *cp;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	cp = find_cmd_tbl(argv[1], cmd_net_sub, ARRAY_SIZE(cmd_net_sub));
+	if (!cp)
+		return CMD_RET_USAGE;
+
+	return cp->cmd(cmdtp, flag, argc - 1, argv + 1);
+}
+
+U_BOOT_CMD(
+	net,	3,	1,	do_net,
+	"network stack statistics",
+	"stats - show the packet counters and the time spent in each stage\n"
+	"net stats reset - clear them"
+);
+#endif /* CONFIG_CMD_NET_STATS */
@@ -566,6 +566,16 @@ static int initr_scsi(void)
 }
 #endif
 
+#ifdef CONFIG_BLK_PARALLEL_PROBE
+static int initr_blk_probe(void)
+{
+	/* Failures are reported per controller, carry on booting anyway */
+	blk_probe_all();
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_BITBANGMII
 static int initr_bbmii(void)
 {
@@ -813,6 +823,10 @@ static init_fnc_t init_sequence_r[] = {
 	INIT_FUNC_WATCHDOG_RESET
 	initr_scsi,
 #endif
+#ifdef CONFIG_BLK_PARALLEL_PROBE
+	INIT_FUNC_WATCHDOG_RESET
+	initr_blk_probe,
+#endif
 #ifdef CONFIG_BITBANGMII
 	initr_bbmii,
 #endif
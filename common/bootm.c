@@ -402,6 +402,9 @@ ulong bootm_disable_interrupts(void)
 {
 	ulong iflag;
 
+	/* Write back the block cache while the devices are still up */
+	blkcache_flush_all();
+
 	/*
 	 * We have reached the point of no return: we are going to
 	 * overwrite all exception vector code, so we cannot easily
@@ -40,6 +40,7 @@
 #include <memalign.h>
 #include <asm/byteorder.h>
 #include <asm/processor.h>
+#include <asm/unaligned.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 
@@ -97,6 +98,11 @@ struct us_data {
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
 	unsigned short	max_xfer_blk;		/* maximum transfer blocks */
+#ifdef CONFIG_USB_UAS
+	unsigned char	ep_cmd;			/* UAS command pipe */
+	unsigned char	ep_status;		/* UAS status pipe */
+	unsigned int	uas_tags;		/* UAS commands in flight, 0: BBB */
+#endif
 };
 
 #if !CONFIG_IS_ENABLED(BLK)
@@ -935,6 +941,342 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+#ifdef CONFIG_USB_UAS
+/*
+ * USB Attached SCSI. Each command is sent as a command IU on the command
+ * pipe, and its data and sense IU go over the data and status pipes on the
+ * stream matching its tag, so several commands can be in flight at once.
+ */
+#define UAS_MAX_TAGS		8
+
+#define UAS_IU_COMMAND		0x01
+#define UAS_IU_SENSE		0x03
+
+#define USB_DT_PIPE_USAGE	0x24
+#define UAS_PIPE_ID_CMD		1
+#define UAS_PIPE_ID_STATUS	2
+#define UAS_PIPE_ID_DATA_IN	3
+#define UAS_PIPE_ID_DATA_OUT	4
+
+struct uas_cmd_iu {
+	__u8	id;
+	__u8	rsvd1;
+	__be16	tag;
+	__u8	prio_attr;
+	__u8	rsvd5;
+	__u8	len;
+	__u8	rsvd7;
+	__u8	lun[8];
+	__u8	cdb[16];
+} __packed;
+
+struct uas_sense_iu {
+	__u8	id;
+	__u8	rsvd1;
+	__be16	tag;
+	__be16	status_qual;
+	__u8	status;
+	__u8	rsvd7[7];
+	__be16	len;
+	__u8	sense[96];
+} __packed;
+
+struct uas_tag {
+	struct usb_bulk_req	cmd_req;
+	struct usb_bulk_req	data_req;
+	struct usb_bulk_req	status_req;
+	lbaint_t		blocks;		/* blocks of a READ/WRITE */
+	struct uas_cmd_iu	cmd __aligned(ARCH_DMA_MINALIGN);
+	struct uas_sense_iu	sense __aligned(ARCH_DMA_MINALIGN);
+};
+
+static struct uas_tag uas_tag[UAS_MAX_TAGS];
+
+/* Takes whatever is left of a command off the host controller */
+static void usb_stor_UAS_cancel(struct usb_device *udev, struct uas_tag *t)
+{
+	usb_bulk_cancel(udev, &t->cmd_req);
+	if (t->data_req.length)
+		usb_bulk_cancel(udev, &t->data_req);
+	usb_bulk_cancel(udev, &t->status_req);
+}
+
+static int usb_stor_UAS_queue(struct us_data *us, int tag, const u8 *cdb,
+			      int cdblen, int lun, void *data, int datalen)
+{
+	struct usb_device *udev = us->pusb_dev;
+	struct uas_tag *t = &uas_tag[tag - 1];
+	int ret;
+
+	memset(&t->cmd, 0, sizeof(t->cmd));
+	t->cmd.id = UAS_IU_COMMAND;
+	t->cmd.tag = cpu_to_be16(tag);
+	t->cmd.lun[1] = lun;
+	memcpy(t->cmd.cdb, cdb, min_t(int, cdblen, sizeof(t->cmd.cdb)));
+
+	/* Be ready for the data and status before sending the command */
+	memset(&t->cmd_req, 0, sizeof(t->cmd_req));
+	memset(&t->data_req, 0, sizeof(t->data_req));
+	memset(&t->status_req, 0, sizeof(t->status_req));
+	t->status_req.pipe = usb_rcvbulkpipe(udev, us->ep_status);
+	t->status_req.stream_id = tag;
+	t->status_req.buffer = &t->sense;
+	t->status_req.length = sizeof(t->sense);
+	ret = usb_bulk_submit(udev, &t->status_req);
+	if (ret)
+		return ret;
+
+	if (datalen) {
+		if (US_DIRECTION(cdb[0]))
+			t->data_req.pipe = usb_rcvbulkpipe(udev, us->ep_in);
+		else
+			t->data_req.pipe = usb_sndbulkpipe(udev, us->ep_out);
+		t->data_req.stream_id = tag;
+		t->data_req.buffer = data;
+		t->data_req.length = datalen;
+		ret = usb_bulk_submit(udev, &t->data_req);
+		if (ret)
+			goto err;
+	}
+
+	t->cmd_req.pipe = usb_sndbulkpipe(udev, us->ep_cmd);
+	t->cmd_req.buffer = &t->cmd;
+	t->cmd_req.length = sizeof(t->cmd);
+	ret = usb_bulk_submit(udev, &t->cmd_req);
+	if (ret)
+		goto err;
+
+	return 0;
+err:
+	/* Nothing must be left on the stream rings for this tag */
+	usb_stor_UAS_cancel(udev, t);
+	return ret;
+}
+
+/* Waits for a command queued by usb_stor_UAS_queue() and checks its status */
+static int usb_stor_UAS_finish(struct us_data *us, int tag, u8 *sense_buf,
+			       int sense_len)
+{
+	struct usb_device *udev = us->pusb_dev;
+	struct uas_tag *t = &uas_tag[tag - 1];
+
+	if (usb_bulk_wait(udev, &t->cmd_req) ||
+	    (t->data_req.length && usb_bulk_wait(udev, &t->data_req)) ||
+	    usb_bulk_wait(udev, &t->status_req)) {
+		usb_stor_UAS_cancel(udev, t);
+		return USB_STOR_TRANSPORT_ERROR;
+	}
+
+	if (t->cmd_req.status || t->status_req.status ||
+	    (t->data_req.status && t->data_req.status != USB_ST_STALLED)) {
+		debug("UAS: tag %d failed, status %lx/%lx/%lx\n", tag,
+		      t->cmd_req.status, t->data_req.status,
+		      t->status_req.status);
+		return USB_STOR_TRANSPORT_ERROR;
+	}
+
+	if (t->status_req.act_len < offsetof(struct uas_sense_iu, sense) ||
+	    t->sense.id != UAS_IU_SENSE || be16_to_cpu(t->sense.tag) != tag) {
+		debug("UAS: tag %d got IU %x\n", tag, t->sense.id);
+		return USB_STOR_TRANSPORT_ERROR;
+	}
+
+	if (!t->sense.status)
+		return USB_STOR_TRANSPORT_GOOD;
+
+	/* The sense data comes with the status, no REQUEST SENSE needed */
+	if (sense_buf)
+		memcpy(sense_buf, t->sense.sense,
+		       min_t(int, sense_len, be16_to_cpu(t->sense.len)));
+
+	return USB_STOR_TRANSPORT_FAILED;
+}
+
+static int usb_stor_UAS_transport(struct scsi_cmd *srb, struct us_data *us)
+{
+	if (usb_stor_UAS_queue(us, 1, srb->cmd, srb->cmdlen, srb->lun,
+			       srb->pdata, srb->datalen))
+		return USB_STOR_TRANSPORT_ERROR;
+
+	return usb_stor_UAS_finish(us, 1, srb->sense_buf,
+				   sizeof(srb->sense_buf));
+}
+
+static void usb_stor_rw10_cdb(u8 *cdb, u8 opcode, unsigned long start,
+			      unsigned short blocks)
+{
+	memset(cdb, 0, 10);
+	cdb[0] = opcode;
+	put_unaligned_be32(start, &cdb[2]);
+	put_unaligned_be16(blocks, &cdb[7]);
+}
+
+/*
+ * Reads or writes with up to us->uas_tags READ(10)/WRITE(10) commands in
+ * flight, completing them in order. Stops at the first error, leaving the
+ * remaining blocks to the caller which retries them one command at a time.
+ *
+ * @return number of blocks transferred
+ */
+static lbaint_t usb_stor_UAS_rw(struct us_data *us, struct blk_desc *block_dev,
+				lbaint_t start, lbaint_t blkcnt,
+				uintptr_t buf_addr, bool write)
+{
+	unsigned int next = 0, oldest = 0, inflight = 0;
+	lbaint_t queued = 0, done = 0;
+	bool failed = false;
+	struct uas_tag *t;
+	u8 cdb[10];
+	int ret;
+
+	while (done < blkcnt) {
+		while (!failed && inflight < us->uas_tags && queued < blkcnt) {
+			t = &uas_tag[next];
+			t->blocks = min_t(lbaint_t, blkcnt - queued,
+					  us->max_xfer_blk);
+			usb_stor_rw10_cdb(cdb, write ? SCSI_WRITE10 : SCSI_READ10,
+					  start + queued, t->blocks);
+			ret = usb_stor_UAS_queue(us, next + 1, cdb, sizeof(cdb),
+					block_dev->lun,
+					(void *)(buf_addr +
+						 queued * block_dev->blksz),
+					t->blocks * block_dev->blksz);
+			if (ret) {
+				debug("UAS: queueing tag %d failed: %d\n",
+				      next + 1, ret);
+				failed = true;
+				break;
+			}
+			queued += t->blocks;
+			inflight++;
+			next = (next + 1) % us->uas_tags;
+		}
+		if (!inflight)
+			break;
+
+		t = &uas_tag[oldest];
+		ret = usb_stor_UAS_finish(us, oldest + 1, NULL, 0);
+		inflight--;
+		oldest = (oldest + 1) % us->uas_tags;
+		if (ret != USB_STOR_TRANSPORT_GOOD)
+			failed = true;
+		if (!failed)
+			done += t->blocks;
+		usb_show_progress();
+	}
+
+	return done;
+}
+
+/*
+ * Switches the interface over to its UAS alternate setting, if it has one
+ * and the host controller can run enough streams on its pipes
+ *
+ * @return 0 if UAS is now used, -ve if the device stays with BBB
+ */
+static int usb_stor_UAS_setup(struct usb_device *dev,
+			      struct usb_interface *iface, struct us_data *ss)
+{
+	struct usb_interface_descriptor *ifd = NULL;
+	struct usb_descriptor_header *head;
+	struct usb_endpoint_descriptor *ep = NULL;
+	unsigned char ep_addr[UAS_PIPE_ID_DATA_OUT + 1] = { 0 };
+	unsigned long pipes[3];
+	unsigned char *buf;
+	bool in_uas = false;
+	int len, index, i, ret;
+
+	if (dev->speed < USB_SPEED_SUPER)
+		return -ENOSYS;
+
+	len = usb_get_configuration_len(dev, 0);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	ret = usb_get_configuration_no(dev, 0, buf, len);
+	if (ret < 0)
+		goto out;
+
+	/*
+	 * The pipe usage descriptors telling what each endpoint is for are
+	 * not kept by usb_parse_config(), so walk the raw descriptors
+	 */
+	ret = -ENOENT;
+	for (index = 0; index + 2 <= len; index += head->bLength) {
+		head = (struct usb_descriptor_header *)&buf[index];
+		if (!head->bLength || index + head->bLength > len)
+			break;
+		switch (head->bDescriptorType) {
+		case USB_DT_INTERFACE:
+			if (in_uas)
+				break;
+			ifd = (struct usb_interface_descriptor *)head;
+			in_uas = ifd->bInterfaceNumber ==
+					iface->desc.bInterfaceNumber &&
+				 ifd->bInterfaceClass ==
+					USB_CLASS_MASS_STORAGE &&
+				 ifd->bInterfaceSubClass == US_SC_SCSI &&
+				 ifd->bInterfaceProtocol == US_PR_UAS;
+			continue;
+		case USB_DT_ENDPOINT:
+			ep = (struct usb_endpoint_descriptor *)head;
+			continue;
+		case USB_DT_PIPE_USAGE:
+			if (in_uas && ep && head->bLength >= 3 &&
+			    buf[index + 2] >= UAS_PIPE_ID_CMD &&
+			    buf[index + 2] <= UAS_PIPE_ID_DATA_OUT)
+				ep_addr[buf[index + 2]] =
+					ep->bEndpointAddress &
+					USB_ENDPOINT_NUMBER_MASK;
+			continue;
+		default:
+			continue;
+		}
+		break;
+	}
+	for (i = UAS_PIPE_ID_CMD; i <= UAS_PIPE_ID_DATA_OUT; i++)
+		if (!ep_addr[i])
+			goto out;
+	debug("UAS: alt %d, endpoints cmd %d status %d in %d out %d\n",
+	      ifd->bAlternateSetting, ep_addr[UAS_PIPE_ID_CMD],
+	      ep_addr[UAS_PIPE_ID_STATUS], ep_addr[UAS_PIPE_ID_DATA_IN],
+	      ep_addr[UAS_PIPE_ID_DATA_OUT]);
+
+	ret = usb_set_interface(dev, iface->desc.bInterfaceNumber,
+				ifd->bAlternateSetting);
+	if (ret)
+		goto out;
+
+	pipes[0] = usb_rcvbulkpipe(dev, ep_addr[UAS_PIPE_ID_STATUS]);
+	pipes[1] = usb_rcvbulkpipe(dev, ep_addr[UAS_PIPE_ID_DATA_IN]);
+	pipes[2] = usb_sndbulkpipe(dev, ep_addr[UAS_PIPE_ID_DATA_OUT]);
+	ret = usb_alloc_streams(dev, pipes, ARRAY_SIZE(pipes), UAS_MAX_TAGS);
+	if (ret <= 0) {
+		debug("UAS: no streams (%d)\n", ret);
+		usb_set_interface(dev, iface->desc.bInterfaceNumber, 0);
+		ret = ret ? ret : -ENOSPC;
+		goto out;
+	}
+
+	ss->ep_cmd = ep_addr[UAS_PIPE_ID_CMD];
+	ss->ep_status = ep_addr[UAS_PIPE_ID_STATUS];
+	ss->ep_in = ep_addr[UAS_PIPE_ID_DATA_IN];
+	ss->ep_out = ep_addr[UAS_PIPE_ID_DATA_OUT];
+	ss->uas_tags = min(ret, UAS_MAX_TAGS);
+	ss->protocol = US_PR_UAS;
+	ss->transport = usb_stor_UAS_transport;
+	/* There is no transport reset, the commands only get retried */
+	ss->transport_reset = NULL;
+	ret = 0;
+	debug("UAS: %d commands in flight\n", ss->uas_tags);
+out:
+	free(buf);
+	return ret;
+}
+#endif /* CONFIG_USB_UAS */
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 				      struct us_data *us)
 {
@@ -996,6 +1338,11 @@ static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss)
 {
 	char *ptr;
 
+#ifdef CONFIG_USB_UAS
+	/* The sense data came with the status of the failed command */
+	if (ss->uas_tags)
+		return 0;
+#endif
 	ptr = (char *)srb->pdata;
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_REQ_SENSE;
@@ -1119,6 +1466,28 @@ static void usb_bin_fixup(struct usb_device_descriptor descriptor,
 }
 #endif /* CONFIG_USB_BIN_FIXUP */
 
+/*
+ * Does what it can of a read or write with queued UAS commands, moving
+ * @start, @blks and @buf_addr past it. The rest is left to the caller, which
+ * sends one command at a time.
+ */
+static void usb_stor_rw_queued(struct us_data *ss, struct blk_desc *block_dev,
+			       lbaint_t *start, lbaint_t *blks,
+			       uintptr_t *buf_addr, bool write)
+{
+#ifdef CONFIG_USB_UAS
+	lbaint_t done;
+
+	if (!ss->uas_tags)
+		return;
+
+	done = usb_stor_UAS_rw(ss, block_dev, *start, *blks, *buf_addr, write);
+	*start += done;
+	*blks -= done;
+	*buf_addr += done * block_dev->blksz;
+#endif
+}
+
 #if CONFIG_IS_ENABLED(BLK)
 static unsigned long usb_stor_read(struct udevice *dev, lbaint_t blknr,
 				   lbaint_t blkcnt, void *buffer)
@@ -1164,7 +1533,9 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
-	do {
+	usb_stor_rw_queued(ss, block_dev, &start, &blks, &buf_addr, false);
+	smallblks = 0;
+	while (blks) {
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1188,7 +1559,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 	ss->flags &= ~USB_READY;
 
 	debug("usb_read: end startblk " LBAF ", blccnt %x buffer %lx\n",
@@ -1247,7 +1618,9 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
-	do {
+	usb_stor_rw_queued(ss, block_dev, &start, &blks, &buf_addr, true);
+	smallblks = 0;
+	while (blks) {
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
 		 */
@@ -1273,7 +1646,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 	ss->flags &= ~USB_READY;
 
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %lx\n",
@@ -1402,6 +1775,11 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		dev->irq_handle = usb_stor_irq;
 	}
 
+#ifdef CONFIG_USB_UAS
+	if (ss->protocol == US_PR_BULK && !usb_stor_UAS_setup(dev, iface, ss))
+		debug("Using UAS\n");
+#endif
+
 	/* Set the maximum transfer size per host controller setting */
 	usb_stor_set_max_xfer_blk(dev, ss);
 
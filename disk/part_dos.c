@@ -321,6 +321,8 @@ int write_mbr_partition(struct blk_desc *dev_desc, void *buf)
 		       __func__, "MBR");
 		return 1;
 	}
+	if (blkcache_flush(dev_desc->if_type, dev_desc->devnum))
+		return 1;
 
 	return 0;
 }
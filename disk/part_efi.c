@@ -396,6 +396,10 @@ int write_gpt_table(struct blk_desc *dev_desc,
 		       gpt_h) != 1)
 		goto err;
 
+	/* Get the tables, and the protective MBR, out of the block cache */
+	if (blkcache_flush(dev_desc->if_type, dev_desc->devnum))
+		goto err;
+
 	debug("GPT successfully written to block device!\n");
 	return 0;
 
@@ -856,6 +860,11 @@ int write_mbr_and_gpt_partitions(struct blk_desc *dev_desc, void *buf)
 		return 1;
 	}
 
+	if (blkcache_flush(dev_desc->if_type, dev_desc->devnum)) {
+		printf("%s: failed writing back the block cache\n", __func__);
+		return 1;
+	}
+
 	return 0;
 }
 #endif
@@ -10,6 +10,7 @@
  */
 #include <common.h>
 
+#include <blk.h>
 #include <command.h>
 #include <dm.h>
 #include <pci.h>
@@ -27,6 +28,9 @@
 #include <dm/lists.h>
 
 static int ata_io_flush(struct ahci_uc_priv *uc_priv, u8 port);
+#ifdef CONFIG_SCSI_AHCI_NCQ
+static int ahci_ncq_poll(struct ahci_uc_priv *uc_priv, u8 port);
+#endif
 
 #ifndef CONFIG_DM_SCSI
 struct ahci_uc_priv *probe_ent = NULL;
@@ -44,6 +48,21 @@ struct ahci_uc_priv *probe_ent = NULL;
 #define MAX_SATA_BLOCKS_READ_WRITE	0x80
 #endif
 
+/*
+ * With NCQ a transfer is split into commands of this many blocks, which
+ * the drive works on in parallel, rather than into one command at a time.
+ */
+#define NCQ_BLOCKS_PER_CMD	0x800
+
+/* Command tables: one per slot with NCQ, only slot 0 is used otherwise */
+#ifdef CONFIG_SCSI_AHCI_NCQ
+#define AHCI_CMD_TBL_NUM	AHCI_MAX_CMD_SLOT
+#else
+#define AHCI_CMD_TBL_NUM	1
+#endif
+#define AHCI_PORT_DMA_SZ	(AHCI_PORT_PRIV_DMA_SZ + \
+				 (AHCI_CMD_TBL_NUM - 1) * (AHCI_CMD_TBL_SZ))
+
 /* Maximum timeouts for each event */
 #define WAIT_MS_SPINUP	20000
 #define WAIT_MS_DATAIO	10000
@@ -177,6 +196,7 @@ static int ahci_host_init(struct ahci_uc_priv *uc_priv)
 	int i, j, ret;
 	void __iomem *port_mmio;
 	u32 port_map;
+	bool deactivated;
 
 	debug("ahci_host_init: start\n");
 
@@ -224,6 +244,11 @@ static int ahci_host_init(struct ahci_uc_priv *uc_priv)
 		uc_priv->n_ports = CONFIG_SYS_SCSI_MAX_SCSI_ID;
 #endif
 
+	/*
+	 * Deactivate and spin up all the ports before waiting for any link,
+	 * so that the ports come up at the same time rather than in turn
+	 */
+	deactivated = false;
 	for (i = 0; i < uc_priv->n_ports; i++) {
 		if (!(port_map & (1 << i)))
 			continue;
@@ -238,12 +263,18 @@ static int ahci_host_init(struct ahci_uc_priv *uc_priv)
 			tmp &= ~(PORT_CMD_LIST_ON | PORT_CMD_FIS_ON |
 				 PORT_CMD_FIS_RX | PORT_CMD_START);
 			writel_with_flush(tmp, port_mmio + PORT_CMD);
-
-			/* spec says 500 msecs for each bit, so
-			 * this is slightly incorrect.
-			 */
-			msleep(500);
+			deactivated = true;
 		}
+	}
+
+	/* spec says 500 msecs for each bit, so this is slightly incorrect. */
+	if (deactivated)
+		msleep(500);
+
+	for (i = 0; i < uc_priv->n_ports; i++) {
+		if (!(port_map & (1 << i)))
+			continue;
+		port_mmio = (u8 *)uc_priv->port[i].port_mmio;
 
 #ifdef CONFIG_SUNXI_AHCI
 		sunxi_dma_init(port_mmio);
@@ -255,6 +286,12 @@ static int ahci_host_init(struct ahci_uc_priv *uc_priv)
 		cmd = readl(port_mmio + PORT_CMD);
 		cmd |= PORT_CMD_SPIN_UP;
 		writel_with_flush(cmd, port_mmio + PORT_CMD);
+	}
+
+	for (i = 0; i < uc_priv->n_ports; i++) {
+		if (!(port_map & (1 << i)))
+			continue;
+		port_mmio = (u8 *)uc_priv->port[i].port_mmio;
 
 		/* Bring up SATA link. */
 		ret = ahci_link_up(uc_priv, i);
@@ -488,11 +525,9 @@ static int ahci_init_one(struct ahci_uc_priv *uc_priv, pci_dev_t dev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
-			unsigned char *buf, int buf_len)
+static int ahci_fill_sg(struct ahci_sg *ahci_sg, unsigned char *buf,
+			int buf_len)
 {
-	struct ahci_ioports *pp = &(uc_priv->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
 	u32 sg_count;
 	int i;
 
@@ -505,7 +540,8 @@ static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
 	for (i = 0; i < sg_count; i++) {
 		ahci_sg->addr =
 		    cpu_to_le32((unsigned long) buf + i * MAX_DATA_BYTE_COUNT);
-		ahci_sg->addr_hi = 0;
+		ahci_sg->addr_hi = cpu_to_le32(upper_32_bits((unsigned long)
+					buf + i * MAX_DATA_BYTE_COUNT));
 		ahci_sg->flags_size = cpu_to_le32(0x3fffff &
 					  (buf_len < MAX_DATA_BYTE_COUNT
 					   ? (buf_len - 1)
@@ -518,14 +554,22 @@ static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static ulong ahci_cmd_tbl(struct ahci_ioports *pp, int tag)
+{
+	return pp->cmd_tbl + tag * (AHCI_CMD_TBL_SZ);
+}
+
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, int tag, u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32((u32)pp->cmd_tbl & 0xffffffff);
+	struct ahci_cmd_hdr *cmd_slot = &pp->cmd_slot[tag];
+	ulong cmd_tbl = ahci_cmd_tbl(pp, tag);
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32((u32)cmd_tbl & 0xffffffff);
 #ifdef CONFIG_PHYS_64BIT
-	pp->cmd_slot->tbl_addr_hi =
-	    cpu_to_le32((u32)(((pp->cmd_tbl) >> 16) >> 16));
+	cmd_slot->tbl_addr_hi =
+	    cpu_to_le32((u32)(((cmd_tbl) >> 16) >> 16));
 #endif
 }
 
@@ -559,22 +603,25 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 		return -1;
 	}
 
-	mem = memalign(2048, AHCI_PORT_PRIV_DMA_SZ);
+	mem = memalign(2048, AHCI_PORT_DMA_SZ);
 	if (!mem) {
 		free(pp);
 		printf("%s: No mem for table!\n", __func__);
 		return -ENOMEM;
 	}
-	memset(mem, 0, AHCI_PORT_PRIV_DMA_SZ);
+	memset(mem, 0, AHCI_PORT_DMA_SZ);
 
 	/*
 	 * First item in chunk of DMA memory: 32-slot command table,
 	 * 32 bytes each in size
 	 */
+	INIT_LIST_HEAD(&pp->reqs);
+	pp->busy = 0;
+
 	pp->cmd_slot =
 		(struct ahci_cmd_hdr *)(uintptr_t)virt_to_phys((void *)mem);
 	debug("cmd_slot = %p\n", pp->cmd_slot);
-	mem += (AHCI_CMD_SLOT_SZ + 224);
+	mem += AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT;
 
 	/*
 	 * Second item: Received-FIS area
@@ -583,8 +630,8 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 	mem += AHCI_RX_FIS_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing the commands and their
+	 * scatter-gather tables, one per slot when NCQ is used
 	 */
 	pp->cmd_tbl = virt_to_phys((void *)mem);
 	debug("cmd_tbl_dma = %lx\n", pp->cmd_tbl);
@@ -615,6 +662,18 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 	return wait_spinup(port_mmio);
 }
 
+/*
+ * Non-queued commands use command slot 0, which is also NCQ tag 0. Let the
+ * queued requests of the port finish first. ahci_ncq_poll() gives up on
+ * them by itself once the drive stops making progress.
+ */
+static void ahci_ncq_quiesce(struct ahci_uc_priv *uc_priv, u8 port)
+{
+#ifdef CONFIG_SCSI_AHCI_NCQ
+	while (ahci_ncq_poll(uc_priv, port))
+		;
+#endif
+}
 
 static int ahci_device_data_io(struct ahci_uc_priv *uc_priv, u8 port, u8 *fis,
 			       int fis_len, u8 *buf, int buf_len, u8 is_write)
@@ -639,11 +698,13 @@ static int ahci_device_data_io(struct ahci_uc_priv *uc_priv, u8 port, u8 *fis,
 		return -1;
 	}
 
+	ahci_ncq_quiesce(uc_priv, port);
+
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(uc_priv, port, buf, buf_len);
+	sg_count = ahci_fill_sg(pp->cmd_tbl_sg, buf, buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
-	ahci_fill_cmd_slot(pp, opts);
+	ahci_fill_cmd_slot(pp, 0, opts);
 
 	ahci_dcache_flush_sata_cmd(pp);
 	ahci_dcache_flush_range((unsigned long)buf, (unsigned long)buf_len);
@@ -726,6 +787,16 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 	memcpy(idbuf, tmpid, ATA_ID_WORDS * 2);
 	ata_swap_buf_le16(idbuf, ATA_ID_WORDS);
 
+#ifdef CONFIG_SCSI_AHCI_NCQ
+	/* Queue as deep as both the controller and the drive allow */
+	if ((uc_priv->cap & HOST_CAP_NCQ) && ata_id_has_ncq(idbuf))
+		uc_priv->port[port].ncq_depth =
+			min_t(u32, ata_id_queue_depth(idbuf),
+			      ((uc_priv->cap >> 8) & 0x1f) + 1);
+	else
+		uc_priv->port[port].ncq_depth = 0;
+#endif
+
 	memcpy(&pccb->pdata[8], "ATA     ", 8);
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
 	ata_id_strcpy((u16 *)&pccb->pdata[32], &idbuf[ATA_ID_FW_REV], 4);
@@ -737,6 +808,229 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 }
 
 
+#ifdef CONFIG_SCSI_AHCI_NCQ
+/*
+ * After an NCQ error the drive has aborted all the queued commands. Restart
+ * the command list engine and clear the errors so the port can be used
+ * again.
+ */
+static void ahci_ncq_recover(struct ahci_ioports *pp)
+{
+	void __iomem *port_mmio = pp->port_mmio;
+	u32 tmp;
+
+	tmp = readl(port_mmio + PORT_CMD);
+	writel_with_flush(tmp & ~PORT_CMD_START, port_mmio + PORT_CMD);
+	waiting_for_cmd_completed(port_mmio + PORT_CMD, 500, PORT_CMD_LIST_ON);
+
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	writel_with_flush(tmp | PORT_CMD_START, port_mmio + PORT_CMD);
+}
+
+/*
+ * Build the FPDMA QUEUED command of an NCQ tag. Writes are sent with FUA set
+ * so that the data is on the media once the command completes, and no flush
+ * is needed between queued commands.
+ */
+static int ahci_ncq_prep(struct ahci_ioports *pp, int tag, u64 lba,
+			 u32 blocks, u8 *buf, bool is_write)
+{
+	u8 *fis = (u8 *)ahci_cmd_tbl(pp, tag);
+	int sg_count;
+
+	memset(fis, 0, 20);
+	fis[0] = 0x27;		/* Host to device FIS. */
+	fis[1] = 1 << 7;	/* Command FIS. */
+	fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	/* The block count goes in the features registers */
+	fis[3] = blocks & 0xff;
+	fis[11] = (blocks >> 8) & 0xff;
+	fis[4] = (lba >> 0) & 0xff;
+	fis[5] = (lba >> 8) & 0xff;
+	fis[6] = (lba >> 16) & 0xff;
+	fis[7] = 1 << 6; /* device reg: set LBA mode */
+	if (is_write)
+		fis[7] |= 1 << 7; /* FUA */
+	fis[8] = (lba >> 24) & 0xff;
+#ifdef CONFIG_SYS_64BIT_LBA
+	fis[9] = (lba >> 32) & 0xff;
+	fis[10] = (lba >> 40) & 0xff;
+#endif
+	/* and the tag in the count register */
+	fis[12] = tag << 3;
+
+	sg_count = ahci_fill_sg((struct ahci_sg *)(fis + AHCI_CMD_TBL_HDR), buf,
+				blocks * ATA_SECT_SIZE);
+	if (sg_count < 0)
+		return -EIO;
+	ahci_fill_cmd_slot(pp, tag, 5 | (sg_count << 16) | (is_write << 6));
+	ahci_dcache_flush_range((unsigned long)fis, AHCI_CMD_TBL_SZ);
+
+	return 0;
+}
+
+/*
+ * Put one command of the pending requests of a port in each free NCQ tag,
+ * in a single write of the command issue register.
+ */
+static void ahci_ncq_issue(struct ahci_ioports *pp)
+{
+	void __iomem *port_mmio = pp->port_mmio;
+	u32 tags = GENMASK(pp->ncq_depth - 1, 0);
+	struct blk_request *req;
+	u32 issue = 0;
+
+	if (!pp->busy)
+		writel(readl(port_mmio + PORT_IRQ_STAT),
+		       port_mmio + PORT_IRQ_STAT);
+
+	list_for_each_entry(req, &pp->reqs, node) {
+		/* Nothing more is sent for a request once a command failed */
+		while (req->issued < req->blkcnt && req->good == req->blkcnt &&
+		       (tags & ~pp->busy)) {
+			u32 blocks = min_t(lbaint_t, req->blkcnt - req->issued,
+					   NCQ_BLOCKS_PER_CMD);
+			u64 lba = req->start + req->issued;
+			int tag = ffs(tags & ~pp->busy) - 1;
+
+			if (ahci_ncq_prep(pp, tag, lba, blocks,
+					  req->buffer +
+					  req->issued * ATA_SECT_SIZE,
+					  req->write)) {
+				req->good = req->issued;
+				break;
+			}
+
+			pp->tag_req[tag] = req;
+			pp->tag_lba[tag] = lba;
+			if (!pp->busy)
+				pp->last_progress = get_timer(0);
+			pp->busy |= BIT(tag);
+			issue |= BIT(tag);
+			req->issued += blocks;
+			req->inflight++;
+		}
+	}
+
+	if (issue) {
+		ahci_dcache_flush_range((unsigned long)pp->cmd_slot,
+					AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT);
+		writel(issue, port_mmio + PORT_SCR_ACT);
+		writel_with_flush(issue, port_mmio + PORT_CMD_ISSUE);
+	}
+}
+
+/*
+ * Retire the NCQ tags the drive has finished, complete the requests whose
+ * commands are all done and issue more commands. This does not wait.
+ *
+ * Returns the number of requests of the port not yet completed.
+ */
+static int ahci_ncq_poll(struct ahci_uc_priv *uc_priv, u8 port)
+{
+	struct ahci_ioports *pp = &uc_priv->port[port];
+	void __iomem *port_mmio = pp->port_mmio;
+	struct blk_request *req, *next;
+	bool failed = false;
+	int pending = 0;
+	u32 done = 0;
+	int tag;
+
+	if (pp->busy) {
+		if (readl(port_mmio + PORT_IRQ_STAT) &
+		    (PORT_IRQ_FATAL)) {
+			printf("scsi_ahci: NCQ error on port %d\n", port);
+			failed = true;
+		} else if (get_timer(pp->last_progress) > WAIT_MS_DATAIO) {
+			printf("scsi_ahci: NCQ timeout on port %d\n", port);
+			failed = true;
+		}
+
+		if (failed) {
+			/* The drive has aborted all the queued commands */
+			ahci_ncq_recover(pp);
+			done = pp->busy;
+		} else {
+			/* It clears the SActive bit of each finished tag */
+			done = pp->busy & ~readl(port_mmio + PORT_SCR_ACT);
+		}
+	}
+
+	if (done) {
+		for (tag = 0; tag < AHCI_MAX_CMD_SLOT; tag++) {
+			if (!(done & BIT(tag)))
+				continue;
+			req = pp->tag_req[tag];
+			if (failed)
+				req->good = min_t(u64, req->good,
+						  pp->tag_lba[tag] - req->start);
+			req->inflight--;
+		}
+		pp->busy &= ~done;
+		pp->last_progress = get_timer(0);
+	}
+
+	list_for_each_entry_safe(req, next, &pp->reqs, node) {
+		if (req->inflight ||
+		    (req->issued < req->blkcnt && req->good == req->blkcnt)) {
+			pending++;
+			continue;
+		}
+
+		list_del(&req->node);
+		if (!req->write)
+			ahci_dcache_invalidate_range((unsigned long)req->buffer,
+						     req->blkcnt *
+						     ATA_SECT_SIZE);
+		blk_request_complete(req, req->good);
+	}
+
+	ahci_ncq_issue(pp);
+
+	return pending;
+}
+
+static int ahci_ncq_submit(struct ahci_uc_priv *uc_priv, u8 port,
+			   struct blk_request *req)
+{
+	struct ahci_ioports *pp = &uc_priv->port[port];
+
+	ahci_dcache_flush_range((unsigned long)req->buffer,
+				req->blkcnt * ATA_SECT_SIZE);
+	req->issued = 0;
+	req->good = req->blkcnt;
+	req->inflight = 0;
+	list_add_tail(&req->node, &pp->reqs);
+	ahci_ncq_issue(pp);
+
+	return 0;
+}
+
+/*
+ * Read or write with FPDMA QUEUED commands, keeping one command in each
+ * NCQ tag until the transfer is done. New commands are issued in batches,
+ * as earlier ones complete.
+ */
+static int ahci_ncq_read_write(struct ahci_uc_priv *uc_priv, u8 port,
+			       lbaint_t lba, u32 blocks, u8 *buf, u8 is_write)
+{
+	struct blk_request req = {
+		.write	= is_write,
+		.start	= lba,
+		.blkcnt	= blocks,
+		.buffer	= buf,
+	};
+
+	ahci_ncq_submit(uc_priv, port, &req);
+	while (!req.complete)
+		ahci_ncq_poll(uc_priv, port);
+
+	return req.result == blocks ? 0 : -EIO;
+}
+#endif
+
 /*
  * SCSI READ10/WRITE10 command operation.
  */
@@ -778,6 +1072,18 @@ static int ata_scsiop_read_write(struct ahci_uc_priv *uc_priv,
 	debug("scsi_ahci: %s %u blocks starting from lba 0x" LBAFU "\n",
 	      is_write ?  "write" : "read", blocks, lba);
 
+#ifdef CONFIG_SCSI_AHCI_NCQ
+	if (uc_priv->port[pccb->target].ncq_depth) {
+		if (ATA_SECT_SIZE * blocks > user_buffer_size) {
+			printf("scsi_ahci: Error: buffer too small.\n");
+			return -EIO;
+		}
+		/* Writes use FUA, so no flush is needed */
+		return ahci_ncq_read_write(uc_priv, pccb->target, lba, blocks,
+					   user_buffer, is_write);
+	}
+#endif
+
 	/* Preset the FIS */
 	memset(fis, 0, sizeof(fis));
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -1103,6 +1409,8 @@ static int ata_io_flush(struct ahci_uc_priv *uc_priv, u8 port)
 	void __iomem *port_mmio = pp->port_mmio;
 	u32 cmd_fis_len = 5;	/* five dwords */
 
+	ahci_ncq_quiesce(uc_priv, port);
+
 	/* Preset the FIS */
 	memset(fis, 0, 20);
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -1110,7 +1418,7 @@ static int ata_io_flush(struct ahci_uc_priv *uc_priv, u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
 	ahci_dcache_flush_sata_cmd(pp);
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
@@ -1190,9 +1498,42 @@ int ahci_probe_scsi_pci(struct udevice *ahci_dev)
 }
 #endif
 
+#ifdef CONFIG_SCSI_AHCI_NCQ
+static int ahci_scsi_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct ahci_uc_priv *uc_priv = dev_get_uclass_priv(dev->parent);
+	struct blk_desc *desc = dev_get_uclass_platdata(req->dev);
+
+	if (desc->target >= uc_priv->n_ports ||
+	    !uc_priv->port[desc->target].ncq_depth ||
+	    desc->blksz != ATA_SECT_SIZE)
+		return -ENOSYS;
+
+	return ahci_ncq_submit(uc_priv, desc->target, req);
+}
+
+static int ahci_scsi_poll(struct udevice *dev)
+{
+	struct ahci_uc_priv *uc_priv = dev_get_uclass_priv(dev->parent);
+	int pending = 0;
+	int i;
+
+	for (i = 0; i < uc_priv->n_ports; i++) {
+		if (uc_priv->port[i].ncq_depth)
+			pending += ahci_ncq_poll(uc_priv, i);
+	}
+
+	return pending;
+}
+#endif
+
 struct scsi_ops scsi_ops = {
 	.exec		= ahci_scsi_exec,
 	.bus_reset	= ahci_scsi_bus_reset,
+#ifdef CONFIG_SCSI_AHCI_NCQ
+	.submit		= ahci_scsi_submit,
+	.poll		= ahci_scsi_poll,
+#endif
 };
 
 U_BOOT_DRIVER(ahci_scsi) = {
@@ -10,6 +10,7 @@
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
+#include <watchdog.h>
 
 static const char *if_typename_str[IF_TYPE_COUNT] = {
 	[IF_TYPE_IDE]		= "ide",
@@ -426,25 +427,32 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+static ulong blk_read_dev(struct blk_desc *block_dev, lbaint_t start,
+			  lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+
+	return blk_get_ops(dev)->read(dev, start, blkcnt, buffer);
+}
+
+static ulong blk_write_dev(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+
+	return blk_get_ops(dev)->write(dev, start, blkcnt, buffer);
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
-
-	return blks_read;
+	return blkcache_dread(block_dev, start, blkcnt, buffer, blk_read_dev);
 }
 
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -456,8 +464,71 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return ops->write(dev, start, blkcnt, buffer);
+	return blkcache_dwrite(block_dev, start, blkcnt, buffer,
+			       blk_write_dev);
+}
+
+int blk_submit(struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(req->dev);
+	const struct blk_ops *ops = blk_get_ops(req->dev);
+	ulong n;
+	int ret;
+
+	req->complete = false;
+	req->result = 0;
+	if (ops->submit && ops->poll) {
+		/* The cache must not hold stale or unwritten blocks */
+		if (req->write)
+			blkcache_discard(desc, req->start, req->blkcnt);
+		else if (blkcache_flush(desc->if_type, desc->devnum))
+			return -EIO;
+
+		ret = ops->submit(req->dev, req);
+		if (ret != -ENOSYS)
+			return ret;
+	}
+
+	/* Do it now, through the cache */
+	if (req->write)
+		n = blk_dwrite(desc, req->start, req->blkcnt, req->buffer);
+	else
+		n = blk_dread(desc, req->start, req->blkcnt, req->buffer);
+	blk_request_complete(req, IS_ERR_VALUE(n) ? (long)n : n);
+
+	return 0;
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+long blk_wait(struct blk_request *req)
+{
+	int ret;
+
+	while (!req->complete) {
+		ret = blk_poll(req->dev);
+		if (ret < 0)
+			return ret;
+		WATCHDOG_RESET();
+	}
+
+	return req->result;
+}
+
+void blk_request_complete(struct blk_request *req, long result)
+{
+	req->result = result;
+	req->complete = true;
+	if (req->done)
+		req->done(req);
 }
 
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
@@ -469,7 +540,7 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_discard(block_dev, start, blkcnt);
 	return ops->erase(dev, start, blkcnt);
 }
 
@@ -648,9 +719,20 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	/* Write back anything still cached before the device goes away */
+	blkcache_invalidate(desc->if_type, desc->devnum);
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
 };
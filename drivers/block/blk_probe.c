@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Overlapping bring-up of storage controllers
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <errno.h>
+#include <linker_lists.h>
+#include <malloc.h>
+#include <watchdog.h>
+
+/* How long to wait for a controller to become ready before finishing it */
+#define BLK_PROBE_TIMEOUT_MS	10000
+
+int blk_probe_run(const struct blk_probe_hooks *hooks, int count)
+{
+	ulong start = get_timer(0);
+	int pending, first_err = 0;
+	bool *done;
+	int i, ret;
+
+	done = calloc(count, sizeof(*done));
+	if (!done)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		if (!hooks[i].start)
+			continue;
+		ret = hooks[i].start();
+		if (ret)
+			debug("%s: %s start failed: %d\n", __func__,
+			      hooks[i].name, ret);
+	}
+
+	for (pending = count; pending; ) {
+		for (i = 0; i < count; i++) {
+			if (done[i])
+				continue;
+			ret = hooks[i].poll ? hooks[i].poll() : 0;
+			if (ret == -EAGAIN &&
+			    get_timer(start) < BLK_PROBE_TIMEOUT_MS)
+				continue;
+			if (ret && ret != -EAGAIN)
+				debug("%s: %s not ready: %d\n", __func__,
+				      hooks[i].name, ret);
+
+			debug("%s: finishing %s after %lu ms\n", __func__,
+			      hooks[i].name, get_timer(start));
+			ret = hooks[i].finish();
+			if (ret) {
+				printf("%s: bring-up failed: %d\n",
+				       hooks[i].name, ret);
+				if (!first_err)
+					first_err = ret;
+			}
+			done[i] = true;
+			pending--;
+		}
+		WATCHDOG_RESET();
+	}
+	free(done);
+
+	return first_err;
+}
+
+int blk_probe_all(void)
+{
+	struct blk_probe_hooks *hooks =
+		ll_entry_start(struct blk_probe_hooks, blk_probe_hooks);
+	const int count = ll_entry_count(struct blk_probe_hooks,
+					 blk_probe_hooks);
+
+	return blk_probe_run(hooks, count);
+}
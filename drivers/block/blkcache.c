@@ -7,39 +7,117 @@
 #include <config.h>
 #include <common.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
 
-struct block_cache_node {
+/*
+ * The cache is made of entries holding a fixed number of blocks, aligned
+ * to a multiple of that number on the device. Entries are found through a
+ * hash of the device and the first block, and are kept in a single LRU list
+ * so the total memory used stays bounded.
+ */
+#define BLKCACHE_HASH_BITS	8
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+
+/* Per-device state: read-ahead tracking and what is needed to write back */
+struct block_cache_dev {
 	struct list_head lh;
 	int iftype;
 	int devnum;
+	struct blk_desc *desc;
+	blkcache_write_t write;
+	lbaint_t next;		/* block following the last read */
+	lbaint_t ra_blocks;	/* current read-ahead window, 0 if off */
+	lbaint_t ra_end;	/* block following the last read-ahead */
+};
+
+struct block_cache_node {
+	struct list_head lh;	/* LRU list, most recently used first */
+	struct hlist_node hn;	/* hash chain */
+	struct block_cache_dev *dev;
 	lbaint_t start;
 	lbaint_t blkcnt;
 	unsigned long blksz;
+	bool dirty;
+	bool readahead;		/* filled by read-ahead and not used yet */
 	char *cache;
 };
 
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_devs);
+static struct hlist_head block_cache_hash[BLKCACHE_HASH_SIZE];
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_ENTRIES,
+	.max_readahead = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static unsigned int cache_hash(struct block_cache_dev *dev, lbaint_t start)
+{
+	u32 key = (u32)(start / _stats.max_blocks_per_entry) ^
+		  (u32)((uintptr_t)dev >> 4);
+
+	/* Fibonacci hashing, as hash_32() in Linux */
+	return (key * 0x61c88647) >> (32 - BLKCACHE_HASH_BITS);
+}
+
+static lbaint_t cache_line(lbaint_t blk)
+{
+	return blk - (blk % _stats.max_blocks_per_entry);
+}
+
+/* Reads larger than this bypass the cache so they do not flush it */
+static lbaint_t cache_max_fill(void)
+{
+	return (lbaint_t)_stats.max_entries * _stats.max_blocks_per_entry / 4;
+}
+
+static struct block_cache_dev *cache_dev(struct blk_desc *desc)
+{
+	struct block_cache_dev *dev;
+
+	list_for_each_entry(dev, &block_cache_devs, lh)
+		if (dev->iftype == desc->if_type &&
+		    dev->devnum == desc->devnum) {
+			dev->desc = desc;
+			return dev;
+		}
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return NULL;
+	dev->iftype = desc->if_type;
+	dev->devnum = desc->devnum;
+	dev->desc = desc;
+	list_add(&dev->lh, &block_cache_devs);
+
+	return dev;
+}
+
+static struct block_cache_dev *cache_find_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *dev;
+
+	list_for_each_entry(dev, &block_cache_devs, lh)
+		if (dev->iftype == iftype && dev->devnum == devnum)
+			return dev;
+
+	return NULL;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *dev,
+					   lbaint_t start, unsigned long blksz)
 {
+	struct hlist_head *head = &block_cache_hash[cache_hash(dev, start)];
 	struct block_cache_node *node;
+	struct hlist_node *pos;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
+	hlist_for_each_entry(node, pos, head, hn)
+		if (node->dev == dev && node->start == start &&
+		    node->blksz == blksz) {
 			if (block_cache.next != &node->lh) {
 				/* maintain MRU ordering */
 				list_del(&node->lh);
@@ -47,120 +125,489 @@ static struct block_cache_node *cache_find(int iftype, int devnum,
 			}
 			return node;
 		}
-	return 0;
+
+	return NULL;
 }
 
-int blkcache_read(int iftype, int devnum,
-		  lbaint_t start, lbaint_t blkcnt,
-		  unsigned long blksz, void *buffer)
+static int cache_write_back(struct block_cache_node *node)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_dev *dev = node->dev;
+
+	if (!node->dirty)
+		return 0;
+
+	debug("write back: start " LBAF ", count " LBAFU "\n",
+	      node->start, node->blkcnt);
+	if (dev->write(dev->desc, node->start, node->blkcnt,
+		       node->cache) != node->blkcnt) {
+		printf("blkcache: write back of block " LBAFU " failed\n",
+		       node->start);
+		return -EIO;
 	}
+	node->dirty = false;
+	_stats.entries_dirty--;
+	_stats.written_back += node->blkcnt;
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
-	++_stats.misses;
 	return 0;
 }
 
-void blkcache_fill(int iftype, int devnum,
-		   lbaint_t start, lbaint_t blkcnt,
-		   unsigned long blksz, void const *buffer)
+static void cache_drop(struct block_cache_node *node)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	list_del(&node->lh);
+	hlist_del(&node->hn);
+	if (node->dirty)
+		_stats.entries_dirty--;
+	_stats.entries--;
+	free(node->cache);
+	free(node);
+}
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
-		return;
+/*
+ * Get an entry for @blkcnt blocks from @start, evicting the least recently
+ * used one (after writing it back) once the cache is full. The data is left
+ * to the caller.
+ *
+ * If the write-back fails the entry stays cached, still dirty, and NULL is
+ * returned: callers then go to the device directly.
+ */
+static struct block_cache_node *cache_alloc(struct block_cache_dev *dev,
+					    lbaint_t start, lbaint_t blkcnt,
+					    unsigned long blksz)
+{
+	unsigned long bytes = _stats.max_blocks_per_entry * blksz;
+	struct block_cache_node *node;
 
-	if (_stats.max_entries == 0)
-		return;
+	if (!_stats.max_entries || !_stats.max_blocks_per_entry)
+		return NULL;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
+	if (_stats.entries >= _stats.max_entries) {
 		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
+		node = list_entry(block_cache.prev, struct block_cache_node,
+				  lh);
 		debug("drop: start " LBAF ", count " LBAFU "\n",
 		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
+		if (cache_write_back(node))
+			return NULL;
+		list_del(&node->lh);
+		hlist_del(&node->hn);
+		_stats.entries--;
+		_stats.evictions++;
+		if (node->readahead)
+			_stats.readahead_wasted += node->blkcnt;
+		if (node->blksz != blksz) {
 			free(node->cache);
-			node->cache = 0;
+			node->cache = NULL;
 		}
 	} else {
 		node = malloc(sizeof(*node));
 		if (!node)
-			return;
-		node->cache = 0;
+			return NULL;
+		node->cache = NULL;
 	}
 
 	if (!node->cache) {
-		node->cache = malloc(bytes);
+		/* Blocks are read straight into it, so align it for DMA */
+		node->cache = malloc_cache_aligned(bytes);
 		if (!node->cache) {
 			free(node);
-			return;
+			return NULL;
 		}
 	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
-
-	node->iftype = iftype;
-	node->devnum = devnum;
+	node->dev = dev;
 	node->start = start;
 	node->blkcnt = blkcnt;
 	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
+	node->dirty = false;
+	node->readahead = false;
 	list_add(&node->lh, &block_cache);
+	hlist_add_head(&node->hn, &block_cache_hash[cache_hash(dev, start)]);
 	_stats.entries++;
+
+	return node;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+/* Number of blocks in the entry starting at @start, clipped to the device */
+static lbaint_t cache_line_blocks(struct blk_desc *desc, lbaint_t start)
+{
+	lbaint_t blkcnt = _stats.max_blocks_per_entry;
+
+	if (desc->lba && start + blkcnt > desc->lba)
+		blkcnt = desc->lba > start ? desc->lba - start : 0;
+
+	return blkcnt;
+}
+
+/* Copy a buffer into all cached entries it overlaps, e.g. after a write */
+static void cache_update(struct block_cache_dev *dev, lbaint_t start,
+			 lbaint_t blkcnt, unsigned long blksz,
+			 const char *buffer)
 {
-	struct list_head *entry, *n;
 	struct block_cache_node *node;
+	lbaint_t blk, end = start + blkcnt;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	for (blk = cache_line(start); blk < end;
+	     blk += _stats.max_blocks_per_entry) {
+		lbaint_t from, to;
+
+		node = cache_find(dev, blk, blksz);
+		if (!node)
+			continue;
+		from = max(start, node->start);
+		to = min(end, node->start + node->blkcnt);
+		if (from < to)
+			memcpy(node->cache + (from - node->start) * blksz,
+			       buffer + (from - start) * blksz,
+			       (to - from) * blksz);
+	}
+}
+
+/* Write back, and optionally drop, the entries overlapping a range */
+static int cache_flush_range(struct block_cache_dev *dev, lbaint_t start,
+			     lbaint_t blkcnt, unsigned long blksz, bool drop)
+{
+	struct block_cache_node *node;
+	lbaint_t blk, end = start + blkcnt;
+	int ret = 0;
+
+	for (blk = cache_line(start); blk < end;
+	     blk += _stats.max_blocks_per_entry) {
+		node = cache_find(dev, blk, blksz);
+		if (!node)
+			continue;
+		if (cache_write_back(node))
+			ret = -EIO;
+		if (drop)
+			cache_drop(node);
+	}
+
+	return ret;
+}
+
+/*
+ * Read entries for the blocks from @start that are not cached yet, in one
+ * device read, stopping at the first cached entry
+ */
+static void cache_readahead(struct block_cache_dev *dev, lbaint_t start,
+			    lbaint_t blkcnt, unsigned long blksz,
+			    blkcache_read_t read)
+{
+	struct blk_desc *desc = dev->desc;
+	struct block_cache_node *node;
+	lbaint_t blk, n;
+	char *buf;
+
+	start = cache_line(start);
+	if (desc->lba) {
+		if (start >= desc->lba)
+			return;
+		blkcnt = min(blkcnt, desc->lba - start);
+	}
+	/*
+	 * Whole entries only, so that a node is never short of the entry it
+	 * stands for; just the last entry of the device may be partial
+	 */
+	if (!desc->lba || start + blkcnt < desc->lba)
+		blkcnt = cache_line(blkcnt);
+	for (n = 0; n < blkcnt; n += _stats.max_blocks_per_entry)
+		if (cache_find(dev, start + n, blksz))
+			break;
+	blkcnt = min(blkcnt, n);
+	if (!blkcnt)
+		return;
+
+	buf = malloc_cache_aligned(blkcnt * blksz);
+	if (!buf)
+		return;
+
+	debug("read-ahead: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	if (read(desc, start, blkcnt, buf) == blkcnt) {
+		_stats.blocks_read += blkcnt;
+		for (blk = start; blk < start + blkcnt;
+		     blk += _stats.max_blocks_per_entry) {
+			n = min(cache_line_blocks(desc, blk),
+				start + blkcnt - blk);
+			node = cache_alloc(dev, blk, n, blksz);
+			if (!node)
+				break;
+			memcpy(node->cache, buf + (blk - start) * blksz,
+			       n * blksz);
+			node->readahead = true;
+			_stats.readahead += n;
+		}
+		dev->ra_end = start + blkcnt;
+	}
+	free(buf);
+}
+
+ulong blkcache_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		     void *buffer, blkcache_read_t read)
+{
+	unsigned long blksz = desc->blksz;
+	lbaint_t blk, end = start + blkcnt;
+	struct block_cache_dev *dev;
+	struct block_cache_node *node;
+	lbaint_t hit = 0;
+	bool seq;
+
+	if (!_stats.max_entries || !_stats.max_blocks_per_entry || !blkcnt)
+		return read(desc, start, blkcnt, buffer);
+
+	dev = cache_dev(desc);
+	if (!dev)
+		return read(desc, start, blkcnt, buffer);
+
+	seq = start == dev->next;
+	dev->next = end;
+
+	if (blkcnt > cache_max_fill()) {
+		/* Make sure the device has any data this covers first */
+		if (_stats.entries_dirty &&
+		    cache_flush_range(dev, start, blkcnt, blksz, false))
+			return 0;
+		++_stats.misses;
+		_stats.blocks_read += blkcnt;
+		return read(desc, start, blkcnt, buffer);
+	}
+
+	for (blk = start; blk < end; ) {
+		lbaint_t line = cache_line(blk), to, n;
+		char *dst = (char *)buffer + (blk - start) * blksz;
+
+		node = cache_find(dev, line, blksz);
+		if (node) {
+			to = min(end, node->start + node->blkcnt);
+			if (to <= blk)
+				break;	/* past the end of the device */
+			memcpy(dst, node->cache + (blk - line) * blksz,
+			       (to - blk) * blksz);
+			if (node->readahead) {
+				node->readahead = false;
+				_stats.readahead_hits += node->blkcnt;
+			}
+			hit += to - blk;
+			blk = to;
+			continue;
+		}
+
+		n = cache_line_blocks(desc, line);
+		if (line + n <= blk)
+			break;
+		if (blk == line && line + n <= end) {
+			/* A whole entry: read it straight into the buffer */
+			if (read(desc, line, n, dst) != n)
+				return blk - start;
+			node = cache_alloc(dev, line, n, blksz);
+			if (node)
+				memcpy(node->cache, dst, n * blksz);
+		} else {
+			/* Part of an entry: read all of it into the cache */
+			node = cache_alloc(dev, line, n, blksz);
+			if (!node) {
+				to = min(end, line + n);
+				if (read(desc, blk, to - blk, dst) != to - blk)
+					return blk - start;
+				_stats.blocks_read += to - blk;
+				blk = to;
+				continue;
+			}
+			if (read(desc, line, n, node->cache) != n) {
+				cache_drop(node);
+				return blk - start;
+			}
+			to = min(end, line + n);
+			memcpy(dst, node->cache + (blk - line) * blksz,
+			       (to - blk) * blksz);
+		}
+		_stats.blocks_read += n;
+		blk = line + n;
+	}
+	blk = min(blk, end);
+
+	if (hit == blkcnt) {
+		++_stats.hits;
+		debug("hit: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	} else if (hit) {
+		++_stats.partial_hits;
+		debug("partial hit: start " LBAF ", count " LBAFU "\n",
+		      start, blkcnt);
+	} else {
+		++_stats.misses;
+		debug("miss: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	}
+
+	/*
+	 * Sequential reads double the read-ahead window each time, up to the
+	 * limit, and keep it ahead of the reader by half a window or more
+	 */
+	if (!_stats.max_readahead || !seq) {
+		dev->ra_blocks = 0;
+	} else {
+		lbaint_t max_ra = min_t(lbaint_t, _stats.max_readahead,
+					cache_max_fill());
+
+		/* Keep the window to whole entries, at least one */
+		max_ra = max_t(lbaint_t, cache_line(max_ra),
+			       _stats.max_blocks_per_entry);
+		dev->ra_blocks = dev->ra_blocks ? dev->ra_blocks * 2 :
+				 _stats.max_blocks_per_entry;
+		dev->ra_blocks = min(dev->ra_blocks, max_ra);
+		if (dev->ra_end < end)
+			dev->ra_end = end;
+		if (dev->ra_end < end + dev->ra_blocks / 2)
+			cache_readahead(dev, dev->ra_end, dev->ra_blocks,
+					blksz, read);
+	}
+
+	return blk - start;
+}
+
+ulong blkcache_dwrite(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		      const void *buffer, blkcache_write_t write)
+{
+	unsigned long blksz = desc->blksz;
+	lbaint_t blk, end = start + blkcnt;
+	struct block_cache_dev *dev;
+	struct block_cache_node *node;
+	ulong n;
+
+	if (!_stats.max_entries || !_stats.max_blocks_per_entry)
+		return write(desc, start, blkcnt, buffer);
+
+	dev = cache_dev(desc);
+	if (!dev)
+		return write(desc, start, blkcnt, buffer);
+	dev->write = write;
+
+	if (!IS_ENABLED(CONFIG_BLOCK_CACHE_WRITEBACK) ||
+	    blkcnt > cache_max_fill()) {
+		/* Write through, keeping what is cached up to date */
+		n = write(desc, start, blkcnt, buffer);
+		if (n <= blkcnt)
+			cache_update(dev, start, n, blksz, buffer);
+		return n;
+	}
+
+	/*
+	 * Write back: whole entries and those already cached take the data,
+	 * the rest is written to the device straight away
+	 */
+	for (blk = start; blk < end; ) {
+		lbaint_t line = cache_line(blk), to;
+		const char *src = (const char *)buffer + (blk - start) * blksz;
+
+		to = min(end, line + _stats.max_blocks_per_entry);
+		node = cache_find(dev, line, blksz);
+		if (!node && blk == line && cache_line_blocks(desc, line) ==
+		    _stats.max_blocks_per_entry &&
+		    to == line + _stats.max_blocks_per_entry)
+			node = cache_alloc(dev, line, to - line, blksz);
+		if (node) {
+			to = min(to, node->start + node->blkcnt);
+			if (to <= blk)
+				return blk - start;
+			memcpy(node->cache + (blk - line) * blksz, src,
+			       (to - blk) * blksz);
+			node->readahead = false;
+			if (!node->dirty) {
+				node->dirty = true;
+				_stats.entries_dirty++;
+			}
+		} else if (write(desc, blk, to - blk, src) != to - blk) {
+			return blk - start;
 		}
+		blk = to;
 	}
+
+	return blkcnt;
+}
+
+void blkcache_discard(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_dev *dev;
+
+	dev = cache_find_dev(desc->if_type, desc->devnum);
+	if (!dev || !_stats.max_blocks_per_entry)
+		return;
+
+	/* Entries only partly erased keep the rest of their data */
+	cache_flush_range(dev, start, blkcnt, desc->blksz, true);
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+int blkcache_flush(int iftype, int devnum)
 {
 	struct block_cache_node *node;
+	int ret = 0;
+
+	if (!_stats.entries_dirty)
+		return 0;
+
+	/* Oldest first, which tends to follow the order of the writes */
+	list_for_each_entry_reverse(node, &block_cache, lh)
+		if (node->dev->iftype == iftype &&
+		    node->dev->devnum == devnum &&
+		    cache_write_back(node))
+			ret = -EIO;
+
+	return ret;
+}
+
+int blkcache_flush_all(void)
+{
+	struct block_cache_node *node;
+	int ret = 0;
+
+	if (!_stats.entries_dirty)
+		return 0;
+
+	list_for_each_entry_reverse(node, &block_cache, lh)
+		if (cache_write_back(node))
+			ret = -EIO;
+
+	return ret;
+}
+
+void blkcache_invalidate(int iftype, int devnum)
+{
+	struct block_cache_node *node, *n;
+	struct block_cache_dev *dev;
+
+	dev = cache_find_dev(iftype, devnum);
+	if (!dev)
+		return;
+
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
+		if (node->dev == dev) {
+			cache_write_back(node);
+			cache_drop(node);
+		}
+	}
+	dev->next = 0;
+	dev->ra_blocks = 0;
+	dev->ra_end = 0;
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries, unsigned readahead)
+{
+	struct block_cache_node *node, *n;
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
 	    (entries != _stats.max_entries)) {
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
+		list_for_each_entry_safe(node, n, &block_cache, lh) {
+			cache_write_back(node);
+			cache_drop(node);
 		}
 		_stats.entries = 0;
+		_stats.entries_dirty = 0;
 	}
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+	_stats.max_readahead = readahead;
 
 	_stats.hits = 0;
+	_stats.partial_hits = 0;
 	_stats.misses = 0;
 }
 
@@ -168,5 +615,12 @@ void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
+	_stats.partial_hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
+	_stats.blocks_read = 0;
+	_stats.readahead = 0;
+	_stats.readahead_hits = 0;
+	_stats.readahead_wasted = 0;
+	_stats.written_back = 0;
 }
@@ -218,15 +218,80 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 }
 
 #ifdef CONFIG_BLK
+/*
+ * Requests are queued here and only done later, by poll(), so that tests can
+ * exercise the same path as drivers which do the transfer in the background.
+ */
+static int host_block_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	list_add_tail(&req->node, &host_dev->reqs);
+
+	return 0;
+}
+
+/* Do the oldest queued request, so each call makes a little progress */
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_request *req;
+	unsigned long n;
+	int count = 0;
+
+	if (list_empty(&host_dev->reqs))
+		return 0;
+
+	req = list_first_entry(&host_dev->reqs, struct blk_request, node);
+	list_del(&req->node);
+	if (req->write)
+		n = host_block_write(dev, req->start, req->blkcnt, req->buffer);
+	else
+		n = host_block_read(dev, req->start, req->blkcnt, req->buffer);
+	blk_request_complete(req, n == -1UL ? -EIO : n);
+
+	list_for_each_entry(req, &host_dev->reqs, node)
+		count++;
+
+	return count;
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	INIT_LIST_HEAD(&host_dev->reqs);
+
+	return 0;
+}
+
+static int host_block_remove(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_request *req, *next;
+
+	/* Nothing must be left pointing at the device */
+	list_for_each_entry_safe(req, next, &host_dev->reqs, node) {
+		list_del(&req->node);
+		blk_request_complete(req, -ENODEV);
+	}
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= host_block_probe,
+	.remove		= host_block_remove,
 	.platdata_auto_alloc_size = sizeof(struct host_block_dev),
 };
 #else
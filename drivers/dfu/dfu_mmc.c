@@ -198,6 +198,9 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 
 		/* Now that we're done */
 		dfu_file_buf_len = 0;
+	} else {
+		/* Raw writes may still be held in the block cache */
+		ret = blkcache_flush(IF_TYPE_MMC, dfu->data.mmc.dev_num);
 	}
 
 	return ret;
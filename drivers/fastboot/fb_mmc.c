@@ -82,6 +82,18 @@ static lbaint_t fb_mmc_blk_write(struct blk_desc *block_dev, lbaint_t start,
 	return blks;
 }
 
+/* Write back what the block cache holds before answering the host */
+static int fb_mmc_flush(struct blk_desc *dev_desc, char *response)
+{
+	if (blkcache_flush(dev_desc->if_type, dev_desc->devnum)) {
+		pr_err("failed writing to device %d\n", dev_desc->devnum);
+		fastboot_fail("failed writing to device", response);
+		return -EIO;
+	}
+
+	return 0;
+}
+
 static lbaint_t fb_mmc_sparse_write(struct sparse_storage *info,
 		lbaint_t blk, lbaint_t blkcnt, const void *buffer)
 {
@@ -123,6 +135,8 @@ static void write_raw_image(struct blk_desc *dev_desc, disk_partition_t *info,
 		fastboot_fail("failed writing to device", response);
 		return;
 	}
+	if (fb_mmc_flush(dev_desc, response))
+		return;
 
 	printf("........ wrote " LBAFU " bytes to '%s'\n", blkcnt * info->blksz,
 	       part_name);
@@ -284,6 +298,8 @@ static int fb_mmc_update_zimage(struct blk_desc *dev_desc,
 		fastboot_fail("cannot write back original ramdisk", response);
 		return -1;
 	}
+	if (fb_mmc_flush(dev_desc, response))
+		return -1;
 
 	puts("........ zImage was updated in boot partition\n");
 	fastboot_okay(NULL, response);
@@ -422,6 +438,8 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		sparse.priv = &sparse_priv;
 		err = write_sparse_image(&sparse, cmd, download_buffer,
 					 response);
+		if (!err)
+			err = fb_mmc_flush(dev_desc, response);
 		if (!err)
 			fastboot_okay(NULL, response);
 	} else {
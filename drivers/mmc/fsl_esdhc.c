@@ -22,6 +22,7 @@
 #include <fdt_support.h>
 #include <asm/io.h>
 #include <dm.h>
+#include <linux/iopoll.h>
 
 #if !CONFIG_IS_ENABLED(BLK)
 #include "mmc_private.h"
@@ -34,9 +35,37 @@ DECLARE_GLOBAL_DATA_PTR;
 				IRQSTATEN_CTOE | IRQSTATEN_CCE | IRQSTATEN_CEBE | \
 				IRQSTATEN_CIE | IRQSTATEN_DTOE | IRQSTATEN_DCE | \
 				IRQSTATEN_DEBE | IRQSTATEN_BRR | IRQSTATEN_BWR | \
-				IRQSTATEN_DINT)
+				IRQSTATEN_DINT | IRQSTATEN_DMAE)
 #define ESDHC_DRIVER_STAGE_VALUE 0xffffffff
 
+/*
+ * ADMA2 descriptor. PROCTL[DMAS] selects 32-bit ADMA2, with 8-byte
+ * descriptors, or 64-bit ADMA2, with 12-byte descriptors carrying the upper
+ * address word. The latter is only used when the controller supports it.
+ */
+struct fsl_esdhc_adma_desc {
+	u8	attr;
+	u8	reserved;
+	__le16	len;
+	__le32	addr_lo;
+	__le32	addr_hi;	/* 64-bit ADMA2 only */
+} __packed;
+
+#define ESDHC_ADMA_DESC_SZ_32		8
+#define ESDHC_ADMA_DESC_SZ_64		sizeof(struct fsl_esdhc_adma_desc)
+
+#define ESDHC_ADMA_DESC_VALID		BIT(0)
+#define ESDHC_ADMA_DESC_END		BIT(1)
+#define ESDHC_ADMA_DESC_TRAN		BIT(5)
+
+/* Largest length that fits the 16-bit field, kept word aligned */
+#define ESDHC_ADMA_MAX_LEN		65532
+#define ESDHC_ADMA_TABLE_ENTRIES	\
+	DIV_ROUND_UP(CONFIG_SYS_MMC_MAX_BLK_COUNT * MMC_MAX_BLOCK_LEN, \
+		     ESDHC_ADMA_MAX_LEN)
+#define ESDHC_ADMA_TABLE_SZ		\
+	(ESDHC_ADMA_TABLE_ENTRIES * sizeof(struct fsl_esdhc_adma_desc))
+
 struct fsl_esdhc {
 	uint    dsaddr;		/* SDMA system address register */
 	uint    blkattr;	/* Block attributes register */
@@ -59,8 +88,9 @@ struct fsl_esdhc {
 	char    reserved1[8];	/* reserved */
 	uint    fevt;		/* Force event register */
 	uint    admaes;		/* ADMA error status register */
-	uint    adsaddr;	/* ADMA system address register */
-	char    reserved2[160];
+	uint    adsaddrl;	/* ADMA system address low register */
+	uint    adsaddrh;	/* ADMA system address high register */
+	char    reserved2[156];
 	uint    hostver;	/* Host controller version register */
 	char    reserved3[4];	/* reserved */
 	uint    dmaerraddr;	/* DMA error address register */
@@ -68,7 +98,17 @@ struct fsl_esdhc {
 	uint    dmaerrattr;	/* DMA error attribute register */
 	char    reserved5[4];	/* reserved */
 	uint    hostcapblt2;	/* Host controller capabilities register 2 */
-	char    reserved6[756];	/* reserved */
+	char    reserved6[8];	/* reserved */
+	uint    tbctl;		/* Tuning block control register */
+	char    reserved7[32];	/* reserved */
+	uint    sdclkctl;	/* SD clock control register */
+	uint    sdtimingctl;	/* SD timing control register */
+	char    reserved8[20];	/* reserved */
+	uint    dllcfg0;	/* DLL config 0 register */
+	uint    dllcfg1;	/* DLL config 1 register */
+	char    reserved9[8];	/* reserved */
+	uint    dllstat0;	/* DLL status 0 register */
+	char    reserved10[664];/* reserved */
 	uint    esdhcctl;	/* eSDHC control register */
 };
 
@@ -91,6 +131,9 @@ struct fsl_esdhc_plat {
  * @wp_enable: 1: enable checking wp; 0: no check
  * @cd_gpio: gpio for card detection
  * @wp_gpio: gpio for write protection
+ * @adma_desc_table: ADMA2 descriptors, NULL when SDMA is used
+ * @adma_64bit: the descriptors are for 64-bit ADMA2
+ * @mode: bus mode the timing registers are set up for
  */
 struct fsl_esdhc_priv {
 	struct fsl_esdhc *esdhc_regs;
@@ -104,8 +147,17 @@ struct fsl_esdhc_priv {
 	struct udevice *dev;
 	int non_removable;
 	int wp_enable;
+	void *adma_desc_table;
+	bool adma_64bit;
+	enum bus_mode mode;
 };
 
+static bool esdhc_is_tuning_cmd(struct mmc_cmd *cmd)
+{
+	return cmd->cmdidx == MMC_CMD_SEND_TUNING_BLOCK ||
+	       cmd->cmdidx == MMC_CMD_SEND_TUNING_BLOCK_HS200;
+}
+
 /* Return the XFERTYP flags for a given command and data packet */
 static uint esdhc_xfertyp(struct mmc_cmd *cmd, struct mmc_data *data)
 {
@@ -114,7 +166,9 @@ static uint esdhc_xfertyp(struct mmc_cmd *cmd, struct mmc_data *data)
 	if (data) {
 		xfertyp |= XFERTYP_DPSEL;
 #ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
-		xfertyp |= XFERTYP_DMAEN;
+		/* The tuning block goes to the tuning logic, not to memory */
+		if (!esdhc_is_tuning_cmd(cmd))
+			xfertyp |= XFERTYP_DMAEN;
 #endif
 		if (data->blocks > 1) {
 			xfertyp |= XFERTYP_MSBSEL;
@@ -210,15 +264,82 @@ static void esdhc_pio_read_write(struct fsl_esdhc_priv *priv,
 }
 #endif
 
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+/*
+ * Describe the whole transfer with ADMA2 descriptors, so that the buffer
+ * can be anywhere in memory and the transfer never stops at the SDMA
+ * buffer boundaries.
+ */
+static void esdhc_prepare_adma_table(struct fsl_esdhc_priv *priv,
+				     dma_addr_t addr, uint len)
+{
+	uint desc_sz = priv->adma_64bit ? ESDHC_ADMA_DESC_SZ_64 :
+					  ESDHC_ADMA_DESC_SZ_32;
+	void *p = priv->adma_desc_table;
+	struct fsl_esdhc_adma_desc *desc;
+	uint chunk;
+
+	do {
+		desc = p;
+		chunk = min_t(uint, len, ESDHC_ADMA_MAX_LEN);
+		len -= chunk;
+
+		desc->attr = ESDHC_ADMA_DESC_VALID | ESDHC_ADMA_DESC_TRAN;
+		if (!len)
+			desc->attr |= ESDHC_ADMA_DESC_END;
+		desc->reserved = 0;
+		desc->len = cpu_to_le16(chunk);
+		desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+		if (priv->adma_64bit)
+			desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+		addr += chunk;
+		p += desc_sz;
+	} while (len);
+
+	flush_dcache_range((ulong)priv->adma_desc_table,
+			   ALIGN((ulong)p, ARCH_DMA_MINALIGN));
+}
+
+static int esdhc_setup_dma(struct fsl_esdhc_priv *priv, void *buf, uint len)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	dma_addr_t addr = virt_to_phys(buf);
+	dma_addr_t table;
+
+	/* 32-bit ADMA2 cannot reach above 4 GiB either, leave it to SDMA */
+	if (priv->adma_desc_table &&
+	    (priv->adma_64bit || !upper_32_bits(addr + len - 1))) {
+		table = virt_to_phys(priv->adma_desc_table);
+		esdhc_prepare_adma_table(priv, addr, len);
+		esdhc_write32(&regs->adsaddrl, lower_32_bits(table));
+		esdhc_write32(&regs->adsaddrh, upper_32_bits(table));
+		esdhc_clrsetbits32(&regs->proctl, PROCTL_DMAS_MASK,
+				   priv->adma_64bit ? PROCTL_DMAS_ADMA2_64 :
+						      PROCTL_DMAS_ADMA2);
+		return 0;
+	}
+
+	/* SDMA can only reach the first 4 GiB */
+	if (upper_32_bits(addr)) {
+		printf("Error found for upper 32 bits\n");
+		return -EINVAL;
+	}
+
+	esdhc_write32(&regs->dsaddr, lower_32_bits(addr));
+	esdhc_clrsetbits32(&regs->proctl, PROCTL_DMAS_MASK, PROCTL_DMAS_SDMA);
+
+	return 0;
+}
+#endif
+
 static int esdhc_setup_data(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 			    struct mmc_data *data)
 {
 	int timeout;
 	struct fsl_esdhc *regs = priv->esdhc_regs;
-#if defined(CONFIG_FSL_LAYERSCAPE)
-	dma_addr_t addr;
-#endif
+	uint len = data->blocks * data->blocksize;
 	uint wml_value;
+	int ret;
 
 	wml_value = data->blocksize/4;
 
@@ -228,21 +349,13 @@ static int esdhc_setup_data(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 
 		esdhc_clrsetbits32(&regs->wml, WML_RD_WML_MASK, wml_value);
 #ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
-#if defined(CONFIG_FSL_LAYERSCAPE)
-		addr = virt_to_phys((void *)(data->dest));
-		if (upper_32_bits(addr))
-			printf("Error found for upper 32 bits\n");
-		else
-			esdhc_write32(&regs->dsaddr, lower_32_bits(addr));
-#else
-		esdhc_write32(&regs->dsaddr, (u32)data->dest);
-#endif
+		ret = esdhc_setup_dma(priv, data->dest, len);
+		if (ret)
+			return ret;
 #endif
 	} else {
 #ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
-		flush_dcache_range((ulong)data->src,
-				   (ulong)data->src+data->blocks
-					 *data->blocksize);
+		flush_dcache_range((ulong)data->src, (ulong)data->src + len);
 #endif
 		if (wml_value > WML_WR_WML_MAX)
 			wml_value = WML_WR_WML_MAX_VAL;
@@ -257,15 +370,9 @@ static int esdhc_setup_data(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 		esdhc_clrsetbits32(&regs->wml, WML_WR_WML_MASK,
 					wml_value << 16);
 #ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
-#if defined(CONFIG_FSL_LAYERSCAPE)
-		addr = virt_to_phys((void *)(data->src));
-		if (upper_32_bits(addr))
-			printf("Error found for upper 32 bits\n");
-		else
-			esdhc_write32(&regs->dsaddr, lower_32_bits(addr));
-#else
-		esdhc_write32(&regs->dsaddr, (u32)data->src);
-#endif
+		ret = esdhc_setup_dma(priv, (void *)data->src, len);
+		if (ret)
+			return ret;
 #endif
 	}
 
@@ -318,31 +425,40 @@ static int esdhc_setup_data(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 static void check_and_invalidate_dcache_range
 	(struct mmc_cmd *cmd,
 	 struct mmc_data *data) {
-	unsigned start = 0;
-	unsigned end = 0;
-	unsigned size = roundup(ARCH_DMA_MINALIGN,
-				data->blocks*data->blocksize);
-#if defined(CONFIG_FSL_LAYERSCAPE)
-	dma_addr_t addr;
-
-	addr = virt_to_phys((void *)(data->dest));
-	if (upper_32_bits(addr))
-		printf("Error found for upper 32 bits\n");
-	else
-		start = lower_32_bits(addr);
-#else
-	start = (unsigned)data->dest;
-#endif
-	end = start + size;
-	invalidate_dcache_range(start, end);
+	ulong start = (ulong)data->dest;
+	ulong size = roundup(data->blocks * data->blocksize,
+			     ARCH_DMA_MINALIGN);
+
+	invalidate_dcache_range(start, start + size);
+}
+
+/* Reset the CMD and, for a command with data, DATA portions after an error */
+static void esdhc_reset_cmd_data(struct fsl_esdhc_priv *priv, bool data)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+
+	esdhc_write32(&regs->sysctl, esdhc_read32(&regs->sysctl) |
+		      SYSCTL_RSTC);
+	while (esdhc_read32(&regs->sysctl) & SYSCTL_RSTC)
+		;
+
+	if (data) {
+		esdhc_write32(&regs->sysctl,
+			      esdhc_read32(&regs->sysctl) |
+			      SYSCTL_RSTD);
+		while ((esdhc_read32(&regs->sysctl) & SYSCTL_RSTD))
+			;
+	}
+
+	esdhc_write32(&regs->irqstat, -1);
 }
 
 /*
- * Sends a command out on the bus.  Takes the mmc pointer,
- * a command pointer, and an optional data pointer.
+ * Sends a command out on the bus and waits for its response, leaving any
+ * data transfer in progress.
  */
-static int esdhc_send_cmd_common(struct fsl_esdhc_priv *priv, struct mmc *mmc,
-				 struct mmc_cmd *cmd, struct mmc_data *data)
+static int esdhc_start_cmd(struct fsl_esdhc_priv *priv, struct mmc *mmc,
+			   struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int	err = 0;
 	uint	xfertyp;
@@ -351,11 +467,6 @@ static int esdhc_send_cmd_common(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 	struct fsl_esdhc *regs = priv->esdhc_regs;
 	unsigned long start;
 
-#ifdef CONFIG_SYS_FSL_ERRATUM_ESDHC111
-	if (cmd->cmdidx == MMC_CMD_STOP_TRANSMISSION)
-		return 0;
-#endif
-
 	esdhc_write32(&regs->irqstat, -1);
 
 	sync();
@@ -381,10 +492,14 @@ static int esdhc_send_cmd_common(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 		if(err)
 			return err;
 
-		if (data->flags & MMC_DATA_READ)
+		if ((data->flags & MMC_DATA_READ) && !esdhc_is_tuning_cmd(cmd))
 			check_and_invalidate_dcache_range(cmd, data);
 	}
 
+	/* Tuning is complete once the block has been received */
+	if (esdhc_is_tuning_cmd(cmd))
+		flags = IRQSTAT_BRR | IRQSTAT_CTOE;
+
 	/* Figure out the transfer arguments */
 	xfertyp = esdhc_xfertyp(cmd, data);
 
@@ -449,56 +564,89 @@ static int esdhc_send_cmd_common(struct fsl_esdhc_priv *priv, struct mmc *mmc,
 	} else
 		cmd->response[0] = esdhc_read32(&regs->cmdrsp0);
 
+	return 0;
+
+out:
+	esdhc_reset_cmd_data(priv, data);
+
+	return err;
+}
+
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+/*
+ * Check whether the DMA transfer of a command started by esdhc_start_cmd()
+ * has finished, without waiting for it.
+ *
+ * Returns -EBUSY while it is still in progress.
+ */
+static int esdhc_check_data(struct fsl_esdhc_priv *priv,
+			    struct mmc_data *data)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	uint irqstat = esdhc_read32(&regs->irqstat);
+
+	if (irqstat & IRQSTAT_DTOE) {
+		esdhc_reset_cmd_data(priv, true);
+		return -ETIMEDOUT;
+	}
+
+	if (irqstat & DATA_ERR) {
+		esdhc_reset_cmd_data(priv, true);
+		return -ECOMM;
+	}
+
+	if ((irqstat & DATA_COMPLETE) != DATA_COMPLETE)
+		return -EBUSY;
+
+	/*
+	 * Need invalidate the dcache here again to avoid any
+	 * cache-fill during the DMA operations such as the
+	 * speculative pre-fetching etc.
+	 */
+	if (data->flags & MMC_DATA_READ)
+		check_and_invalidate_dcache_range(NULL, data);
+
+	esdhc_write32(&regs->irqstat, -1);
+
+	return 0;
+}
+#endif
+
+/*
+ * Sends a command out on the bus.  Takes the mmc pointer,
+ * a command pointer, and an optional data pointer.
+ */
+static int esdhc_send_cmd_common(struct fsl_esdhc_priv *priv, struct mmc *mmc,
+				 struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	int err;
+
+#ifdef CONFIG_SYS_FSL_ERRATUM_ESDHC111
+	if (cmd->cmdidx == MMC_CMD_STOP_TRANSMISSION)
+		return 0;
+#endif
+
+	err = esdhc_start_cmd(priv, mmc, cmd, data);
+	if (err)
+		return err;
+
 	/* Wait until all of the blocks are transferred */
-	if (data) {
+	if (data && !esdhc_is_tuning_cmd(cmd)) {
 #ifdef CONFIG_SYS_FSL_ESDHC_USE_PIO
 		esdhc_pio_read_write(priv, data);
 #else
 		do {
-			irqstat = esdhc_read32(&regs->irqstat);
-
-			if (irqstat & IRQSTAT_DTOE) {
-				err = -ETIMEDOUT;
-				goto out;
-			}
+			err = esdhc_check_data(priv, data);
+		} while (err == -EBUSY);
 
-			if (irqstat & DATA_ERR) {
-				err = -ECOMM;
-				goto out;
-			}
-		} while ((irqstat & DATA_COMPLETE) != DATA_COMPLETE);
-
-		/*
-		 * Need invalidate the dcache here again to avoid any
-		 * cache-fill during the DMA operations such as the
-		 * speculative pre-fetching etc.
-		 */
-		if (data->flags & MMC_DATA_READ) {
-			check_and_invalidate_dcache_range(cmd, data);
-		}
+		return err;
 #endif
 	}
 
-out:
-	/* Reset CMD and DATA portions on error */
-	if (err) {
-		esdhc_write32(&regs->sysctl, esdhc_read32(&regs->sysctl) |
-			      SYSCTL_RSTC);
-		while (esdhc_read32(&regs->sysctl) & SYSCTL_RSTC)
-			;
-
-		if (data) {
-			esdhc_write32(&regs->sysctl,
-				      esdhc_read32(&regs->sysctl) |
-				      SYSCTL_RSTD);
-			while ((esdhc_read32(&regs->sysctl) & SYSCTL_RSTD))
-				;
-		}
-	}
-
 	esdhc_write32(&regs->irqstat, -1);
 
-	return err;
+	return 0;
 }
 
 static void set_sysctl(struct fsl_esdhc_priv *priv, struct mmc *mmc, uint clock)
@@ -521,6 +669,26 @@ static void set_sysctl(struct fsl_esdhc_priv *priv, struct mmc *mmc, uint clock)
 	while (sdhc_clk / (div * pre_div * ddr_pre_div) > clock && div < 16)
 		div++;
 
+	/* The HS400 DLL needs an overall divider of 4, 8 or 12 */
+	if (IS_ENABLED(CONFIG_FSL_ESDHC_USE_PERIPHERAL_CLK) &&
+	    clock == 200000000 &&
+	    (mmc->selected_mode == MMC_HS_400 || mmc->hs400_tuning)) {
+		u32 div_ratio = pre_div * div;
+
+		if (div_ratio <= 4) {
+			pre_div = 4;
+			div = 1;
+		} else if (div_ratio <= 8) {
+			pre_div = 4;
+			div = 2;
+		} else if (div_ratio <= 12) {
+			pre_div = 4;
+			div = 3;
+		} else {
+			printf("fsl_esdhc: unsupported clock division\n");
+		}
+	}
+
 	pre_div >>= 1;
 	div -= 1;
 
@@ -544,7 +712,7 @@ static void set_sysctl(struct fsl_esdhc_priv *priv, struct mmc *mmc, uint clock)
 	esdhc_setbits32(&regs->sysctl, SYSCTL_PEREN | SYSCTL_CKEN);
 }
 
-#ifdef CONFIG_FSL_ESDHC_USE_PERIPHERAL_CLK
+#if defined(CONFIG_FSL_ESDHC_USE_PERIPHERAL_CLK) || defined(MMC_SUPPORTS_TUNING)
 static void esdhc_clock_control(struct fsl_esdhc_priv *priv, bool enable)
 {
 	struct fsl_esdhc *regs = priv->esdhc_regs;
@@ -573,15 +741,170 @@ static void esdhc_clock_control(struct fsl_esdhc_priv *priv, bool enable)
 }
 #endif
 
+#ifdef MMC_SUPPORTS_TUNING
+static void esdhc_flush_async_fifo(struct fsl_esdhc_priv *priv)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	u32 time_out;
+
+	esdhc_setbits32(&regs->esdhcctl, ESDHCCTL_FAF);
+
+	time_out = 20;
+	while (esdhc_read32(&regs->esdhcctl) & ESDHCCTL_FAF) {
+		if (time_out == 0) {
+			printf("fsl_esdhc: Flush asynchronous FIFO timeout.\n");
+			break;
+		}
+		time_out--;
+		mdelay(1);
+	}
+}
+
+static void esdhc_tuning_block_enable(struct fsl_esdhc_priv *priv, bool en)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+
+	esdhc_clock_control(priv, false);
+	esdhc_flush_async_fifo(priv);
+	if (en)
+		esdhc_setbits32(&regs->tbctl, TBCTL_TB_EN);
+	else
+		esdhc_clrbits32(&regs->tbctl, TBCTL_TB_EN);
+	esdhc_clock_control(priv, true);
+}
+
+static void esdhc_exit_hs400(struct fsl_esdhc_priv *priv)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+
+	esdhc_clrbits32(&regs->sdtimingctl, SDTIMINGCTL_FLW_CTL_BG);
+	esdhc_clrbits32(&regs->sdclkctl, SDCLKCTL_CMD_CLK_CTL);
+
+	esdhc_clock_control(priv, false);
+	esdhc_clrbits32(&regs->tbctl, TBCTL_HS400_MODE);
+	esdhc_clock_control(priv, true);
+
+	esdhc_clrbits32(&regs->dllcfg0, DLLCFG0_DLL_FREQ_SEL |
+					DLLCFG0_DLL_ENABLE);
+	esdhc_clrbits32(&regs->tbctl, TBCTL_HS400_WNDW_ADJUST);
+
+	esdhc_tuning_block_enable(priv, false);
+}
+
+/*
+ * Program the UHS mode of the bus. HS400 also needs the data strobe DLL
+ * locked to the card clock, and the command to be clocked from it.
+ */
+static int esdhc_set_timing(struct fsl_esdhc_priv *priv, struct mmc *mmc)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	enum bus_mode mode = mmc->selected_mode;
+	ulong start;
+	u32 uhsm;
+
+	if (priv->mode == mode)
+		return 0;
+
+	/* Leave HS400 before switching to any other mode */
+	if (priv->mode == MMC_HS_400)
+		esdhc_exit_hs400(priv);
+
+	switch (mode) {
+	case UHS_SDR25:
+		uhsm = AUTOC12ERR_UHSM_SDR25;
+		break;
+	case UHS_SDR50:
+		uhsm = AUTOC12ERR_UHSM_SDR50;
+		break;
+	case UHS_SDR104:
+	case MMC_HS_200:
+	case MMC_HS_400:
+		uhsm = AUTOC12ERR_UHSM_SDR104;
+		break;
+	case UHS_DDR50:
+		uhsm = AUTOC12ERR_UHSM_DDR50;
+		break;
+	default:
+		uhsm = AUTOC12ERR_UHSM_SDR12;
+		break;
+	}
+
+	esdhc_clock_control(priv, false);
+	esdhc_clrsetbits32(&regs->autoc12err, AUTOC12ERR_UHSM_MASK, uhsm);
+
+	if (mode == MMC_HS_400) {
+		esdhc_setbits32(&regs->tbctl, TBCTL_HS400_MODE);
+		esdhc_setbits32(&regs->sdclkctl, SDCLKCTL_CMD_CLK_CTL);
+		esdhc_clock_control(priv, true);
+
+		if (mmc->clock == 200000000)
+			esdhc_setbits32(&regs->dllcfg0, DLLCFG0_DLL_FREQ_SEL);
+
+		esdhc_setbits32(&regs->dllcfg0, DLLCFG0_DLL_ENABLE);
+
+		esdhc_setbits32(&regs->dllcfg0, DLLCFG0_DLL_RESET);
+		udelay(1);
+		esdhc_clrbits32(&regs->dllcfg0, DLLCFG0_DLL_RESET);
+
+		start = get_timer(0);
+		while (!(esdhc_read32(&regs->dllstat0) & DLLSTAT0_SLV_LOCK)) {
+			if (get_timer(start) > 1000) {
+				printf("fsl_esdhc: delay chain lock timeout\n");
+				return -ETIMEDOUT;
+			}
+		}
+
+		esdhc_setbits32(&regs->tbctl, TBCTL_HS400_WNDW_ADJUST);
+
+		esdhc_clock_control(priv, false);
+		esdhc_flush_async_fifo(priv);
+	}
+	esdhc_clock_control(priv, true);
+
+	priv->mode = mode;
+
+	return 0;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_IO_VOLTAGE)
+static int esdhc_set_voltage(struct fsl_esdhc_priv *priv,
+			     enum mmc_voltage voltage)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+
+	switch (voltage) {
+	case MMC_SIGNAL_VOLTAGE_330:
+		/* The workaround keeps the IO at 1.8V */
+		if (IS_ENABLED(CONFIG_FSL_ESDHC_33V_IO_RELIABILITY_WORKAROUND))
+			return -ENOTSUPP;
+		esdhc_clrbits32(&regs->proctl, PROCTL_VOLT_SEL);
+		return 0;
+	case MMC_SIGNAL_VOLTAGE_180:
+		esdhc_setbits32(&regs->proctl, PROCTL_VOLT_SEL);
+		return 0;
+	default:
+		return -ENOTSUPP;
+	}
+}
+#endif
+
 static int esdhc_set_ios_common(struct fsl_esdhc_priv *priv, struct mmc *mmc)
 {
 	struct fsl_esdhc *regs = priv->esdhc_regs;
+	int __maybe_unused ret;
 
 #ifdef CONFIG_FSL_ESDHC_USE_PERIPHERAL_CLK
 	/* Select to use peripheral clock */
 	esdhc_clock_control(priv, false);
 	esdhc_setbits32(&regs->esdhcctl, ESDHCCTL_PCS);
 	esdhc_clock_control(priv, true);
+#endif
+#ifdef MMC_SUPPORTS_TUNING
+	/* Set the bus timing, which also sets up the HS400 DLL */
+	ret = esdhc_set_timing(priv, mmc);
+	if (ret)
+		return ret;
 #endif
 	/* Set the clock speed */
 	if (priv->clock != mmc->clock)
@@ -595,6 +918,13 @@ static int esdhc_set_ios_common(struct fsl_esdhc_priv *priv, struct mmc *mmc)
 	else if (mmc->bus_width == 8)
 		esdhc_setbits32(&regs->proctl, PROCTL_DTW_8);
 
+#if CONFIG_IS_ENABLED(MMC_IO_VOLTAGE)
+	/* Set the signal voltage */
+	ret = esdhc_set_voltage(priv, mmc->signal_voltage);
+	if (ret)
+		return ret;
+#endif
+
 	return 0;
 }
 
@@ -632,6 +962,9 @@ static int esdhc_init_common(struct fsl_esdhc_priv *priv, struct mmc *mmc)
 		if (get_timer(start) > 1000)
 			return -ETIMEDOUT;
 	}
+
+	/* The reset also took the bus timing back to legacy */
+	priv->mode = MMC_LEGACY;
 #ifdef CONFIG_FSL_ESDHC_33V_IO_RELIABILITY_WORKAROUND
 	if (!esdhc_getcd_common(priv)) {
 		esdhc_setbits32(&regs->proctl, PROCTL_VOLT_SEL);
@@ -738,6 +1071,33 @@ static int fsl_esdhc_init(struct fsl_esdhc_priv *priv,
 				       SYSCTL_IPGEN | SYSCTL_CKEN);
 
 	writel(SDHCI_IRQ_EN_BITS, &regs->irqstaten);
+
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+	if (IS_ENABLED(CONFIG_FSL_ESDHC_SUPPORT_ADMA2) &&
+	    !priv->adma_desc_table) {
+		priv->adma_desc_table = memalign(ARCH_DMA_MINALIGN,
+						 ESDHC_ADMA_TABLE_SZ);
+		if (!priv->adma_desc_table)
+			debug("fsl_esdhc: no ADMA2 table, using SDMA\n");
+	}
+
+	/*
+	 * 64-bit ADMA2 only if the controller has it, otherwise 32-bit ADMA2
+	 * is used below 4 GiB and SDMA, with its own limit, elsewhere
+	 */
+	priv->adma_64bit = IS_ENABLED(CONFIG_DMA_ADDR_T_64BIT) &&
+			   (esdhc_read32(&regs->hostcapblt) &
+			    ESDHC_HOSTCAPBLT_BIT64);
+
+	/* The table itself must be reachable in 32-bit mode */
+	if (priv->adma_desc_table && !priv->adma_64bit &&
+	    upper_32_bits(virt_to_phys(priv->adma_desc_table))) {
+		free(priv->adma_desc_table);
+		priv->adma_desc_table = NULL;
+		debug("fsl_esdhc: ADMA2 table above 4 GiB, using SDMA\n");
+	}
+#endif
+
 	cfg = &plat->cfg;
 #ifndef CONFIG_DM_MMC
 	memset(cfg, '\0', sizeof(*cfg));
@@ -1101,6 +1461,24 @@ static int fsl_esdhc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	return esdhc_send_cmd_common(priv, &plat->mmc, cmd, data);
 }
 
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+static int fsl_esdhc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+				    struct mmc_data *data)
+{
+	struct fsl_esdhc_plat *plat = dev_get_platdata(dev);
+	struct fsl_esdhc_priv *priv = dev_get_priv(dev);
+
+	return esdhc_start_cmd(priv, &plat->mmc, cmd, data);
+}
+
+static int fsl_esdhc_send_cmd_poll(struct udevice *dev, struct mmc_data *data)
+{
+	struct fsl_esdhc_priv *priv = dev_get_priv(dev);
+
+	return esdhc_check_data(priv, data);
+}
+#endif
+
 static int fsl_esdhc_set_ios(struct udevice *dev)
 {
 	struct fsl_esdhc_plat *plat = dev_get_platdata(dev);
@@ -1109,13 +1487,89 @@ static int fsl_esdhc_set_ios(struct udevice *dev)
 	return esdhc_set_ios_common(priv, &plat->mmc);
 }
 
+#ifdef MMC_SUPPORTS_TUNING
+static int fsl_esdhc_execute_tuning(struct udevice *dev, uint32_t opcode)
+{
+	struct fsl_esdhc_plat *plat = dev_get_platdata(dev);
+	struct fsl_esdhc_priv *priv = dev_get_priv(dev);
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	struct mmc *mmc = &plat->mmc;
+	u32 val, irqstaten;
+	int i, ret = 0;
+
+	/* The HS400 clock divider is already needed while tuning */
+	if (IS_ENABLED(CONFIG_FSL_ESDHC_USE_PERIPHERAL_CLK) &&
+	    mmc->hs400_tuning)
+		set_sysctl(priv, mmc, mmc->clock);
+
+	esdhc_tuning_block_enable(priv, true);
+	esdhc_setbits32(&regs->autoc12err, AUTOC12ERR_EXECUTE_TUNING);
+
+	irqstaten = esdhc_read32(&regs->irqstaten);
+	esdhc_write32(&regs->irqstaten, IRQSTATEN_BRR | IRQSTATEN_CC |
+					IRQSTATEN_CTOE);
+
+	/*
+	 * The controller moves the sampling point after each tuning block
+	 * and clears EXECUTE_TUNING once it is done; the block contents do
+	 * not matter. A tuning command that fails is a failed tap, and the
+	 * tuning only passes if the tap it ends on works.
+	 */
+	for (i = 0; i < ESDHC_MAX_TUNING_LOOP; i++) {
+		ret = mmc_send_tuning(mmc, opcode, NULL);
+		if (ret)
+			debug("fsl_esdhc: tuning block %d failed (%d)\n", i,
+			      ret);
+		mdelay(1);
+
+		val = esdhc_read32(&regs->autoc12err);
+		if (!(val & AUTOC12ERR_EXECUTE_TUNING))
+			break;
+	}
+
+	esdhc_write32(&regs->irqstaten, irqstaten);
+
+	if (i != ESDHC_MAX_TUNING_LOOP && (val & AUTOC12ERR_SMPCLKSEL) &&
+	    !ret) {
+		if (mmc->hs400_tuning)
+			esdhc_setbits32(&regs->sdtimingctl,
+					SDTIMINGCTL_FLW_CTL_BG);
+		return 0;
+	}
+
+	printf("fsl_esdhc: tuning failed!\n");
+	esdhc_clrbits32(&regs->autoc12err, AUTOC12ERR_SMPCLKSEL |
+					   AUTOC12ERR_EXECUTE_TUNING);
+	esdhc_tuning_block_enable(priv, false);
+
+	return -ETIMEDOUT;
+}
+#endif
+
+static int fsl_esdhc_wait_dat0(struct udevice *dev, int state,
+			       int timeout_us)
+{
+	struct fsl_esdhc_priv *priv = dev_get_priv(dev);
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	u32 tmp;
+
+	return readx_poll_timeout(esdhc_read32, &regs->prsstat, tmp,
+				  !!(tmp & PRSSTAT_DAT0) == !!state,
+				  timeout_us);
+}
+
 static const struct dm_mmc_ops fsl_esdhc_ops = {
 	.get_cd		= fsl_esdhc_get_cd,
 	.send_cmd	= fsl_esdhc_send_cmd,
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+	.send_cmd_start	= fsl_esdhc_send_cmd_start,
+	.send_cmd_poll	= fsl_esdhc_send_cmd_poll,
+#endif
 	.set_ios	= fsl_esdhc_set_ios,
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning = fsl_esdhc_execute_tuning,
 #endif
+	.wait_dat0	= fsl_esdhc_wait_dat0,
 };
 #endif
 
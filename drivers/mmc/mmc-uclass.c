@@ -11,6 +11,10 @@
 #include <dm/lists.h>
 #include "mmc_private.h"
 
+#if CONFIG_IS_ENABLED(BLK)
+static int mmc_async_poll(struct mmc_uclass_priv *upriv);
+#endif
+
 int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		    struct mmc_data *data)
 {
@@ -18,6 +22,14 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
 	int ret;
 
+#if CONFIG_IS_ENABLED(BLK)
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+
+	/* Reads queued with blk_submit() have the bus until they are done */
+	while (upriv->busy)
+		mmc_async_poll(upriv);
+#endif
+
 	mmmc_trace_before_send(mmc, cmd);
 	if (ops->send_cmd)
 		ret = ops->send_cmd(dev, cmd, data);
@@ -61,6 +73,25 @@ int mmc_wait_dat0(struct mmc *mmc, int state, int timeout_us)
 	return dm_mmc_wait_dat0(mmc->dev, state, timeout_us);
 }
 
+int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+			  struct mmc_data *data)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->send_cmd_start)
+		return -ENOSYS;
+	return ops->send_cmd_start(dev, cmd, data);
+}
+
+int dm_mmc_send_cmd_poll(struct udevice *dev, struct mmc_data *data)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->send_cmd_poll)
+		return -ENOSYS;
+	return ops->send_cmd_poll(dev, data);
+}
+
 int dm_mmc_get_wp(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -368,6 +399,8 @@ static int mmc_select_hwpart(struct udevice *bdev, int hwpart)
 	if (mmc->part_config == MMCPART_NOAVAILABLE)
 		return -EMEDIUMTYPE;
 
+	/* Cached blocks belong to the current partition */
+	blkcache_flush(desc->if_type, desc->devnum);
 	ret = mmc_switch_part(mmc, hwpart);
 	if (!ret)
 		blkcache_invalidate(desc->if_type, desc->devnum);
@@ -404,6 +437,142 @@ static int mmc_blk_remove(struct udevice *dev)
 }
 #endif
 
+/* Describe the part of a queued read which is transferred next */
+static void mmc_async_data(struct mmc *mmc, struct blk_request *req,
+			   lbaint_t blocks, struct mmc_data *data)
+{
+	data->dest = req->buffer + req->issued * mmc->read_bl_len;
+	data->blocks = blocks;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
+
+/*
+ * Start reading the next part of the first queued request, at most b_max
+ * blocks. On error the request is marked as failed after the blocks read
+ * so far.
+ */
+static void mmc_async_issue(struct mmc_uclass_priv *upriv)
+{
+	struct mmc *mmc = upriv->mmc;
+	struct blk_request *req;
+	struct blk_desc *desc;
+	struct mmc_data data;
+	struct mmc_cmd cmd;
+	lbaint_t cur;
+
+	req = list_first_entry(&upriv->reqs, struct blk_request, node);
+	desc = dev_get_uclass_platdata(req->dev);
+	if (!req->issued &&
+	    (blk_dselect_hwpart(desc, desc->hwpart) < 0 ||
+	     mmc_set_blocklen(mmc, mmc->read_bl_len))) {
+		req->good = 0;
+		return;
+	}
+
+	cur = min_t(lbaint_t, req->blkcnt - req->issued, mmc->cfg->b_max);
+	if (cur > 1)
+		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+	else
+		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+	cmd.cmdarg = req->start + req->issued;
+	if (!mmc->high_capacity)
+		cmd.cmdarg *= mmc->read_bl_len;
+	cmd.resp_type = MMC_RSP_R1;
+	mmc_async_data(mmc, req, cur, &data);
+
+	if (dm_mmc_send_cmd_start(mmc->dev, &cmd, &data)) {
+		req->good = req->issued;
+		return;
+	}
+	req->inflight = cur;
+	upriv->busy = true;
+}
+
+/*
+ * Finish the transfer in flight if it is done, complete the requests which
+ * need nothing more and start the next transfer.
+ *
+ * Returns the number of requests not yet completed.
+ */
+static int mmc_async_poll(struct mmc_uclass_priv *upriv)
+{
+	struct mmc *mmc = upriv->mmc;
+	struct blk_request *req;
+	struct mmc_data data;
+	struct mmc_cmd cmd;
+	int pending = 0;
+	int ret;
+
+	if (upriv->busy) {
+		req = list_first_entry(&upriv->reqs, struct blk_request, node);
+		mmc_async_data(mmc, req, req->inflight, &data);
+		ret = dm_mmc_send_cmd_poll(mmc->dev, &data);
+		if (ret == -EBUSY)
+			goto out;
+
+		upriv->busy = false;
+		if (!ret && req->inflight > 1) {
+			cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+			cmd.cmdarg = 0;
+			cmd.resp_type = MMC_RSP_R1b;
+			ret = mmc_send_cmd(mmc, &cmd, NULL);
+		}
+		if (ret)
+			req->good = req->issued;
+		else
+			req->issued += req->inflight;
+		req->inflight = 0;
+	}
+
+	while (!upriv->busy && !list_empty(&upriv->reqs)) {
+		req = list_first_entry(&upriv->reqs, struct blk_request, node);
+		if (req->issued < req->blkcnt && req->good == req->blkcnt) {
+			mmc_async_issue(upriv);
+			continue;
+		}
+
+		list_del(&req->node);
+		blk_request_complete(req, req->good);
+	}
+
+out:
+	list_for_each_entry(req, &upriv->reqs, node)
+		pending++;
+
+	return pending;
+}
+
+static int mmc_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct udevice *mmc_dev = dev_get_parent(dev);
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(mmc_dev);
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc_dev);
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	/* Only reads are queued: writes need the card's busy handling */
+	if (req->write || !ops->send_cmd_start || !ops->send_cmd_poll)
+		return -ENOSYS;
+
+	if (req->start + req->blkcnt > desc->lba)
+		return -EINVAL;
+
+	req->issued = 0;
+	req->good = req->blkcnt;
+	req->inflight = 0;
+	list_add_tail(&req->node, &upriv->reqs);
+	mmc_async_poll(upriv);
+
+	return 0;
+}
+
+static int mmc_blk_poll(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev_get_parent(dev));
+
+	return mmc_async_poll(upriv);
+}
+
 static const struct blk_ops mmc_blk_ops = {
 	.read	= mmc_bread,
 #if CONFIG_IS_ENABLED(MMC_WRITE)
@@ -411,6 +580,8 @@ static const struct blk_ops mmc_blk_ops = {
 	.erase	= mmc_berase,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
+	.submit	= mmc_blk_submit,
+	.poll	= mmc_blk_poll,
 };
 
 U_BOOT_DRIVER(mmc_blk) = {
@@ -428,9 +599,19 @@ U_BOOT_DRIVER(mmc_blk) = {
 #endif /* CONFIG_BLK */
 
 
+static int mmc_pre_probe(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+
+	INIT_LIST_HEAD(&upriv->reqs);
+
+	return 0;
+}
+
 UCLASS_DRIVER(mmc) = {
 	.id		= UCLASS_MMC,
 	.name		= "mmc",
 	.flags		= DM_UC_FLAG_SEQ_ALIAS,
+	.pre_probe	= mmc_pre_probe,
 	.per_device_auto_alloc_size = sizeof(struct mmc_uclass_priv),
 };
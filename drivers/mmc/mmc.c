@@ -1928,7 +1928,9 @@ static int mmc_select_hs400(struct mmc *mmc)
 	mmc_set_clock(mmc, mmc->tran_speed, false);
 
 	/* execute tuning if needed */
+	mmc->hs400_tuning = true;
 	err = mmc_execute_tuning(mmc, MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	mmc->hs400_tuning = false;
 	if (err) {
 		debug("tuning failed\n");
 		return err;
@@ -2998,6 +3000,88 @@ int mmc_initialize(bd_t *bis)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DM_MMC) && CONFIG_IS_ENABLED(BLK_PARALLEL_PROBE)
+/* Starts the card power-up on each host, leaving MMC cards to get ready */
+static int mmc_blk_probe_start(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	struct mmc *mmc;
+	int ret;
+
+	ret = mmc_initialize(NULL);
+	if (ret)
+		return ret;
+
+	ret = uclass_get(UCLASS_MMC, &uc);
+	if (ret)
+		return ret;
+
+	uclass_foreach_dev(dev, uc) {
+		mmc = device_active(dev) ? mmc_get_mmc_dev(dev) : NULL;
+		if (!mmc || mmc->has_init || mmc->init_in_progress)
+			continue;
+		mmc_start_init(mmc);
+	}
+
+	return 0;
+}
+
+/* Checks whether the MMC cards left powering up are ready */
+static int mmc_blk_probe_poll(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	struct mmc *mmc;
+	int ret;
+
+	ret = uclass_get(UCLASS_MMC, &uc);
+	if (ret)
+		return ret;
+
+	uclass_foreach_dev(dev, uc) {
+		mmc = device_active(dev) ? mmc_get_mmc_dev(dev) : NULL;
+		if (!mmc || !mmc->init_in_progress || !mmc->op_cond_pending ||
+		    (mmc->ocr & OCR_BUSY))
+			continue;
+		/* mmc_complete_init() reports any error */
+		if (mmc_send_op_cond_iter(mmc, 1))
+			continue;
+		if (!(mmc->ocr & OCR_BUSY))
+			return -EAGAIN;
+	}
+
+	return 0;
+}
+
+static int mmc_blk_probe_finish(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	struct mmc *mmc;
+	int ret;
+
+	ret = uclass_get(UCLASS_MMC, &uc);
+	if (ret)
+		return ret;
+
+	uclass_foreach_dev(dev, uc) {
+		mmc = device_active(dev) ? mmc_get_mmc_dev(dev) : NULL;
+		if (mmc && mmc->init_in_progress)
+			mmc_init(mmc);
+	}
+
+	return 0;
+}
+
+U_BOOT_BLK_PROBE(mmc) = {
+	.name	= "MMC",
+	.start	= mmc_blk_probe_start,
+	.poll	= mmc_blk_probe_poll,
+	.finish	= mmc_blk_probe_finish,
+};
+#endif
+
 #ifdef CONFIG_CMD_BKOPS_ENABLE
 int mmc_set_bkops_enable(struct mmc *mmc)
 {
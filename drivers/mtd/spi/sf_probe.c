@@ -12,6 +12,7 @@
 #include <errno.h>
 #include <malloc.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 
 #include "sf_internal.h"
@@ -152,6 +153,19 @@ static int spi_flash_std_probe(struct udevice *dev)
 
 static int spi_flash_std_remove(struct udevice *dev)
 {
+	struct spi_flash *flash = dev_get_uclass_priv(dev);
+	int ret;
+
+	ret = spi_nor_remove(flash);
+	if (ret)
+		return ret;
+
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	if (flash->dirmap_rdesc) {
+		spi_mem_dirmap_destroy(flash->dirmap_rdesc);
+		flash->dirmap_rdesc = NULL;
+	}
+#endif
 #ifdef CONFIG_SPI_FLASH_MTD
 	spi_flash_mtd_unregister();
 #endif
@@ -178,6 +192,7 @@ U_BOOT_DRIVER(spi_flash_std) = {
 	.remove		= spi_flash_std_remove,
 	.priv_auto_alloc_size = sizeof(struct spi_flash),
 	.ops		= &spi_flash_std_ops,
+	.flags		= DM_FLAG_OS_PREPARE,
 };
 
 #endif /* CONFIG_DM_SPI_FLASH */
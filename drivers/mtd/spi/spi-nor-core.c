@@ -34,6 +34,58 @@
 
 #define DEFAULT_READY_WAIT_JIFFIES		(40UL * HZ)
 
+/*
+ * Apply the bus widths of @proto to @op. In DTR the dummy phase is counted in
+ * bytes on both clock edges, and in 8D-8D-8D the opcode grows to two bytes:
+ * the command followed by the extension byte described by SFDP.
+ */
+static void spi_nor_setup_op(const struct spi_nor *nor,
+			     struct spi_mem_op *op,
+			     const enum spi_nor_protocol proto)
+{
+	u8 ext;
+
+	op->cmd.buswidth = spi_nor_get_protocol_inst_nbits(proto);
+
+	if (op->addr.nbytes)
+		op->addr.buswidth = spi_nor_get_protocol_addr_nbits(proto);
+
+	if (op->dummy.nbytes)
+		op->dummy.buswidth = spi_nor_get_protocol_addr_nbits(proto);
+
+	if (op->data.nbytes)
+		op->data.buswidth = spi_nor_get_protocol_data_nbits(proto);
+
+	if (!spi_nor_protocol_is_dtr(proto))
+		return;
+
+	op->cmd.dtr = 1;
+	op->addr.dtr = 1;
+	op->dummy.dtr = 1;
+	op->data.dtr = 1;
+
+	/* 2 bytes per clock cycle in DTR mode. */
+	op->dummy.nbytes *= 2;
+
+	if (spi_nor_get_protocol_inst_nbits(proto) != 8)
+		return;
+
+	switch (nor->cmd_ext_type) {
+	case SPI_NOR_EXT_REPEAT:
+		ext = op->cmd.opcode;
+		break;
+	case SPI_NOR_EXT_INVERT:
+		ext = ~op->cmd.opcode;
+		break;
+	default:
+		/* Leave the opcode alone, supports_op() will refuse it. */
+		return;
+	}
+
+	op->cmd.opcode = (op->cmd.opcode << 8) | ext;
+	op->cmd.nbytes = 2;
+}
+
 static int spi_nor_read_write_reg(struct spi_nor *nor, struct spi_mem_op
 		*op, void *buf)
 {
@@ -52,6 +104,8 @@ static int spi_nor_read_reg(struct spi_nor *nor, u8 code, u8 *val, int len)
 					  SPI_MEM_OP_DATA_IN(len, NULL, 1));
 	int ret;
 
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
 	ret = spi_nor_read_write_reg(nor, &op, val);
 	if (ret < 0)
 		dev_dbg(&flash->spimem->spi->dev, "error %d reading %x\n", ret,
@@ -67,28 +121,94 @@ static int spi_nor_write_reg(struct spi_nor *nor, u8 opcode, u8 *buf, int len)
 					  SPI_MEM_OP_NO_DUMMY,
 					  SPI_MEM_OP_DATA_OUT(len, NULL, 1));
 
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
 	return spi_nor_read_write_reg(nor, &op, buf);
 }
 
-static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
-				 u_char *buf)
+/*
+ * In 8D-8D-8D mode the status registers are read with an address and a dummy
+ * phase, and the data phase is 2 bytes long since it spans a full clock.
+ */
+static int spi_nor_read_reg_octal_dtr(struct spi_nor *nor, u8 code, u8 *val)
 {
-	struct spi_mem_op op =
+	struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(code, 1),
+					  SPI_MEM_OP_ADDR(nor->rdsr_addr_nbytes,
+							  0, 1),
+					  SPI_MEM_OP_DUMMY(nor->rdsr_dummy, 1),
+					  SPI_MEM_OP_DATA_IN(2, NULL, 1));
+
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
+	return spi_nor_read_write_reg(nor, &op, val);
+}
+
+/*
+ * Fill in the read operation for the current read opcode and protocol. The
+ * address, length and buffer are left for the caller to set.
+ */
+static void spi_nor_setup_read_op(struct spi_nor *nor, struct spi_mem_op *op)
+{
+	struct spi_mem_op tmpl =
 			SPI_MEM_OP(SPI_MEM_OP_CMD(nor->read_opcode, 1),
-				   SPI_MEM_OP_ADDR(nor->addr_width, from, 1),
+				   SPI_MEM_OP_ADDR(nor->addr_width, 0, 1),
 				   SPI_MEM_OP_DUMMY(nor->read_dummy, 1),
-				   SPI_MEM_OP_DATA_IN(len, buf, 1));
-	size_t remaining = len;
-	int ret;
+				   SPI_MEM_OP_DATA_IN(0, NULL, 1));
 
-	/* get transfer protocols. */
-	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
-	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
-	op.dummy.buswidth = op.addr.buswidth;
-	op.data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
+	*op = tmpl;
 
 	/* convert the dummy cycles to the number of bytes */
-	op.dummy.nbytes = (nor->read_dummy * op.dummy.buswidth) / 8;
+	op->dummy.nbytes = (nor->read_dummy *
+			    spi_nor_get_protocol_addr_nbits(nor->read_proto)) / 8;
+
+	/* get transfer protocols. */
+	spi_nor_setup_op(nor, op, nor->read_proto);
+
+	/* the template carries no length, set the data width by hand */
+	op->data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
+}
+
+static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
+				 u_char *buf)
+{
+	struct spi_mem_op op;
+	size_t remaining;
+	int ret;
+
+	spi_nor_setup_read_op(nor, &op);
+
+	/*
+	 * A DTR data phase moves two bytes per clock, so only even addresses
+	 * and lengths can be read. Trim the length, or bounce a lone odd byte
+	 * through a 2-byte read; the caller loops on short reads.
+	 */
+	if (spi_nor_protocol_is_dtr(nor->read_proto) && ((from | len) & 1)) {
+		if (!(from & 1) && len > 1) {
+			len &= ~1;
+		} else {
+			u8 tmp[2];
+
+			op.addr.val = from & ~1;
+			op.data.nbytes = 2;
+			op.data.buf.in = tmp;
+			ret = spi_mem_exec_op(nor->spi, &op);
+			if (ret)
+				return ret;
+
+			buf[0] = tmp[from & 1];
+			return 1;
+		}
+	}
+
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	/* The caller loops on short reads, so hand it over in one go. */
+	if (nor->dirmap_rdesc)
+		return spi_mem_dirmap_read(nor->dirmap_rdesc, from, len, buf);
+#endif
+
+	remaining = len;
+	op.addr.val = from;
+	op.data.buf.in = buf;
 
 	while (remaining) {
 		op.data.nbytes = remaining < UINT_MAX ? remaining : UINT_MAX;
@@ -118,14 +238,36 @@ static ssize_t spi_nor_write_data(struct spi_nor *nor, loff_t to, size_t len,
 				   SPI_MEM_OP_DATA_OUT(len, buf, 1));
 	int ret;
 
-	/* get transfer protocols. */
-	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->write_proto);
-	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->write_proto);
-	op.data.buswidth = spi_nor_get_protocol_data_nbits(nor->write_proto);
-
 	if (nor->program_opcode == SPINOR_OP_AAI_WP && nor->sst_write_second)
 		op.addr.nbytes = 0;
 
+	/* get transfer protocols. */
+	spi_nor_setup_op(nor, &op, nor->write_proto);
+
+	/*
+	 * Same alignment rule as for DTR reads, a lone odd byte is padded with
+	 * 0xff which leaves the neighbouring byte in the array untouched.
+	 */
+	if (spi_nor_protocol_is_dtr(nor->write_proto) && ((to | len) & 1)) {
+		if (!(to & 1) && len > 1) {
+			len &= ~1;
+			op.data.nbytes = len;
+		} else {
+			u8 pad[2];
+
+			pad[to & 1] = buf[0];
+			pad[!(to & 1)] = 0xff;
+			op.addr.val = to & ~1;
+			op.data.nbytes = 2;
+			op.data.buf.out = pad;
+			ret = spi_mem_exec_op(nor->spi, &op);
+			if (ret)
+				return ret;
+
+			return 1;
+		}
+	}
+
 	ret = spi_mem_adjust_op_size(nor->spi, &op);
 	if (ret)
 		return ret;
@@ -146,15 +288,18 @@ static ssize_t spi_nor_write_data(struct spi_nor *nor, loff_t to, size_t len,
 static int read_sr(struct spi_nor *nor)
 {
 	int ret;
-	u8 val;
+	u8 val[2];
 
-	ret = nor->read_reg(nor, SPINOR_OP_RDSR, &val, 1);
+	if (nor->reg_proto == SNOR_PROTO_8_8_8_DTR)
+		ret = spi_nor_read_reg_octal_dtr(nor, SPINOR_OP_RDSR, val);
+	else
+		ret = nor->read_reg(nor, SPINOR_OP_RDSR, val, 1);
 	if (ret < 0) {
 		pr_debug("error %d reading SR\n", (int)ret);
 		return ret;
 	}
 
-	return val;
+	return val[0];
 }
 
 /*
@@ -165,15 +310,18 @@ static int read_sr(struct spi_nor *nor)
 static int read_fsr(struct spi_nor *nor)
 {
 	int ret;
-	u8 val;
+	u8 val[2];
 
-	ret = nor->read_reg(nor, SPINOR_OP_RDFSR, &val, 1);
+	if (nor->reg_proto == SNOR_PROTO_8_8_8_DTR)
+		ret = spi_nor_read_reg_octal_dtr(nor, SPINOR_OP_RDFSR, val);
+	else
+		ret = nor->read_reg(nor, SPINOR_OP_RDFSR, val, 1);
 	if (ret < 0) {
 		pr_debug("error %d reading FSR\n", ret);
 		return ret;
 	}
 
-	return val;
+	return val[0];
 }
 
 /*
@@ -204,6 +352,13 @@ static int read_cr(struct spi_nor *nor)
 static int write_sr(struct spi_nor *nor, u8 val)
 {
 	nor->cmd_buf[0] = val;
+
+	/* A DTR data phase is a whole clock, send the value on both edges. */
+	if (nor->reg_proto == SNOR_PROTO_8_8_8_DTR) {
+		nor->cmd_buf[1] = val;
+		return nor->write_reg(nor, SPINOR_OP_WRSR, nor->cmd_buf, 2);
+	}
+
 	return nor->write_reg(nor, SPINOR_OP_WRSR, nor->cmd_buf, 1);
 }
 
@@ -251,6 +406,8 @@ static u8 spi_nor_convert_3to4_read(u8 opcode)
 		{ SPINOR_OP_READ_1_2_2,	SPINOR_OP_READ_1_2_2_4B },
 		{ SPINOR_OP_READ_1_1_4,	SPINOR_OP_READ_1_1_4_4B },
 		{ SPINOR_OP_READ_1_4_4,	SPINOR_OP_READ_1_4_4_4B },
+		{ SPINOR_OP_READ_1_1_8,	SPINOR_OP_READ_1_1_8_4B },
+		{ SPINOR_OP_READ_1_8_8,	SPINOR_OP_READ_1_8_8_4B },
 
 		{ SPINOR_OP_READ_1_1_1_DTR,	SPINOR_OP_READ_1_1_1_DTR_4B },
 		{ SPINOR_OP_READ_1_2_2_DTR,	SPINOR_OP_READ_1_2_2_DTR_4B },
@@ -267,6 +424,8 @@ static u8 spi_nor_convert_3to4_program(u8 opcode)
 		{ SPINOR_OP_PP,		SPINOR_OP_PP_4B },
 		{ SPINOR_OP_PP_1_1_4,	SPINOR_OP_PP_1_1_4_4B },
 		{ SPINOR_OP_PP_1_4_4,	SPINOR_OP_PP_1_4_4_4B },
+		{ SPINOR_OP_PP_1_1_8,	SPINOR_OP_PP_1_1_8_4B },
+		{ SPINOR_OP_PP_1_8_8,	SPINOR_OP_PP_1_8_8_4B },
 	};
 
 	return spi_nor_convert_opcode(opcode, spi_nor_3to4_program,
@@ -526,6 +685,8 @@ static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr)
 	if (nor->erase)
 		return nor->erase(nor, addr);
 
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
 	/*
 	 * Default implementation, if driver doesn't have a specialized HW
 	 * control
@@ -1429,6 +1590,104 @@ static int spansion_no_read_cr_quad_enable(struct spi_nor *nor)
 #endif /* CONFIG_SPI_FLASH_SFDP_SUPPORT */
 #endif /* CONFIG_SPI_FLASH_SPANSION */
 
+#ifdef CONFIG_SPI_FLASH_STMICRO
+static int micron_write_any_reg(struct spi_nor *nor, u8 addr_nbytes, u32 reg,
+				u8 *buf, unsigned int len,
+				enum spi_nor_protocol proto)
+{
+	struct spi_mem_op op =
+		SPI_MEM_OP(SPI_MEM_OP_CMD(SPINOR_OP_MT_WR_ANY_REG, 1),
+			   SPI_MEM_OP_ADDR(addr_nbytes, reg, 1),
+			   SPI_MEM_OP_NO_DUMMY,
+			   SPI_MEM_OP_DATA_OUT(len, buf, 1));
+	int ret;
+
+	spi_nor_setup_op(nor, &op, proto);
+
+	ret = write_enable(nor);
+	if (ret < 0)
+		return ret;
+
+	return spi_mem_exec_op(nor->spi, &op);
+}
+
+/*
+ * Read the JEDEC ID back in the protocol we just switched to. In 8D-8D-8D
+ * the Read ID command needs 8 dummy cycles and an even number of bytes.
+ */
+static int micron_check_id(struct spi_nor *nor, enum spi_nor_protocol proto)
+{
+	u8 id[SPI_NOR_MAX_ID_LEN];
+	struct spi_mem_op op =
+		SPI_MEM_OP(SPI_MEM_OP_CMD(SPINOR_OP_RDID, 1),
+			   SPI_MEM_OP_NO_ADDR,
+			   SPI_MEM_OP_NO_DUMMY,
+			   SPI_MEM_OP_DATA_IN(round_up(nor->info->id_len, 2),
+					      id, 1));
+	int ret;
+
+	if (proto == SNOR_PROTO_8_8_8_DTR)
+		op.dummy.nbytes = 8;
+
+	spi_nor_setup_op(nor, &op, proto);
+
+	ret = spi_mem_exec_op(nor->spi, &op);
+	if (ret)
+		return ret;
+
+	if (memcmp(id, nor->info->id, nor->info->id_len))
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Micron Xccela flashes switch protocol through the volatile configuration
+ * registers. The array read dummy cycles are programmed first, so that they
+ * match nor->read_dummy once the device comes up in 8D-8D-8D.
+ */
+static int micron_octal_dtr_enable(struct spi_nor *nor, bool enable)
+{
+	u8 *buf = nor->cmd_buf;
+	int ret;
+
+	if (enable) {
+		buf[0] = nor->read_dummy;
+		ret = micron_write_any_reg(nor, 3, SPINOR_REG_MT_CFR1V, buf, 1,
+					   SNOR_PROTO_1_1_1);
+		if (ret)
+			return ret;
+
+		ret = spi_nor_wait_till_ready(nor);
+		if (ret)
+			return ret;
+
+		buf[0] = SPINOR_MT_OCT_DTR;
+		ret = micron_write_any_reg(nor, 3, SPINOR_REG_MT_CFR0V, buf, 1,
+					   SNOR_PROTO_1_1_1);
+	} else {
+		/* The second byte restores the default dummy cycles. */
+		buf[0] = SPINOR_MT_EXSPI;
+		buf[1] = SPINOR_REG_MT_CFR1V_DEF;
+		ret = micron_write_any_reg(nor, 4, SPINOR_REG_MT_CFR0V, buf, 2,
+					   SNOR_PROTO_8_8_8_DTR);
+	}
+	if (ret)
+		return ret;
+
+	nor->reg_proto = enable ? SNOR_PROTO_8_8_8_DTR : SNOR_PROTO_1_1_1;
+
+	ret = micron_check_id(nor, nor->reg_proto);
+	if (ret) {
+		dev_dbg(nor->dev, "failed to switch %s octal DTR mode\n",
+			enable ? "to" : "out of");
+		return ret;
+	}
+
+	return spi_nor_wait_till_ready(nor);
+}
+#endif /* CONFIG_SPI_FLASH_STMICRO */
+
 struct spi_nor_read_command {
 	u8			num_mode_clocks;
 	u8			num_wait_states;
@@ -1463,6 +1722,7 @@ enum spi_nor_read_command_index {
 	SNOR_CMD_READ_1_8_8,
 	SNOR_CMD_READ_8_8_8,
 	SNOR_CMD_READ_1_8_8_DTR,
+	SNOR_CMD_READ_8_8_8_DTR,
 
 	SNOR_CMD_READ_MAX
 };
@@ -1479,6 +1739,7 @@ enum spi_nor_pp_command_index {
 	SNOR_CMD_PP_1_1_8,
 	SNOR_CMD_PP_1_8_8,
 	SNOR_CMD_PP_8_8_8,
+	SNOR_CMD_PP_8_8_8_DTR,
 
 	SNOR_CMD_PP_MAX
 };
@@ -1492,6 +1753,7 @@ struct spi_nor_flash_parameter {
 	struct spi_nor_pp_command	page_programs[SNOR_CMD_PP_MAX];
 
 	int (*quad_enable)(struct spi_nor *nor);
+	int (*octal_dtr_enable)(struct spi_nor *nor, bool enable);
 };
 
 static void
@@ -1588,6 +1850,7 @@ struct sfdp_parameter_header {
 
 #define SFDP_BFPT_ID		0xff00	/* Basic Flash Parameter Table */
 #define SFDP_SECTOR_MAP_ID	0xff81	/* Sector Map Table */
+#define SFDP_PROFILE1_ID	0xff05	/* xSPI Profile 1.0 table */
 
 #define SFDP_SIGNATURE		0x50444653U
 #define SFDP_JESD216_MAJOR	1
@@ -1609,11 +1872,14 @@ struct sfdp_header {
 /* Basic Flash Parameter Table */
 
 /*
- * JESD216 rev B defines a Basic Flash Parameter Table of 16 DWORDs.
+ * JESD216 rev D defines a Basic Flash Parameter Table of 20 DWORDs.
  * They are indexed from 1 but C arrays are indexed from 0.
  */
 #define BFPT_DWORD(i)		((i) - 1)
-#define BFPT_DWORD_MAX		16
+#define BFPT_DWORD_MAX		20
+
+/* JESD216 rev A and B defined 16 DWORDs. */
+#define BFPT_DWORD_MAX_JESD216B			16
 
 /* The first version of JESB216 defined only 9 DWORDs. */
 #define BFPT_DWORD_MAX_JESD216			9
@@ -1678,6 +1944,13 @@ struct sfdp_header {
 #define BFPT_DWORD15_QER_SR2_BIT1_NO_RD		(0x4UL << 20)
 #define BFPT_DWORD15_QER_SR2_BIT1		(0x5UL << 20) /* Spansion */
 
+/* 18th DWORD. */
+#define BFPT_DWORD18_CMD_EXT_MASK		GENMASK(30, 29)
+#define BFPT_DWORD18_CMD_EXT_REP		(0x0UL << 29) /* Repeat */
+#define BFPT_DWORD18_CMD_EXT_INV		(0x1UL << 29) /* Invert */
+#define BFPT_DWORD18_CMD_EXT_RES		(0x2UL << 29) /* Reserved */
+#define BFPT_DWORD18_CMD_EXT_16B		(0x3UL << 29) /* 16-bit opcode */
+
 struct sfdp_bfpt {
 	u32	dwords[BFPT_DWORD_MAX];
 };
@@ -1930,7 +2203,7 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 	}
 
 	/* Stop here if not JESD216 rev A or later. */
-	if (bfpt_header->length < BFPT_DWORD_MAX)
+	if (bfpt_header->length < BFPT_DWORD_MAX_JESD216B)
 		return 0;
 
 	/* Page size: this field specifies 'N' so the page size = 2^N bytes. */
@@ -1964,6 +2237,101 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 		return -EINVAL;
 	}
 
+	/* Stop here if not JESD216 rev C or later. */
+	if (bfpt_header->length < BFPT_DWORD_MAX)
+		return 0;
+
+	/* 8D-8D-8D command extension. */
+	switch (bfpt.dwords[BFPT_DWORD(18)] & BFPT_DWORD18_CMD_EXT_MASK) {
+	case BFPT_DWORD18_CMD_EXT_REP:
+		nor->cmd_ext_type = SPI_NOR_EXT_REPEAT;
+		break;
+
+	case BFPT_DWORD18_CMD_EXT_INV:
+		nor->cmd_ext_type = SPI_NOR_EXT_INVERT;
+		break;
+
+	case BFPT_DWORD18_CMD_EXT_16B:
+		nor->cmd_ext_type = SPI_NOR_EXT_HEX;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* xSPI Profile 1.0 table, the 8D-8D-8D counterpart of the BFPT. */
+#define PROFILE1_DWORD_MAX			5
+
+#define PROFILE1_DWORD1_RDSR_ADDR_BYTES		BIT(29)
+#define PROFILE1_DWORD1_RDSR_DUMMY		BIT(28)
+#define PROFILE1_DWORD1_RD_FAST_CMD		GENMASK(15, 8)
+#define PROFILE1_DWORD4_DUMMY_200MHZ		GENMASK(11, 7)
+#define PROFILE1_DWORD5_DUMMY_166MHZ		GENMASK(31, 27)
+#define PROFILE1_DWORD5_DUMMY_133MHZ		GENMASK(21, 17)
+#define PROFILE1_DWORD5_DUMMY_100MHZ		GENMASK(11, 7)
+
+#define PROFILE1_DUMMY_DEFAULT			20
+
+/**
+ * spi_nor_parse_profile1() - parse the xSPI Profile 1.0 table
+ * @nor:		pointer to a 'struct spi_nor'
+ * @profile1_header:	pointer to the 'struct sfdp_parameter_header' describing
+ *			the Profile 1.0 table length and version
+ * @params:		pointer to the 'struct spi_nor_flash_parameter' to be
+ *			filled
+ *
+ * The table gives the 8D-8D-8D Fast Read opcode, its dummy cycles for each
+ * supported frequency and how the status register is read in that mode.
+ * We don't know the bus frequency here, so take the dummy cycles of the
+ * fastest one the flash supports: too many is safe, too few is not.
+ *
+ * Return: 0 on success, -errno otherwise.
+ */
+static int spi_nor_parse_profile1(struct spi_nor *nor,
+				  const struct sfdp_parameter_header *profile1_header,
+				  struct spi_nor_flash_parameter *params)
+{
+	u32 dwords[PROFILE1_DWORD_MAX];
+	u8 opcode, dummy;
+	int i, err;
+
+	if (profile1_header->length < PROFILE1_DWORD_MAX)
+		return 0;
+
+	err = spi_nor_read_sfdp(nor, SFDP_PARAM_HEADER_PTP(profile1_header),
+				sizeof(dwords), dwords);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < PROFILE1_DWORD_MAX; i++)
+		dwords[i] = le32_to_cpu(dwords[i]);
+
+	opcode = (dwords[0] & PROFILE1_DWORD1_RD_FAST_CMD) >> 8;
+
+	nor->rdsr_dummy = dwords[0] & PROFILE1_DWORD1_RDSR_DUMMY ? 8 : 4;
+	nor->rdsr_addr_nbytes =
+		dwords[0] & PROFILE1_DWORD1_RDSR_ADDR_BYTES ? 4 : 0;
+
+	dummy = (dwords[3] & PROFILE1_DWORD4_DUMMY_200MHZ) >> 7;
+	if (!dummy)
+		dummy = (dwords[4] & PROFILE1_DWORD5_DUMMY_166MHZ) >> 27;
+	if (!dummy)
+		dummy = (dwords[4] & PROFILE1_DWORD5_DUMMY_133MHZ) >> 17;
+	if (!dummy)
+		dummy = (dwords[4] & PROFILE1_DWORD5_DUMMY_100MHZ) >> 7;
+	if (!dummy)
+		dummy = PROFILE1_DUMMY_DEFAULT;
+
+	/* Controllers count DTR dummy in half cycles, keep it even. */
+	dummy = round_up(dummy, 2);
+
+	params->hwcaps.mask |= SNOR_HWCAPS_READ_8_8_8_DTR;
+	spi_nor_set_read_settings(&params->reads[SNOR_CMD_READ_8_8_8_DTR],
+				  0, dummy, opcode, SNOR_PROTO_8_8_8_DTR);
+
 	return 0;
 }
 
@@ -2063,6 +2431,10 @@ static int spi_nor_parse_sfdp(struct spi_nor *nor,
 			dev_info(dev, "non-uniform erase sector maps are not supported yet.\n");
 			break;
 
+		case SFDP_PROFILE1_ID:
+			err = spi_nor_parse_profile1(nor, param_header, params);
+			break;
+
 		default:
 			break;
 		}
@@ -2121,6 +2493,20 @@ static int spi_nor_init_params(struct spi_nor *nor,
 					  SNOR_PROTO_1_1_4);
 	}
 
+	if (info->flags & SPI_NOR_OCTAL_READ) {
+		params->hwcaps.mask |= SNOR_HWCAPS_READ_1_1_8;
+		spi_nor_set_read_settings(&params->reads[SNOR_CMD_READ_1_1_8],
+					  0, 8, SPINOR_OP_READ_1_1_8,
+					  SNOR_PROTO_1_1_8);
+	}
+
+	if (info->flags & SPI_NOR_OCTAL_DTR_READ) {
+		params->hwcaps.mask |= SNOR_HWCAPS_READ_8_8_8_DTR;
+		spi_nor_set_read_settings(&params->reads[SNOR_CMD_READ_8_8_8_DTR],
+					  0, 20, SPINOR_OP_READ_FAST,
+					  SNOR_PROTO_8_8_8_DTR);
+	}
+
 	/* Page Program settings. */
 	params->hwcaps.mask |= SNOR_HWCAPS_PP;
 	spi_nor_set_pp_settings(&params->page_programs[SNOR_CMD_PP],
@@ -2132,6 +2518,21 @@ static int spi_nor_init_params(struct spi_nor *nor,
 					SPINOR_OP_PP_1_1_4, SNOR_PROTO_1_1_4);
 	}
 
+	if (info->flags & SPI_NOR_OCTAL_DTR_PP) {
+		params->hwcaps.mask |= SNOR_HWCAPS_PP_8_8_8_DTR;
+		/*
+		 * Page Program has the same opcode in 8D-8D-8D, the address
+		 * width is widened to 4 bytes when the mode is selected.
+		 */
+		spi_nor_set_pp_settings(&params->page_programs[SNOR_CMD_PP_8_8_8_DTR],
+					SPINOR_OP_PP, SNOR_PROTO_8_8_8_DTR);
+	}
+
+	/* Defaults for 8D-8D-8D, SFDP may override them below. */
+	nor->cmd_ext_type = SPI_NOR_EXT_REPEAT;
+	nor->rdsr_dummy = 8;
+	nor->rdsr_addr_nbytes = 0;
+
 	/* Select the procedure to set the Quad Enable bit. */
 	if (params->hwcaps.mask & (SNOR_HWCAPS_READ_QUAD |
 				   SNOR_HWCAPS_PP_QUAD)) {
@@ -2154,10 +2555,25 @@ static int spi_nor_init_params(struct spi_nor *nor,
 		}
 	}
 
+	/* Select the procedure to enter and leave 8D-8D-8D mode. */
+	if (params->hwcaps.mask & (SNOR_HWCAPS_READ_8_8_8_DTR |
+				   SNOR_HWCAPS_PP_8_8_8_DTR)) {
+		switch (JEDEC_MFR(info)) {
+#ifdef CONFIG_SPI_FLASH_STMICRO
+		case SNOR_MFR_MICRON:
+			params->octal_dtr_enable = micron_octal_dtr_enable;
+			break;
+#endif
+		default:
+			break;
+		}
+	}
+
 	/* Override the parameters with data read from SFDP tables. */
 	nor->addr_width = 0;
 	nor->mtd.erasesize = 0;
-	if ((info->flags & (SPI_NOR_DUAL_READ | SPI_NOR_QUAD_READ)) &&
+	if ((info->flags & (SPI_NOR_DUAL_READ | SPI_NOR_QUAD_READ |
+			    SPI_NOR_OCTAL_READ | SPI_NOR_OCTAL_DTR_READ)) &&
 	    !(info->flags & SPI_NOR_SKIP_SFDP)) {
 		struct spi_nor_flash_parameter sfdp_params;
 
@@ -2165,11 +2581,31 @@ static int spi_nor_init_params(struct spi_nor *nor,
 		if (spi_nor_parse_sfdp(nor, &sfdp_params)) {
 			nor->addr_width = 0;
 			nor->mtd.erasesize = 0;
+			nor->cmd_ext_type = SPI_NOR_EXT_REPEAT;
+			nor->rdsr_dummy = 8;
+			nor->rdsr_addr_nbytes = 0;
 		} else {
 			memcpy(params, &sfdp_params, sizeof(*params));
 		}
 	}
 
+#ifdef CONFIG_SPI_FLASH_STMICRO
+	/*
+	 * The Xccela SFDP advertises the generic Fast Read opcode for
+	 * 8D-8D-8D, use the dedicated DTR one with the 20 dummy cycles that
+	 * micron_octal_dtr_enable() programs.
+	 */
+	if (info->flags & SPI_NOR_OCTAL_DTR_READ &&
+	    JEDEC_MFR(info) == SNOR_MFR_MICRON) {
+		spi_nor_set_read_settings(&params->reads[SNOR_CMD_READ_8_8_8_DTR],
+					  0, 20, SPINOR_OP_MT_DTR_RD,
+					  SNOR_PROTO_8_8_8_DTR);
+		nor->cmd_ext_type = SPI_NOR_EXT_REPEAT;
+		nor->rdsr_dummy = 8;
+		nor->rdsr_addr_nbytes = 0;
+	}
+#endif
+
 	return 0;
 }
 
@@ -2202,6 +2638,7 @@ static int spi_nor_hwcaps_read2cmd(u32 hwcaps)
 		{ SNOR_HWCAPS_READ_1_8_8,	SNOR_CMD_READ_1_8_8 },
 		{ SNOR_HWCAPS_READ_8_8_8,	SNOR_CMD_READ_8_8_8 },
 		{ SNOR_HWCAPS_READ_1_8_8_DTR,	SNOR_CMD_READ_1_8_8_DTR },
+		{ SNOR_HWCAPS_READ_8_8_8_DTR,	SNOR_CMD_READ_8_8_8_DTR },
 	};
 
 	return spi_nor_hwcaps2cmd(hwcaps, hwcaps_read2cmd,
@@ -2218,6 +2655,7 @@ static int spi_nor_hwcaps_pp2cmd(u32 hwcaps)
 		{ SNOR_HWCAPS_PP_1_1_8,		SNOR_CMD_PP_1_1_8 },
 		{ SNOR_HWCAPS_PP_1_8_8,		SNOR_CMD_PP_1_8_8 },
 		{ SNOR_HWCAPS_PP_8_8_8,		SNOR_CMD_PP_8_8_8 },
+		{ SNOR_HWCAPS_PP_8_8_8_DTR,	SNOR_CMD_PP_8_8_8_DTR },
 	};
 
 	return spi_nor_hwcaps2cmd(hwcaps, hwcaps_pp2cmd,
@@ -2360,9 +2798,65 @@ static int spi_nor_setup(struct spi_nor *nor, const struct flash_info *info,
 	else
 		nor->quad_enable = NULL;
 
+	/* Enable 8D-8D-8D if it was selected. */
+	if (nor->read_proto == SNOR_PROTO_8_8_8_DTR)
+		nor->octal_dtr_enable = params->octal_dtr_enable;
+	else
+		nor->octal_dtr_enable = NULL;
+
 	return 0;
 }
 
+/*
+ * Once the flash is switched to 8D-8D-8D every command goes out in that
+ * protocol, so the read and program commands are only usable as a pair, and
+ * only if the controller can run them and we know how to switch modes.
+ */
+static void spi_nor_adjust_octal_dtr_hwcaps(struct spi_nor *nor,
+					    struct spi_nor_flash_parameter *params,
+					    u32 *mask)
+{
+	const u32 octal_dtr = SNOR_HWCAPS_READ_8_8_8_DTR |
+			      SNOR_HWCAPS_PP_8_8_8_DTR;
+#if CONFIG_IS_ENABLED(DM_SPI) && !defined(CONFIG_SPI_FLASH_BAR)
+	const struct spi_nor_read_command *read;
+	const struct spi_nor_pp_command *pp;
+	struct spi_mem_op op;
+#endif
+
+	if ((*mask & params->hwcaps.mask & octal_dtr) != octal_dtr ||
+	    !params->octal_dtr_enable)
+		goto drop;
+
+#if CONFIG_IS_ENABLED(DM_SPI) && !defined(CONFIG_SPI_FLASH_BAR)
+	read = &params->reads[SNOR_CMD_READ_8_8_8_DTR];
+	op = (struct spi_mem_op)
+		SPI_MEM_OP(SPI_MEM_OP_CMD(read->opcode, 1),
+			   SPI_MEM_OP_ADDR(4, 0, 1),
+			   SPI_MEM_OP_DUMMY(read->num_mode_clocks +
+					    read->num_wait_states, 1),
+			   SPI_MEM_OP_DATA_IN(2, NULL, 1));
+	spi_nor_setup_op(nor, &op, SNOR_PROTO_8_8_8_DTR);
+	if (!spi_mem_supports_op(nor->spi, &op))
+		goto drop;
+
+	pp = &params->page_programs[SNOR_CMD_PP_8_8_8_DTR];
+	op = (struct spi_mem_op)
+		SPI_MEM_OP(SPI_MEM_OP_CMD(pp->opcode, 1),
+			   SPI_MEM_OP_ADDR(4, 0, 1),
+			   SPI_MEM_OP_NO_DUMMY,
+			   SPI_MEM_OP_DATA_OUT(2, NULL, 1));
+	spi_nor_setup_op(nor, &op, SNOR_PROTO_8_8_8_DTR);
+	if (!spi_mem_supports_op(nor->spi, &op))
+		goto drop;
+
+	return;
+#endif
+
+drop:
+	*mask &= ~octal_dtr;
+}
+
 static int spi_nor_init(struct spi_nor *nor)
 {
 	int err;
@@ -2388,6 +2882,14 @@ static int spi_nor_init(struct spi_nor *nor)
 		}
 	}
 
+	if (nor->octal_dtr_enable && nor->reg_proto != SNOR_PROTO_8_8_8_DTR) {
+		err = nor->octal_dtr_enable(nor, true);
+		if (err) {
+			dev_dbg(nor->dev, "octal DTR mode not supported\n");
+			return err;
+		}
+	}
+
 	if (nor->addr_width == 4 &&
 	    (JEDEC_MFR(nor->info) != SNOR_MFR_SPANSION) &&
 	    !(nor->info->flags & SPI_NOR_4B_OPCODES)) {
@@ -2406,6 +2908,39 @@ static int spi_nor_init(struct spi_nor *nor)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+static int spi_nor_create_read_dirmap(struct spi_nor *nor)
+{
+	struct spi_mem_dirmap_info info = {
+		.offset = 0,
+		.length = nor->mtd.size,
+	};
+	struct spi_mem_dirmap_desc *desc;
+
+	/*
+	 * With bank switching the upper address bits live in the flash BAR
+	 * register, which a linear mapping of the whole device cannot follow.
+	 */
+#ifdef CONFIG_SPI_FLASH_BAR
+	if (nor->addr_width == 3 && nor->mtd.size > SZ_16M)
+		return 0;
+#endif
+
+	spi_nor_setup_read_op(nor, &info.op_tmpl);
+
+	/* Not fatal, spi_nor_read_data() then keeps issuing plain ops. */
+	desc = spi_mem_dirmap_create(nor->spi, &info);
+	if (IS_ERR(desc)) {
+		dev_dbg(nor->dev, "no read dirmap: %ld\n", PTR_ERR(desc));
+		return 0;
+	}
+
+	nor->dirmap_rdesc = desc;
+
+	return 0;
+}
+#endif
+
 int spi_nor_scan(struct spi_nor *nor)
 {
 	struct spi_nor_flash_parameter params;
@@ -2442,6 +2977,17 @@ int spi_nor_scan(struct spi_nor *nor)
 			hwcaps.mask |= SNOR_HWCAPS_READ_1_2_2;
 	}
 
+	if (spi->mode & SPI_RX_OCTAL) {
+		hwcaps.mask |= SNOR_HWCAPS_READ_1_1_8;
+
+		if (spi->mode & SPI_TX_OCTAL)
+			hwcaps.mask |= (SNOR_HWCAPS_READ_1_8_8 |
+					SNOR_HWCAPS_PP_1_1_8 |
+					SNOR_HWCAPS_PP_1_8_8 |
+					SNOR_HWCAPS_READ_8_8_8_DTR |
+					SNOR_HWCAPS_PP_8_8_8_DTR);
+	}
+
 	info = spi_nor_read_id(nor);
 	if (IS_ERR_OR_NULL(info))
 		return -ENOENT;
@@ -2509,6 +3055,8 @@ int spi_nor_scan(struct spi_nor *nor)
 	if ((info->flags & SPI_NOR_NO_FR) || (spi->mode & SPI_RX_SLOW))
 		params.hwcaps.mask &= ~SNOR_HWCAPS_READ_FAST;
 
+	spi_nor_adjust_octal_dtr_hwcaps(nor, &params, &hwcaps.mask);
+
 	/*
 	 * Configure the SPI memory:
 	 * - select op codes for (Fast) Read, Page Program and Sector Erase.
@@ -2542,6 +3090,14 @@ int spi_nor_scan(struct spi_nor *nor)
 		nor->addr_width = 3;
 	}
 
+#ifndef CONFIG_SPI_FLASH_BAR
+	/* 8D-8D-8D only exists with 4-byte addresses. */
+	if (nor->read_proto == SNOR_PROTO_8_8_8_DTR && nor->addr_width != 4) {
+		nor->addr_width = 4;
+		spi_nor_set_4byte_opcodes(nor, info);
+	}
+#endif
+
 	if (nor->addr_width > SPI_NOR_MAX_ADDR_WIDTH) {
 		dev_dbg(dev, "address width is too large: %u\n",
 			nor->addr_width);
@@ -2559,6 +3115,12 @@ int spi_nor_scan(struct spi_nor *nor)
 	nor->erase_size = mtd->erasesize;
 	nor->sector_size = mtd->erasesize;
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	ret = spi_nor_create_read_dirmap(nor);
+	if (ret)
+		return ret;
+#endif
+
 #ifndef CONFIG_SPL_BUILD
 	printf("SF: Detected %s with page size ", nor->name);
 	print_size(nor->page_size, ", erase size ");
@@ -2570,6 +3132,14 @@ int spi_nor_scan(struct spi_nor *nor)
 	return 0;
 }
 
+int spi_nor_remove(struct spi_nor *nor)
+{
+	if (nor->octal_dtr_enable && nor->reg_proto == SNOR_PROTO_8_8_8_DTR)
+		return nor->octal_dtr_enable(nor, false);
+
+	return 0;
+}
+
 /* U-Boot specific functions, need to extend MTD to support these */
 int spi_flash_cmd_get_sw_write_prot(struct spi_nor *nor)
 {
@@ -170,8 +170,16 @@ const struct flash_info spi_nor_ids[] = {
 	{ INFO("n25q00",      0x20ba21, 0, 64 * 1024, 2048, SECT_4K | USE_FSR | SPI_NOR_QUAD_READ | NO_CHIP_ERASE) },
 	{ INFO("n25q00a",     0x20bb21, 0, 64 * 1024, 2048, SECT_4K | USE_FSR | SPI_NOR_QUAD_READ | NO_CHIP_ERASE) },
 	{ INFO("mt25qu02g",   0x20bb22, 0, 64 * 1024, 4096, SECT_4K | USE_FSR | SPI_NOR_QUAD_READ | NO_CHIP_ERASE) },
-	{ INFO("mt35xu512aba", 0x2c5b1a, 0,  128 * 1024,  512, USE_FSR | SPI_NOR_4B_OPCODES) },
-	{ INFO("mt35xu02g",  0x2c5b1c, 0, 128 * 1024,  2048, USE_FSR | SPI_NOR_4B_OPCODES) },
+	{
+		INFO("mt35xu512aba", 0x2c5b1a, 0,  128 * 1024,  512,
+		     USE_FSR | SPI_NOR_4B_OPCODES | SPI_NOR_OCTAL_READ |
+		     SPI_NOR_OCTAL_DTR_READ | SPI_NOR_OCTAL_DTR_PP)
+	},
+	{
+		INFO("mt35xu02g",  0x2c5b1c, 0, 128 * 1024,  2048,
+		     USE_FSR | SPI_NOR_4B_OPCODES | SPI_NOR_OCTAL_READ |
+		     SPI_NOR_OCTAL_DTR_READ | SPI_NOR_OCTAL_DTR_PP)
+	},
 #endif
 #ifdef CONFIG_SPI_FLASH_SPANSION	/* SPANSION */
 	/* Spansion/Cypress -- single (large) sector size only, at least
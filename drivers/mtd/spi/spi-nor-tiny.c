@@ -797,6 +797,12 @@ int spi_nor_scan(struct spi_nor *nor)
 	return 0;
 }
 
+/* The tiny variant never leaves the power-on protocol. */
+int spi_nor_remove(struct spi_nor *nor)
+{
+	return 0;
+}
+
 /* U-Boot specific functions, need to extend MTD to support these */
 int spi_flash_cmd_get_sw_write_prot(struct spi_nor *nor)
 {
@@ -668,12 +668,12 @@ static int fm_eth_init_mac(struct fm_eth *fm_eth, struct ccsr_fman *reg)
 	fm_eth->mac = mac;
 
 #ifdef CONFIG_SYS_FMAN_V3
-	init_memac(mac, base, phyregs, MAX_RXBUF_LEN);
+	init_memac(mac, base, phyregs, MAX_RX_FRAME_LEN);
 #else
 	if (fm_eth->type == FM_ETH_1G_E)
-		init_dtsec(mac, base, phyregs, MAX_RXBUF_LEN);
+		init_dtsec(mac, base, phyregs, MAX_RX_FRAME_LEN);
 	else
-		init_tgec(mac, base, phyregs, MAX_RXBUF_LEN);
+		init_tgec(mac, base, phyregs, MAX_RX_FRAME_LEN);
 #endif
 
 	return 0;
@@ -754,7 +754,7 @@ int fm_eth_initialize(struct ccsr_fman *reg, struct fm_eth_info *info)
 	fm_eth->tx_port = (void *)&reg->port[info->tx_port_id - 1].fm_bmi;
 
 	/* set the ethernet max receive length */
-	fm_eth->max_rx_len = MAX_RXBUF_LEN;
+	fm_eth->max_rx_len = MAX_RX_FRAME_LEN;
 
 	/* init global mac structure */
 	ret = fm_eth_init_mac(fm_eth, reg);
@@ -139,7 +139,14 @@ struct fm_eth {
 
 #define RX_BD_RING_SIZE		8
 #define TX_BD_RING_SIZE		8
+/* Rx buffers are a power of two large enough for a whole frame */
+#ifdef CONFIG_NET_JUMBO_FRAMES
+#define MAX_RXBUF_LOG2		14
+#define MAX_RX_FRAME_LEN	PKTSIZE
+#else
 #define MAX_RXBUF_LOG2		11
+#define MAX_RX_FRAME_LEN	MAX_RXBUF_LEN
+#endif
 #define MAX_RXBUF_LEN		(1 << MAX_RXBUF_LOG2)
 
 #define PORT_IS_ENABLED(port)	(fm_port_to_index(port) == -1 ? \
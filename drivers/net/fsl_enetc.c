@@ -243,14 +243,22 @@ static int enetc_probe(struct udevice *dev)
 	}
 
 	priv->enetc_txbd = memalign(ENETC_BD_ALIGN,
-				    sizeof(struct enetc_tx_bd) * ENETC_BD_CNT);
+				    sizeof(struct enetc_tx_bd) * ENETC_TX_BD_CNT);
 	priv->enetc_rxbd = memalign(ENETC_BD_ALIGN,
-				    sizeof(union enetc_rx_bd) * ENETC_BD_CNT);
-
-	if (!priv->enetc_txbd || !priv->enetc_rxbd) {
+				    sizeof(union enetc_rx_bd) * ENETC_RX_BD_CNT);
+	/* each Rx buffer must be aligned to 64B */
+	priv->tx_buf = memalign(ARCH_DMA_MINALIGN,
+				PKTSIZE_ALIGN * ENETC_TX_BD_CNT);
+	priv->rx_buf = memalign(ARCH_DMA_MINALIGN,
+				PKTSIZE_ALIGN * ENETC_RX_BD_CNT);
+
+	if (!priv->enetc_txbd || !priv->enetc_rxbd ||
+	    !priv->tx_buf || !priv->rx_buf) {
 		/* free should be able to handle NULL, just free all pointers */
 		free(priv->enetc_txbd);
 		free(priv->enetc_rxbd);
+		free(priv->tx_buf);
+		free(priv->rx_buf);
 
 		return -ENOMEM;
 	}
@@ -281,6 +289,8 @@ static int enetc_remove(struct udevice *dev)
 
 	free(priv->enetc_txbd);
 	free(priv->enetc_rxbd);
+	free(priv->tx_buf);
+	free(priv->rx_buf);
 
 	return 0;
 }
@@ -360,10 +370,18 @@ static void enetc_enable_si_port(struct enetc_priv *priv)
 	enetc_write(priv, ENETC_SIMR, ENETC_SIMR_EN);
 }
 
+/* returns the Rx buffer for a given BD index */
+static inline uchar *enetc_rxb(struct udevice *dev, int i)
+{
+	struct enetc_priv *priv = dev_get_priv(dev);
+
+	return priv->rx_buf + i * PKTSIZE_ALIGN;
+}
+
 /* returns DMA address for a given buffer index */
 static inline u64 enetc_rxb_address(struct udevice *dev, int i)
 {
-	return cpu_to_le64(dm_pci_virt_to_mem(dev, net_rx_packets[i]));
+	return cpu_to_le64(dm_pci_virt_to_mem(dev, enetc_rxb(dev, i)));
 }
 
 /*
@@ -379,7 +397,7 @@ static void enetc_setup_tx_bdr(struct udevice *dev)
 	u64 tx_bd_add = (u64)priv->enetc_txbd;
 
 	/* used later to advance to the next Tx BD */
-	tx_bdr->bd_count = ENETC_BD_CNT;
+	tx_bdr->bd_count = ENETC_TX_BD_CNT;
 	tx_bdr->next_prod_idx = 0;
 	tx_bdr->next_cons_idx = 0;
 	tx_bdr->cons_idx = priv->regs_base +
@@ -392,7 +410,7 @@ static void enetc_setup_tx_bdr(struct udevice *dev)
 			lower_32_bits(tx_bd_add));
 	enetc_bdr_write(priv, TX, ENETC_TX_BDR_ID, ENETC_TBBAR1,
 			upper_32_bits(tx_bd_add));
-	/* set Tx 8 BD count */
+	/* set Tx BD count */
 	enetc_bdr_write(priv, TX, ENETC_TX_BDR_ID, ENETC_TBLENR,
 			tx_bdr->bd_count);
 
@@ -420,7 +438,7 @@ static void enetc_setup_rx_bdr(struct udevice *dev)
 	int i;
 
 	/* used later to advance to the next BD produced by ENETC HW */
-	rx_bdr->bd_count = ENETC_BD_CNT;
+	rx_bdr->bd_count = ENETC_RX_BD_CNT;
 	rx_bdr->next_prod_idx = 0;
 	rx_bdr->next_cons_idx = 0;
 	rx_bdr->cons_idx = priv->regs_base +
@@ -487,13 +505,44 @@ static int enetc_start(struct udevice *dev)
 	return 0;
 }
 
+/*
+ * Wait for the Tx BDs still owned by ENETC, until the ring has at least
+ * @free BDs available to software
+ */
+static int enetc_tx_reclaim(struct udevice *dev, int free)
+{
+	struct enetc_priv *priv = dev_get_priv(dev);
+	struct bd_ring *txr = &priv->tx_bdr;
+	int tries = ENETC_POLL_TRIES;
+	int used;
+
+	do {
+		txr->next_cons_idx = enetc_read_reg(txr->cons_idx) &
+				     ENETC_BDR_IDX_MASK;
+		used = (txr->next_prod_idx - txr->next_cons_idx +
+			txr->bd_count) % txr->bd_count;
+		/* one BD always stays unused to tell a full ring from empty */
+		if (txr->bd_count - 1 - used >= free)
+			return 0;
+		udelay(10);
+	} while (--tries >= 0);
+
+	return -ETIMEDOUT;
+}
+
 /*
  * Stop the network interface:
+ * - let the frames still in the Tx ring go out
  * - just quiesce it, we can wipe all configuration as _start starts from
  * scratch each time
  */
 static void enetc_stop(struct udevice *dev)
 {
+	struct enetc_priv *priv = dev_get_priv(dev);
+
+	if (enetc_tx_reclaim(dev, priv->tx_bdr.bd_count - 1))
+		enetc_dbg(dev, "Tx BDR did not drain\n");
+
 	/* FLR is sufficient to quiesce the device */
 	dm_pci_flr(dev);
 	/* leave the BARs accessible after we stop, this is needed to use
@@ -504,26 +553,32 @@ static void enetc_stop(struct udevice *dev)
 
 /*
  * ENETC transmit packet:
- * - check if Tx BD ring is full
+ * - check if Tx BD ring is full, reclaiming sent BDs only then
+ * - copy the packet to the buffer of the BD, the caller reuses its buffer
  * - set buffer/packet address (dma address)
  * - set final fragment flag
- * - try while producer index equals consumer index or timeout
+ * - hand the BD to ENETC and return without waiting for it
  */
 static int enetc_send(struct udevice *dev, void *packet, int length)
 {
 	struct enetc_priv *priv = dev_get_priv(dev);
 	struct bd_ring *txr = &priv->tx_bdr;
-	void *nv_packet = (void *)packet;
-	int tries = ENETC_POLL_TRIES;
-	u32 pi, ci;
+	uchar *nv_packet;
+	u32 pi;
+
+	if (length > PKTSIZE_ALIGN)
+		return -EMSGSIZE;
 
 	pi = txr->next_prod_idx;
-	ci = enetc_read_reg(txr->cons_idx) & ENETC_BDR_IDX_MASK;
 	/* Tx ring is full when */
-	if (((pi + 1) % txr->bd_count) == ci) {
+	if (((pi + 1) % txr->bd_count) == txr->next_cons_idx &&
+	    enetc_tx_reclaim(dev, 1)) {
 		enetc_dbg(dev, "Tx BDR full\n");
 		return -ETIMEDOUT;
 	}
+
+	nv_packet = priv->tx_buf + pi * PKTSIZE_ALIGN;
+	memcpy(nv_packet, packet, length);
 	enetc_dbg(dev, "TxBD[%d]send: pkt_len=%d, buff @0x%x%08x\n", pi, length,
 		  upper_32_bits((u64)nv_packet), lower_32_bits((u64)nv_packet));
 
@@ -539,26 +594,22 @@ static int enetc_send(struct udevice *dev, void *packet, int length)
 	pi = (pi + 1) % txr->bd_count;
 	txr->next_prod_idx = pi;
 	enetc_write_reg(txr->prod_idx, pi);
-	while ((--tries >= 0) &&
-	       (pi != (enetc_read_reg(txr->cons_idx) & ENETC_BDR_IDX_MASK)))
-		udelay(10);
 
-	return tries > 0 ? 0 : -ETIMEDOUT;
+	return 0;
 }
 
 /*
  * Receive frame:
- * - wait for the next BD to get ready bit set
- * - clean up the descriptor
- * - move on and indicate to HW that the cleaned BD is available for Rx
+ * - wait for the next BD to get ready bit set, only on the first call of a
+ * poll so that the frames already received are handed over back to back
+ * - leave the BD to enetc_free_pkt(), the stack still uses its buffer
  */
 static int enetc_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct enetc_priv *priv = dev_get_priv(dev);
 	struct bd_ring *rxr = &priv->rx_bdr;
-	int tries = ENETC_POLL_TRIES;
+	int tries = flags & ETH_RECV_CHECK_DEVICE ? ENETC_POLL_TRIES : 0;
 	int pi = rxr->next_prod_idx;
-	int ci = rxr->next_cons_idx;
 	u32 status;
 	int len;
 	u8 rdy;
@@ -575,28 +626,63 @@ static int enetc_recv(struct udevice *dev, int flags, uchar **packetp)
 
 	dmb();
 	len = le16_to_cpu(priv->enetc_rxbd[pi].r.buf_len);
-	*packetp = (uchar *)enetc_rxb_address(dev, pi);
+	*packetp = enetc_rxb(dev, pi);
 	enetc_dbg(dev, "RxBD[%d]: len=%d err=%d pkt=0x%x%08x\n", pi, len,
 		  ENETC_RXBD_STATUS_ERRORS(status),
 		  upper_32_bits((u64)*packetp), lower_32_bits((u64)*packetp));
 
-	/* BD clean up and advance to next in ring */
-	memset(&priv->enetc_rxbd[pi], 0, sizeof(union enetc_rx_bd));
-	priv->enetc_rxbd[pi].w.addr = enetc_rxb_address(dev, pi);
+	/* advance to next in ring */
 	rxr->next_prod_idx = (pi + 1) % rxr->bd_count;
+
+	return len;
+}
+
+/*
+ * Free a received frame, they are freed in the order they were received:
+ * - clean up the descriptor
+ * - move on and indicate to HW that the cleaned BD is available for Rx
+ */
+static int enetc_free_pkt(struct udevice *dev, uchar *packet, int length)
+{
+	struct enetc_priv *priv = dev_get_priv(dev);
+	struct bd_ring *rxr = &priv->rx_bdr;
+	int ci = rxr->next_cons_idx;
+
+	/* BD clean up */
+	memset(&priv->enetc_rxbd[ci], 0, sizeof(union enetc_rx_bd));
+	priv->enetc_rxbd[ci].w.addr = enetc_rxb_address(dev, ci);
 	ci = (ci + 1) % rxr->bd_count;
 	rxr->next_cons_idx = ci;
 	dmb();
 	/* free up the slot in the ring for HW */
 	enetc_write_reg(rxr->cons_idx, ci);
 
-	return len;
+	return 0;
+}
+
+/*
+ * Report the checksum the MAC computed over the frame after the Ethernet
+ * header, the stack uses it to check the UDP/TCP checksum. The frame is the
+ * one enetc_free_pkt() releases next, its BD is still as ENETC returned it.
+ */
+static int enetc_rx_csum(struct udevice *dev, uchar *packet, int length,
+			 u16 *sum)
+{
+	struct enetc_priv *priv = dev_get_priv(dev);
+	int ci = priv->rx_bdr.next_cons_idx;
+	u16 inet_csum = le16_to_cpu(priv->enetc_rxbd[ci].r.inet_csum);
+
+	*sum = ~cpu_to_be16(inet_csum) & 0xffff;
+
+	return ETH_CSUM_COMPLETE;
 }
 
 static const struct eth_ops enetc_ops = {
 	.start	= enetc_start,
 	.send	= enetc_send,
 	.recv	= enetc_recv,
+	.free_pkt = enetc_free_pkt,
+	.rx_csum = enetc_rx_csum,
 	.stop	= enetc_stop,
 	.write_hwaddr = enetc_write_hwaddr,
 };
@@ -79,9 +79,14 @@ enum enetc_bdr_type {TX, RX};
 #define  ENETC_PM_IF_IFMODE_MASK	GENMASK(1, 0)
 
 /* buffer descriptors count must be multiple of 8 and aligned to 128 bytes */
-#define ENETC_BD_CNT		CONFIG_SYS_RX_ETH_BUFFER
+#define ENETC_TX_BD_CNT		CONFIG_FSL_ENETC_TX_BD_CNT
+#define ENETC_RX_BD_CNT		CONFIG_FSL_ENETC_RX_BD_CNT
 #define ENETC_BD_ALIGN		128
 
+#if (ENETC_TX_BD_CNT % 8) || (ENETC_RX_BD_CNT % 8)
+#error "ENETC buffer descriptor counts must be multiples of 8"
+#endif
+
 /* single pair of Rx/Tx rings */
 #define ENETC_RX_BDR_CNT	1
 #define ENETC_TX_BDR_CNT	1
@@ -144,6 +149,9 @@ struct bd_ring {
 struct enetc_priv {
 	struct enetc_tx_bd *enetc_txbd;
 	union enetc_rx_bd *enetc_rxbd;
+	/* one PKTSIZE_ALIGN buffer per Tx/Rx BD */
+	uchar *tx_buf;
+	uchar *rx_buf;
 
 	void *regs_base; /* base ENETC registers */
 	void *port_regs; /* base ENETC port registers */
@@ -206,6 +206,36 @@ static void ldpaa_eth_get_dpmac_counter(struct eth_device *net_dev)
 }
 #endif
 
+/* Give buffers back to the pool, retrying while the portal is busy */
+static int ldpaa_eth_release_bufs(u64 *bufs, int count)
+{
+	u32 timeo = (CONFIG_SYS_HZ * 2) / 1000;
+	u32 time_start;
+	struct qbman_release_desc releasedesc;
+	struct qbman_swp *swp = dflt_dpio->sw_portal;
+	int err;
+
+	qbman_release_desc_clear(&releasedesc);
+	qbman_release_desc_set_bpid(&releasedesc, dflt_dpbp->dpbp_attr.bpid);
+	time_start = get_timer(0);
+	do {
+		/* Release buffer into the QBMAN */
+		err = qbman_swp_release(swp, &releasedesc, bufs, count);
+	} while (get_timer(time_start) < timeo && err == -EBUSY);
+
+	return err;
+}
+
+static void ldpaa_eth_rx_release_flush(struct ldpaa_eth_priv *priv)
+{
+	if (!priv->rx_bufs_cnt)
+		return;
+
+	if (ldpaa_eth_release_bufs(priv->rx_bufs, priv->rx_bufs_cnt) == -EBUSY)
+		printf("Rx frame: QBMAN buffer release fails\n");
+	priv->rx_bufs_cnt = 0;
+}
+
 static void ldpaa_eth_rx(struct ldpaa_eth_priv *priv,
 			 const struct dpaa_fd *fd)
 {
@@ -213,11 +243,8 @@ static void ldpaa_eth_rx(struct ldpaa_eth_priv *priv,
 	uint16_t fd_offset;
 	uint32_t fd_length;
 	struct ldpaa_fas *fas;
-	uint32_t status, err;
-	u32 timeo = (CONFIG_SYS_HZ * 2) / 1000;
-	u32 time_start;
-	struct qbman_release_desc releasedesc;
-	struct qbman_swp *swp = dflt_dpio->sw_portal;
+	uint32_t status;
+	int csum = 0;
 
 	fd_addr = ldpaa_fd_get_addr(fd);
 	fd_offset = ldpaa_fd_get_offset(fd);
@@ -240,84 +267,122 @@ static void ldpaa_eth_rx(struct ldpaa_eth_priv *priv,
 			       status & LDPAA_ETH_RX_UNSUPP_MASK);
 			goto error;
 		}
+		/* Bad checksums were dropped above, report the good ones */
+		if (status & LDPAA_ETH_FAS_L3CV)
+			csum |= ETH_CSUM_IP;
+		if (status & LDPAA_ETH_FAS_L4CV)
+			csum |= ETH_CSUM_L4;
 	}
 
 	debug("Rx frame: To Upper layer\n");
-	net_process_received_packet((uint8_t *)(fd_addr) + fd_offset,
-				    fd_length);
+	priv->rx_pkt = (uint8_t *)(fd_addr) + fd_offset;
+	priv->rx_csum = csum;
+	net_process_received_packet(priv->rx_pkt, fd_length);
+	priv->rx_pkt = NULL;
 
 error:
 	flush_dcache_range(fd_addr, fd_addr + LDPAA_ETH_RX_BUFFER_SIZE);
-	qbman_release_desc_clear(&releasedesc);
-	qbman_release_desc_set_bpid(&releasedesc, dflt_dpbp->dpbp_attr.bpid);
-	time_start = get_timer(0);
-	do {
-		/* Release buffer into the QBMAN */
-		err = qbman_swp_release(swp, &releasedesc, &fd_addr, 1);
-	} while (get_timer(time_start) < timeo && err == -EBUSY);
-
-	if (err == -EBUSY)
-		printf("Rx frame: QBMAN buffer release fails\n");
 
-	return;
+	/* The buffer goes back to the pool with the rest of the burst */
+	priv->rx_bufs[priv->rx_bufs_cnt++] = fd_addr;
+	if (priv->rx_bufs_cnt == LDPAA_ETH_BUF_BATCH)
+		ldpaa_eth_rx_release_flush(priv);
 }
 
-static int ldpaa_eth_pull_dequeue_rx(struct eth_device *dev)
+/*
+ * Process the responses to the last volatile dequeue command, up to and
+ * including the one QBMAN marks as expired. Returns the number of frames
+ * handed to the stack, or -ENODATA if QBMAN stopped answering.
+ */
+static int ldpaa_eth_rx_drain(struct ldpaa_eth_priv *priv)
 {
-	struct ldpaa_eth_priv *priv = (struct ldpaa_eth_priv *)dev->priv;
 	const struct ldpaa_dq *dq;
 	const struct dpaa_fd *fd;
-	int i = 5, err = 0, status;
+	int frames = 0, status;
 	u32 timeo = (CONFIG_SYS_HZ * 2) / 1000;
 	u32 time_start;
-	static struct qbman_pull_desc pulldesc;
 	struct qbman_swp *swp = dflt_dpio->sw_portal;
 
-	while (--i) {
-		qbman_pull_desc_clear(&pulldesc);
-		qbman_pull_desc_set_numframes(&pulldesc, 1);
-		qbman_pull_desc_set_fq(&pulldesc, priv->rx_dflt_fqid);
-
-		err = qbman_swp_pull(swp, &pulldesc);
-		if (err < 0) {
-			printf("Dequeue frames error:0x%08x\n", err);
-			continue;
-		}
-
+	do {
 		time_start = get_timer(0);
 
-		 do {
+		do {
 			dq = qbman_swp_dqrr_next(swp);
 		} while (get_timer(time_start) < timeo && !dq);
 
-		if (dq) {
-			/* Check for valid frame. If not sent a consume
-			 * confirmation to QBMAN otherwise give it to NADK
-			 * application and then send consume confirmation to
-			 * QBMAN.
-			 */
-			status = (uint8_t)ldpaa_dq_flags(dq);
-			if ((status & LDPAA_DQ_STAT_VALIDFRAME) == 0) {
-				debug("Dequeue RX frames:");
-				debug("No frame delivered\n");
-
-				qbman_swp_dqrr_consume(swp, dq);
-				continue;
-			}
+		if (!dq) {
+			debug("No DQRR entries\n");
+			return -ENODATA;
+		}
 
+		/* Check for valid frame. If not sent a consume
+		 * confirmation to QBMAN otherwise give it to NADK
+		 * application and then send consume confirmation to
+		 * QBMAN.
+		 */
+		status = (uint8_t)ldpaa_dq_flags(dq);
+		if (status & LDPAA_DQ_STAT_VALIDFRAME) {
 			fd = ldpaa_dq_fd(dq);
 
 			/* Obtain FD and process it */
 			ldpaa_eth_rx(priv, fd);
-			qbman_swp_dqrr_consume(swp, dq);
-			break;
+			frames++;
 		} else {
-			err = -ENODATA;
-			debug("No DQRR entries\n");
+			debug("Dequeue RX frames:");
+			debug("No frame delivered\n");
+		}
+		qbman_swp_dqrr_consume(swp, dq);
+	} while (!(status & LDPAA_DQ_STAT_EXPIRED));
+
+	return frames;
+}
+
+/* Report the checksums WRIOP verified for the frame being passed up */
+static int ldpaa_eth_rx_csum(struct eth_device *dev, uchar *packet,
+			     int length, u16 *sum)
+{
+	struct ldpaa_eth_priv *priv = (struct ldpaa_eth_priv *)dev->priv;
+
+	if (packet != priv->rx_pkt)
+		return 0;
+
+	return priv->rx_csum;
+}
+
+static int ldpaa_eth_pull_dequeue_rx(struct eth_device *dev)
+{
+	struct ldpaa_eth_priv *priv = (struct ldpaa_eth_priv *)dev->priv;
+	int i = 5, err = 0, frames;
+	static struct qbman_pull_desc pulldesc;
+	struct qbman_swp *swp = dflt_dpio->sw_portal;
+
+	while (--i) {
+		qbman_pull_desc_clear(&pulldesc);
+		qbman_pull_desc_set_numframes(&pulldesc, LDPAA_ETH_RX_BATCH);
+		qbman_pull_desc_set_fq(&pulldesc, priv->rx_dflt_fqid);
+
+		/*
+		 * -EBUSY means the responses to an earlier command are still
+		 * outstanding; collect those instead of issuing a new one.
+		 */
+		err = qbman_swp_pull(swp, &pulldesc);
+		if (err < 0 && err != -EBUSY) {
+			printf("Dequeue frames error:0x%08x\n", err);
+			continue;
+		}
+
+		frames = ldpaa_eth_rx_drain(priv);
+		if (frames < 0) {
+			err = frames;
 			break;
 		}
+		err = 0;
+		if (frames)
+			break;
 	}
 
+	ldpaa_eth_rx_release_flush(priv);
+
 	return err;
 }
 
@@ -331,23 +396,40 @@ static int ldpaa_eth_tx(struct eth_device *net_dev, void *buf, int len)
 	u32 time_start;
 	struct qbman_swp *swp = dflt_dpio->sw_portal;
 	struct qbman_eq_desc ed;
-	struct qbman_release_desc releasedesc;
 
 	/* Setup the FD fields */
 	memset(&fd, 0, sizeof(fd));
 
 	data_offset = priv->tx_data_offset;
 
-	do {
-		err = qbman_swp_acquire(dflt_dpio->sw_portal,
-					dflt_dpbp->dpbp_attr.bpid,
-					&buffer_start, 1);
-	} while (err == -EBUSY);
+	/*
+	 * Tx confirmation is disabled: WRIOP hands the buffer straight back
+	 * to the pool once the frame is out. Take buffers from the pool a
+	 * batch at a time so most frames go out with a single enqueue.
+	 */
+	if (!priv->tx_bufs_cnt) {
+		do {
+			err = qbman_swp_acquire(swp, dflt_dpbp->dpbp_attr.bpid,
+						priv->tx_bufs,
+						LDPAA_ETH_BUF_BATCH);
+		} while (err == -EBUSY);
+
+		/* Running short of buffers, fall back to a single one */
+		if (!err) {
+			do {
+				err = qbman_swp_acquire(swp,
+						dflt_dpbp->dpbp_attr.bpid,
+						priv->tx_bufs, 1);
+			} while (err == -EBUSY);
+		}
 
-	if (err <= 0) {
-		printf("qbman_swp_acquire() failed\n");
-		return -ENOMEM;
+		if (err <= 0) {
+			printf("qbman_swp_acquire() failed\n");
+			return -ENOMEM;
+		}
+		priv->tx_bufs_cnt = err;
 	}
+	buffer_start = priv->tx_bufs[--priv->tx_bufs_cnt];
 
 	debug("TX data: malloc buffer start=0x%p\n", (u64 *)buffer_start);
 
@@ -385,16 +467,8 @@ static int ldpaa_eth_tx(struct eth_device *net_dev, void *buf, int len)
 	return err;
 
 error:
-	qbman_release_desc_clear(&releasedesc);
-	qbman_release_desc_set_bpid(&releasedesc, dflt_dpbp->dpbp_attr.bpid);
-	time_start = get_timer(0);
-	do {
-		/* Release buffer into the QBMAN */
-		err = qbman_swp_release(swp, &releasedesc, &buffer_start, 1);
-	} while (get_timer(time_start) < timeo && err == -EBUSY);
-
-	if (err == -EBUSY)
-		printf("TX data: QBMAN buffer release fails\n");
+	/* Keep the buffer for the next frame */
+	priv->tx_bufs[priv->tx_bufs_cnt++] = buffer_start;
 
 	return err;
 }
@@ -635,6 +709,12 @@ static void ldpaa_eth_stop(struct eth_device *net_dev)
 	}
 #endif
 
+	/* Hand the buffers cached for Tx back so the pool drain frees them */
+	if (priv->tx_bufs_cnt) {
+		ldpaa_eth_release_bufs(priv->tx_bufs, priv->tx_bufs_cnt);
+		priv->tx_bufs_cnt = 0;
+	}
+
 	/* Free DPBP handle and reset. */
 	ldpaa_dpbp_free();
 
@@ -723,15 +803,19 @@ err_alloc:
 static int ldpaa_dpbp_seed(uint16_t bpid)
 {
 	int i;
-	int count;
+	int count, total = 0;
 
 	for (i = 0; i < LDPAA_ETH_NUM_BUFS; i += 7) {
 		count = ldpaa_bp_add_7(bpid);
-		if (count < 7)
-			printf("Buffer Seed= %d\n", count);
+		total += count;
+		/* Out of memory, make do with what the pool already has */
+		if (count < 7) {
+			printf("Buffer Seed= %d\n", total);
+			break;
+		}
 	}
 
-	return 0;
+	return total ? 0 : -ENOMEM;
 }
 
 static int ldpaa_dpbp_setup(void)
@@ -1023,6 +1107,29 @@ static int ldpaa_dpni_bind(struct ldpaa_eth_priv *priv)
 		return err;
 	}
 
+	/*
+	 * Have the frame status tell which checksums were found good, so the
+	 * stack does not check them again. Older MC firmware lacks this.
+	 */
+	err = dpni_set_offload(dflt_mc_io, MC_CMD_NO_FLAGS,
+			       dflt_dpni->dpni_handle, DPNI_OFF_RX_L3_CSUM, 1);
+	if (!err)
+		err = dpni_set_offload(dflt_mc_io, MC_CMD_NO_FLAGS,
+				       dflt_dpni->dpni_handle,
+				       DPNI_OFF_RX_L4_CSUM, 1);
+	if (err)
+		debug("dpni_set_offload() failed: %d\n", err);
+
+	if (IS_ENABLED(CONFIG_NET_JUMBO_FRAMES)) {
+		err = dpni_set_max_frame_length(dflt_mc_io, MC_CMD_NO_FLAGS,
+						dflt_dpni->dpni_handle,
+						PKTSIZE);
+		if (err) {
+			printf("dpni_set_max_frame_length() failed\n");
+			return err;
+		}
+	}
+
 	return 0;
 }
 
@@ -1040,6 +1147,7 @@ static int ldpaa_eth_netdev_init(struct eth_device *net_dev,
 	net_dev->halt = ldpaa_eth_stop;
 	net_dev->send = ldpaa_eth_tx;
 	net_dev->recv = ldpaa_eth_pull_dequeue_rx;
+	net_dev->rx_csum = ldpaa_eth_rx_csum;
 
 #ifdef CONFIG_PHYLIB
 	err = init_phy(net_dev);
@@ -8,6 +8,7 @@
 #define __LDPAA_ETH_H
 
 #include <linux/netdevice.h>
+#include <linux/sizes.h>
 #include <fsl-mc/fsl_mc.h>
 #include <fsl-mc/fsl_dpaa_fd.h>
 #include <fsl-mc/fsl_dprc.h>
@@ -24,9 +25,24 @@ enum ldpaa_eth_type {
 };
 
 /* Arbitrary values for now, but we'll need to tune */
-#define LDPAA_ETH_NUM_BUFS		(7 * 7)
+#ifdef CONFIG_NET_JUMBO_FRAMES
+#define LDPAA_ETH_NUM_BUFS		(7 * 6)
+#else
+#define LDPAA_ETH_NUM_BUFS		(7 * 16)
+#endif
 #define LDPAA_ETH_REFILL_THRESH		(LDPAA_ETH_NUM_BUFS/2)
-#define LDPAA_ETH_RX_BUFFER_SIZE	2048
+/*
+ * The headroom and a whole frame, rounded up to 2 KiB: 2048 bytes without
+ * jumbo frames, 10240 with them
+ */
+#define LDPAA_ETH_RX_BUFFER_SIZE	ALIGN(LDPAA_ETH_BUF_ALIGN + PKTSIZE, \
+					      SZ_2K)
+
+/* Frames requested by one volatile dequeue command, QBMAN allows 1 to 16 */
+#define LDPAA_ETH_RX_BATCH		16
+
+/* Buffers moved by one acquire or release command, QBMAN allows 1 to 7 */
+#define LDPAA_ETH_BUF_BATCH		7
 
 /* Hardware requires alignment for buffer address and length: 256-byte
  * for ingress, 64-byte for egress. Using 256 for both.
@@ -126,6 +142,16 @@ struct ldpaa_eth_priv {
 	uint16_t tx_qdid;
 	uint16_t tx_flow_id;
 
+	/* Pool buffers acquired ahead of time for Tx frames */
+	u64 tx_bufs[LDPAA_ETH_BUF_BATCH];
+	int tx_bufs_cnt;
+	/* Rx buffers handed back by the stack, not yet released to the pool */
+	u64 rx_bufs[LDPAA_ETH_BUF_BATCH];
+	int rx_bufs_cnt;
+	/* Frame being passed to the stack and its ETH_CSUM_x flags */
+	uchar *rx_pkt;
+	int rx_csum;
+
 	enum ldpaa_eth_type type;	/* 1G or 10G ethernet */
 };
 
@@ -360,6 +360,15 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		debug("eth_sandbox: received packet[%d], %d waiting\n",
 		      lcl_recv_packet_length, priv->recv_packets - 1);
 		*packetp = priv->recv_packet_buffer[0];
+
+		/* Pretend to DMA the packet where the stack asked for it */
+		if (priv->post_buf && lcl_recv_packet_length <= priv->post_len) {
+			memcpy(priv->post_buf, priv->recv_packet_buffer[0],
+			       lcl_recv_packet_length);
+			*packetp = priv->post_buf;
+			priv->post_buf = NULL;
+			priv->recv_posted++;
+		}
 		return lcl_recv_packet_length;
 	}
 	return 0;
@@ -385,9 +394,35 @@ static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 	return 0;
 }
 
+static int sb_eth_post_rx_buf(struct udevice *dev, uchar *buf, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	priv->post_buf = buf;
+	priv->post_len = len;
+
+	return 0;
+}
+
+static int sb_eth_rx_csum(struct udevice *dev, uchar *packet, int length,
+			  u16 *sum)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	/* Pretend to have summed up the frame as it came in */
+	if (priv->rx_csum & ETH_CSUM_COMPLETE)
+		*sum = ~compute_ip_checksum(packet + ETHER_HDR_SIZE,
+					    length - ETHER_HDR_SIZE) & 0xffff;
+
+	return priv->rx_csum;
+}
+
 static void sb_eth_stop(struct udevice *dev)
 {
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
 	debug("eth_sandbox: Stop\n");
+	priv->post_buf = NULL;
 }
 
 static int sb_eth_write_hwaddr(struct udevice *dev)
@@ -404,6 +439,8 @@ static const struct eth_ops sb_eth_ops = {
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
 	.free_pkt		= sb_eth_free_pkt,
+	.post_rx_buf		= sb_eth_post_rx_buf,
+	.rx_csum		= sb_eth_rx_csum,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
 };
@@ -10,7 +10,7 @@
 #include <dm/device.h>
 #include "nvme.h"
 
-static int nvme_uclass_post_probe(struct udevice *udev)
+int nvme_bind_namespaces(struct udevice *udev)
 {
 	char name[20];
 	struct udevice *ns_udev;
@@ -35,6 +35,17 @@ static int nvme_uclass_post_probe(struct udevice *udev)
 	return 0;
 }
 
+static int nvme_uclass_post_probe(struct udevice *udev)
+{
+	struct nvme_dev *ndev = dev_get_priv(udev);
+
+	/* Done once the controller is ready, see nvme_blk_probe_finish() */
+	if (ndev->enable_pending)
+		return 0;
+
+	return nvme_bind_namespaces(udev);
+}
+
 UCLASS_DRIVER(nvme) = {
 	.name	= "nvme",
 	.id	= UCLASS_NVME,
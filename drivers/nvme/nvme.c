@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <dm.h>
 #include <errno.h>
 #include <memalign.h>
@@ -12,13 +13,15 @@
 #include <dm/device-internal.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
+
+/* Set while blk_probe_all() probes the controllers, see nvme_probe() */
+static bool nvme_probe_nowait;
 
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
@@ -26,6 +29,12 @@ enum nvme_queue_id {
 	NVME_Q_NUM,
 };
 
+/* The block request an I/O command in a submission queue slot belongs to */
+struct nvme_slot {
+	struct blk_request *req;
+	u64 slba;
+};
+
 /*
  * An NVM Express queue. Each device has at least two (one for admin
  * commands and one for I/O commands).
@@ -44,7 +53,14 @@ struct nvme_queue {
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
-	unsigned long cmdid_data[];
+	struct list_head reqs;		/* block requests not yet completed */
+	int inflight;			/* I/O commands in flight */
+	ulong last_progress;		/* timer_get_us() of the last one */
+	bool failed;			/* could not be reset, fail all I/O */
+	u16 next_slot;			/* where to look for a free slot */
+	/* slots whose command, command ID and PRP list are in use */
+	DECLARE_BITMAP(busy, NVME_Q_DEPTH);
+	struct nvme_slot slots[];
 };
 
 static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
@@ -65,12 +81,26 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
+/**
+ * nvme_setup_prps() - describe a transfer with PRP entries
+ *
+ * Transfers spanning more than two pages use the PRP list of @slot, taken
+ * from the pool allocated at probe time, so that every command in flight
+ * has its own list.
+ *
+ * @dev:	NVMe device
+ * @slot:	I/O submission queue slot the command goes to
+ * @prp2:	Returns the PRP2 value of the command
+ * @total_len:	Length of the transfer in bytes
+ * @dma_addr:	Address of the buffer, which is also PRP1
+ * @return 0 if OK, -ve on error
+ */
+static int nvme_setup_prps(struct nvme_dev *dev, int slot, u64 *prp2,
 			   int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
+	u64 *prp_list, *prp_pool;
 	int length = total_len;
 	int i, nprps;
 	u32 prps_per_page = (page_size >> 3) - 1;
@@ -94,34 +124,29 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	nprps = DIV_ROUND_UP(length, page_size);
 	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		/*
-		 * Always increase in increments of pages.  It doesn't waste
-		 * much memory and reduces the number of allocations.
-		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = prps_per_page * num_pages;
+	if (num_pages > dev->prp_list_pages) {
+		printf("Error: transfer too large for the PRP list\n");
+		return -EINVAL;
 	}
 
-	prp_pool = dev->prp_pool;
+	prp_list = (void *)dev->prp_pool +
+		   (ulong)slot * dev->prp_list_pages * page_size;
+	prp_pool = prp_list;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
+		if (i == prps_per_page) {
 			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
 					page_size);
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += page_size >> 3;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	flush_dcache_range((ulong)prp_list,
+			   (ulong)prp_list + num_pages * page_size);
+	*prp2 = (ulong)prp_list;
 
 	return 0;
 }
@@ -144,12 +169,38 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_get_slot() - take a free I/O command slot
+ *
+ * The slot number is used as command ID and selects the PRP list, so it
+ * stays taken until the completion of the command has been reaped, even if
+ * completions come back out of order.
+ *
+ * @nvmeq:	The queue to use
+ * @return slot number, -1 if all slots are busy
+ */
+static int nvme_get_slot(struct nvme_queue *nvmeq)
+{
+	int i, slot;
+
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		slot = (nvmeq->next_slot + i) % nvmeq->q_depth;
+		if (!test_bit(slot, nvmeq->busy)) {
+			__set_bit(slot, nvmeq->busy);
+			nvmeq->next_slot = (slot + 1) % nvmeq->q_depth;
+			return slot;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
  *
  * @nvmeq:	The queue to use
  * @cmd:	The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -159,10 +210,21 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
 }
 
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 				struct nvme_command *cmd,
 				u32 *result, unsigned timeout)
@@ -227,10 +289,11 @@ static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
 static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 					   int qid, int depth)
 {
-	struct nvme_queue *nvmeq = malloc(sizeof(*nvmeq));
+	struct nvme_queue *nvmeq = calloc(1, sizeof(*nvmeq) +
+					  depth * sizeof(struct nvme_slot));
 	if (!nvmeq)
 		return NULL;
-	memset(nvmeq, 0, sizeof(*nvmeq));
+	INIT_LIST_HEAD(&nvmeq->reqs);
 
 	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_SIZE(depth));
 	if (!nvmeq->cqes)
@@ -283,13 +346,11 @@ static int nvme_delete_cq(struct nvme_dev *dev, u16 cqid)
 	return nvme_delete_queue(dev, nvme_admin_delete_cq, cqid);
 }
 
-static int nvme_enable_ctrl(struct nvme_dev *dev)
+static void nvme_start_ctrl(struct nvme_dev *dev)
 {
 	dev->ctrl_config &= ~NVME_CC_SHN_MASK;
 	dev->ctrl_config |= NVME_CC_ENABLE;
 	writel(cpu_to_le32(dev->ctrl_config), &dev->bar->cc);
-
-	return nvme_wait_ready(dev, true);
 }
 
 static int nvme_disable_ctrl(struct nvme_dev *dev)
@@ -324,6 +385,7 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 {
 	struct nvme_dev *dev = nvmeq->dev;
 
+	nvmeq->sq_head = 0;
 	nvmeq->sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
@@ -334,6 +396,24 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 	dev->online_queues++;
 }
 
+/* Waits for the controller enabled by nvme_configure_admin_queue() */
+static int nvme_admin_queue_ready(struct nvme_dev *dev)
+{
+	int result;
+
+	dev->enable_pending = false;
+	result = nvme_wait_ready(dev, true);
+	if (result) {
+		nvme_free_queues(dev, 0);
+		return result;
+	}
+
+	dev->queues[NVME_ADMIN_Q]->cq_vector = 0;
+	nvme_init_queue(dev->queues[NVME_ADMIN_Q], 0);
+
+	return 0;
+}
+
 static int nvme_configure_admin_queue(struct nvme_dev *dev)
 {
 	int result;
@@ -383,20 +463,13 @@ static int nvme_configure_admin_queue(struct nvme_dev *dev)
 	nvme_writeq((ulong)nvmeq->sq_cmds, &dev->bar->asq);
 	nvme_writeq((ulong)nvmeq->cqes, &dev->bar->acq);
 
-	result = nvme_enable_ctrl(dev);
-	if (result)
-		goto free_nvmeq;
-
-	nvmeq->cq_vector = 0;
-
-	nvme_init_queue(dev->queues[NVME_ADMIN_Q], 0);
-
-	return result;
-
- free_nvmeq:
-	nvme_free_queues(dev, 0);
+	nvme_start_ctrl(dev);
+	if (nvme_probe_nowait) {
+		dev->enable_pending = true;
+		return 0;
+	}
 
-	return result;
+	return nvme_admin_queue_ready(dev);
 }
 
 static int nvme_alloc_cq(struct nvme_dev *dev, u16 qid,
@@ -529,6 +602,44 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 	return result;
 }
 
+/**
+ * nvme_reset_io_queue() - drop every command of an I/O queue
+ *
+ * Deleting the submission queue makes the controller abort the commands it
+ * holds, so that none of them can still write to memory once this returns.
+ * The queues are then created again, empty. If the controller does not
+ * cooperate it is disabled, and all further I/O on the queue fails.
+ *
+ * @nvmeq:	I/O queue to reset
+ * @return 0 if OK, -ve on error
+ */
+static int nvme_reset_io_queue(struct nvme_queue *nvmeq)
+{
+	struct nvme_dev *dev = nvmeq->dev;
+	int ret;
+
+	ret = nvme_delete_sq(dev, nvmeq->qid);
+	if (!ret)
+		ret = nvme_delete_cq(dev, nvmeq->qid);
+	if (!ret) {
+		dev->online_queues--;
+		ret = nvme_create_queue(nvmeq, nvmeq->qid);
+	}
+
+	memset(nvmeq->busy, 0, sizeof(nvmeq->busy));
+	memset(nvmeq->slots, 0, nvmeq->q_depth * sizeof(struct nvme_slot));
+	nvmeq->inflight = 0;
+
+	if (ret) {
+		printf("Error: cannot reset NVMe I/O queue %u, disabling\n",
+		       nvmeq->qid);
+		nvme_disable_ctrl(dev);
+		nvmeq->failed = true;
+	}
+
+	return ret;
+}
+
 static int nvme_set_queue_count(struct nvme_dev *dev, int count)
 {
 	int status;
@@ -676,65 +787,246 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
-static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
-			 lbaint_t blkcnt, void *buffer, bool read)
+/**
+ * nvme_issue() - queue the I/O commands of the pending block requests
+ *
+ * Requests are split into commands of at most the maximum transfer size and
+ * up to q_depth - 1 of them are kept in flight, one submission queue entry
+ * always staying empty. Each command takes a free slot for its command ID
+ * and PRP list. The doorbell is rung once for the whole batch.
+ *
+ * @nvmeq:	I/O queue to fill
+ */
+static void nvme_issue(struct nvme_queue *nvmeq)
 {
-	struct nvme_ns *ns = dev_get_priv(udev);
-	struct nvme_dev *dev = ns->dev;
+	struct nvme_dev *dev = nvmeq->dev;
+	struct blk_request *req;
 	struct nvme_command c;
-	struct blk_desc *desc = dev_get_uclass_platdata(udev);
-	int status;
+	int queued = 0;
 	u64 prp2;
-	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
-
-	if (!read)
-		flush_dcache_range((unsigned long)buffer,
-				   (unsigned long)buffer + total_len);
-
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+
+	if (nvmeq->failed)
+		return;
+
+	list_for_each_entry(req, &nvmeq->reqs, node) {
+		struct nvme_ns *ns = dev_get_priv(req->dev);
+		u32 max_lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
+
+		/* Nothing more is sent for a request once a command failed */
+		while (req->issued < req->blkcnt && req->good == req->blkcnt &&
+		       nvmeq->inflight < nvmeq->q_depth - 1) {
+			void *buf = req->buffer +
+				    (req->issued << ns->lba_shift);
+			u64 slba = req->start + req->issued;
+			u32 lbas;
+			int slot;
+
+			slot = nvme_get_slot(nvmeq);
+			if (slot < 0)
+				break;
+
+			lbas = min_t(u64, req->blkcnt - req->issued, max_lbas);
+			if (nvme_setup_prps(dev, slot, &prp2,
+					    lbas << ns->lba_shift,
+					    (ulong)buf)) {
+				__clear_bit(slot, nvmeq->busy);
+				req->good = req->issued;
+				break;
+			}
+
+			memset(&c, 0, sizeof(c));
+			c.rw.opcode = req->write ? nvme_cmd_write :
+				      nvme_cmd_read;
+			c.rw.nsid = cpu_to_le32(ns->ns_id);
+			c.rw.command_id = cpu_to_le16(slot);
+			c.rw.slba = cpu_to_le64(slba);
+			c.rw.length = cpu_to_le16(lbas - 1);
+			c.rw.prp1 = cpu_to_le64((ulong)buf);
+			c.rw.prp2 = cpu_to_le64(prp2);
+			nvmeq->slots[slot].req = req;
+			nvmeq->slots[slot].slba = slba;
+			nvme_queue_cmd(nvmeq, &c);
+
+			if (!nvmeq->inflight)
+				nvmeq->last_progress = timer_get_us();
+			nvmeq->inflight++;
+			req->inflight++;
+			req->issued += lbas;
+			queued++;
 		}
+	}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, (ulong)buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64((ulong)buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+	if (queued)
+		writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
+/**
+ * nvme_reap_completions() - process the completions posted to a queue
+ *
+ * Every completion that has arrived is consumed and the completion queue
+ * doorbell is written once for the whole batch. This does not wait.
+ *
+ * @nvmeq:	I/O queue to poll
+ */
+static void nvme_reap_completions(struct nvme_queue *nvmeq)
+{
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	struct nvme_completion *cqe;
+	struct nvme_slot *slot;
+	int reaped = 0;
+	u16 status, cid;
+
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != phase)
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		buffer += lbas << ns->lba_shift;
+
+		cqe = &nvmeq->cqes[head];
+		nvmeq->sq_head = le16_to_cpu(readw(&cqe->sq_head));
+		cid = le16_to_cpu(readw(&cqe->command_id));
+		status >>= 1;
+		if (status)
+			printf("ERROR: status = %x, phase = %d, head = %d\n",
+			       status, phase, head);
+
+		if (cid < nvmeq->q_depth && test_bit(cid, nvmeq->busy)) {
+			slot = &nvmeq->slots[cid];
+			if (status)
+				slot->req->good = min_t(u64, slot->req->good,
+							slot->slba -
+							slot->req->start);
+			slot->req->inflight--;
+			slot->req = NULL;
+			__clear_bit(cid, nvmeq->busy);
+			nvmeq->inflight--;
+		} else {
+			printf("Error: completion for unknown command %u\n",
+			       cid);
+		}
+
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			phase = !phase;
+		}
+		reaped++;
 	}
 
-	if (read)
-		invalidate_dcache_range((unsigned long)buffer,
-					(unsigned long)buffer + total_len);
+	if (!reaped)
+		return;
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
+	nvmeq->cq_head = head;
+	nvmeq->cq_phase = phase;
+	nvmeq->last_progress = timer_get_us();
+}
+
+/**
+ * nvme_io_poll() - make progress on the block requests of an I/O queue
+ *
+ * Requests whose commands have all completed are completed with the number
+ * of blocks before the first failed command, and the queue is refilled.
+ * When nothing completes for IO_TIMEOUT, the queue is reset, which aborts
+ * the commands in flight, and the requests they belong to fail with
+ * -ETIMEDOUT.
+ *
+ * @nvmeq:	I/O queue to poll
+ * @return number of requests not yet completed
+ */
+static int nvme_io_poll(struct nvme_queue *nvmeq)
+{
+	struct blk_request *req, *next;
+	struct nvme_ns *ns;
+	int pending = 0;
+	long result;
+
+	if (!nvmeq->failed)
+		nvme_reap_completions(nvmeq);
+
+	if (nvmeq->inflight &&
+	    timer_get_us() - nvmeq->last_progress >= IO_TIMEOUT * 100000) {
+		req = list_first_entry(&nvmeq->reqs, struct blk_request, node);
+		printf("Error: %s: I/O timeout\n", req->dev->name);
+		/* Nothing may still be written to the buffers after this */
+		nvme_reset_io_queue(nvmeq);
+	}
+
+	list_for_each_entry_safe(req, next, &nvmeq->reqs, node) {
+		if (req->inflight && nvmeq->inflight) {
+			pending++;
+			continue;
+		}
+		if (nvmeq->failed) {
+			result = -EIO;
+		} else if (req->inflight) {
+			/* Its commands were aborted by the reset above */
+			req->inflight = 0;
+			result = -ETIMEDOUT;
+		} else if (req->issued < req->blkcnt &&
+			   req->good == req->blkcnt) {
+			pending++;
+			continue;
+		} else {
+			result = req->good;
+		}
+
+		list_del(&req->node);
+		if (!req->write) {
+			ns = dev_get_priv(req->dev);
+			invalidate_dcache_range((ulong)req->buffer,
+						(ulong)req->buffer +
+						(req->blkcnt << ns->lba_shift));
+		}
+		blk_request_complete(req, result);
+	}
+
+	nvme_issue(nvmeq);
+
+	return pending;
+}
+
+static int nvme_blk_submit(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_queue *nvmeq = ns->dev->queues[NVME_IO_Q];
+
+	if (req->write)
+		flush_dcache_range((ulong)req->buffer,
+				   (ulong)req->buffer +
+				   (req->blkcnt << ns->lba_shift));
+
+	req->issued = 0;
+	req->good = req->blkcnt;
+	req->inflight = 0;
+	list_add_tail(&req->node, &nvmeq->reqs);
+	nvme_issue(nvmeq);
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	return nvme_io_poll(ns->dev->queues[NVME_IO_Q]);
+}
+
+static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
+			 lbaint_t blkcnt, void *buffer, bool read)
+{
+	struct blk_request req = {
+		.dev	= udev,
+		.write	= !read,
+		.start	= blknr,
+		.blkcnt	= blkcnt,
+		.buffer	= buffer,
+	};
+
+	nvme_blk_submit(udev, &req);
+	while (!req.complete)
+		nvme_blk_poll(udev);
+
+	return req.result < 0 ? 0 : req.result;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -752,6 +1044,8 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -772,6 +1066,41 @@ static int nvme_bind(struct udevice *udev)
 	return device_set_name(udev, name);
 }
 
+/* Sets up the I/O queues once the controller is enabled */
+static int nvme_setup_ctrl(struct udevice *udev)
+{
+	struct nvme_dev *ndev = dev_get_priv(udev);
+	int ret, nprps;
+
+	if (ndev->enable_pending) {
+		ret = nvme_admin_queue_ready(ndev);
+		if (ret)
+			return ret;
+	}
+
+	ret = nvme_setup_io_queues(ndev);
+	if (ret)
+		return ret;
+
+	nvme_get_info_from_identify(ndev);
+
+	/*
+	 * Allocate once the page and maximum transfer sizes are known: each
+	 * I/O queue slot gets a PRP list for a maximum sized transfer.
+	 */
+	nprps = (1 << ndev->max_transfer_shift) / ndev->page_size + 1;
+	ndev->prp_list_pages = DIV_ROUND_UP(nprps,
+					    (ndev->page_size >> 3) - 1);
+	ndev->prp_pool = memalign(ndev->page_size, ndev->q_depth *
+				  ndev->prp_list_pages * ndev->page_size);
+	if (!ndev->prp_pool) {
+		printf("Error: %s: Out of memory!\n", udev->name);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static int nvme_probe(struct udevice *udev)
 {
 	int ret;
@@ -805,21 +1134,18 @@ static int nvme_probe(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
+	/*
+	 * When probing for blk_probe_all(), leave the controller getting
+	 * ready while the other ones are probed: nvme_blk_probe_finish()
+	 * sets it up later on.
+	 */
+	if (ndev->enable_pending)
+		return 0;
 
-	ret = nvme_setup_io_queues(ndev);
+	ret = nvme_setup_ctrl(udev);
 	if (ret)
 		goto free_queue;
 
-	nvme_get_info_from_identify(ndev);
-
 	return 0;
 
 free_queue:
@@ -828,11 +1154,112 @@ free_nvme:
 	return ret;
 }
 
+static int nvme_remove(struct udevice *udev)
+{
+	struct nvme_dev *ndev = dev_get_priv(udev);
+
+	/* Stop the controller before its queues go away */
+	nvme_disable_ctrl(ndev);
+	if (ndev->queues) {
+		nvme_free_queues(ndev, 0);
+		free(ndev->queues);
+		ndev->queues = NULL;
+	}
+	free(ndev->prp_pool);
+	ndev->prp_pool = NULL;
+
+	return 0;
+}
+
+#ifdef CONFIG_BLK_PARALLEL_PROBE
+static int nvme_blk_probe_start(void)
+{
+	int ret;
+
+	nvme_probe_nowait = true;
+	ret = nvme_scan_namespace();
+	nvme_probe_nowait = false;
+
+	return ret;
+}
+
+static int nvme_blk_probe_poll(void)
+{
+	struct nvme_dev *ndev;
+	struct udevice *udev;
+	struct uclass *uc;
+	u32 csts;
+	int ret;
+
+	ret = uclass_get(UCLASS_NVME, &uc);
+	if (ret)
+		return ret;
+
+	uclass_foreach_dev(udev, uc) {
+		if (!device_active(udev))
+			continue;
+		ndev = dev_get_priv(udev);
+		if (!ndev->enable_pending)
+			continue;
+		csts = readl(&ndev->bar->csts);
+		if (!(csts & (NVME_CSTS_RDY | NVME_CSTS_CFS)))
+			return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/*
+ * A controller that cannot be set up is removed and unbound, so that
+ * nothing uses its queues, which may already be freed.
+ */
+static int nvme_blk_probe_finish(void)
+{
+	struct udevice *udev, *next;
+	struct nvme_dev *ndev;
+	struct uclass *uc;
+	int ret, err = 0;
+
+	ret = uclass_get(UCLASS_NVME, &uc);
+	if (ret)
+		return ret;
+
+	uclass_foreach_dev_safe(udev, next, uc) {
+		if (!device_active(udev))
+			continue;
+		ndev = dev_get_priv(udev);
+		if (!ndev->enable_pending)
+			continue;
+		ret = nvme_setup_ctrl(udev);
+		if (!ret)
+			ret = nvme_bind_namespaces(udev);
+		if (ret) {
+			printf("Error: %s: setup failed: %d\n", udev->name,
+			       ret);
+			if (!err)
+				err = ret;
+			device_remove(udev, DM_REMOVE_NORMAL);
+			device_unbind(udev);
+		}
+	}
+
+	return err;
+}
+
+U_BOOT_BLK_PROBE(nvme) = {
+	.name	= "NVMe",
+	.start	= nvme_blk_probe_start,
+	.poll	= nvme_blk_probe_poll,
+	.finish	= nvme_blk_probe_finish,
+};
+#endif
+
 U_BOOT_DRIVER(nvme) = {
 	.name	= "nvme",
 	.id	= UCLASS_NVME,
 	.bind	= nvme_bind,
 	.probe	= nvme_probe,
+	.remove	= nvme_remove,
 	.priv_auto_alloc_size = sizeof(struct nvme_dev),
 };
 
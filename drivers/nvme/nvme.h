@@ -625,8 +625,9 @@ struct nvme_dev {
 	u32 page_size;
 	u8 vwc;
 	u64 *prp_pool;
-	u32 prp_entry_num;
+	u32 prp_list_pages;	/* PRP list pages of each I/O queue slot */
 	u32 nn;
+	bool enable_pending;	/* enabled, not yet waited for being ready */
 };
 
 /*
@@ -644,4 +645,12 @@ struct nvme_ns {
 	u32 mode_select_block_len;
 };
 
+/**
+ * nvme_bind_namespaces() - create a blk device for each namespace
+ *
+ * @udev:	NVMe controller device, set up
+ * @return 0 if OK, -ve on error
+ */
+int nvme_bind_namespaces(struct udevice *udev);
+
 #endif /* __DRIVER_NVME_H__ */
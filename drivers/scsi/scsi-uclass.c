@@ -32,6 +32,26 @@ int scsi_bus_reset(struct udevice *dev)
 	return ops->bus_reset(dev);
 }
 
+int scsi_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct scsi_ops *ops = scsi_get_ops(dev);
+
+	if (!ops->submit)
+		return -ENOSYS;
+
+	return ops->submit(dev, req);
+}
+
+int scsi_poll(struct udevice *dev)
+{
+	struct scsi_ops *ops = scsi_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
 UCLASS_DRIVER(scsi) = {
 	.id		= UCLASS_SCSI,
 	.name		= "scsi",
@@ -646,6 +646,18 @@ int scsi_scan(bool verbose)
 
 	return 0;
 }
+
+#ifdef CONFIG_BLK_PARALLEL_PROBE
+static int scsi_blk_probe_finish(void)
+{
+	return scsi_scan(false);
+}
+
+U_BOOT_BLK_PROBE(scsi) = {
+	.name	= "SCSI",
+	.finish	= scsi_blk_probe_finish,
+};
+#endif
 #else
 int scsi_scan(bool verbose)
 {
@@ -688,9 +700,25 @@ int scsi_scan(bool verbose)
 #endif
 
 #ifdef CONFIG_BLK
+#ifdef CONFIG_DM_SCSI
+static int scsi_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	return scsi_submit(dev->parent, req);
+}
+
+static int scsi_blk_poll(struct udevice *dev)
+{
+	return scsi_poll(dev->parent);
+}
+#endif
+
 static const struct blk_ops scsi_blk_ops = {
 	.read	= scsi_read,
 	.write	= scsi_write,
+#ifdef CONFIG_DM_SCSI
+	.submit	= scsi_blk_submit,
+	.poll	= scsi_blk_poll,
+#endif
 };
 
 U_BOOT_DRIVER(scsi_blk) = {
@@ -202,7 +202,7 @@ static bool atmel_qspi_supports_op(struct spi_slave *slave,
 	    op->dummy.nbytes == 0)
 		return false;
 
-	return true;
+	return spi_mem_default_supports_op(slave, op);
 }
 
 static int atmel_qspi_set_cfg(struct atmel_qspi *aq,
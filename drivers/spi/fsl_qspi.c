@@ -9,6 +9,7 @@
 #include <common.h>
 #include <malloc.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <asm/io.h>
 #include <linux/sizes.h>
 #include <linux/iopoll.h>
@@ -405,7 +406,11 @@ static inline void qspi_ahb_read(struct fsl_qspi_priv *priv, u8 *rxbuf, int len)
 
 	rx_addr = (void *)(uintptr_t)(priv->cur_amba_base + priv->sf_addr);
 	/* Read out the data directly from the AHB buffer. */
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	spi_mem_dirmap_copy(rxbuf, rx_addr, len);
+#else
 	memcpy(rxbuf, rx_addr, len);
+#endif
 
 	qspi_write32(priv->flags, &regs->mcr, mcr_reg);
 }
@@ -1128,12 +1133,70 @@ static int fsl_qspi_set_mode(struct udevice *bus, uint mode)
 	return 0;
 }
 
+#if defined(CONFIG_SYS_FSL_QSPI_AHB) && CONFIG_IS_ENABLED(SPI_DIRMAP)
+static int fsl_qspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct fsl_qspi_priv *priv = dev_get_priv(desc->slave->dev->parent);
+	const struct spi_mem_op *op = &desc->info.op_tmpl;
+	u32 amba_size_per_chip = priv->amba_total_size >>
+				 (priv->num_chipselect >> 1);
+	u8 opcode = QSPI_CMD_FAST_READ;
+
+	/*
+	 * AHB reads always run the SEQID_FAST_READ sequence programmed by
+	 * qspi_set_lut(), so only a matching single line fast read can be
+	 * mapped.
+	 */
+#ifndef CONFIG_SPI_FLASH_BAR
+	if (FSL_QSPI_FLASH_SIZE > SZ_16M)
+		opcode = QSPI_CMD_FAST_READ_4B;
+#endif
+	if (op->cmd.opcode != opcode || op->cmd.buswidth != 1 ||
+	    op->addr.buswidth != 1 || op->data.buswidth != 1 ||
+	    op->dummy.nbytes != 1)
+		return -ENOTSUPP;
+
+	if (desc->info.offset + desc->info.length > amba_size_per_chip)
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+static ssize_t fsl_qspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				    u64 offs, size_t len, void *buf)
+{
+	struct fsl_qspi_priv *priv = dev_get_priv(desc->slave->dev->parent);
+	u32 amba_size_per_chip = priv->amba_total_size >>
+				 (priv->num_chipselect >> 1);
+	u64 addr = desc->info.offset + offs;
+
+	if (addr >= amba_size_per_chip)
+		return -EINVAL;
+
+	len = min_t(u64, len, amba_size_per_chip - addr);
+
+	/* claim_bus() already pointed cur_amba_base at this chip select. */
+	priv->sf_addr = addr;
+	qspi_ahb_read(priv, buf, len);
+
+	return len;
+}
+
+static const struct spi_controller_mem_ops fsl_qspi_mem_ops = {
+	.dirmap_create	= fsl_qspi_dirmap_create,
+	.dirmap_read	= fsl_qspi_dirmap_read,
+};
+#endif
+
 static const struct dm_spi_ops fsl_qspi_ops = {
 	.claim_bus	= fsl_qspi_claim_bus,
 	.release_bus	= fsl_qspi_release_bus,
 	.xfer		= fsl_qspi_xfer,
 	.set_speed	= fsl_qspi_set_speed,
 	.set_mode	= fsl_qspi_set_mode,
+#if defined(CONFIG_SYS_FSL_QSPI_AHB) && CONFIG_IS_ENABLED(SPI_DIRMAP)
+	.mem_ops	= &fsl_qspi_mem_ops,
+#endif
 };
 
 static const struct udevice_id fsl_qspi_ids[] = {
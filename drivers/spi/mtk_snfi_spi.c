@@ -64,7 +64,7 @@ static int mtk_snfi_adjust_op_size(struct spi_slave *slave,
 	 * or the output+input data must not exceed the GPRAM size.
 	 */
 
-	nbytes = sizeof(op->cmd.opcode) + op->addr.nbytes +
+	nbytes = op->cmd.nbytes + op->addr.nbytes +
 		op->dummy.nbytes;
 
 	if (nbytes + op->data.nbytes <= SNFI_GPRAM_SIZE)
@@ -85,7 +85,7 @@ static bool mtk_snfi_supports_op(struct spi_slave *slave,
 	    op->dummy.buswidth > 1 || op->data.buswidth > 1)
 		return false;
 
-	return true;
+	return spi_mem_default_supports_op(slave, op);
 }
 
 static int mtk_snfi_mac_trigger(struct mtk_snfi_priv *priv,
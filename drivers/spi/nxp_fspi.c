@@ -202,9 +202,15 @@
 
 #define FSPI_DLLACR			0xC0
 #define FSPI_DLLACR_OVRDEN		BIT(8)
+#define FSPI_DLLACR_SLVDLY(x)		((x) << 3)
+#define FSPI_DLLACR_DLLRESET		BIT(1)
+#define FSPI_DLLACR_DLLEN		BIT(0)
 
 #define FSPI_DLLBCR			0xC4
 #define FSPI_DLLBCR_OVRDEN		BIT(8)
+#define FSPI_DLLBCR_SLVDLY(x)		((x) << 3)
+#define FSPI_DLLBCR_DLLRESET		BIT(1)
+#define FSPI_DLLBCR_DLLEN		BIT(0)
 
 #define FSPI_STS0			0xE0
 #define FSPI_STS0_DLPHB(x)		((x) << 8)
@@ -219,6 +225,16 @@
 #define FSPI_STS1_AHB_ERRCD(x)		((x) << 8)
 #define FSPI_STS1_AHB_ERRID(x)		(x)
 
+#define FSPI_STS2			0xE8
+#define FSPI_STS2_BSLVLOCK		BIT(17)
+#define FSPI_STS2_BREFLOCK		BIT(16)
+#define FSPI_STS2_ASLVLOCK		BIT(1)
+#define FSPI_STS2_AREFLOCK		BIT(0)
+#define FSPI_STS2_AB_LOCK		(FSPI_STS2_BSLVLOCK | \
+					 FSPI_STS2_BREFLOCK | \
+					 FSPI_STS2_ASLVLOCK | \
+					 FSPI_STS2_AREFLOCK)
+
 #define FSPI_AHBSPNST			0xEC
 #define FSPI_AHBSPNST_DATLFT(x)		((x) << 16)
 #define FSPI_AHBSPNST_BUFID(x)		((x) << 1)
@@ -302,6 +318,13 @@
 #define POLL_TOUT		5000
 #define NXP_FSPI_MAX_CHIPSELECT		4
 
+/* Above this rate the read strobe needs the DLL instead of the override. */
+#define NXP_FSPI_DLL_MIN_RATE		100000000
+
+/* MCR0[RXCLKSRC]: sample on the internal loopback or on the flash DQS. */
+#define FSPI_RXCLKSRC_LOOPBACK		0
+#define FSPI_RXCLKSRC_DQS		3
+
 struct nxp_fspi_devtype_data {
 	unsigned int rxfifo;
 	unsigned int txfifo;
@@ -324,6 +347,7 @@ struct nxp_fspi {
 	void __iomem *ahb_addr;
 	u32 memmap_phy;
 	u32 memmap_phy_size;
+	bool dqs_sampling;
 	struct clk clk, clk_en;
 	const struct nxp_fspi_devtype_data *devtype_data;
 };
@@ -404,7 +428,8 @@ static bool nxp_fspi_supports_op(struct spi_slave *slave,
 
 	/* Max 64 dummy clock cycles supported */
 	if (op->dummy.buswidth &&
-	    (op->dummy.nbytes * 8 / op->dummy.buswidth > 64))
+	    (op->dummy.nbytes * 8 / op->dummy.buswidth /
+	     (op->dummy.dtr ? 2 : 1) > 64))
 		return false;
 
 	/* Max data length, check controller limits and alignment */
@@ -418,7 +443,10 @@ static bool nxp_fspi_supports_op(struct spi_slave *slave,
 	    op->data.nbytes > f->devtype_data->txfifo)
 		return false;
 
-	return true;
+	if (op->cmd.dtr)
+		return spi_mem_dtr_supports_op(slave, op);
+
+	return spi_mem_default_supports_op(slave, op);
 }
 
 /* Instead of busy looping invoke readl_poll_timeout functionality. */
@@ -463,23 +491,37 @@ static void nxp_fspi_prepare_lut(struct nxp_fspi *f,
 {
 	void __iomem *base = f->iobase;
 	u32 lutval[4] = {};
-	int lutidx = 1, i;
+	int lutidx = 0, i;
+	u32 data_ins;
 
-	/* cmd */
-	lutval[0] |= LUT_DEF(0, LUT_CMD, LUT_PAD(op->cmd.buswidth),
-			     op->cmd.opcode);
+	/* cmd, one instruction per opcode byte, MSB first */
+	for (i = op->cmd.nbytes - 1; i >= 0; i--) {
+		lutval[lutidx / 2] |= LUT_DEF(lutidx,
+					      op->cmd.dtr ? LUT_CMD_DDR : LUT_CMD,
+					      LUT_PAD(op->cmd.buswidth),
+					      (op->cmd.opcode >> (8 * i)) & 0xff);
+		lutidx++;
+	}
 
 	/* addr bytes */
 	if (op->addr.nbytes) {
-		lutval[lutidx / 2] |= LUT_DEF(lutidx, LUT_ADDR,
+		lutval[lutidx / 2] |= LUT_DEF(lutidx,
+					      op->addr.dtr ? LUT_ADDR_DDR :
+					      LUT_ADDR,
 					      LUT_PAD(op->addr.buswidth),
 					      op->addr.nbytes * 8);
 		lutidx++;
 	}
 
-	/* dummy bytes, if needed */
+	/*
+	 * dummy bytes, if needed. The operand counts cycles in SDR and half
+	 * cycles in DDR, which is what the spi-mem byte count gives either way
+	 * since DTR dummy bytes are already doubled.
+	 */
 	if (op->dummy.nbytes) {
-		lutval[lutidx / 2] |= LUT_DEF(lutidx, LUT_DUMMY,
+		lutval[lutidx / 2] |= LUT_DEF(lutidx,
+					      op->dummy.dtr ? LUT_DUMMY_DDR :
+					      LUT_DUMMY,
 		/*
 		 * Due to FlexSPI controller limitation number of PAD for dummy
 		 * buswidth needs to be programmed as equal to data buswidth.
@@ -492,9 +534,12 @@ static void nxp_fspi_prepare_lut(struct nxp_fspi *f,
 
 	/* read/write data bytes */
 	if (op->data.nbytes) {
-		lutval[lutidx / 2] |= LUT_DEF(lutidx,
-					      op->data.dir == SPI_MEM_DATA_IN ?
-					      LUT_NXP_READ : LUT_NXP_WRITE,
+		if (op->data.dir == SPI_MEM_DATA_IN)
+			data_ins = op->data.dtr ? LUT_READ_DDR : LUT_NXP_READ;
+		else
+			data_ins = op->data.dtr ? LUT_WRITE_DDR : LUT_NXP_WRITE;
+
+		lutval[lutidx / 2] |= LUT_DEF(lutidx, data_ins,
 					      LUT_PAD(op->data.buswidth),
 					      0);
 		lutidx++;
@@ -519,7 +564,64 @@ static void nxp_fspi_prepare_lut(struct nxp_fspi *f,
 	fspi_writel(f, FSPI_LCKER_LOCK, f->iobase + FSPI_LCKCR);
 }
 
-#if CONFIG_IS_ENABLED(CONFIG_CLK)
+/*
+ * DTR reads are sampled on the DQS strobe driven by the flash, everything
+ * else on the internal loopback. RXCLKSRC may only change while the module
+ * is disabled, so only touch MCR0 when the source actually changes.
+ */
+static void nxp_fspi_select_rx_sample_clk(struct nxp_fspi *f,
+					  const struct spi_mem_op *op)
+{
+	bool dqs = op->data.dtr && op->data.dir == SPI_MEM_DATA_IN;
+	u32 reg;
+
+	if (f->dqs_sampling == dqs)
+		return;
+
+	reg = fspi_readl(f, f->iobase + FSPI_MCR0);
+	fspi_writel(f, reg | FSPI_MCR0_MDIS, f->iobase + FSPI_MCR0);
+
+	reg &= ~FSPI_MCR0_RXCLKSRC(3);
+	reg |= FSPI_MCR0_RXCLKSRC(dqs ? FSPI_RXCLKSRC_DQS :
+				  FSPI_RXCLKSRC_LOOPBACK);
+	fspi_writel(f, reg | FSPI_MCR0_MDIS, f->iobase + FSPI_MCR0);
+	fspi_writel(f, reg & ~FSPI_MCR0_MDIS, f->iobase + FSPI_MCR0);
+
+	f->dqs_sampling = dqs;
+}
+
+/*
+ * Lock the DLLs on the reference clock so the read strobe is delayed by
+ * half a clock cycle, as needed for DQS sampling at high rates.
+ */
+static void nxp_fspi_dll_calibration(struct nxp_fspi *f)
+{
+	void __iomem *base = f->iobase;
+	int ret;
+
+	/* Reset the DLL, set the DLLRESET to 1 and then set to 0 */
+	fspi_writel(f, FSPI_DLLACR_DLLRESET, base + FSPI_DLLACR);
+	fspi_writel(f, FSPI_DLLBCR_DLLRESET, base + FSPI_DLLBCR);
+	fspi_writel(f, 0, base + FSPI_DLLACR);
+	fspi_writel(f, 0, base + FSPI_DLLBCR);
+
+	/*
+	 * The slave delay line target is (SLVDLY + 1) / 32 of a reference
+	 * clock cycle, 0xF gives half a cycle.
+	 */
+	fspi_writel(f, FSPI_DLLACR_DLLEN | FSPI_DLLACR_SLVDLY(0xF),
+		    base + FSPI_DLLACR);
+	fspi_writel(f, FSPI_DLLBCR_DLLEN | FSPI_DLLBCR_SLVDLY(0xF),
+		    base + FSPI_DLLBCR);
+
+	/* Wait to get REF/SLV lock */
+	ret = fspi_readl_poll_tout(f, base + FSPI_STS2, FSPI_STS2_AB_LOCK,
+				   0, POLL_TOUT, true);
+	if (ret)
+		dev_warn(f->dev, "DLL lock failed\n");
+}
+
+#if CONFIG_IS_ENABLED(CLK)
 static int nxp_fspi_clk_prep_enable(struct nxp_fspi *f)
 {
 	int ret;
@@ -758,6 +860,7 @@ static int nxp_fspi_exec_op(struct spi_slave *slave,
 	WARN_ON(err);
 	udelay(1);
 
+	nxp_fspi_select_rx_sample_clk(f, op);
 	nxp_fspi_prepare_lut(f, op);
 	/*
 	 * If we have large chunks of data, we read them through the AHB bus
@@ -802,13 +905,64 @@ static int nxp_fspi_adjust_op_size(struct spi_slave *slave,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+static int nxp_fspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct nxp_fspi *f = dev_get_priv(desc->slave->dev->parent);
+
+	if (!nxp_fspi_supports_op(desc->slave, &desc->info.op_tmpl) ||
+	    nxp_fspi_check_buswidth(f, desc->info.op_tmpl.data.buswidth))
+		return -ENOTSUPP;
+
+	/* The selected chip select always gets the whole AHB window. */
+	if (desc->info.offset + desc->info.length > f->memmap_phy_size)
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+/*
+ * Read straight from the AHB window, with no ahb_buf_size split: the AHB
+ * buffer prefetches the following lines while the current ones are being
+ * copied out. exec_op() invalidates the AHB buffer after every IP command,
+ * so whatever is left in there is still valid for the next dirmap read.
+ */
+static ssize_t nxp_fspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				    u64 offs, size_t len, void *buf)
+{
+	struct nxp_fspi *f = dev_get_priv(desc->slave->dev->parent);
+	struct spi_mem_op op = desc->info.op_tmpl;
+	u64 addr = desc->info.offset + offs;
+	int err;
+
+	if (addr >= f->memmap_phy_size)
+		return -EINVAL;
+
+	len = min_t(u64, len, f->memmap_phy_size - addr);
+
+	/* Wait for controller being ready. */
+	err = fspi_readl_poll_tout(f, f->iobase + FSPI_STS0,
+				   FSPI_STS0_ARB_IDLE, 1, POLL_TOUT, true);
+	WARN_ON(err);
+
+	/* AHB reads use the same single LUT entry as the IP commands. */
+	op.data.nbytes = len;
+	nxp_fspi_select_rx_sample_clk(f, &op);
+	nxp_fspi_prepare_lut(f, &op);
+
+	spi_mem_dirmap_copy(buf, f->ahb_addr + addr, len);
+
+	return len;
+}
+#endif
+
 static int nxp_fspi_default_setup(struct nxp_fspi *f)
 {
 	void __iomem *base = f->iobase;
 	int ret, i;
 	u32 reg;
 
-#if CONFIG_IS_ENABLED(CONFIG_CLK)
+#if CONFIG_IS_ENABLED(CLK)
 	/* disable and unprepare clock to avoid glitch pass to controller */
 	nxp_fspi_clk_disable_unprep(f);
 
@@ -898,8 +1052,8 @@ static int nxp_fspi_claim_bus(struct udevice *dev)
 
 static int nxp_fspi_set_speed(struct udevice *bus, uint speed)
 {
-#if CONFIG_IS_ENABLED(CONFIG_CLK)
 	struct nxp_fspi *f = dev_get_priv(bus);
+#if CONFIG_IS_ENABLED(CLK)
 	int ret;
 
 	nxp_fspi_clk_disable_unprep(f);
@@ -912,6 +1066,18 @@ static int nxp_fspi_set_speed(struct udevice *bus, uint speed)
 	if (ret)
 		return ret;
 #endif
+
+	/*
+	 * Without clock control the serial clock is left as the firmware
+	 * set it up, and the requested rate is the best guess we have.
+	 */
+	if (speed > NXP_FSPI_DLL_MIN_RATE) {
+		nxp_fspi_dll_calibration(f);
+	} else {
+		fspi_writel(f, FSPI_DLLACR_OVRDEN, f->iobase + FSPI_DLLACR);
+		fspi_writel(f, FSPI_DLLBCR_OVRDEN, f->iobase + FSPI_DLLBCR);
+	}
+
 	return 0;
 }
 
@@ -924,7 +1090,7 @@ static int nxp_fspi_set_mode(struct udevice *bus, uint mode)
 static int nxp_fspi_ofdata_to_platdata(struct udevice *bus)
 {
 	struct nxp_fspi *f = dev_get_priv(bus);
-#if CONFIG_IS_ENABLED(CONFIG_CLK)
+#if CONFIG_IS_ENABLED(CLK)
 	int ret;
 #endif
 
@@ -950,7 +1116,7 @@ static int nxp_fspi_ofdata_to_platdata(struct udevice *bus)
 	f->ahb_addr = map_physmem(ahb_addr, ahb_size, MAP_NOCACHE);
 	f->memmap_phy_size = ahb_size;
 
-#if CONFIG_IS_ENABLED(CONFIG_CLK)
+#if CONFIG_IS_ENABLED(CLK)
 	ret = clk_get_by_name(bus, "fspi_en", &f->clk_en);
 	if (ret) {
 		dev_err(bus, "failed to get fspi_en clock\n");
@@ -973,6 +1139,10 @@ static const struct spi_controller_mem_ops nxp_fspi_mem_ops = {
 	.adjust_op_size = nxp_fspi_adjust_op_size,
 	.supports_op = nxp_fspi_supports_op,
 	.exec_op = nxp_fspi_exec_op,
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	.dirmap_create = nxp_fspi_dirmap_create,
+	.dirmap_read = nxp_fspi_dirmap_read,
+#endif
 };
 
 static const struct dm_spi_ops nxp_fspi_ops = {
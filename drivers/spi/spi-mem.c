@@ -11,8 +11,12 @@
 #include <linux/pm_runtime.h>
 #include "internals.h"
 #else
+#include <malloc.h>
 #include <spi.h>
 #include <spi-mem.h>
+#include <dma.h>
+#include <asm/unaligned.h>
+#include <linux/err.h>
 #endif
 
 #ifndef __UBOOT__
@@ -111,15 +115,24 @@ static int spi_check_buswidth_req(struct spi_slave *slave, u8 buswidth, bool tx)
 		return 0;
 
 	case 2:
-		if ((tx && (mode & (SPI_TX_DUAL | SPI_TX_QUAD))) ||
-		    (!tx && (mode & (SPI_RX_DUAL | SPI_RX_QUAD))))
+		if ((tx &&
+		     (mode & (SPI_TX_DUAL | SPI_TX_QUAD | SPI_TX_OCTAL))) ||
+		    (!tx &&
+		     (mode & (SPI_RX_DUAL | SPI_RX_QUAD | SPI_RX_OCTAL))))
 			return 0;
 
 		break;
 
 	case 4:
-		if ((tx && (mode & SPI_TX_QUAD)) ||
-		    (!tx && (mode & SPI_RX_QUAD)))
+		if ((tx && (mode & (SPI_TX_QUAD | SPI_TX_OCTAL))) ||
+		    (!tx && (mode & (SPI_RX_QUAD | SPI_RX_OCTAL))))
+			return 0;
+
+		break;
+
+	case 8:
+		if ((tx && (mode & SPI_TX_OCTAL)) ||
+		    (!tx && (mode & SPI_RX_OCTAL)))
 			return 0;
 
 		break;
@@ -131,8 +144,8 @@ static int spi_check_buswidth_req(struct spi_slave *slave, u8 buswidth, bool tx)
 	return -ENOTSUPP;
 }
 
-bool spi_mem_default_supports_op(struct spi_slave *slave,
-				 const struct spi_mem_op *op)
+static bool spi_mem_check_buswidth(struct spi_slave *slave,
+				   const struct spi_mem_op *op)
 {
 	if (spi_check_buswidth_req(slave, op->cmd.buswidth, true))
 		return false;
@@ -152,6 +165,49 @@ bool spi_mem_default_supports_op(struct spi_slave *slave,
 
 	return true;
 }
+
+/**
+ * spi_mem_dtr_supports_op() - Check a DTR operation against the bus widths
+ * @slave: the SPI device
+ * @op: the operation to check
+ *
+ * Helper for controllers able to run DTR operations. In 8D mode every phase
+ * moves two bytes per clock, so each of them must be an even number of bytes.
+ *
+ * Return: true if @op can be issued on this device, false otherwise.
+ */
+bool spi_mem_dtr_supports_op(struct spi_slave *slave,
+			     const struct spi_mem_op *op)
+{
+	if (op->cmd.buswidth == 8 && op->cmd.nbytes % 2)
+		return false;
+
+	if (op->addr.nbytes && op->addr.buswidth == 8 && op->addr.nbytes % 2)
+		return false;
+
+	if (op->dummy.nbytes && op->dummy.buswidth == 8 &&
+	    op->dummy.nbytes % 2)
+		return false;
+
+	if (op->data.nbytes && op->data.buswidth == 8 && op->data.nbytes % 2)
+		return false;
+
+	return spi_mem_check_buswidth(slave, op);
+}
+EXPORT_SYMBOL_GPL(spi_mem_dtr_supports_op);
+
+bool spi_mem_default_supports_op(struct spi_slave *slave,
+				 const struct spi_mem_op *op)
+{
+	/* Controllers must opt in to DTR and 2-byte opcodes. */
+	if (op->cmd.dtr || op->addr.dtr || op->dummy.dtr || op->data.dtr)
+		return false;
+
+	if (op->cmd.nbytes != 1)
+		return false;
+
+	return spi_mem_check_buswidth(slave, op);
+}
 EXPORT_SYMBOL_GPL(spi_mem_default_supports_op);
 
 /**
@@ -256,7 +312,7 @@ int spi_mem_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 	}
 
 #ifndef __UBOOT__
-	tmpbufsize = sizeof(op->cmd.opcode) + op->addr.nbytes +
+	tmpbufsize = op->cmd.nbytes + op->addr.nbytes +
 		     op->dummy.nbytes;
 
 	/*
@@ -272,7 +328,7 @@ int spi_mem_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 
 	tmpbuf[0] = op->cmd.opcode;
 	xfers[xferpos].tx_buf = tmpbuf;
-	xfers[xferpos].len = sizeof(op->cmd.opcode);
+	xfers[xferpos].len = op->cmd.nbytes;
 	xfers[xferpos].tx_nbits = op->cmd.buswidth;
 	spi_message_add_tail(&xfers[xferpos], &msg);
 	xferpos++;
@@ -336,7 +392,7 @@ int spi_mem_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 			tx_buf = op->data.buf.out;
 	}
 
-	op_len = sizeof(op->cmd.opcode) + op->addr.nbytes + op->dummy.nbytes;
+	op_len = op->cmd.nbytes + op->addr.nbytes + op->dummy.nbytes;
 
 	/*
 	 * Avoid using malloc() here so that we can use this code in SPL where
@@ -349,7 +405,9 @@ int spi_mem_exec_op(struct spi_slave *slave, const struct spi_mem_op *op)
 	 */
 	u8 op_buf[op_len];
 
-	op_buf[pos++] = op->cmd.opcode;
+	for (i = 0; i < op->cmd.nbytes; i++)
+		op_buf[pos++] = op->cmd.opcode >>
+				(8 * (op->cmd.nbytes - i - 1));
 
 	if (op->addr.nbytes) {
 		for (i = 0; i < op->addr.nbytes; i++)
@@ -425,7 +483,7 @@ int spi_mem_adjust_op_size(struct spi_slave *slave, struct spi_mem_op *op)
 	if (!ops->mem_ops || !ops->mem_ops->exec_op) {
 		unsigned int len;
 
-		len = sizeof(op->cmd.opcode) + op->addr.nbytes +
+		len = op->cmd.nbytes + op->addr.nbytes +
 			op->dummy.nbytes;
 		if (slave->max_write_size && len > slave->max_write_size)
 			return -EINVAL;
@@ -447,6 +505,197 @@ int spi_mem_adjust_op_size(struct spi_slave *slave, struct spi_mem_op *op)
 }
 EXPORT_SYMBOL_GPL(spi_mem_adjust_op_size);
 
+static ssize_t spi_mem_no_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				      u64 offs, size_t len, void *buf)
+{
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.buf.in = buf;
+	op.data.nbytes = len;
+	ret = spi_mem_adjust_op_size(desc->slave, &op);
+	if (ret)
+		return ret;
+
+	ret = spi_mem_exec_op(desc->slave, &op);
+	if (ret)
+		return ret;
+
+	return op.data.nbytes;
+}
+
+/**
+ * spi_mem_dirmap_create() - Create a direct mapping descriptor
+ * @slave: SPI device this direct mapping should be created for
+ * @info: direct mapping information
+ *
+ * This function is creating a direct mapping descriptor which can then be used
+ * to access the memory using spi_mem_dirmap_read(). If the controller does
+ * not support direct mapping, or rejects this specific mapping, the
+ * descriptor falls back to regular spi_mem_exec_op() calls so that callers
+ * do not have to care.
+ *
+ * Return: a valid pointer in case of success, and ERR_PTR() otherwise.
+ */
+struct spi_mem_dirmap_desc *
+spi_mem_dirmap_create(struct spi_slave *slave,
+		      const struct spi_mem_dirmap_info *info)
+{
+	struct udevice *bus = slave->dev->parent;
+	struct dm_spi_ops *ops = spi_get_ops(bus);
+	struct spi_mem_dirmap_desc *desc;
+	int ret = -ENOTSUPP;
+
+	/* Only read direct mappings are supported for now. */
+	if (info->op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return ERR_PTR(-EINVAL);
+
+	/* An address is required to derive the offset within the mapping. */
+	if (!info->op_tmpl.addr.nbytes)
+		return ERR_PTR(-EINVAL);
+
+	desc = calloc(1, sizeof(*desc));
+	if (!desc)
+		return ERR_PTR(-ENOMEM);
+
+	desc->slave = slave;
+	desc->info = *info;
+	if (ops->mem_ops && ops->mem_ops->dirmap_create)
+		ret = ops->mem_ops->dirmap_create(desc);
+
+	if (ret) {
+		desc->nodirmap = true;
+		if (!spi_mem_supports_op(slave, &desc->info.op_tmpl))
+			ret = -ENOTSUPP;
+		else
+			ret = 0;
+	}
+
+	if (ret) {
+		free(desc);
+		return ERR_PTR(ret);
+	}
+
+	return desc;
+}
+EXPORT_SYMBOL_GPL(spi_mem_dirmap_create);
+
+/**
+ * spi_mem_dirmap_destroy() - Destroy a direct mapping descriptor
+ * @desc: the direct mapping descriptor to destroy
+ *
+ * This function destroys a direct mapping descriptor previously created by
+ * spi_mem_dirmap_create().
+ */
+void spi_mem_dirmap_destroy(struct spi_mem_dirmap_desc *desc)
+{
+	struct udevice *bus = desc->slave->dev->parent;
+	struct dm_spi_ops *ops = spi_get_ops(bus);
+
+	if (!desc->nodirmap && ops->mem_ops->dirmap_destroy)
+		ops->mem_ops->dirmap_destroy(desc);
+
+	free(desc);
+}
+EXPORT_SYMBOL_GPL(spi_mem_dirmap_destroy);
+
+/**
+ * spi_mem_dirmap_read() - Read data through a direct mapping
+ * @desc: direct mapping descriptor
+ * @offs: offset to start reading from. Note that this is not an absolute
+ *	  offset, but the offset within the direct mapping which already has
+ *	  its own offset
+ * @len: length in bytes
+ * @buf: destination buffer
+ *
+ * This function reads data from a memory device using a direct mapping
+ * previously instantiated with spi_mem_dirmap_create().
+ *
+ * Return: the amount of data read from the memory device or a negative error
+ * code. Note that the returned size might be smaller than @len, and the caller
+ * is responsible for calling spi_mem_dirmap_read() again when that happens.
+ */
+ssize_t spi_mem_dirmap_read(struct spi_mem_dirmap_desc *desc,
+			    u64 offs, size_t len, void *buf)
+{
+	struct udevice *bus = desc->slave->dev->parent;
+	struct dm_spi_ops *ops = spi_get_ops(bus);
+	ssize_t ret;
+
+	if (desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -EINVAL;
+
+	if (!len)
+		return 0;
+
+	if (desc->nodirmap)
+		return spi_mem_no_dirmap_read(desc, offs, len, buf);
+
+	if (!ops->mem_ops->dirmap_read)
+		return -ENOTSUPP;
+
+	ret = spi_claim_bus(desc->slave);
+	if (ret < 0)
+		return ret;
+
+	ret = ops->mem_ops->dirmap_read(desc, offs, len, buf);
+
+	spi_release_bus(desc->slave);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(spi_mem_dirmap_read);
+
+/**
+ * spi_mem_dirmap_copy() - Copy data out of a memory-mapped flash window
+ * @buf: destination buffer
+ * @src: source address inside the controller's memory-mapped window
+ * @len: length in bytes
+ *
+ * Helper for controller ->dirmap_read() implementations. The window is
+ * usually mapped as device memory, where the generic memcpy() falls back to
+ * byte accesses as soon as source and destination are not equally aligned.
+ * Copy in 64-bit words aligned on the source instead, so that every access
+ * is a full-width AHB burst into the controller's prefetch buffer.
+ *
+ * With CONFIG_SPI_DIRMAP_DMA the cache-aligned bulk of the transfer is
+ * handed to a memory-to-memory DMA channel first; the CPU only copies what
+ * is left, or everything if no channel is available.
+ */
+void spi_mem_dirmap_copy(void *buf, const void __iomem *src, size_t len)
+{
+	u8 *dst = buf;
+
+#if CONFIG_IS_ENABLED(SPI_DIRMAP_DMA)
+	if (IS_ALIGNED((ulong)dst, ARCH_DMA_MINALIGN) &&
+	    len >= ARCH_DMA_MINALIGN) {
+		size_t bulk = ALIGN_DOWN(len, ARCH_DMA_MINALIGN);
+
+		if (dma_memcpy(dst, (void *)src, bulk) >= 0) {
+			dst += bulk;
+			src += bulk;
+			len -= bulk;
+		}
+	}
+#endif
+
+	while (len && !IS_ALIGNED((ulong)src, sizeof(u64))) {
+		*dst++ = *(const volatile u8 *)src++;
+		len--;
+	}
+
+	while (len >= sizeof(u64)) {
+		put_unaligned(*(const volatile u64 *)src, (u64 *)dst);
+		dst += sizeof(u64);
+		src += sizeof(u64);
+		len -= sizeof(u64);
+	}
+
+	while (len--)
+		*dst++ = *(const volatile u8 *)src++;
+}
+
 #ifndef __UBOOT__
 static inline struct spi_mem_driver *to_spi_mem_drv(struct device_driver *drv)
 {
@@ -111,6 +111,9 @@ void reset_cpu(ulong addr)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	/* Blocks only held in the cache would be lost across the reset */
+	blkcache_flush_all();
+
 	printf("resetting ...\n");
 
 	sysreset_walk_halt(SYSRESET_COLD);
@@ -9,8 +9,23 @@
 #include <usb.h>
 #include <dm/root.h>
 
+/* Number of bulk transfers which can be queued with bulk_submit() */
+#define SANDBOX_USB_MAX_BULK	4
+
+/**
+ * struct sandbox_usb_ctrl - private state for this driver
+ *
+ * @rootdev:	USB address of the root hub
+ * @bulk_reqs:	Bulk transfers queued with bulk_submit(), oldest first. They
+ *		are done in order, when one of them is waited for.
+ * @bulk_udevs:	Device each queued transfer is for
+ * @bulk_count:	Number of queued transfers
+ */
 struct sandbox_usb_ctrl {
 	int rootdev;
+	struct usb_bulk_req *bulk_reqs[SANDBOX_USB_MAX_BULK];
+	struct usb_device *bulk_udevs[SANDBOX_USB_MAX_BULK];
+	int bulk_count;
 };
 
 static void usbmon_trace(struct udevice *bus, ulong pipe,
@@ -97,6 +112,79 @@ static int sandbox_submit_bulk(struct udevice *bus, struct usb_device *udev,
 	return ret;
 }
 
+static int sandbox_bulk_submit(struct udevice *bus, struct usb_device *udev,
+			       struct usb_bulk_req *req)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+
+	if (ctrl->bulk_count == SANDBOX_USB_MAX_BULK)
+		return -EBUSY;
+
+	req->done = false;
+	req->act_len = 0;
+	req->status = USB_ST_NOT_PROC;
+	ctrl->bulk_reqs[ctrl->bulk_count] = req;
+	ctrl->bulk_udevs[ctrl->bulk_count] = udev;
+	ctrl->bulk_count++;
+
+	return 0;
+}
+
+/* Takes a queued transfer off the queue, without doing it */
+static void sandbox_bulk_dequeue(struct sandbox_usb_ctrl *ctrl, int i)
+{
+	ctrl->bulk_count--;
+	memmove(&ctrl->bulk_reqs[i], &ctrl->bulk_reqs[i + 1],
+		(ctrl->bulk_count - i) * sizeof(ctrl->bulk_reqs[0]));
+	memmove(&ctrl->bulk_udevs[i], &ctrl->bulk_udevs[i + 1],
+		(ctrl->bulk_count - i) * sizeof(ctrl->bulk_udevs[0]));
+}
+
+static int sandbox_bulk_wait(struct udevice *bus, struct usb_device *udev,
+			     struct usb_bulk_req *req)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	struct usb_bulk_req *first;
+	struct usb_device *first_udev;
+	int ret;
+
+	while (!req->done) {
+		/* Something which is not queued never completes */
+		if (!ctrl->bulk_count)
+			return -ETIMEDOUT;
+
+		first = ctrl->bulk_reqs[0];
+		first_udev = ctrl->bulk_udevs[0];
+		sandbox_bulk_dequeue(ctrl, 0);
+		ret = sandbox_submit_bulk(bus, first_udev, first->pipe,
+					  first->buffer, first->length);
+		first->status = ret < 0 ? USB_ST_CRC_ERR : 0;
+		first->act_len = ret < 0 ? 0 : ret;
+		first->done = true;
+	}
+
+	return 0;
+}
+
+static int sandbox_bulk_cancel(struct udevice *bus, struct usb_device *udev,
+			       struct usb_bulk_req *req)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	int i;
+
+	for (i = 0; i < ctrl->bulk_count; i++) {
+		if (ctrl->bulk_reqs[i] == req) {
+			sandbox_bulk_dequeue(ctrl, i);
+			req->status = USB_ST_NAK_REC;
+			req->act_len = 0;
+			req->done = true;
+			break;
+		}
+	}
+
+	return 0;
+}
+
 static int sandbox_submit_int(struct udevice *bus, struct usb_device *udev,
 			      unsigned long pipe, void *buffer, int length,
 			      int interval, bool nonblock)
@@ -141,6 +229,9 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.bulk		= sandbox_submit_bulk,
 	.interrupt	= sandbox_submit_int,
 	.alloc_device	= sandbox_alloc_device,
+	.bulk_submit	= sandbox_bulk_submit,
+	.bulk_wait	= sandbox_bulk_wait,
+	.bulk_cancel	= sandbox_bulk_cancel,
 };
 
 static const struct udevice_id sandbox_usb_ids[] = {
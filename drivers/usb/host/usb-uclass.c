@@ -159,6 +159,51 @@ int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
 	return ops->get_max_xfer_size(bus, size);
 }
 
+int usb_alloc_streams(struct usb_device *udev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->alloc_streams)
+		return -ENOSYS;
+
+	return ops->alloc_streams(bus, udev, pipes, num_pipes, num_streams);
+}
+
+int usb_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->bulk_submit)
+		return -ENOSYS;
+
+	return ops->bulk_submit(bus, udev, req);
+}
+
+int usb_bulk_wait(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->bulk_wait)
+		return -ENOSYS;
+
+	return ops->bulk_wait(bus, udev, req);
+}
+
+int usb_bulk_cancel(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->bulk_cancel)
+		return -ENOSYS;
+
+	return ops->bulk_cancel(bus, udev, req);
+}
+
 int usb_stop(void)
 {
 	struct udevice *bus;
@@ -332,6 +377,22 @@ int usb_init(void)
 	return usb_started ? 0 : -1;
 }
 
+#ifdef CONFIG_BLK_PARALLEL_PROBE
+static int usb_blk_probe_finish(void)
+{
+	/* usb_init() reports its own errors, a board may have no USB at all */
+	if (!usb_started)
+		usb_init();
+
+	return 0;
+}
+
+U_BOOT_BLK_PROBE(usb) = {
+	.name	= "USB",
+	.finish	= usb_blk_probe_finish,
+};
+#endif
+
 /*
  * TODO(sjg@chromium.org): Remove this legacy function. At present it is needed
  * to support boards which use driver model for USB but not Ethernet, and want
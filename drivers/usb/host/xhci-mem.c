@@ -148,9 +148,11 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
 
 		ctrl->dcbaa->dev_context_ptrs[slot_id] = 0;
 
-		for (i = 0; i < 31; ++i)
+		for (i = 0; i < 31; ++i) {
 			if (virt_dev->eps[i].ring)
 				xhci_ring_free(virt_dev->eps[i].ring);
+			xhci_free_streams(&virt_dev->eps[i]);
+		}
 
 		if (virt_dev->in_ctx)
 			xhci_free_container_ctx(virt_dev->in_ctx);
@@ -277,7 +279,14 @@ static struct xhci_segment *xhci_segment_alloc(void)
 	seg = (struct xhci_segment *)malloc(sizeof(struct xhci_segment));
 	BUG_ON(!seg);
 
-	seg->trbs = (union xhci_trb *)xhci_malloc(SEGMENT_SIZE);
+	/*
+	 * Align the segment on its size so that it never crosses a 64KB
+	 * boundary (section 6.1: rings may not cross one)
+	 */
+	seg->trbs = (union xhci_trb *)memalign(SEGMENT_SIZE, SEGMENT_SIZE);
+	BUG_ON(!seg->trbs);
+	memset(seg->trbs, '\0', SEGMENT_SIZE);
+	xhci_flush_cache((uintptr_t)seg->trbs, SEGMENT_SIZE);
 
 	seg->next = NULL;
 
@@ -287,8 +296,8 @@ static struct xhci_segment *xhci_segment_alloc(void)
 /**
  * Create a new ring with zero or more segments.
  * TODO: current code only uses one-time-allocated single-segment rings
- * of 1KB anyway, so we might as well get rid of all the segment and
- * linking code (and maybe increase the size a bit, e.g. 4KB).
+ * of 4KB anyway, so we might as well get rid of all the segment and
+ * linking code.
  *
  *
  * Link each segment together into a ring.
@@ -338,6 +347,60 @@ struct xhci_ring *xhci_ring_alloc(unsigned int num_segs, bool link_trbs)
 	return ring;
 }
 
+/**
+ * Allocates the stream context array of an endpoint and a transfer ring
+ * for each of its streams. Stream 0 is reserved and gets no ring.
+ *
+ * @param virt_ep	endpoint to allocate the streams of
+ * @param num_streams	number of entries in the array, a power of 2
+ * @return none
+ */
+void xhci_alloc_streams_mem(struct xhci_virt_ep *virt_ep,
+			    unsigned int num_streams)
+{
+	unsigned int i;
+	u64 val_64;
+
+	virt_ep->stream_ctx = xhci_malloc(num_streams *
+					  sizeof(struct xhci_stream_ctx));
+	virt_ep->stream_rings = calloc(num_streams, sizeof(struct xhci_ring *));
+	BUG_ON(!virt_ep->stream_rings);
+
+	for (i = 1; i < num_streams; i++) {
+		virt_ep->stream_rings[i] = xhci_ring_alloc(1, true);
+		val_64 = (uintptr_t)virt_ep->stream_rings[i]->enqueue;
+		virt_ep->stream_ctx[i].stream_ring = cpu_to_le64(val_64 |
+				SCT_FOR_CTX(SCT_PRI_TR) |
+				virt_ep->stream_rings[i]->cycle_state);
+	}
+	virt_ep->num_streams = num_streams - 1;
+
+	xhci_flush_cache((uintptr_t)virt_ep->stream_ctx,
+			 num_streams * sizeof(struct xhci_stream_ctx));
+}
+
+/**
+ * Frees the stream context array and stream rings of an endpoint, if any
+ *
+ * @param virt_ep	endpoint to free the streams of
+ * @return none
+ */
+void xhci_free_streams(struct xhci_virt_ep *virt_ep)
+{
+	unsigned int i;
+
+	if (!virt_ep->stream_rings)
+		return;
+
+	for (i = 1; i <= virt_ep->num_streams; i++)
+		xhci_ring_free(virt_ep->stream_rings[i]);
+	free(virt_ep->stream_rings);
+	free(virt_ep->stream_ctx);
+	virt_ep->stream_rings = NULL;
+	virt_ep->stream_ctx = NULL;
+	virt_ep->num_streams = 0;
+}
+
 /**
  * Set up the scratchpad buffer array and scratchpad buffers
  *
@@ -258,18 +258,19 @@ static int prepare_ring(struct xhci_ctrl *ctrl, struct xhci_ring *ep_ring,
 }
 
 /**
- * Generic function for queueing a command TRB on the command ring.
- * Check to make sure there's room on the command ring for one command TRB.
+ * Queues a command TRB on the command ring, with a stream ID for the
+ * 'set TR dequeue pointer' command.
  *
  * @param ctrl		Host controller data structure
  * @param ptr		Pointer address to write in the first two fields (opt.)
  * @param slot_id	Slot ID to encode in the flags field (opt.)
  * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param stream_id	Stream ID to encode in the status field (opt.)
  * @param cmd		Command type to enqueue
  * @return none
  */
-void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
-			u32 ep_index, trb_type cmd)
+static void queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
+			  u32 ep_index, u32 stream_id, trb_type cmd)
 {
 	u32 fields[4];
 	u64 val_64 = (uintptr_t)ptr;
@@ -278,7 +279,7 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 
 	fields[0] = lower_32_bits(val_64);
 	fields[1] = upper_32_bits(val_64);
-	fields[2] = 0;
+	fields[2] = STREAM_ID_FOR_TRB(stream_id);
 	fields[3] = TRB_TYPE(cmd) | SLOT_ID_FOR_TRB(slot_id) |
 		    ctrl->cmd_ring->cycle_state;
 
@@ -295,6 +296,23 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
 }
 
+/**
+ * Generic function for queueing a command TRB on the command ring.
+ * Check to make sure there's room on the command ring for one command TRB.
+ *
+ * @param ctrl		Host controller data structure
+ * @param ptr		Pointer address to write in the first two fields (opt.)
+ * @param slot_id	Slot ID to encode in the flags field (opt.)
+ * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param cmd		Command type to enqueue
+ * @return none
+ */
+void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
+			u32 ep_index, trb_type cmd)
+{
+	queue_command(ctrl, ptr, slot_id, ep_index, 0, cmd);
+}
+
 /**
  * The TD size is the number of bytes remaining in the TD (including this TRB),
  * right shifted by 10.
@@ -351,12 +369,13 @@ static u32 xhci_v1_0_td_remainder(int running_total,
  *
  * @param udev		pointer to the USB device structure
  * @param ep_index	index of the endpoint
+ * @param stream_id	stream the TRBs are for, 0 without streams
  * @param start_cycle	cycle flag of the first TRB
  * @param start_trb	pionter to the first TRB
  * @return none
  */
 static void giveback_first_trb(struct usb_device *udev, int ep_index,
-				int start_cycle,
+				unsigned int stream_id, int start_cycle,
 				struct xhci_generic_trb *start_trb)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
@@ -374,7 +393,7 @@ static void giveback_first_trb(struct usb_device *udev, int ep_index,
 
 	/* Ringing EP doorbell here */
 	xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
-				DB_VALUE(ep_index, 0));
+				DB_VALUE(ep_index, stream_id));
 
 	return;
 }
@@ -473,39 +492,209 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 	BUG();
 }
 
+static unsigned long comp_code_to_status(u32 comp_code)
+{
+	switch (comp_code) {
+	case COMP_SUCCESS:
+	case COMP_SHORT_TX:
+		return 0;
+	case COMP_STALL:
+		return USB_ST_STALLED;
+	case COMP_DB_ERR:
+	case COMP_TRB_ERR:
+		return USB_ST_BUF_ERR;
+	case COMP_BABBLE:
+		return USB_ST_BABBLE_DET;
+	default:
+		return 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+	}
+}
+
+static void record_transfer_result(struct usb_device *udev,
+				   union xhci_trb *event, int length)
+{
+	u32 comp_code;
+
+	udev->act_len = min(length, length -
+		(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
+
+	comp_code = GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len));
+	BUG_ON(comp_code == COMP_SUCCESS && udev->act_len != length);
+	udev->status = comp_code_to_status(comp_code);
+}
+
+/**** Bulk and Control transfer methods ****/
+
+/* Next TRB of a single-segment transfer ring, following the link TRB */
+static union xhci_trb *next_trb(struct xhci_ring *ring, union xhci_trb *trb)
+{
+	trb++;
+	if (TRB_TYPE_LINK_LE32(trb->link.control))
+		trb = ring->first_seg->trbs;
+
+	return trb;
+}
+
+static bool trb_in_td(struct xhci_td *td, union xhci_trb *trb)
+{
+	union xhci_trb *trbs = td->ring->first_seg->trbs;
+
+	if (trb < trbs || trb >= trbs + TRBS_PER_SEGMENT)
+		return false;
+	if (td->first <= td->last)
+		return trb >= td->first && trb <= td->last;
+
+	/* The transfer wraps around the end of the ring */
+	return trb >= td->first || trb <= td->last;
+}
+
+/**
+ * Finds the queued bulk transfer a transfer event is for
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	transfer event
+ * @return the transfer, NULL if there is none
+ */
+static struct xhci_td *xhci_find_td(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 field = le32_to_cpu(event->trans_event.flags);
+	union xhci_trb *trb;
+	int i;
+
+	trb = (union xhci_trb *)(uintptr_t)
+		le64_to_cpu(event->trans_event.buffer);
+	for (i = 0; i < XHCI_MAX_TDS; i++) {
+		struct xhci_td *td = &ctrl->tds[i];
+
+		if (td->req && td->udev->slot_id == TRB_TO_SLOT_ID(field) &&
+		    td->ep_index == TRB_TO_EP_INDEX(field) &&
+		    trb_in_td(td, trb))
+			return td;
+	}
+
+	return NULL;
+}
+
+/**
+ * Completes a queued bulk transfer from its transfer event, which may be
+ * for a TRB before the last one when a short packet ended the transfer
+ *
+ * @param ctrl	Host controller data structure
+ * @param td	the transfer
+ * @param event	transfer event
+ * @return none
+ */
+static void xhci_td_done(struct xhci_ctrl *ctrl, struct xhci_td *td,
+			 union xhci_trb *event)
+{
+	struct usb_bulk_req *req = td->req;
+	u32 comp_code;
+	union xhci_trb *trb, *cur;
+	int len = 0;
+
+	trb = (union xhci_trb *)(uintptr_t)
+		le64_to_cpu(event->trans_event.buffer);
+	for (cur = td->first; cur != trb; cur = next_trb(td->ring, cur))
+		len += le32_to_cpu(cur->generic.field[2]) & TRB_LEN_MASK;
+	len += (le32_to_cpu(trb->generic.field[2]) & TRB_LEN_MASK) -
+		EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len));
+
+	comp_code = GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len));
+	req->act_len = min(len, req->length);
+	req->status = comp_code_to_status(comp_code);
+	req->done = true;
+	td->req = NULL;
+
+	if (usb_pipein(req->pipe))
+		xhci_inval_cache((uintptr_t)req->buffer, req->length);
+}
+
+/* Marks the transfers still queued on a ring as failed, after abort_td() */
+static void cancel_tds(struct xhci_ctrl *ctrl, struct xhci_ring *ring)
+{
+	int i;
+
+	for (i = 0; i < XHCI_MAX_TDS; i++) {
+		struct xhci_td *td = &ctrl->tds[i];
+
+		if (!td->req || td->ring != ring)
+			continue;
+		td->req->status = USB_ST_NAK_REC; /* closest to a timeout */
+		td->req->act_len = 0;
+		td->req->done = true;
+		td->req = NULL;
+	}
+}
+
+/**
+ * Returns the next event on the event ring, whatever its type
+ *
+ * @param ctrl	Host controller data structure
+ * @return pointer to event trb, NULL if none came in time
+ */
+static union xhci_trb *xhci_next_event(struct xhci_ctrl *ctrl)
+{
+	unsigned long ts = get_timer(0);
+
+	do {
+		if (event_ready(ctrl))
+			return ctrl->event_ring->dequeue;
+	} while (get_timer(ts) < XHCI_TIMEOUT);
+
+	return NULL;
+}
+
 /*
  * Stops transfer processing for an endpoint and throws away all unprocessed
  * TRBs by setting the xHC's dequeue pointer to our enqueue pointer. The next
  * xhci_bulk_tx/xhci_ctrl_tx on this enpoint will add new transfers there and
  * ring the doorbell, causing this endpoint to start working again.
- * (Careful: This will BUG() when there was no transfer in progress. Shouldn't
- * happen in practice for current uses and is too complicated to fix right now.)
+ * With streams, this is done for the ring of @stream_id.
  */
-static void abort_td(struct usb_device *udev, int ep_index)
+static void abort_td(struct usb_device *udev, int ep_index,
+		     struct xhci_ring *ring, unsigned int stream_id)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
-	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
 	union xhci_trb *event;
-	u32 field;
+	struct xhci_td *td;
+	uintptr_t deq;
+	u32 comp_code;
+	trb_type type;
 
 	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_STOP_RING);
 
-	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
-	field = le32_to_cpu(event->trans_event.flags);
-	BUG_ON(TRB_TO_SLOT_ID(field) != udev->slot_id);
-	BUG_ON(TRB_TO_EP_INDEX(field) != ep_index);
-	BUG_ON(GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len
-		!= COMP_STOP)));
-	xhci_acknowledge_event(ctrl);
-
-	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
+	/*
+	 * An endpoint working on a transfer reports it stopped before the
+	 * command completes, an idle one (e.g. a stream still waiting for the
+	 * device) does not. Transfers on other endpoints may complete in the
+	 * meantime.
+	 */
+	for (;;) {
+		event = xhci_next_event(ctrl);
+		BUG_ON(!event);
+		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+		if (type == TRB_COMPLETION)
+			break;
+		if (type == TRB_TRANSFER) {
+			comp_code = GET_COMP_CODE(le32_to_cpu(
+					event->trans_event.transfer_len));
+			td = xhci_find_td(ctrl, event);
+			if (td && comp_code != COMP_STOP &&
+			    comp_code != COMP_STOP_INVAL)
+				xhci_td_done(ctrl, td, event);
+		}
+		xhci_acknowledge_event(ctrl);
+	}
 	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
 		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
 		event->event_cmd.status)) != COMP_SUCCESS);
 	xhci_acknowledge_event(ctrl);
 
-	xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
-		ring->cycle_state), udev->slot_id, ep_index, TRB_SET_DEQ);
+	deq = (uintptr_t)ring->enqueue | ring->cycle_state;
+	if (stream_id)
+		deq |= SCT_FOR_CTX(SCT_PRI_TR);
+	queue_command(ctrl, (void *)deq, udev->slot_id, ep_index, stream_id,
+		      TRB_SET_DEQ);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
 	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
 		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
@@ -513,49 +702,48 @@ static void abort_td(struct usb_device *udev, int ep_index)
 	xhci_acknowledge_event(ctrl);
 }
 
-static void record_transfer_result(struct usb_device *udev,
-				   union xhci_trb *event, int length)
+/**
+ * Aborts the ring a queued bulk transfer is on and fails what is left on
+ * it. Stopping the endpoint stops its other streams too, so their doorbells
+ * are rung again for the transfers they still have queued.
+ *
+ * @param udev	pointer to the USB device structure
+ * @param td	a transfer on the ring
+ * @return none
+ */
+static void abort_bulk_ring(struct usb_device *udev, struct xhci_td *td)
 {
-	udev->act_len = min(length, length -
-		(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_ring *ring = td->ring;
+	int ep_index = td->ep_index;
+	int i;
 
-	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
-	case COMP_SUCCESS:
-		BUG_ON(udev->act_len != length);
-		/* fallthrough */
-	case COMP_SHORT_TX:
-		udev->status = 0;
-		break;
-	case COMP_STALL:
-		udev->status = USB_ST_STALLED;
-		break;
-	case COMP_DB_ERR:
-	case COMP_TRB_ERR:
-		udev->status = USB_ST_BUF_ERR;
-		break;
-	case COMP_BABBLE:
-		udev->status = USB_ST_BABBLE_DET;
-		break;
-	default:
-		udev->status = 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+	abort_td(udev, ep_index, ring, td->req->stream_id);
+	cancel_tds(ctrl, ring);
+
+	for (i = 0; i < XHCI_MAX_TDS; i++) {
+		td = &ctrl->tds[i];
+		if (td->req && td->udev == udev && td->ep_index == ep_index)
+			xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
+				    DB_VALUE(ep_index, td->req->stream_id));
 	}
 }
 
-/**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Queues up the BULK Request and rings the doorbell, without waiting for
+ * it to complete. With a stream ID, the TRBs go on the ring of that stream.
  *
  * @param udev		pointer to the USB device structure
- * @param pipe		contains the DIR_IN or OUT , devnum
- * @param length	length of the buffer
- * @param buffer	buffer to be read/written based on the request
- * @return returns 0 if successful else -1 on failure
+ * @param req		the request, with the pipe, buffer and length
+ * @return 0 if successful else error code on failure
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req)
 {
+	unsigned long pipe = req->pipe;
+	int length = req->length;
+	void *buffer = req->buffer;
 	int num_trbs = 0;
-	struct xhci_generic_trb *start_trb;
+	struct xhci_generic_trb *start_trb, *last_trb;
 	bool first_trb = false;
 	int start_cycle;
 	u32 field = 0;
@@ -564,30 +752,38 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	int slot_id = udev->slot_id;
 	int ep_index;
 	struct xhci_virt_device *virt_dev;
+	struct xhci_virt_ep *virt_ep;
 	struct xhci_ep_ctx *ep_ctx;
 	struct xhci_ring *ring;		/* EP transfer ring */
-	union xhci_trb *event;
+	struct xhci_td *td = NULL;
 
 	int running_total, trb_buff_len;
 	unsigned int total_packet_count;
 	int maxpacketsize;
 	u64 addr;
-	int ret;
+	int ret, i, used;
 	u32 trb_fields[4];
 	u64 val_64 = (uintptr_t)buffer;
 
-	debug("dev=%p, pipe=%lx, buffer=%p, length=%d\n",
-		udev, pipe, buffer, length);
+	debug("dev=%p, pipe=%lx, stream=%u, buffer=%p, length=%d\n",
+	      udev, pipe, req->stream_id, buffer, length);
 
 	ep_index = usb_pipe_ep_index(pipe);
 	virt_dev = ctrl->devs[slot_id];
+	virt_ep = &virt_dev->eps[ep_index];
 
 	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
 			 virt_dev->out_ctx->size);
 
 	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
 
-	ring = virt_dev->eps[ep_index].ring;
+	if (req->stream_id) {
+		if (req->stream_id > virt_ep->num_streams)
+			return -EINVAL;
+		ring = virt_ep->stream_rings[req->stream_id];
+	} else {
+		ring = virt_ep->ring;
+	}
 	/*
 	 * How much data is (potentially) left before the 64KB boundary?
 	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
@@ -612,6 +808,24 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		running_total += TRB_MAX_BUFF_SIZE;
 	}
 
+	/*
+	 * Several transfers may be queued on the ring: make sure this one
+	 * fits in what the others leave, keeping the link TRB and one spare
+	 */
+	used = 0;
+	for (i = 0; i < XHCI_MAX_TDS; i++) {
+		if (!ctrl->tds[i].req) {
+			if (!td)
+				td = &ctrl->tds[i];
+		} else if (ctrl->tds[i].ring == ring) {
+			used += ctrl->tds[i].last - ctrl->tds[i].first + 1;
+			if (ctrl->tds[i].last < ctrl->tds[i].first)
+				used += TRBS_PER_SEGMENT;
+		}
+	}
+	if (!td || used + num_trbs > TRBS_PER_SEGMENT - 2)
+		return -EBUSY;
+
 	/*
 	 * XXX: Calling routine prepare_ring() called in place of
 	 * prepare_trasfer() as there in 'Linux' since we are not
@@ -698,7 +912,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_fields[2] = length_field;
 		trb_fields[3] = field | (TRB_NORMAL << TRB_TYPE_SHIFT);
 
-		queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
+		last_trb = queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
 
 		--num_trbs;
 
@@ -709,26 +923,116 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_buff_len = min((length - running_total), TRB_MAX_BUFF_SIZE);
 	} while (running_total < length);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	req->done = false;
+	req->act_len = 0;
+	req->status = USB_ST_NOT_PROC;
+	td->req = req;
+	td->udev = udev;
+	td->ring = ring;
+	td->first = (union xhci_trb *)start_trb;
+	td->last = (union xhci_trb *)last_trb;
+	td->ep_index = ep_index;
 
-	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
-	if (!event) {
-		debug("XHCI bulk transfer timed out, aborting...\n");
-		abort_td(udev, ep_index);
-		udev->status = USB_ST_NAK_REC;  /* closest thing to a timeout */
-		udev->act_len = 0;
-		return -ETIMEDOUT;
+	giveback_first_trb(udev, ep_index, req->stream_id, start_cycle,
+			   start_trb);
+
+	return 0;
+}
+
+/**
+ * Waits for a BULK Request queued by xhci_bulk_submit() to complete.
+ * Other queued requests that complete meanwhile are marked as done too.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param req		the request
+ * @return 0 once done (see req->status), -ETIMEDOUT if it timed out
+ */
+int xhci_bulk_wait(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	union xhci_trb *event;
+	struct xhci_td *td;
+	int i;
+
+	while (!req->done) {
+		event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
+		if (!event) {
+			debug("XHCI bulk transfer timed out, aborting...\n");
+			for (i = 0; i < XHCI_MAX_TDS; i++)
+				if (ctrl->tds[i].req == req)
+					break;
+			BUG_ON(i == XHCI_MAX_TDS);
+			abort_bulk_ring(udev, &ctrl->tds[i]);
+			return -ETIMEDOUT;
+		}
+
+		td = xhci_find_td(ctrl, event);
+		if (td)
+			xhci_td_done(ctrl, td, event);
+		else
+			printf("Unexpected XHCI transfer event, skipping... "
+			       "(%08x %08x %08x %08x)\n",
+			       le32_to_cpu(event->generic.field[0]),
+			       le32_to_cpu(event->generic.field[1]),
+			       le32_to_cpu(event->generic.field[2]),
+			       le32_to_cpu(event->generic.field[3]));
+		xhci_acknowledge_event(ctrl);
 	}
-	field = le32_to_cpu(event->trans_event.flags);
 
-	BUG_ON(TRB_TO_SLOT_ID(field) != slot_id);
-	BUG_ON(TRB_TO_EP_INDEX(field) != ep_index);
-	BUG_ON(*(void **)(uintptr_t)le64_to_cpu(event->trans_event.buffer) -
-		buffer > (size_t)length);
+	return 0;
+}
 
-	record_transfer_result(udev, event, length);
-	xhci_acknowledge_event(ctrl);
-	xhci_inval_cache((uintptr_t)buffer, length);
+/**
+ * Cancels a BULK Request queued by xhci_bulk_submit(), along with anything
+ * else queued on its ring. Nothing is done if it has already completed.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param req		the request
+ * @return 0
+ */
+int xhci_bulk_cancel(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int i;
+
+	for (i = 0; i < XHCI_MAX_TDS; i++) {
+		if (ctrl->tds[i].req == req) {
+			abort_bulk_ring(udev, &ctrl->tds[i]);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Queues up the BULK Request and waits for it to complete
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @return returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+			int length, void *buffer)
+{
+	struct usb_bulk_req req = {
+		.pipe = pipe,
+		.buffer = buffer,
+		.length = length,
+	};
+	int ret;
+
+	ret = xhci_bulk_submit(udev, &req);
+	if (ret)
+		return ret;
+
+	ret = xhci_bulk_wait(udev, &req);
+	udev->status = req.status;
+	udev->act_len = req.act_len;
+	if (ret)
+		return ret;
 
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
@@ -906,7 +1210,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	queue_trb(ctrl, ep_ring, false, trb_fields);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event)
@@ -938,7 +1242,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 abort:
 	debug("XHCI control transfer timed out, aborting...\n");
-	abort_td(udev, ep_index);
+	abort_td(udev, ep_index, ep_ring, 0);
 	udev->status = USB_ST_NAK_REC;
 	udev->act_len = 0;
 	return -ETIMEDOUT;
@@ -28,6 +28,7 @@
 #include <asm/cache.h>
 #include <asm/unaligned.h>
 #include <linux/errno.h>
+#include <linux/log2.h>
 #include "xhci.h"
 
 #ifndef CONFIG_USB_MAX_CONTROLLER_COUNT
@@ -1386,6 +1387,146 @@ static int xhci_submit_bulk_msg(struct udevice *dev, struct usb_device *udev,
 	return _xhci_submit_bulk_msg(udev, pipe, buffer, length);
 }
 
+/*
+ * Finds the SuperSpeed companion descriptor of the endpoint of a pipe. The
+ * endpoints of all alternate settings are listed in the interface, so the
+ * same address can show up more than once: pick the one with most streams.
+ */
+static struct usb_ss_ep_comp_descriptor *
+xhci_get_ss_ep_comp(struct usb_device *udev, unsigned long pipe)
+{
+	u8 addr = usb_pipeendpoint(pipe) | (usb_pipein(pipe) ? USB_DIR_IN : 0);
+	struct usb_ss_ep_comp_descriptor *best = NULL, *desc;
+	struct usb_interface *ifdesc;
+	int i, j;
+
+	for (i = 0; i < udev->config.no_of_if; i++) {
+		ifdesc = &udev->config.if_desc[i];
+		for (j = 0; j < ifdesc->no_of_ep; j++) {
+			if (ifdesc->ep_desc[j].bEndpointAddress != addr)
+				continue;
+			desc = &ifdesc->ss_ep_comp_desc[j];
+			if (!best || (desc->bmAttributes & 0x1f) >
+				     (best->bmAttributes & 0x1f))
+				best = desc;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Switch bulk endpoints over to streams, giving each stream its own
+ * transfer ring. See section 4.12.2 of the xHCI spec.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipes		bulk pipes of the endpoints
+ * @param num_pipes	number of pipes
+ * @param num_streams	number of streams wanted, numbered from 1
+ * @return number of streams set up, else error code on failure
+ */
+static int _xhci_alloc_streams(struct usb_device *udev, unsigned long *pipes,
+			       int num_pipes, unsigned int num_streams)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct usb_ss_ep_comp_descriptor *ss_ep_comp_desc;
+	struct xhci_input_control_ctx *ctrl_ctx;
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_virt_ep *virt_ep;
+	unsigned int max_streams;
+	u32 hcc_params, ep_flags = 0;
+	int i, ep_index, ret;
+
+	hcc_params = xhci_readl(&ctrl->hccr->cr_hccparams);
+	if (!((hcc_params >> 12) & 0xf) || udev->speed < USB_SPEED_SUPER)
+		return -ENOSYS;
+
+	/* Stream 0 is reserved, and the array size must be a power of 2 */
+	num_streams = roundup_pow_of_two(num_streams + 1);
+	max_streams = HCC_MAX_PSA(hcc_params);
+	for (i = 0; i < num_pipes; i++) {
+		if (usb_pipetype(pipes[i]) != PIPE_BULK)
+			return -EINVAL;
+		ss_ep_comp_desc = xhci_get_ss_ep_comp(udev, pipes[i]);
+		if (!ss_ep_comp_desc || !(ss_ep_comp_desc->bmAttributes & 0x1f))
+			return -ENOSYS;
+		max_streams = min_t(unsigned int, max_streams,
+				    1 << (ss_ep_comp_desc->bmAttributes & 0x1f));
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		if (virt_dev->eps[ep_index].num_streams)
+			return -EBUSY;
+		ep_flags |= 1 << (ep_index + 1);
+	}
+	num_streams = min(num_streams, max_streams);
+
+	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+
+	ctrl_ctx = xhci_get_input_control_ctx(virt_dev->in_ctx);
+	ctrl_ctx->add_flags = cpu_to_le32(SLOT_FLAG | ep_flags);
+	ctrl_ctx->drop_flags = cpu_to_le32(ep_flags);
+	xhci_slot_copy(ctrl, virt_dev->in_ctx, virt_dev->out_ctx);
+
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		virt_ep = &virt_dev->eps[ep_index];
+		xhci_endpoint_copy(ctrl, virt_dev->in_ctx, virt_dev->out_ctx,
+				   ep_index);
+		xhci_alloc_streams_mem(virt_ep, num_streams);
+
+		ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->in_ctx, ep_index);
+		ep_ctx->ep_info &= cpu_to_le32(~EP_MAXPSTREAMS_MASK);
+		ep_ctx->ep_info |= cpu_to_le32(EP_MAXPSTREAMS(
+				ilog2(num_streams) - 1) | EP_HAS_LSA);
+		ep_ctx->deq = cpu_to_le64((uintptr_t)virt_ep->stream_ctx);
+		virt_ep->ep_state |= EP_HAS_STREAMS;
+	}
+
+	ret = xhci_configure_endpoints(udev, false);
+	if (ret) {
+		for (i = 0; i < num_pipes; i++) {
+			virt_ep = &virt_dev->eps[usb_pipe_ep_index(pipes[i])];
+			xhci_free_streams(virt_ep);
+			virt_ep->ep_state &= ~EP_HAS_STREAMS;
+		}
+		return ret;
+	}
+
+	return num_streams - 1;
+}
+
+static int xhci_alloc_streams(struct udevice *dev, struct usb_device *udev,
+			      unsigned long *pipes, int num_pipes,
+			      unsigned int num_streams)
+{
+	debug("%s: dev='%s', udev=%p\n", __func__, dev->name, udev);
+	return _xhci_alloc_streams(udev, pipes, num_pipes, num_streams);
+}
+
+static int xhci_bulk_submit_req(struct udevice *dev, struct usb_device *udev,
+				struct usb_bulk_req *req)
+{
+	if (usb_pipetype(req->pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(req->pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_submit(udev, req);
+}
+
+static int xhci_bulk_wait_req(struct udevice *dev, struct usb_device *udev,
+			      struct usb_bulk_req *req)
+{
+	return xhci_bulk_wait(udev, req);
+}
+
+static int xhci_bulk_cancel_req(struct udevice *dev, struct usb_device *udev,
+				struct usb_bulk_req *req)
+{
+	return xhci_bulk_cancel(udev, req);
+}
+
 static int xhci_submit_int_msg(struct udevice *dev, struct usb_device *udev,
 			       unsigned long pipe, void *buffer, int length,
 			       int interval, bool nonblock)
@@ -1470,11 +1611,11 @@ static int xhci_update_hub_device(struct udevice *dev, struct usb_device *udev)
 static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
 {
 	/*
-	 * xHCD allocates one segment which includes 64 TRBs for each endpoint
+	 * xHCD allocates one segment which includes 256 TRBs for each endpoint
 	 * and the last TRB in this segment is configured as a link TRB to form
 	 * a TRB ring. Each TRB can transfer up to 64K bytes, however data
 	 * buffers referenced by transfer TRBs shall not span 64KB boundaries.
-	 * Hence the maximum number of TRBs we can use in one transfer is 62.
+	 * Hence the maximum number of TRBs we can use in one transfer is 254.
 	 */
 	*size = (TRBS_PER_SEGMENT - 2) * TRB_MAX_BUFF_SIZE;
 
@@ -1535,6 +1676,10 @@ struct dm_usb_ops xhci_usb_ops = {
 	.alloc_device = xhci_alloc_device,
 	.update_hub_device = xhci_update_hub_device,
 	.get_max_xfer_size  = xhci_get_max_xfer_size,
+	.alloc_streams = xhci_alloc_streams,
+	.bulk_submit = xhci_bulk_submit_req,
+	.bulk_wait = xhci_bulk_wait_req,
+	.bulk_cancel = xhci_bulk_cancel_req,
 };
 
 #endif
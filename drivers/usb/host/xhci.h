@@ -987,15 +987,16 @@ typedef enum {
  * TRBS_PER_SEGMENT must be a multiple of 4,
  * since the command ring is 64-byte aligned.
  * It must also be greater than 16.
+ * A segment of 256 TRBs lets a single bulk transfer reach 16MB.
  */
-#define TRBS_PER_SEGMENT	64
+#define TRBS_PER_SEGMENT	256
 /* Allow two commands + a link TRB, along with any reserved command TRBs */
 #define MAX_RSVD_CMD_TRBS	(TRBS_PER_SEGMENT - 3)
 #define SEGMENT_SIZE		(TRBS_PER_SEGMENT*16)
 /* SEGMENT_SHIFT should be log2(SEGMENT_SIZE).
  * Change this if you change TRBS_PER_SEGMENT!
  */
-#define SEGMENT_SHIFT		10
+#define SEGMENT_SHIFT		12
 /* TRB buffer pointers can't cross 64KB boundaries */
 #define TRB_MAX_BUFF_SHIFT	16
 #define TRB_MAX_BUFF_SIZE	(1 << TRB_MAX_BUFF_SHIFT)
@@ -1056,8 +1057,29 @@ struct xhci_scratchpad {
 #define XHCI_STOP_EP_CMD_TIMEOUT	5
 /* XXX: Make these module parameters */
 
+/**
+ * struct xhci_stream_ctx - entry of a stream context array
+ *
+ * @stream_ring:	dequeue pointer of the stream ring, with the DCS bit and
+ *			the stream context type in bits 3:1
+ */
+struct xhci_stream_ctx {
+	__le64	stream_ring;
+	/* offset 0x14 - 0x1f reserved for HC internal use */
+	__le32	reserved[2];
+};
+
+/* Stream Context Types (section 6.4.1) - bits 3:1 of stream ctx deq ptr */
+#define	SCT_FOR_CTX(p)		(((p) & 0x7) << 1)
+/* Primary stream array type, dequeue pointer is to a transfer ring */
+#define	SCT_PRI_TR		1
+
 struct xhci_virt_ep {
 	struct xhci_ring		*ring;
+	/* Stream context array and rings, indexed by stream ID */
+	struct xhci_stream_ctx		*stream_ctx;
+	struct xhci_ring		**stream_rings;
+	unsigned int			num_streams;
 	unsigned int			ep_state;
 #define SET_DEQ_PENDING		(1 << 0)
 #define EP_HALTED		(1 << 1)	/* For stall handling */
@@ -1210,6 +1232,28 @@ void xhci_hcd_stop(int index);
 /* true: Controller Not Ready to accept doorbell or op reg writes after reset */
 #define XHCI_STS_CNR		(1 << 11)
 
+/* Bulk transfers in flight at once on a controller */
+#define XHCI_MAX_TDS		64
+
+/**
+ * struct xhci_td - a bulk transfer queued on a transfer ring
+ *
+ * @req:	request this is for, NULL when the entry is free
+ * @udev:	device the request is for
+ * @ring:	ring the TRBs are on, the stream ring with streams
+ * @first:	first TRB of the transfer
+ * @last:	last TRB of the transfer, with IOC set
+ * @ep_index:	endpoint index
+ */
+struct xhci_td {
+	struct usb_bulk_req *req;
+	struct usb_device *udev;
+	struct xhci_ring *ring;
+	union xhci_trb *first;
+	union xhci_trb *last;
+	int ep_index;
+};
+
 struct xhci_ctrl {
 #if CONFIG_IS_ENABLED(DM_USB)
 	struct udevice *dev;
@@ -1230,6 +1274,8 @@ struct xhci_ctrl {
 	struct xhci_scratchpad *scratchpad;
 	struct xhci_virt_device *devs[MAX_HC_SLOTS];
 	int rootdev;
+	/* Bulk transfers queued and not yet completed */
+	struct xhci_td tds[XHCI_MAX_TDS];
 };
 
 unsigned long trb_addr(struct xhci_segment *seg, union xhci_trb *trb);
@@ -1255,6 +1301,9 @@ void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer);
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req);
+int xhci_bulk_wait(struct usb_device *udev, struct usb_bulk_req *req);
+int xhci_bulk_cancel(struct usb_device *udev, struct usb_bulk_req *req);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
@@ -1262,6 +1311,9 @@ void xhci_flush_cache(uintptr_t addr, u32 type_len);
 void xhci_inval_cache(uintptr_t addr, u32 type_len);
 void xhci_cleanup(struct xhci_ctrl *ctrl);
 struct xhci_ring *xhci_ring_alloc(unsigned int num_segs, bool link_trbs);
+void xhci_alloc_streams_mem(struct xhci_virt_ep *virt_ep,
+			    unsigned int num_streams);
+void xhci_free_streams(struct xhci_virt_ep *virt_ep);
 int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id);
 int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor);
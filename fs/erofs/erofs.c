@@ -0,0 +1,554 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS filesystem implementation for U-Boot
+ *
+ * Everything is read from the block device on demand. Plain files are
+ * copied block range by block range, the tail of an inline file is read
+ * from right after its inode. Compressed files are handled in zmap.c and
+ * decompressed extent by extent straight into the destination buffer.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <erofs.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <part.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
+#include <linux/stat.h>
+
+#include "erofs_fs.h"
+
+/* Symbolic links followed during a lookup */
+#define EROFS_MAX_SYMLINKS	8
+#define EROFS_MAX_TARGET_LEN	4096
+
+/* Largest single fs_devread(), byte_len is an int */
+#define EROFS_MAX_DEVREAD	SZ_1G
+
+/* Directory iterator, one directory block at a time */
+struct erofs_dir_iter {
+	struct erofs_inode dir;
+	u64	pos;		/* Directory offset of the next block to read */
+	u8	*blk;		/* Current directory block */
+	u32	blklen;
+	u32	nent;		/* Dirents in the current block */
+	u32	idx;		/* Next dirent in the current block */
+	u64	nid;		/* Inode of the current entry */
+	u8	type;		/* EROFS_FT_* of the current entry */
+	char	name[EROFS_NAME_LEN + 1];
+};
+
+struct erofs_sb_info *erofs_sbi;
+
+/* Read 'len' bytes at byte offset 'pos' of the image */
+int erofs_dev_read(u64 pos, void *buf, u64 len)
+{
+	int log2blksz = erofs_sbi->dev->log2blksz;
+
+	while (len) {
+		int n = min_t(u64, len, EROFS_MAX_DEVREAD);
+
+		if (!fs_devread(erofs_sbi->dev, &erofs_sbi->part,
+				pos >> log2blksz,
+				pos & (erofs_sbi->dev->blksz - 1), n, buf))
+			return -EIO;
+
+		pos += n;
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int erofs_read_inode(u64 nid, struct erofs_inode *inode)
+{
+	union {
+		struct erofs_inode_compact c;
+		struct erofs_inode_extended e;
+	} raw;
+	u64 pos = erofs_iloc(nid);
+	u16 ifmt;
+	int ret;
+
+	ret = erofs_dev_read(pos, &raw.c, sizeof(raw.c));
+	if (ret)
+		return ret;
+
+	memset(inode, 0, sizeof(*inode));
+	inode->nid = nid;
+
+	ifmt = le16_to_cpu(raw.c.i_format);
+	inode->datalayout = (ifmt >> EROFS_I_DATALAYOUT_BIT) &
+			    EROFS_I_DATALAYOUT_MASK;
+	if (inode->datalayout > EROFS_INODE_FLAT_COMPRESSION) {
+		printf("EROFS: unsupported data layout %u of inode %llu\n",
+		       inode->datalayout, nid);
+		return -EOPNOTSUPP;
+	}
+
+	switch ((ifmt >> EROFS_I_VERSION_BIT) & 1) {
+	case EROFS_INODE_LAYOUT_EXTENDED:
+		ret = erofs_dev_read(pos, &raw.e, sizeof(raw.e));
+		if (ret)
+			return ret;
+		inode->inode_isize = sizeof(raw.e);
+		inode->xattr_isize =
+			EROFS_XATTR_IBODY_SIZE(le16_to_cpu(raw.e.i_xattr_icount));
+		inode->mode = le16_to_cpu(raw.e.i_mode);
+		inode->size = le64_to_cpu(raw.e.i_size);
+		inode->raw_blkaddr = le32_to_cpu(raw.e.i_u);
+		break;
+	default:
+		inode->inode_isize = sizeof(raw.c);
+		inode->xattr_isize =
+			EROFS_XATTR_IBODY_SIZE(le16_to_cpu(raw.c.i_xattr_icount));
+		inode->mode = le16_to_cpu(raw.c.i_mode);
+		inode->size = le32_to_cpu(raw.c.i_size);
+		inode->raw_blkaddr = le32_to_cpu(raw.c.i_u);
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Read from an uncompressed inode. All blocks but an inline tail are
+ * contiguous from raw_blkaddr, the tail follows the inode and its xattrs.
+ */
+static int erofs_read_flat(struct erofs_inode *inode, char *buf, u64 len,
+			   u64 offset)
+{
+	u64 nblocks = DIV_ROUND_UP(inode->size, EROFS_BLKSIZ);
+	u64 lastblk = nblocks;
+	u64 pos, n;
+	int ret;
+
+	if (inode->datalayout == EROFS_INODE_FLAT_INLINE)
+		lastblk--;
+
+	while (len) {
+		if (offset >> EROFS_BLKSZBITS < lastblk) {
+			n = min(len, (lastblk << EROFS_BLKSZBITS) - offset);
+			pos = ((u64)inode->raw_blkaddr << EROFS_BLKSZBITS) +
+			      offset;
+		} else {
+			n = len;
+			pos = erofs_iloc(inode->nid) + inode->inode_isize +
+			      inode->xattr_isize + (offset & (EROFS_BLKSIZ - 1));
+		}
+
+		ret = erofs_dev_read(pos, buf, n);
+		if (ret)
+			return ret;
+
+		buf += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int erofs_pread(struct erofs_inode *inode, char *buf, u64 len,
+		       u64 offset)
+{
+	if (erofs_inode_is_compressed(inode))
+		return z_erofs_read_data(inode, buf, len, offset);
+
+	return erofs_read_flat(inode, buf, len, offset);
+}
+
+static int erofs_dir_open(struct erofs_inode *dir, struct erofs_dir_iter *it)
+{
+	if (!S_ISDIR(dir->mode))
+		return -ENOTDIR;
+
+	memset(it, 0, sizeof(*it));
+	it->dir = *dir;
+	it->blk = malloc(EROFS_BLKSIZ);
+	if (!it->blk)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void erofs_dir_close(struct erofs_dir_iter *it)
+{
+	free(it->blk);
+	it->blk = NULL;
+}
+
+/*
+ * Step to the next directory entry, -ENOENT at the end. The nameoff of the
+ * first dirent of a block gives the number of dirents, each name runs up
+ * to the next one, the last one up to a NUL or the end of the block.
+ */
+static int erofs_dir_next(struct erofs_dir_iter *it)
+{
+	struct erofs_dirent *de;
+	u32 start, end, len;
+	int ret;
+
+	while (it->idx >= it->nent) {
+		if (it->pos >= it->dir.size)
+			return -ENOENT;
+
+		it->blklen = min_t(u64, EROFS_BLKSIZ, it->dir.size - it->pos);
+		ret = erofs_pread(&it->dir, (char *)it->blk, it->blklen,
+				  it->pos);
+		if (ret)
+			return ret;
+		it->pos += EROFS_BLKSIZ;
+
+		de = (struct erofs_dirent *)it->blk;
+		start = get_unaligned_le16(&de->nameoff);
+		if (start < sizeof(*de) || start % sizeof(*de) ||
+		    start >= it->blklen)
+			return -EIO;
+
+		it->nent = start / sizeof(*de);
+		it->idx = 0;
+	}
+
+	de = (struct erofs_dirent *)it->blk + it->idx;
+	start = get_unaligned_le16(&de->nameoff);
+	if (++it->idx < it->nent) {
+		end = get_unaligned_le16(&de[1].nameoff);
+		len = end - start;
+	} else {
+		end = it->blklen;
+		len = strnlen((char *)it->blk + start, end - start);
+	}
+
+	if (start >= end || end > it->blklen || len > EROFS_NAME_LEN)
+		return -EIO;
+
+	memcpy(it->name, it->blk + start, len);
+	it->name[len] = '\0';
+	it->nid = get_unaligned_le64(&de->nid);
+	it->type = de->file_type;
+
+	return 0;
+}
+
+static int erofs_dir_find(struct erofs_inode *dir, const char *name, u64 *nid)
+{
+	struct erofs_dir_iter it;
+	int ret;
+
+	ret = erofs_dir_open(dir, &it);
+	if (ret)
+		return ret;
+
+	while (!(ret = erofs_dir_next(&it))) {
+		if (!strcmp(it.name, name)) {
+			*nid = it.nid;
+			break;
+		}
+	}
+
+	erofs_dir_close(&it);
+
+	return ret;
+}
+
+/*
+ * Resolve 'path' to an inode, following symbolic links. Directories hold
+ * "." and ".." entries, so those need no special casing.
+ */
+static int erofs_lookup(const char *path, struct erofs_inode *inode)
+{
+	u64 dir_nid, nid;
+	char *buf, *p, *comp;
+	int links = 0;
+	int ret;
+
+	if (!erofs_sbi)
+		return -ENODEV;
+
+	buf = strdup(path);
+	if (!buf)
+		return -ENOMEM;
+
+	dir_nid = erofs_sbi->root_nid;
+	ret = erofs_read_inode(dir_nid, inode);
+
+	for (p = buf; !ret;) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+
+		comp = p;
+		while (*p && *p != '/')
+			p++;
+		if (*p)
+			*p++ = '\0';
+
+		ret = erofs_dir_find(inode, comp, &nid);
+		if (ret)
+			break;
+
+		ret = erofs_read_inode(nid, inode);
+		if (ret)
+			break;
+
+		if (S_ISLNK(inode->mode)) {
+			size_t rest = strlen(p);
+			char *target;
+
+			if (++links > EROFS_MAX_SYMLINKS ||
+			    inode->size > EROFS_MAX_TARGET_LEN) {
+				ret = -ELOOP;
+				break;
+			}
+
+			/* Continue with target + "/" + remaining path */
+			target = malloc(inode->size + rest + 2);
+			if (!target) {
+				ret = -ENOMEM;
+				break;
+			}
+
+			ret = erofs_pread(inode, target, inode->size, 0);
+			if (ret) {
+				free(target);
+				break;
+			}
+			target[inode->size] = '/';
+			strcpy(target + inode->size + 1, p);
+
+			free(buf);
+			buf = target;
+			p = buf;
+
+			/* Relative targets resolve from the link's directory */
+			if (*p == '/')
+				dir_nid = erofs_sbi->root_nid;
+			ret = erofs_read_inode(dir_nid, inode);
+			continue;
+		}
+
+		if (S_ISDIR(inode->mode))
+			dir_nid = nid;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+int erofs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct erofs_super_block *sb;
+	struct erofs_sb_info *sbi;
+	int ret = -EINVAL;
+
+	erofs_close();
+
+	sb = malloc_cache_aligned(max_t(int, sizeof(*sb), fs_dev_desc->blksz));
+	if (!sb)
+		return -ENOMEM;
+
+	if (!fs_devread(fs_dev_desc, fs_partition,
+			EROFS_SUPER_OFFSET >> fs_dev_desc->log2blksz,
+			EROFS_SUPER_OFFSET & (fs_dev_desc->blksz - 1),
+			sizeof(*sb), (char *)sb))
+		goto out;
+
+	if (le32_to_cpu(sb->magic) != EROFS_SUPER_MAGIC_V1)
+		goto out;
+
+	if (sb->blkszbits != EROFS_BLKSZBITS) {
+		printf("EROFS: unsupported block size %u\n",
+		       1 << sb->blkszbits);
+		goto out;
+	}
+
+	if (le32_to_cpu(sb->feature_incompat) & ~EROFS_ALL_FEATURE_INCOMPAT) {
+		printf("EROFS: unsupported features 0x%x\n",
+		       le32_to_cpu(sb->feature_incompat) &
+		       ~EROFS_ALL_FEATURE_INCOMPAT);
+		goto out;
+	}
+
+	sbi = calloc(1, sizeof(*sbi));
+	if (!sbi) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	sbi->dev = fs_dev_desc;
+	sbi->part = *fs_partition;
+	sbi->meta_blkaddr = le32_to_cpu(sb->meta_blkaddr);
+	sbi->root_nid = le16_to_cpu(sb->root_nid);
+	sbi->feature_incompat = le32_to_cpu(sb->feature_incompat);
+	sbi->metablk = -1;
+
+	sbi->metabuf = malloc_cache_aligned(EROFS_BLKSIZ);
+	sbi->pcluster = malloc_cache_aligned(EROFS_BLKSIZ);
+	if (!sbi->metabuf || !sbi->pcluster) {
+		free(sbi->pcluster);
+		free(sbi->metabuf);
+		free(sbi);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	erofs_sbi = sbi;
+
+	debug("EROFS: %u blocks, root nid %llu\n", le32_to_cpu(sb->blocks),
+	      sbi->root_nid);
+
+	ret = 0;
+out:
+	free(sb);
+	return ret;
+}
+
+int erofs_exists(const char *filename)
+{
+	struct erofs_inode inode;
+
+	return !erofs_lookup(filename, &inode);
+}
+
+int erofs_size(const char *filename, loff_t *size)
+{
+	struct erofs_inode inode;
+	int ret;
+
+	ret = erofs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+
+	*size = inode.size;
+
+	return 0;
+}
+
+int erofs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	       loff_t *actread)
+{
+	struct erofs_inode inode;
+	int ret;
+
+	*actread = 0;
+
+	ret = erofs_lookup(filename, &inode);
+	if (ret)
+		goto out;
+
+	if (!S_ISREG(inode.mode)) {
+		ret = -EISDIR;
+		goto out;
+	}
+
+	if (offset >= inode.size)
+		return 0;
+
+	if (!len || offset + len > inode.size)
+		len = inode.size - offset;
+
+	ret = erofs_pread(&inode, buf, len, offset);
+	if (!ret)
+		*actread = len;
+out:
+	if (ret)
+		printf("** Unable to read file %s **\n", filename);
+
+	return ret;
+}
+
+struct erofs_dir_stream {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	struct erofs_dir_iter it;
+};
+
+int erofs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct erofs_dir_stream *dir;
+	struct erofs_inode inode;
+	int ret;
+
+	ret = erofs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		return -ENOMEM;
+
+	ret = erofs_dir_open(&inode, &dir->it);
+	if (ret) {
+		free(dir);
+		return ret;
+	}
+
+	*dirsp = (struct fs_dir_stream *)dir;
+
+	return 0;
+}
+
+int erofs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
+{
+	struct erofs_dir_stream *dir = (struct erofs_dir_stream *)dirs;
+	struct fs_dirent *dent = &dir->dirent;
+	struct erofs_inode inode;
+	int ret;
+
+	ret = erofs_dir_next(&dir->it);
+	if (ret)
+		return ret;
+
+	memset(dent, 0, sizeof(*dent));
+	strlcpy(dent->name, dir->it.name, sizeof(dent->name));
+
+	switch (dir->it.type) {
+	case EROFS_FT_DIR:
+		dent->type = FS_DT_DIR;
+		break;
+	case EROFS_FT_SYMLINK:
+		dent->type = FS_DT_LNK;
+		break;
+	case EROFS_FT_REG_FILE:
+		dent->type = FS_DT_REG;
+		ret = erofs_read_inode(dir->it.nid, &inode);
+		if (ret)
+			return ret;
+		dent->size = inode.size;
+		break;
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+
+	*dentp = dent;
+
+	return 0;
+}
+
+void erofs_closedir(struct fs_dir_stream *dirs)
+{
+	struct erofs_dir_stream *dir = (struct erofs_dir_stream *)dirs;
+
+	erofs_dir_close(&dir->it);
+	free(dir);
+}
+
+void erofs_close(void)
+{
+	if (!erofs_sbi)
+		return;
+
+	free(erofs_sbi->pcluster);
+	free(erofs_sbi->metabuf);
+	free(erofs_sbi);
+	erofs_sbi = NULL;
+}
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * EROFS filesystem implementation for U-Boot
+ *
+ * On-disk layout as defined by the Linux kernel (fs/erofs/erofs_fs.h) and
+ * erofs-utils, all fields are little endian. Only 4 KiB blocks exist.
+ */
+
+#ifndef __EROFS_FS_H__
+#define __EROFS_FS_H__
+
+#include <part.h>
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+#define EROFS_SUPER_OFFSET		1024
+#define EROFS_SUPER_MAGIC_V1		0xe0f5e1e2
+
+#define EROFS_BLKSZBITS			12
+#define EROFS_BLKSIZ			(1 << EROFS_BLKSZBITS)
+#define EROFS_ISLOTBITS			5	/* 32 byte inode slots */
+
+#define EROFS_FEATURE_INCOMPAT_LZ4_0PADDING	0x00000001
+#define EROFS_ALL_FEATURE_INCOMPAT		EROFS_FEATURE_INCOMPAT_LZ4_0PADDING
+
+struct erofs_super_block {
+	__le32 magic;
+	__le32 checksum;
+	__le32 feature_compat;
+	__u8 blkszbits;
+	__u8 reserved;
+	__le16 root_nid;
+	__le64 inos;
+	__le64 build_time;
+	__le32 build_time_nsec;
+	__le32 blocks;
+	__le32 meta_blkaddr;	/* Block of nid 0 */
+	__le32 xattr_blkaddr;
+	__u8 uuid[16];
+	__u8 volume_name[16];
+	__le32 feature_incompat;
+	__u8 reserved2[44];
+} __packed;
+
+/* i_format: bit 0 is the inode layout, bits 1-3 the data layout */
+#define EROFS_I_VERSION_BIT		0
+#define EROFS_I_DATALAYOUT_BIT		1
+#define EROFS_I_DATALAYOUT_MASK		0x7
+
+#define EROFS_INODE_LAYOUT_COMPACT	0
+#define EROFS_INODE_LAYOUT_EXTENDED	1
+
+#define EROFS_INODE_FLAT_PLAIN			0
+#define EROFS_INODE_FLAT_COMPRESSION_LEGACY	1
+#define EROFS_INODE_FLAT_INLINE			2
+#define EROFS_INODE_FLAT_COMPRESSION		3
+
+struct erofs_inode_compact {
+	__le16 i_format;
+	__le16 i_xattr_icount;
+	__le16 i_mode;
+	__le16 i_nlink;
+	__le32 i_size;
+	__le32 i_reserved;
+	__le32 i_u;		/* Raw block address, compressed blocks */
+	__le32 i_ino;
+	__le16 i_uid;
+	__le16 i_gid;
+	__le32 i_reserved2;
+} __packed;
+
+struct erofs_inode_extended {
+	__le16 i_format;
+	__le16 i_xattr_icount;
+	__le16 i_mode;
+	__le16 i_reserved;
+	__le64 i_size;
+	__le32 i_u;
+	__le32 i_ino;
+	__le32 i_uid;
+	__le32 i_gid;
+	__le64 i_ctime;
+	__le32 i_ctime_nsec;
+	__le32 i_nlink;
+	__u8 i_reserved2[16];
+} __packed;
+
+/* In-inode xattrs: a 12 byte header then (i_xattr_icount - 1) slots */
+#define EROFS_XATTR_IBODY_SIZE(count) \
+	((count) ? 12 + sizeof(__u32) * ((count) - 1) : 0)
+
+enum {
+	EROFS_FT_UNKNOWN,
+	EROFS_FT_REG_FILE,
+	EROFS_FT_DIR,
+	EROFS_FT_CHRDEV,
+	EROFS_FT_BLKDEV,
+	EROFS_FT_FIFO,
+	EROFS_FT_SOCK,
+	EROFS_FT_SYMLINK,
+};
+
+/* A directory block starts with dirents, names follow back to back */
+struct erofs_dirent {
+	__le64 nid;
+	__le16 nameoff;
+	__u8 file_type;
+	__u8 reserved;
+} __packed;
+
+#define EROFS_NAME_LEN			255
+
+/* Compressed inodes: map header 8 byte aligned after inode and xattrs */
+#define Z_EROFS_ADVISE_COMPACTED_2B	0x0001
+
+#define Z_EROFS_COMPRESSION_LZ4		0
+
+struct z_erofs_map_header {
+	__le32 h_reserved1;
+	__le16 h_advise;
+	__u8 h_algorithmtype;	/* Bits 0-3: HEAD1 algorithm */
+	__u8 h_clusterbits;	/* Bits 0-2: logical cluster bits - 12 */
+} __packed;
+
+#define Z_EROFS_VLE_CLUSTER_TYPE_PLAIN		0
+#define Z_EROFS_VLE_CLUSTER_TYPE_HEAD		1
+#define Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD	2
+#define Z_EROFS_VLE_DI_CLUSTER_TYPE_MASK	0x3
+
+/* Legacy (full) index, one per logical cluster */
+struct z_erofs_vle_decompressed_index {
+	__le16 di_advise;
+	__le16 di_clusterofs;	/* Where the extent starts in a HEAD */
+	union {
+		__le32 blkaddr;		/* HEAD, PLAIN: physical cluster */
+		__le16 delta[2];	/* NONHEAD: distance to HEAD, next */
+	} di_u;
+} __packed;
+
+/* Legacy indexes follow the map header and 8 bytes of padding */
+#define Z_EROFS_VLE_LEGACY_INDEX_ALIGN(size) \
+	(round_up(size, sizeof(struct z_erofs_vle_decompressed_index)) + \
+	 sizeof(struct z_erofs_map_header) + 8)
+
+/* In-memory inode */
+struct erofs_inode {
+	u64	nid;
+	u64	size;
+	u32	raw_blkaddr;
+	u16	mode;
+	u8	datalayout;
+	u8	inode_isize;
+	u32	xattr_isize;
+
+	/* Compressed inodes, set up by z_erofs_fill_inode() */
+	bool	z_inited;
+	u16	z_advise;
+	u8	z_algorithmtype;
+	u8	z_lclusterbits;
+};
+
+struct erofs_sb_info {
+	struct blk_desc *dev;
+	disk_partition_t part;
+	u32	meta_blkaddr;
+	u64	root_nid;
+	u32	feature_incompat;
+	u8	*metabuf;	/* Last block of compression indexes read */
+	u64	metablk;	/* Its block number, -1 if none */
+	u8	*pcluster;	/* Physical cluster being decompressed */
+};
+
+extern struct erofs_sb_info *erofs_sbi;
+
+static inline u64 erofs_iloc(u64 nid)
+{
+	return ((u64)erofs_sbi->meta_blkaddr << EROFS_BLKSZBITS) +
+	       (nid << EROFS_ISLOTBITS);
+}
+
+static inline bool erofs_inode_is_compressed(struct erofs_inode *inode)
+{
+	return inode->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY ||
+	       inode->datalayout == EROFS_INODE_FLAT_COMPRESSION;
+}
+
+/* erofs.c */
+int erofs_dev_read(u64 pos, void *buf, u64 len);
+
+/* zmap.c */
+int z_erofs_read_data(struct erofs_inode *inode, char *buf, u64 len,
+		      u64 offset);
+
+#endif /* __EROFS_FS_H__ */
@@ -0,0 +1,497 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS filesystem implementation for U-Boot
+ *
+ * Compressed files. The file is split into 4 KiB logical clusters, each
+ * described by an index that says whether an extent starts in it (HEAD or
+ * PLAIN, with the physical cluster holding the extent) or how far back the
+ * extent it belongs to starts (NONHEAD). Every extent is compressed into a
+ * single 4 KiB physical cluster. Follows the Linux fs/erofs/zmap.c logic.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+
+#include "erofs_fs.h"
+
+#define EROFS_MAP_MAPPED	BIT(0)	/* Extent has data */
+#define EROFS_MAP_ZIPPED	BIT(1)	/* Extent is compressed */
+#define EROFS_MAP_FULL_MAPPED	BIT(2)	/* m_llen reaches the extent end */
+
+struct erofs_map_blocks {
+	u64	m_la;		/* Logical start of the extent */
+	u64	m_llen;		/* Logical length, up to the lookup point */
+	u64	m_pa;		/* Physical cluster */
+	u32	m_flags;
+};
+
+/* Index of one logical cluster, decoded */
+struct z_erofs_maprecorder {
+	struct erofs_inode *inode;
+	struct erofs_map_blocks *map;
+	u8	*kaddr;		/* Metadata block holding the index */
+	u64	lcn;
+	u8	type;
+	u16	clusterofs;
+	u16	delta[2];
+	u32	pblk;
+};
+
+static int z_erofs_fill_inode(struct erofs_inode *inode)
+{
+	struct z_erofs_map_header h;
+	u64 pos;
+	int ret;
+
+	if (inode->z_inited)
+		return 0;
+
+	pos = round_up(erofs_iloc(inode->nid) + inode->inode_isize +
+		       inode->xattr_isize, 8);
+	ret = erofs_dev_read(pos, &h, sizeof(h));
+	if (ret)
+		return ret;
+
+	inode->z_advise = le16_to_cpu(h.h_advise);
+	inode->z_algorithmtype = h.h_algorithmtype & 15;
+	inode->z_lclusterbits = EROFS_BLKSZBITS + (h.h_clusterbits & 7);
+
+	if (inode->z_algorithmtype != Z_EROFS_COMPRESSION_LZ4) {
+		printf("EROFS: unsupported compression %u\n",
+		       inode->z_algorithmtype);
+		return -EOPNOTSUPP;
+	}
+
+	/* Physical clusters are always a single block here */
+	if (inode->z_lclusterbits != EROFS_BLKSZBITS ||
+	    (h.h_clusterbits >> 3) & 0x1f) {
+		printf("EROFS: unsupported cluster size\n");
+		return -EOPNOTSUPP;
+	}
+
+	inode->z_inited = true;
+
+	return 0;
+}
+
+static int z_erofs_reload_indexes(struct z_erofs_maprecorder *m, u64 blk)
+{
+	struct erofs_sb_info *sbi = erofs_sbi;
+	int ret;
+
+	if (sbi->metablk != blk) {
+		ret = erofs_dev_read(blk << EROFS_BLKSZBITS, sbi->metabuf,
+				     EROFS_BLKSIZ);
+		if (ret) {
+			sbi->metablk = -1;
+			return ret;
+		}
+		sbi->metablk = blk;
+	}
+	m->kaddr = sbi->metabuf;
+
+	return 0;
+}
+
+static int legacy_load_cluster_from_disk(struct z_erofs_maprecorder *m,
+					 u64 lcn)
+{
+	struct erofs_inode *inode = m->inode;
+	struct z_erofs_vle_decompressed_index *di;
+	u64 pos = Z_EROFS_VLE_LEGACY_INDEX_ALIGN(erofs_iloc(inode->nid) +
+						 inode->inode_isize +
+						 inode->xattr_isize) +
+		  lcn * sizeof(*di);
+	int ret;
+
+	ret = z_erofs_reload_indexes(m, pos >> EROFS_BLKSZBITS);
+	if (ret)
+		return ret;
+
+	di = (void *)(m->kaddr + (pos & (EROFS_BLKSIZ - 1)));
+	m->lcn = lcn;
+	m->type = le16_to_cpu(di->di_advise) & Z_EROFS_VLE_DI_CLUSTER_TYPE_MASK;
+
+	switch (m->type) {
+	case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+		m->clusterofs = 1 << inode->z_lclusterbits;
+		m->delta[0] = le16_to_cpu(di->di_u.delta[0]);
+		m->delta[1] = le16_to_cpu(di->di_u.delta[1]);
+		break;
+	case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+		m->clusterofs = le16_to_cpu(di->di_clusterofs);
+		m->pblk = le32_to_cpu(di->di_u.blkaddr);
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static unsigned int decode_compactedbits(unsigned int lobits,
+					 unsigned int lomask, u8 *in,
+					 unsigned int pos, u8 *type)
+{
+	const unsigned int v = get_unaligned_le32(in + pos / 8) >> (pos & 7);
+
+	*type = (v >> lobits) & 3;
+
+	return v & lomask;
+}
+
+/*
+ * Compacted indexes come in packs of 2 (4 bytes each) or 16 (2 bytes each)
+ * clusters, sharing the physical block address of the first HEAD at the end
+ * of the pack.
+ */
+static int unpack_compacted_index(struct z_erofs_maprecorder *m,
+				  unsigned int amortizedshift,
+				  unsigned int eofs)
+{
+	const unsigned int lclusterbits = m->inode->z_lclusterbits;
+	const unsigned int lomask = (1 << lclusterbits) - 1;
+	unsigned int vcnt, base, lo, encodebits, nblk;
+	int i;
+	u8 *in, type;
+
+	if (1 << amortizedshift == 4)
+		vcnt = 2;
+	else if (1 << amortizedshift == 2 && lclusterbits == 12)
+		vcnt = 16;
+	else
+		return -EOPNOTSUPP;
+
+	encodebits = ((vcnt << amortizedshift) - sizeof(__le32)) * 8 / vcnt;
+	base = round_down(eofs, vcnt << amortizedshift);
+	in = m->kaddr + base;
+
+	i = (eofs - base) >> amortizedshift;
+
+	lo = decode_compactedbits(lclusterbits, lomask, in, encodebits * i,
+				  &type);
+	m->type = type;
+	if (type == Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD) {
+		m->clusterofs = 1 << lclusterbits;
+		if (i + 1 != vcnt) {
+			m->delta[0] = lo;
+			return 0;
+		}
+		/*
+		 * The last cluster of a pack stores delta[1] instead, get
+		 * delta[0] through the previous cluster.
+		 */
+		lo = decode_compactedbits(lclusterbits, lomask, in,
+					  encodebits * (i - 1), &type);
+		if (type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD)
+			lo = 0;
+		m->delta[0] = lo + 1;
+		return 0;
+	}
+
+	m->clusterofs = lo;
+	m->delta[0] = 0;
+
+	/* Count the HEADs before this one to find its physical block */
+	nblk = 1;
+	while (i > 0) {
+		--i;
+		lo = decode_compactedbits(lclusterbits, lomask, in,
+					  encodebits * i, &type);
+		if (type == Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD)
+			i -= lo;
+
+		if (i >= 0)
+			++nblk;
+	}
+	in += (vcnt << amortizedshift) - sizeof(__le32);
+	m->pblk = get_unaligned_le32(in) + nblk;
+
+	return 0;
+}
+
+static int compacted_load_cluster_from_disk(struct z_erofs_maprecorder *m,
+					    u64 lcn)
+{
+	struct erofs_inode *inode = m->inode;
+	const u64 ebase = round_up(erofs_iloc(inode->nid) + inode->inode_isize +
+				   inode->xattr_isize, 8) +
+			  sizeof(struct z_erofs_map_header);
+	const u64 totalidx = DIV_ROUND_UP(inode->size, EROFS_BLKSIZ);
+	unsigned int compacted_4b_initial, compacted_2b;
+	unsigned int amortizedshift;
+	u64 pos;
+	int ret;
+
+	if (lcn >= totalidx)
+		return -EINVAL;
+
+	m->lcn = lcn;
+
+	/* 4 byte packs until the 2 byte packs are 32 byte aligned */
+	compacted_4b_initial = (32 - ebase % 32) / 4;
+	if (compacted_4b_initial == 32 / 4)
+		compacted_4b_initial = 0;
+
+	if (inode->z_advise & Z_EROFS_ADVISE_COMPACTED_2B &&
+	    totalidx > compacted_4b_initial)
+		compacted_2b = rounddown(totalidx - compacted_4b_initial, 16);
+	else
+		compacted_2b = 0;
+
+	pos = ebase;
+	if (lcn < compacted_4b_initial) {
+		amortizedshift = 2;
+		goto out;
+	}
+	pos += compacted_4b_initial * 4;
+	lcn -= compacted_4b_initial;
+
+	if (lcn < compacted_2b) {
+		amortizedshift = 1;
+		goto out;
+	}
+	pos += compacted_2b * 2;
+	lcn -= compacted_2b;
+	amortizedshift = 2;
+out:
+	pos += lcn * (1 << amortizedshift);
+	ret = z_erofs_reload_indexes(m, pos >> EROFS_BLKSZBITS);
+	if (ret)
+		return ret;
+
+	return unpack_compacted_index(m, amortizedshift,
+				      pos & (EROFS_BLKSIZ - 1));
+}
+
+static int z_erofs_load_cluster_from_disk(struct z_erofs_maprecorder *m,
+					  u64 lcn)
+{
+	if (m->inode->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY)
+		return legacy_load_cluster_from_disk(m, lcn);
+
+	return compacted_load_cluster_from_disk(m, lcn);
+}
+
+/* Walk back from a NONHEAD cluster to the HEAD starting its extent */
+static int z_erofs_extent_lookback(struct z_erofs_maprecorder *m,
+				   unsigned int lookback_distance)
+{
+	struct erofs_map_blocks *map = m->map;
+	u64 lcn = m->lcn;
+	int ret;
+
+	while (1) {
+		if (lcn < lookback_distance)
+			return -EINVAL;
+
+		lcn -= lookback_distance;
+		ret = z_erofs_load_cluster_from_disk(m, lcn);
+		if (ret)
+			return ret;
+
+		switch (m->type) {
+		case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+			if (!m->delta[0])
+				return -EINVAL;
+			lookback_distance = m->delta[0];
+			continue;
+		case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+			map->m_flags &= ~EROFS_MAP_ZIPPED;
+			/* fall through */
+		case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+			map->m_la = (lcn << m->inode->z_lclusterbits) |
+				    m->clusterofs;
+			return 0;
+		default:
+			return -EOPNOTSUPP;
+		}
+	}
+}
+
+/*
+ * Find the extent holding byte map->m_la of the file.
+ */
+static int z_erofs_map_blocks(struct erofs_inode *inode,
+			      struct erofs_map_blocks *map)
+{
+	struct z_erofs_maprecorder m = {
+		.inode = inode,
+		.map = map,
+	};
+	unsigned int lclusterbits, endoff;
+	u64 end;
+	int ret;
+
+	/* Beyond EOF is unmapped */
+	if (map->m_la >= inode->size) {
+		map->m_llen = map->m_la + 1 - inode->size;
+		map->m_la = inode->size;
+		map->m_flags = 0;
+		return 0;
+	}
+
+	ret = z_erofs_fill_inode(inode);
+	if (ret)
+		return ret;
+
+	lclusterbits = inode->z_lclusterbits;
+	endoff = map->m_la & ((1 << lclusterbits) - 1);
+
+	ret = z_erofs_load_cluster_from_disk(&m, map->m_la >> lclusterbits);
+	if (ret)
+		return ret;
+
+	map->m_flags = EROFS_MAP_ZIPPED;
+	end = (m.lcn + 1ULL) << lclusterbits;
+
+	switch (m.type) {
+	case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+		if (endoff >= m.clusterofs)
+			map->m_flags &= ~EROFS_MAP_ZIPPED;
+		/* fall through */
+	case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+		if (endoff >= m.clusterofs) {
+			map->m_la = (m.lcn << lclusterbits) | m.clusterofs;
+			break;
+		}
+		/* The byte belongs to the extent ending at clusterofs */
+		if (!m.lcn)
+			return -EINVAL;
+		end = (m.lcn << lclusterbits) | m.clusterofs;
+		map->m_flags |= EROFS_MAP_FULL_MAPPED;
+		m.delta[0] = 1;
+		/* fall through */
+	case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+		ret = z_erofs_extent_lookback(&m, m.delta[0]);
+		if (ret)
+			return ret;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	map->m_llen = end - map->m_la;
+	map->m_pa = (u64)m.pblk << EROFS_BLKSZBITS;
+	map->m_flags |= EROFS_MAP_MAPPED;
+
+	return 0;
+}
+
+/*
+ * Produce the first 'len' bytes of the extent in 'map' from its physical
+ * cluster, skipping the first 'skip' of them, into 'out'.
+ */
+static int z_erofs_decompress(struct erofs_map_blocks *map, char *out,
+			      u64 skip, u64 len, bool partial)
+{
+	u8 *src = erofs_sbi->pcluster;
+	unsigned int margin = 0;
+	size_t outlen = len;
+	char *dst = out;
+	int ret;
+
+	ret = erofs_dev_read(map->m_pa, src, EROFS_BLKSIZ);
+	if (ret)
+		return ret;
+
+	/* Stored uncompressed, shifted to the start of the cluster */
+	if (!(map->m_flags & EROFS_MAP_ZIPPED)) {
+		if (len > EROFS_BLKSIZ)
+			return -EINVAL;
+		memcpy(out, src + skip, len - skip);
+		return 0;
+	}
+
+	/*
+	 * With 0PADDING the compressed data is right aligned in the cluster,
+	 * ending exactly at the end of it, so the decoder can check that the
+	 * whole input is consumed. Otherwise trailing bytes are padding.
+	 */
+	if (erofs_sbi->feature_incompat & EROFS_FEATURE_INCOMPAT_LZ4_0PADDING) {
+		while (margin < EROFS_BLKSIZ && !src[margin])
+			margin++;
+		if (margin >= EROFS_BLKSIZ)
+			return -EIO;
+	} else {
+		partial = true;
+	}
+
+	/* Only the part before the read position needs a staging buffer */
+	if (skip) {
+		dst = malloc(len);
+		if (!dst)
+			return -ENOMEM;
+	}
+
+	ret = ulz4_block(src + margin, EROFS_BLKSIZ - margin, dst, &outlen,
+			 partial);
+	if (!ret && outlen != len)
+		ret = -EIO;
+
+	if (skip) {
+		if (!ret)
+			memcpy(out, dst + skip, len - skip);
+		free(dst);
+	}
+
+	return ret;
+}
+
+/*
+ * Read 'len' bytes at 'offset' of compressed file 'inode'. Extents are
+ * looked up from the end of the range backwards, since an extent is found
+ * by its last byte, and decompressed straight into place.
+ */
+int z_erofs_read_data(struct erofs_inode *inode, char *buf, u64 len,
+		      u64 offset)
+{
+	struct erofs_map_blocks map;
+	u64 end = offset + len;
+	u64 length, skip;
+	bool partial;
+	int ret;
+
+	while (end > offset) {
+		map.m_la = end - 1;
+
+		ret = z_erofs_map_blocks(inode, &map);
+		if (ret)
+			return ret;
+
+		/* Trim to what was asked for */
+		if (end < map.m_la + map.m_llen) {
+			length = end - map.m_la;
+			partial = true;
+		} else {
+			length = map.m_llen;
+			partial = !(map.m_flags & EROFS_MAP_FULL_MAPPED);
+		}
+
+		if (map.m_la < offset) {
+			skip = offset - map.m_la;
+			end = offset;
+		} else {
+			skip = 0;
+			end = map.m_la;
+		}
+
+		if (!(map.m_flags & EROFS_MAP_MAPPED)) {
+			memset(buf + end - offset, 0, length - skip);
+			continue;
+		}
+
+		ret = z_erofs_decompress(&map, buf + end - offset, skip,
+					 length, partial);
+		if (ret) {
+			printf("EROFS: cannot decompress extent at %llu\n",
+			       map.m_la);
+			return ret;
+		}
+	}
+
+	return 0;
+}
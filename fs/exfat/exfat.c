@@ -0,0 +1,594 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * exfat.c
+ *
+ * R/O exFAT filesystem implementation
+ *
+ * Files and directories are located through their stream extension entry.
+ * When it carries the NoFatChain flag the data occupies consecutive clusters
+ * and is read with a single sequential device read, otherwise the cluster
+ * chain is followed through the FAT and each run of consecutive clusters is
+ * read at once.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <charset.h>
+#include <exfat.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <part.h>
+#include <linux/ctype.h>
+#include <linux/sizes.h>
+
+/* Bytes of the FAT kept in memory by exfat_next_cluster() */
+#define EXFAT_FATBUF_SIZE	SZ_4K
+
+/* Largest single fs_devread(), byte_len is an int */
+#define EXFAT_MAX_DEVREAD	SZ_1G
+
+/* Location of the data of a file or directory */
+struct exfat_node {
+	u32	start;		/* First cluster, 0 if nothing allocated */
+	u64	size;		/* Allocated data length in bytes */
+	u64	valid_size;	/* Bytes that hold data, the rest reads as 0 */
+	u8	flags;		/* EXFAT_SF_x */
+	u16	attr;		/* EXFAT_ATTR_x */
+};
+
+static struct exfat_data {
+	struct blk_desc *dev;
+	disk_partition_t part;
+	u32	fat_sect;	/* Sector of the first FAT */
+	u32	heap_sect;	/* Sector of cluster 2 */
+	u32	cluster_count;
+	u32	root_cluster;
+	u32	serial;
+	int	sect_bits;	/* log2 of bytes/sector */
+	int	clust_bits;	/* log2 of bytes/cluster */
+	u32	*fatbuf;	/* EXFAT_FATBUF_SIZE bytes of the FAT */
+	u32	fatbuf_first;	/* First entry in fatbuf, -1 if empty */
+} *exfat;
+
+/* Read 'len' bytes at byte offset 'pos' of the volume */
+static int exfat_devread(u64 pos, void *buf, u64 len)
+{
+	int log2blksz = exfat->dev->log2blksz;
+
+	while (len) {
+		int n = min_t(u64, len, EXFAT_MAX_DEVREAD);
+
+		if (!fs_devread(exfat->dev, &exfat->part, pos >> log2blksz,
+				pos & (exfat->dev->blksz - 1), n, buf))
+			return -EIO;
+
+		pos += n;
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static inline u64 exfat_clust_to_pos(u32 clust)
+{
+	return ((u64)exfat->heap_sect << exfat->sect_bits) +
+	       ((u64)(clust - EXFAT_FIRST_CLUSTER) << exfat->clust_bits);
+}
+
+static inline bool exfat_clust_valid(u32 clust)
+{
+	return clust >= EXFAT_FIRST_CLUSTER &&
+	       clust < exfat->cluster_count + EXFAT_FIRST_CLUSTER;
+}
+
+/*
+ * Return the cluster following 'clust' in the data of 'node', or
+ * EXFAT_EOF_CLUSTER if there is none.
+ */
+static u32 exfat_next_cluster(struct exfat_node *node, u32 clust)
+{
+	u32 per_buf = EXFAT_FATBUF_SIZE / sizeof(u32);
+	u32 first, next;
+
+	if (node->flags & EXFAT_SF_NO_FAT_CHAIN) {
+		u64 end = node->start +
+			  ((node->size + (1 << exfat->clust_bits) - 1) >>
+			   exfat->clust_bits);
+
+		return clust + 1 < end ? clust + 1 : EXFAT_EOF_CLUSTER;
+	}
+
+	if (!exfat_clust_valid(clust))
+		return EXFAT_EOF_CLUSTER;
+
+	first = clust - clust % per_buf;
+	if (first != exfat->fatbuf_first) {
+		u64 pos = ((u64)exfat->fat_sect << exfat->sect_bits) +
+			  (u64)first * sizeof(u32);
+		u64 len = min_t(u64, per_buf, exfat->cluster_count +
+				EXFAT_FIRST_CLUSTER - first) * sizeof(u32);
+
+		if (exfat_devread(pos, exfat->fatbuf, len)) {
+			exfat->fatbuf_first = -1;
+			return EXFAT_EOF_CLUSTER;
+		}
+		exfat->fatbuf_first = first;
+	}
+
+	next = le32_to_cpu(exfat->fatbuf[clust - first]);
+	if (!exfat_clust_valid(next))
+		return EXFAT_EOF_CLUSTER;
+
+	return next;
+}
+
+/*
+ * Read 'len' bytes at offset 'pos' of the data of 'node' into 'buf'. The
+ * caller makes sure that the range lies within node->size.
+ */
+static int exfat_read_node(struct exfat_node *node, u64 pos, u64 len,
+			   char *buf)
+{
+	u64 clust_size = 1ULL << exfat->clust_bits;
+	u64 valid = min(node->valid_size, node->size);
+	u64 cur = 0;	/* Byte offset of 'clust' in the data */
+	u32 clust = node->start;
+	int ret;
+
+	/* Nothing on disk beyond the valid data length */
+	if (pos + len > valid) {
+		u64 zero_from = max(pos, valid);
+
+		memset(buf + (zero_from - pos), 0, pos + len - zero_from);
+		len = zero_from - pos;
+	}
+
+	if (!len)
+		return 0;
+
+	if (!exfat_clust_valid(clust))
+		return -EINVAL;
+
+	/* Contiguous file, a single read and no chain walk */
+	if (node->flags & EXFAT_SF_NO_FAT_CHAIN) {
+		if (node->start + ((pos + len - 1) >> exfat->clust_bits) >=
+		    exfat->cluster_count + EXFAT_FIRST_CLUSTER)
+			return -EINVAL;
+
+		return exfat_devread(exfat_clust_to_pos(clust) + pos, buf,
+				     len);
+	}
+
+	/* Go to the cluster holding 'pos' */
+	while (cur + clust_size <= pos) {
+		clust = exfat_next_cluster(node, clust);
+		if (clust == EXFAT_EOF_CLUSTER)
+			return -EINVAL;
+		cur += clust_size;
+	}
+
+	while (len) {
+		u32 end = clust, next;
+		u64 run = clust_size, n;
+
+		/* Extend the run over consecutive clusters */
+		while (cur + run < pos + len) {
+			next = exfat_next_cluster(node, end);
+			if (next != end + 1)
+				break;
+			end = next;
+			run += clust_size;
+		}
+
+		n = min(cur + run, pos + len) - pos;
+		ret = exfat_devread(exfat_clust_to_pos(clust) + (pos - cur),
+				    buf, n);
+		if (ret)
+			return ret;
+
+		buf += n;
+		pos += n;
+		len -= n;
+		if (!len)
+			break;
+
+		clust = exfat_next_cluster(node, end);
+		if (clust == EXFAT_EOF_CLUSTER)
+			return -EINVAL;
+		cur += run;
+	}
+
+	return 0;
+}
+
+/*
+ * Load the entries of directory 'node' into a newly allocated buffer.
+ */
+static int exfat_load_dir(struct exfat_node *node, char **bufp, u64 *sizep)
+{
+	char *buf;
+	int ret;
+
+	if (!node->size || node->size > SZ_64M)
+		return -EINVAL;
+
+	buf = malloc(node->size);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = exfat_read_node(node, 0, node->size, buf);
+	if (ret) {
+		free(buf);
+		return ret;
+	}
+
+	*bufp = buf;
+	*sizep = node->size;
+
+	return 0;
+}
+
+/*
+ * Parse the entry set starting at '*pos' of a directory loaded by
+ * exfat_load_dir(). On success fill 'node' and the UTF-8 'name', and leave
+ * '*pos' past the entry set. Return -ENOENT at the end of the directory.
+ */
+static int exfat_next_entry(const char *dir, u64 size, u64 *pos,
+			    struct exfat_node *node, char *name, int name_size)
+{
+	const struct exfat_file_entry *file;
+	const struct exfat_stream_entry *stream;
+	const struct exfat_name_entry *fname;
+	u16 uname[EXFAT_MAX_NAME_LEN + 1];
+	const u16 *src;
+	int count, i, len;
+
+	for (; *pos + sizeof(*file) <= size; *pos += sizeof(*file)) {
+		file = (const struct exfat_file_entry *)(dir + *pos);
+		if (file->type == EXFAT_ENTRY_EOD)
+			return -ENOENT;
+		if (file->type != EXFAT_ENTRY_FILE)
+			continue;
+
+		count = file->secondary_count;
+		if (count < 2 || *pos + (count + 1) * sizeof(*file) > size)
+			continue;
+
+		stream = (const struct exfat_stream_entry *)(file + 1);
+		if (stream->type != EXFAT_ENTRY_STREAM)
+			continue;
+
+		len = stream->name_len;
+		if (count - 1 < DIV_ROUND_UP(len, EXFAT_NAME_PER_ENTRY))
+			continue;
+
+		fname = (const struct exfat_name_entry *)(stream + 1);
+		for (i = 0; i < len; i++)
+			uname[i] = le16_to_cpu(fname[i / EXFAT_NAME_PER_ENTRY].
+					       name[i % EXFAT_NAME_PER_ENTRY]);
+		uname[len] = 0;
+
+		/* Convert to UTF-8, truncating on a code point boundary */
+		src = uname;
+		for (i = 0; *src;) {
+			char utf8[4], *p = utf8;
+			s32 code = utf16_get(&src);
+
+			if (code < 0 || utf8_put(code, &p)) {
+				p = utf8;
+				*p++ = '?';
+			}
+			if (i + (p - utf8) >= name_size)
+				break;
+			memcpy(name + i, utf8, p - utf8);
+			i += p - utf8;
+		}
+		name[i] = '\0';
+
+		node->start = le32_to_cpu(stream->start_cluster);
+		node->size = le64_to_cpu(stream->size);
+		node->valid_size = le64_to_cpu(stream->valid_size);
+		node->flags = stream->flags;
+		node->attr = le16_to_cpu(file->attr);
+
+		*pos += (count + 1) * sizeof(*file);
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * exFAT names compare case insensitively through the volume upcase table.
+ * Only ASCII is folded here, which covers the names used for images.
+ */
+static int exfat_namecmp(const char *a, const char *b, int blen)
+{
+	int i;
+
+	for (i = 0; i < blen; i++) {
+		if (!a[i] || toupper(a[i]) != toupper(b[i]))
+			return 1;
+	}
+
+	return a[i] != '\0';
+}
+
+static void exfat_root_node(struct exfat_node *node)
+{
+	u64 clust_size = 1ULL << exfat->clust_bits;
+	u32 clust = exfat->root_cluster;
+	u32 nclust = 0;
+
+	/* The root directory has no stream entry, its size is its chain */
+	memset(node, 0, sizeof(*node));
+	node->start = clust;
+	node->attr = EXFAT_ATTR_DIR;
+	while (clust != EXFAT_EOF_CLUSTER && nclust < exfat->cluster_count) {
+		nclust++;
+		clust = exfat_next_cluster(node, clust);
+	}
+	node->size = nclust * clust_size;
+	node->valid_size = node->size;
+}
+
+/*
+ * Look up 'path' from the root directory.
+ */
+static int exfat_lookup(const char *path, struct exfat_node *node)
+{
+	char name[256];
+	char *dir;
+	u64 size, pos;
+	int ret;
+
+	if (!exfat)
+		return -ENODEV;
+
+	exfat_root_node(node);
+
+	while (*path) {
+		const char *next;
+		int len;
+
+		while (*path == '/' || *path == '\\')
+			path++;
+		if (!*path)
+			break;
+
+		for (next = path; *next && *next != '/' && *next != '\\';)
+			next++;
+		len = next - path;
+
+		if (!(node->attr & EXFAT_ATTR_DIR))
+			return -ENOTDIR;
+
+		ret = exfat_load_dir(node, &dir, &size);
+		if (ret)
+			return ret;
+
+		for (pos = 0; ; ) {
+			ret = exfat_next_entry(dir, size, &pos, node, name,
+					       sizeof(name));
+			if (ret || !exfat_namecmp(name, path, len))
+				break;
+		}
+		free(dir);
+		if (ret)
+			return ret;
+
+		path = next;
+	}
+
+	return 0;
+}
+
+int exfat_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct exfat_boot_sector *bs;
+	struct exfat_data *data;
+	int ret = -EINVAL;
+
+	exfat_close();
+
+	bs = malloc_cache_aligned(max_t(int, sizeof(*bs), fs_dev_desc->blksz));
+	if (!bs)
+		return -ENOMEM;
+
+	if (!fs_devread(fs_dev_desc, fs_partition, 0, 0, sizeof(*bs),
+			(char *)bs))
+		goto out;
+
+	if (memcmp(bs->fs_name, EXFAT_SIGN, EXFAT_SIGNLEN) ||
+	    le16_to_cpu(bs->signature) != 0xaa55)
+		goto out;
+
+	if (bs->sect_size_bits < 9 || bs->sect_size_bits > 12 ||
+	    bs->sect_size_bits + bs->clust_size_bits > 25 ||
+	    !bs->cluster_count || !bs->fats) {
+		debug("exFAT: invalid boot sector\n");
+		goto out;
+	}
+
+	data = calloc(1, sizeof(*data));
+	if (!data) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	data->fatbuf = malloc_cache_aligned(EXFAT_FATBUF_SIZE);
+	if (!data->fatbuf) {
+		free(data);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	data->dev = fs_dev_desc;
+	data->part = *fs_partition;
+	data->sect_bits = bs->sect_size_bits;
+	data->clust_bits = bs->sect_size_bits + bs->clust_size_bits;
+	data->fat_sect = le32_to_cpu(bs->fat_offset);
+	data->heap_sect = le32_to_cpu(bs->heap_offset);
+	data->cluster_count = le32_to_cpu(bs->cluster_count);
+	data->root_cluster = le32_to_cpu(bs->root_cluster);
+	data->serial = le32_to_cpu(bs->serial);
+	data->fatbuf_first = -1;
+	exfat = data;
+
+	debug("exFAT: fat_sect: %u, heap_sect: %u, clusters: %u, 2^%d bytes\n",
+	      data->fat_sect, data->heap_sect, data->cluster_count,
+	      data->clust_bits);
+
+	ret = 0;
+out:
+	free(bs);
+	return ret;
+}
+
+int exfat_exists(const char *filename)
+{
+	struct exfat_node node;
+
+	return !exfat_lookup(filename, &node);
+}
+
+int exfat_size(const char *filename, loff_t *size)
+{
+	struct exfat_node node;
+	int ret;
+
+	ret = exfat_lookup(filename, &node);
+	if (ret)
+		return ret;
+
+	*size = node.size;
+
+	return 0;
+}
+
+int exfat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
+		    loff_t *actread)
+{
+	struct exfat_node node;
+	int ret;
+
+	*actread = 0;
+
+	ret = exfat_lookup(filename, &node);
+	if (ret)
+		goto out;
+
+	if (node.attr & EXFAT_ATTR_DIR) {
+		ret = -EISDIR;
+		goto out;
+	}
+
+	if (offset >= node.size)
+		return 0;
+
+	if (!len || offset + len > node.size)
+		len = node.size - offset;
+
+	ret = exfat_read_node(&node, offset, len, buf);
+	if (!ret)
+		*actread = len;
+out:
+	if (ret)
+		printf("** Unable to read file %s **\n", filename);
+
+	return ret;
+}
+
+int exfat_uuid(char *uuid_str)
+{
+	if (!exfat)
+		return -ENODEV;
+
+	sprintf(uuid_str, "%04X-%04X", exfat->serial >> 16,
+		exfat->serial & 0xffff);
+
+	return 0;
+}
+
+struct exfat_dir {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	char *buf;
+	u64 size;
+	u64 pos;
+};
+
+int exfat_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct exfat_node node;
+	struct exfat_dir *dir;
+	int ret;
+
+	ret = exfat_lookup(filename, &node);
+	if (ret)
+		return ret;
+
+	if (!(node.attr & EXFAT_ATTR_DIR))
+		return -ENOTDIR;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		return -ENOMEM;
+
+	ret = exfat_load_dir(&node, &dir->buf, &dir->size);
+	if (ret) {
+		free(dir);
+		return ret;
+	}
+
+	*dirsp = (struct fs_dir_stream *)dir;
+
+	return 0;
+}
+
+int exfat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
+{
+	struct exfat_dir *dir = (struct exfat_dir *)dirs;
+	struct fs_dirent *dent = &dir->dirent;
+	struct exfat_node node;
+	int ret;
+
+	memset(dent, 0, sizeof(*dent));
+	ret = exfat_next_entry(dir->buf, dir->size, &dir->pos, &node,
+			       dent->name, sizeof(dent->name));
+	if (ret)
+		return ret;
+
+	if (node.attr & EXFAT_ATTR_DIR) {
+		dent->type = FS_DT_DIR;
+	} else {
+		dent->type = FS_DT_REG;
+		dent->size = node.size;
+	}
+
+	*dentp = dent;
+
+	return 0;
+}
+
+void exfat_closedir(struct fs_dir_stream *dirs)
+{
+	struct exfat_dir *dir = (struct exfat_dir *)dirs;
+
+	free(dir->buf);
+	free(dir);
+}
+
+void exfat_close(void)
+{
+	if (!exfat)
+		return;
+
+	free(exfat->fatbuf);
+	free(exfat);
+	exfat = NULL;
+}
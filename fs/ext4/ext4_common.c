@@ -2163,9 +2163,10 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 					printf("< ? > ");
 					break;
 				}
-				printf("%10u %s\n",
-				       le32_to_cpu(fdiro->inode.size),
-					filename);
+				printf("%10llu %s\n",
+				       (unsigned long long)
+				       ext4fs_isize(&fdiro->inode),
+				       filename);
 			}
 			free(fdiro);
 		}
@@ -2350,7 +2351,7 @@ int ext4fs_open(const char *filename, loff_t *len)
 		if (status == 0)
 			goto fail;
 	}
-	*len = le32_to_cpu(fdiro->inode.size);
+	*len = ext4fs_isize(&fdiro->inode);
 	ext4fs_file = fdiro;
 
 	return 0;
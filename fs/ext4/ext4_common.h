@@ -47,6 +47,20 @@ static inline void *zalloc(size_t size)
 	return p;
 }
 
+/*
+ * The upper 32 bits of the size live in size_high, which only holds them
+ * for regular files (it used to be dir_acl).
+ */
+static inline loff_t ext4fs_isize(const struct ext2_inode *inode)
+{
+	loff_t size = le32_to_cpu(inode->size);
+
+	if ((le16_to_cpu(inode->mode) & FILETYPE_INO_MASK) == FILETYPE_INO_REG)
+		size |= (loff_t)le32_to_cpu(inode->size_high) << 32;
+
+	return size;
+}
+
 int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos, loff_t len,
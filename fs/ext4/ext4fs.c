@@ -25,6 +25,7 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -40,6 +41,176 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/* State of an extent-mapped read of [pos, pos + len) into buf */
+struct ext4fs_extent_read {
+	loff_t pos;
+	loff_t len;
+	char *buf;
+	loff_t done;		/* bytes of buf filled so far, holes included */
+	int log2_fs_blksz;	/* log2 of the filesystem block size */
+	int log2_sect_per_blk;	/* filesystem blocks to device sectors */
+};
+
+/* Largest single ext4fs_devread(), byte_len is an int */
+#define EXT4FS_MAX_DEVREAD	SZ_1G
+
+/* Fill the range up to file offset @end with zeroes (hole or unwritten) */
+static void ext4fs_extent_read_zero(struct ext4fs_extent_read *rd, loff_t end)
+{
+	loff_t n = min(end, rd->pos + rd->len) - (rd->pos + rd->done);
+
+	if (n <= 0)
+		return;
+
+	memset(rd->buf + rd->done, 0, n);
+	rd->done += n;
+}
+
+/*
+ * Copy the part of one leaf extent that overlaps the request, reading the
+ * whole run of blocks at once straight into the destination buffer.
+ */
+static int ext4fs_extent_read_one(struct ext4fs_extent_read *rd,
+				  const struct ext4_extent *ext)
+{
+	unsigned int nblk = le16_to_cpu(ext->ee_len);
+	bool unwritten = nblk > EXT4_EXT_INIT_MAX_LEN;
+	loff_t start, end, cur;
+	u64 pblk;
+
+	if (unwritten)
+		nblk -= EXT4_EXT_INIT_MAX_LEN;
+
+	start = (loff_t)le32_to_cpu(ext->ee_block) << rd->log2_fs_blksz;
+	end = start + ((loff_t)nblk << rd->log2_fs_blksz);
+	cur = rd->pos + rd->done;
+	if (end <= cur)
+		return 0;
+
+	/* Anything between the previous extent and this one is a hole */
+	ext4fs_extent_read_zero(rd, start);
+	if (unwritten) {
+		ext4fs_extent_read_zero(rd, end);
+		return 0;
+	}
+
+	pblk = ((u64)le16_to_cpu(ext->ee_start_hi) << 32) |
+	       le32_to_cpu(ext->ee_start_lo);
+	end = min(end, rd->pos + rd->len);
+
+	for (cur = rd->pos + rd->done; cur < end; cur = rd->pos + rd->done) {
+		loff_t off = cur - start;
+		int n = min_t(loff_t, end - cur, EXT4FS_MAX_DEVREAD);
+		lbaint_t sector;
+
+		sector = (pblk + (off >> rd->log2_fs_blksz)) <<
+			 rd->log2_sect_per_blk;
+		if (!ext4fs_devread(sector,
+				    off & ((1 << rd->log2_fs_blksz) - 1), n,
+				    rd->buf + rd->done))
+			return -EIO;
+
+		rd->done += n;
+	}
+
+	return 0;
+}
+
+/*
+ * Walk the extent tree in logical order, only descending into the index
+ * entries that cover the part of the file still to be read.
+ */
+static int ext4fs_extent_read_node(struct ext4fs_extent_read *rd,
+				   struct ext4_extent_header *eh)
+{
+	int entries = le16_to_cpu(eh->eh_entries);
+	struct ext4_extent_idx *idx;
+	u32 first, last;
+	int i, ret;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC)
+		return -EINVAL;
+
+	if (!eh->eh_depth) {
+		struct ext4_extent *ext = (struct ext4_extent *)(eh + 1);
+
+		for (i = 0; i < entries && rd->done < rd->len; i++) {
+			ret = ext4fs_extent_read_one(rd, &ext[i]);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	idx = (struct ext4_extent_idx *)(eh + 1);
+	for (i = 0; i < entries && rd->done < rd->len; i++) {
+		int blksz = 1 << rd->log2_fs_blksz;
+		struct ext4_extent_header *child;
+		u64 leaf;
+
+		first = (rd->pos + rd->done) >> rd->log2_fs_blksz;
+		last = (rd->pos + rd->len - 1) >> rd->log2_fs_blksz;
+
+		/* The next index starts at or before what we need */
+		if (i + 1 < entries && le32_to_cpu(idx[i + 1].ei_block) <= first)
+			continue;
+		if (le32_to_cpu(idx[i].ei_block) > last)
+			break;
+
+		leaf = ((u64)le16_to_cpu(idx[i].ei_leaf_hi) << 32) |
+		       le32_to_cpu(idx[i].ei_leaf_lo);
+
+		child = zalloc(blksz);
+		if (!child)
+			return -ENOMEM;
+
+		if (!ext4fs_devread(leaf << rd->log2_sect_per_blk, 0, blksz,
+				    (char *)child)) {
+			free(child);
+			return -EIO;
+		}
+
+		ret = ext4fs_extent_read_node(rd, child);
+		free(child);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Extent mapped files are read one extent at a time rather than one block at
+ * a time, so the extent tree is walked once for the whole request instead of
+ * once per block and every extent turns into a single large device read.
+ */
+static int ext4fs_read_file_extents(struct ext2fs_node *node, loff_t pos,
+				    loff_t len, char *buf)
+{
+	struct ext4fs_extent_read rd = {
+		.pos = pos,
+		.len = len,
+		.buf = buf,
+		.log2_fs_blksz = LOG2_BLOCK_SIZE(node->data),
+		.log2_sect_per_blk = LOG2_BLOCK_SIZE(node->data) -
+				     get_fs()->dev_desc->log2blksz,
+	};
+	int ret;
+
+	ret = ext4fs_extent_read_node(&rd, (struct ext4_extent_header *)
+				      node->inode.b.blocks.dir_blocks);
+	if (ret) {
+		printf("invalid extent block\n");
+		return ret;
+	}
+
+	/* Trailing hole */
+	ext4fs_extent_read_zero(&rd, pos + len);
+
+	return 0;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -54,7 +225,7 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
-	unsigned int filesize = le32_to_cpu(node->inode.size);
+	loff_t filesize = ext4fs_isize(&node->inode);
 	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
 	lbaint_t delayed_extent = 0;
@@ -76,6 +247,15 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		return -1;
 	}
 
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		ext_cache_fini(&cache);
+		if (ext4fs_read_file_extents(node, pos, len, buf))
+			return -1;
+
+		*actread = len;
+		return 0;
+	}
+
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
 	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
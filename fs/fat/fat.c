@@ -144,17 +144,85 @@ static void get_name(dir_entry *dirent, char *s_name)
 		*s_name = DELETED_FLAG;
 }
 
-static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, int idx);
 
 #if !CONFIG_IS_ENABLED(FAT_WRITE)
 /* Stub for read only operation */
-int flush_dirty_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, int idx)
 {
 	(void)(mydata);
+	(void)(idx);
 	return 0;
 }
 #endif
 
+/*
+ * Mark all FAT cache windows as unused.
+ */
+static void fat_cache_init(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		mydata->fatwin[i].num = -1;
+		mydata->fatwin[i].stamp = 0;
+		mydata->fatwin[i].dirty = 0;
+	}
+	mydata->fatwin_stamp = 0;
+}
+
+/*
+ * Make FAT window 'bufnum' resident in the FAT cache, reusing the least
+ * recently used window (after writing it back if dirty) on a miss.
+ * Return the index of the cache window or -1 on failure.
+ */
+static int fat_cache_get(fsdata *mydata, __u32 bufnum)
+{
+	struct fat_window *win;
+	__u8 *bufptr;
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i, idx = 0;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		win = &mydata->fatwin[i];
+		if (win->num == (int)bufnum)
+			goto found;
+		/* Unused windows have stamp 0 and are picked first */
+		if (win->stamp < mydata->fatwin[idx].stamp)
+			idx = i;
+	}
+
+	i = idx;
+	win = &mydata->fatwin[i];
+
+	/* Write back the evicted window to the disk */
+	if (flush_fat_window(mydata, i) < 0)
+		return -1;
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	debug("FAT: window %d -> %u\n", i, bufnum);
+
+	bufptr = mydata->fatbuf + i * FATBUFSIZE;
+	if (disk_read(startblock, getsize, bufptr) < 0) {
+		debug("Error reading FAT blocks\n");
+		win->num = -1;
+		win->stamp = 0;
+		return -1;
+	}
+	win->num = bufnum;
+
+found:
+	win->stamp = ++mydata->fatwin_stamp;
+
+	return i;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -164,6 +232,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
+	__u8 *fatbuf;
+	int idx;
 
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		printf("Error: Invalid FAT entry: 0x%08x\n", entry);
@@ -192,42 +262,23 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	idx = fat_cache_get(mydata, bufnum);
+	if (idx < 0)
+		return ret;
+	fatbuf = mydata->fatbuf + idx * FATBUFSIZE;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *)fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *)fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -414,7 +465,8 @@ getit:
 		filesize -= actsize;
 		buffer += actsize;
 
-		curclust = get_fatent(mydata, endclust);
+		/* The run search already looked up the cluster after the run */
+		curclust = newclust;
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
@@ -611,9 +663,8 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
+	fat_cache_init(mydata);
+	mydata->fatbuf = malloc_cache_aligned(FATCACHESIZE);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
@@ -10,11 +10,14 @@
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
+#include <exfat.h>
 #include <fat.h>
 #include <fs.h>
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
+#include <squashfs.h>
+#include <erofs.h>
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
@@ -193,6 +196,28 @@ static struct fstype_info fstypes[] = {
 	},
 #endif
 
+#ifdef CONFIG_FS_EXFAT
+	{
+		.fstype = FS_TYPE_EXFAT,
+		.name = "exfat",
+		.null_dev_desc_ok = false,
+		.probe = exfat_probe,
+		.close = exfat_close,
+		.ls = fs_ls_generic,
+		.exists = exfat_exists,
+		.size = exfat_size,
+		.read = exfat_read_file,
+		.write = fs_write_unsupported,
+		.uuid = exfat_uuid,
+		.opendir = exfat_opendir,
+		.readdir = exfat_readdir,
+		.closedir = exfat_closedir,
+		.unlink = fs_unlink_unsupported,
+		.mkdir = fs_mkdir_unsupported,
+		.ln = fs_ln_unsupported,
+	},
+#endif
+
 #if CONFIG_IS_ENABLED(FS_EXT4)
 	{
 		.fstype = FS_TYPE_EXT,
@@ -273,6 +298,48 @@ static struct fstype_info fstypes[] = {
 		.mkdir = fs_mkdir_unsupported,
 		.ln = fs_ln_unsupported,
 	},
+#endif
+#ifdef CONFIG_FS_SQUASHFS
+	{
+		.fstype = FS_TYPE_SQUASHFS,
+		.name = "squashfs",
+		.null_dev_desc_ok = false,
+		.probe = sqfs_probe,
+		.close = sqfs_close,
+		.ls = fs_ls_generic,
+		.exists = sqfs_exists,
+		.size = sqfs_size,
+		.read = sqfs_read,
+		.write = fs_write_unsupported,
+		.uuid = fs_uuid_unsupported,
+		.opendir = sqfs_opendir,
+		.readdir = sqfs_readdir,
+		.closedir = sqfs_closedir,
+		.unlink = fs_unlink_unsupported,
+		.mkdir = fs_mkdir_unsupported,
+		.ln = fs_ln_unsupported,
+	},
+#endif
+#ifdef CONFIG_FS_EROFS
+	{
+		.fstype = FS_TYPE_EROFS,
+		.name = "erofs",
+		.null_dev_desc_ok = false,
+		.probe = erofs_probe,
+		.close = erofs_close,
+		.ls = fs_ls_generic,
+		.exists = erofs_exists,
+		.size = erofs_size,
+		.read = erofs_read,
+		.write = fs_write_unsupported,
+		.uuid = fs_uuid_unsupported,
+		.opendir = erofs_opendir,
+		.readdir = erofs_readdir,
+		.closedir = erofs_closedir,
+		.unlink = fs_unlink_unsupported,
+		.mkdir = fs_mkdir_unsupported,
+		.ln = fs_ln_unsupported,
+	},
 #endif
 	{
 		.fstype = FS_TYPE_ANY,
@@ -389,13 +456,24 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 	return -1;
 }
 
-static void fs_close(void)
+/* Returns an error if blocks written by the command did not reach the device */
+static int fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
+	int ret = 0;
 
 	info->close();
 
+	/* Leave nothing written only to the block cache behind */
+	if (fs_dev_desc &&
+	    blkcache_flush(fs_dev_desc->if_type, fs_dev_desc->devnum)) {
+		printf("** Unable to write back the block cache **\n");
+		ret = -1;
+	}
+
 	fs_type = FS_TYPE_ANY;
+
+	return ret;
 }
 
 int fs_uuid(char *uuid_str)
@@ -532,7 +610,8 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		printf("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
-	fs_close();
+	if (fs_close())
+		ret = -1;
 
 	return ret;
 }
@@ -598,7 +677,8 @@ int fs_unlink(const char *filename)
 	ret = info->unlink(filename);
 
 	fs_type = FS_TYPE_ANY;
-	fs_close();
+	if (fs_close())
+		ret = -1;
 
 	return ret;
 }
@@ -612,7 +692,8 @@ int fs_mkdir(const char *dirname)
 	ret = info->mkdir(dirname);
 
 	fs_type = FS_TYPE_ANY;
-	fs_close();
+	if (fs_close())
+		ret = -1;
 
 	return ret;
 }
@@ -628,7 +709,8 @@ int fs_ln(const char *fname, const char *target)
 		printf("** Unable to create link %s -> %s **\n", fname, target);
 		ret = -1;
 	}
-	fs_close();
+	if (fs_close())
+		ret = -1;
 
 	return ret;
 }
@@ -0,0 +1,905 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * Everything is read from the block device on demand, so a file can be
+ * loaded out of an image without copying the image into memory first.
+ * Recently used metadata blocks and fragment blocks are kept decompressed
+ * in small caches, since consecutive lookups and the tails of small files
+ * keep hitting the same few blocks. Data blocks fully covered by a read are
+ * decompressed straight into the destination buffer.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <part.h>
+#include <squashfs.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
+
+#include "sqfs_filesystem.h"
+
+#define SQFS_META_CACHE_ENTRIES	8
+#define SQFS_FRAG_CACHE_ENTRIES	3
+
+/* Symbolic links followed and directories descended during a lookup */
+#define SQFS_MAX_SYMLINKS	8
+#define SQFS_MAX_DEPTH		64
+#define SQFS_MAX_TARGET_LEN	4096
+
+/* Largest single fs_devread(), byte_len is an int */
+#define SQFS_MAX_DEVREAD	SZ_1G
+
+struct sqfs_cache_entry {
+	u64	pos;		/* On-disk position of the block, -1 if unused */
+	u64	next;		/* On-disk position of the following block */
+	u32	len;		/* Decompressed length */
+	u32	stamp;		/* Last use, the oldest entry is evicted */
+	u8	*data;
+};
+
+struct sqfs_cache {
+	struct sqfs_cache_entry	entries[SQFS_META_CACHE_ENTRIES];
+	int	count;		/* Entries in use, at most the array size */
+	u32	stamp;		/* Use counter for entries[].stamp */
+};
+
+/* In-memory form of the inode types this driver cares about */
+struct sqfs_inode {
+	u16	type;		/* Basic type, SQFS_DIR_TYPE etc. */
+	u64	size;		/* File size, directory listing size */
+	u64	start;		/* First data block, directory block */
+	u32	offset;		/* Directory offset in its metadata block */
+	u32	frag;		/* Fragment index, SQFS_INVALID_FRAG if none */
+	u32	frag_off;	/* Offset of the file tail in the fragment */
+	u64	list_blk;	/* Metadata position of the block size list */
+	u32	list_off;
+};
+
+/* Directory iterator */
+struct sqfs_dir_iter {
+	u64	blk;		/* Metadata cursor in the directory table */
+	u32	off;
+	u32	remaining;	/* Listing bytes left */
+	u32	count;		/* Entries left under the current header */
+	u32	inode_blk;	/* Inode block of the current header */
+	u64	ref;		/* Inode reference of the current entry */
+	u16	type;		/* Basic type of the current entry */
+	char	name[SQFS_NAME_MAX + 1];
+};
+
+static struct sqfs_ctxt {
+	struct blk_desc *dev;
+	disk_partition_t part;
+	u16	comp;
+	u16	flags;
+	u32	block_size;
+	int	block_log;
+	u32	fragments;
+	u64	bytes_used;
+	u64	root_inode;
+	u64	inode_table;
+	u64	dir_table;
+	u64	frag_table;
+	u8	*cbuf;		/* Compressed block read from the device */
+	u8	*bounce;	/* Data block partially covered by a read */
+	struct sqfs_cache meta;
+	struct sqfs_cache frag;
+} *sqfs;
+
+/* Read 'len' bytes at byte offset 'pos' of the image */
+static int sqfs_devread(u64 pos, void *buf, u64 len)
+{
+	int log2blksz = sqfs->dev->log2blksz;
+
+	while (len) {
+		int n = min_t(u64, len, SQFS_MAX_DEVREAD);
+
+		if (!fs_devread(sqfs->dev, &sqfs->part, pos >> log2blksz,
+				pos & (sqfs->dev->blksz - 1), n, buf))
+			return -EIO;
+
+		pos += n;
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static void sqfs_cache_free(struct sqfs_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+	cache->count = 0;
+}
+
+static int sqfs_cache_init(struct sqfs_cache *cache, int count, u32 size)
+{
+	int i;
+
+	memset(cache, 0, sizeof(*cache));
+	for (i = 0; i < count; i++) {
+		cache->entries[i].pos = -1;
+		cache->entries[i].data = malloc_cache_aligned(size);
+		if (!cache->entries[i].data) {
+			sqfs_cache_free(cache);
+			return -ENOMEM;
+		}
+		cache->count++;
+	}
+
+	return 0;
+}
+
+/*
+ * Return the entry caching the block at 'pos', or the least recently used
+ * entry (with its pos set to -1) for the caller to fill.
+ */
+static struct sqfs_cache_entry *sqfs_cache_get(struct sqfs_cache *cache,
+					       u64 pos, bool *hit)
+{
+	struct sqfs_cache_entry *e, *victim = &cache->entries[0];
+	int i;
+
+	for (i = 0; i < cache->count; i++) {
+		e = &cache->entries[i];
+		if (e->pos == pos) {
+			*hit = true;
+			e->stamp = ++cache->stamp;
+			return e;
+		}
+		if (e->stamp < victim->stamp)
+			victim = e;
+	}
+
+	*hit = false;
+	victim->pos = -1;
+	victim->stamp = ++cache->stamp;
+
+	return victim;
+}
+
+/*
+ * Read the metadata block at 'pos' through the metadata cache.
+ */
+static struct sqfs_cache_entry *sqfs_read_meta(u64 pos)
+{
+	struct sqfs_cache_entry *e;
+	u32 hdr, clen, len;
+	u64 avail;
+	bool hit;
+
+	e = sqfs_cache_get(&sqfs->meta, pos, &hit);
+	if (hit)
+		return e;
+
+	if (pos + SQFS_METADATA_HDR_SIZE > sqfs->bytes_used)
+		return NULL;
+
+	/* Header and block in one go, the block is at most 8 KiB */
+	avail = min_t(u64, sqfs->bytes_used - pos,
+		      SQFS_METADATA_HDR_SIZE + SQFS_METADATA_SIZE);
+	if (sqfs_devread(pos, sqfs->cbuf, avail))
+		return NULL;
+
+	hdr = get_unaligned_le16(sqfs->cbuf);
+	clen = SQFS_METADATA_LEN(hdr);
+	if (clen > SQFS_METADATA_SIZE ||
+	    SQFS_METADATA_HDR_SIZE + clen > avail) {
+		printf("SquashFS: bad metadata block at %llu\n", pos);
+		return NULL;
+	}
+
+	if (hdr & SQFS_METADATA_UNCOMPRESSED) {
+		memcpy(e->data, sqfs->cbuf + SQFS_METADATA_HDR_SIZE, clen);
+		len = clen;
+	} else {
+		len = SQFS_METADATA_SIZE;
+		if (sqfs_decompress(sqfs->comp, e->data, &len,
+				    sqfs->cbuf + SQFS_METADATA_HDR_SIZE,
+				    clen)) {
+			printf("SquashFS: cannot decompress metadata at %llu\n",
+			       pos);
+			return NULL;
+		}
+	}
+
+	e->pos = pos;
+	e->next = pos + SQFS_METADATA_HDR_SIZE + clen;
+	e->len = len;
+
+	return e;
+}
+
+/*
+ * Copy 'len' bytes of a metadata table into 'buf', starting at offset '*off'
+ * of the metadata block at '*blk'. The cursor is advanced past the data.
+ */
+static int sqfs_read_meta_data(u64 *blk, u32 *off, void *buf, u32 len)
+{
+	struct sqfs_cache_entry *e;
+	u32 n;
+
+	while (len) {
+		e = sqfs_read_meta(*blk);
+		if (!e)
+			return -EIO;
+
+		if (*off >= e->len)
+			return -EINVAL;
+
+		n = min(len, e->len - *off);
+		if (buf) {
+			memcpy(buf, e->data + *off, n);
+			buf += n;
+		}
+		len -= n;
+		*off += n;
+
+		if (*off == e->len) {
+			*blk = e->next;
+			*off = 0;
+		}
+	}
+
+	return 0;
+}
+
+static int sqfs_read_inode(u64 ref, struct sqfs_inode *inode)
+{
+	u64 blk = sqfs->inode_table + SQFS_INODE_BLK(ref);
+	u32 off = SQFS_INODE_OFF(ref);
+	struct squashfs_base_inode base;
+	int ret;
+
+	ret = sqfs_read_meta_data(&blk, &off, &base, sizeof(base));
+	if (ret)
+		return ret;
+
+	memset(inode, 0, sizeof(*inode));
+	inode->frag = SQFS_INVALID_FRAG;
+
+	switch (le16_to_cpu(base.inode_type)) {
+	case SQFS_DIR_TYPE: {
+		struct squashfs_dir_inode dir;
+
+		ret = sqfs_read_meta_data(&blk, &off, &dir, sizeof(dir));
+		inode->type = SQFS_DIR_TYPE;
+		inode->size = le16_to_cpu(dir.file_size);
+		inode->start = le32_to_cpu(dir.start_block);
+		inode->offset = le16_to_cpu(dir.offset);
+		break;
+	}
+	case SQFS_LDIR_TYPE: {
+		struct squashfs_ldir_inode dir;
+
+		ret = sqfs_read_meta_data(&blk, &off, &dir, sizeof(dir));
+		inode->type = SQFS_DIR_TYPE;
+		inode->size = le32_to_cpu(dir.file_size);
+		inode->start = le32_to_cpu(dir.start_block);
+		inode->offset = le16_to_cpu(dir.offset);
+		break;
+	}
+	case SQFS_REG_TYPE: {
+		struct squashfs_reg_inode reg;
+
+		ret = sqfs_read_meta_data(&blk, &off, &reg, sizeof(reg));
+		inode->type = SQFS_REG_TYPE;
+		inode->size = le32_to_cpu(reg.file_size);
+		inode->start = le32_to_cpu(reg.start_block);
+		inode->frag = le32_to_cpu(reg.fragment);
+		inode->frag_off = le32_to_cpu(reg.offset);
+		break;
+	}
+	case SQFS_LREG_TYPE: {
+		struct squashfs_lreg_inode reg;
+
+		ret = sqfs_read_meta_data(&blk, &off, &reg, sizeof(reg));
+		inode->type = SQFS_REG_TYPE;
+		inode->size = le64_to_cpu(reg.file_size);
+		inode->start = le64_to_cpu(reg.start_block);
+		inode->frag = le32_to_cpu(reg.fragment);
+		inode->frag_off = le32_to_cpu(reg.offset);
+		break;
+	}
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE: {
+		struct squashfs_symlink_inode sym;
+
+		ret = sqfs_read_meta_data(&blk, &off, &sym, sizeof(sym));
+		inode->type = SQFS_SYMLINK_TYPE;
+		inode->size = le32_to_cpu(sym.symlink_size);
+		break;
+	}
+	default:
+		/* Devices, fifos and sockets have no data to read */
+		inode->type = le16_to_cpu(base.inode_type);
+		break;
+	}
+
+	/* Block size list or symlink target */
+	inode->list_blk = blk;
+	inode->list_off = off;
+
+	return ret;
+}
+
+static int sqfs_dir_open(struct sqfs_inode *dir, struct sqfs_dir_iter *it)
+{
+	if (dir->type != SQFS_DIR_TYPE)
+		return -ENOTDIR;
+
+	memset(it, 0, sizeof(*it));
+	it->blk = sqfs->dir_table + dir->start;
+	it->off = dir->offset;
+	/* The listing size includes the implicit "." and ".." */
+	it->remaining = dir->size > 3 ? dir->size - 3 : 0;
+
+	return 0;
+}
+
+/*
+ * Advance to the next directory entry, -ENOENT at the end of the listing.
+ */
+static int sqfs_dir_next(struct sqfs_dir_iter *it)
+{
+	struct squashfs_dir_entry entry;
+	u32 len;
+	int ret;
+
+	if (!it->count) {
+		struct squashfs_dir_header hdr;
+
+		if (it->remaining < sizeof(hdr))
+			return -ENOENT;
+
+		ret = sqfs_read_meta_data(&it->blk, &it->off, &hdr,
+					  sizeof(hdr));
+		if (ret)
+			return ret;
+		it->remaining -= sizeof(hdr);
+
+		it->count = le32_to_cpu(hdr.count) + 1;
+		it->inode_blk = le32_to_cpu(hdr.start);
+		if (it->count > SQFS_DIR_COUNT_MAX)
+			return -EINVAL;
+	}
+
+	if (it->remaining < sizeof(entry))
+		return -ENOENT;
+
+	ret = sqfs_read_meta_data(&it->blk, &it->off, &entry, sizeof(entry));
+	if (ret)
+		return ret;
+	it->remaining -= sizeof(entry);
+
+	len = le16_to_cpu(entry.size) + 1;
+	if (len > SQFS_NAME_MAX || len > it->remaining)
+		return -EINVAL;
+
+	ret = sqfs_read_meta_data(&it->blk, &it->off, it->name, len);
+	if (ret)
+		return ret;
+	it->name[len] = '\0';
+	it->remaining -= len;
+
+	it->ref = ((u64)it->inode_blk << 16) | le16_to_cpu(entry.offset);
+	it->type = le16_to_cpu(entry.type);
+	if (it->type >= SQFS_LDIR_TYPE)
+		it->type -= SQFS_LDIR_TYPE - SQFS_DIR_TYPE;
+	it->count--;
+
+	return 0;
+}
+
+/*
+ * Resolve 'path' to an inode, following symbolic links.
+ */
+static int sqfs_lookup(const char *path, struct sqfs_inode *inode)
+{
+	u64 stack[SQFS_MAX_DEPTH];
+	struct sqfs_dir_iter it;
+	char *buf, *p, *comp;
+	int depth = 0, links = 0;
+	int ret;
+
+	if (!sqfs)
+		return -ENODEV;
+
+	buf = strdup(path);
+	if (!buf)
+		return -ENOMEM;
+
+	stack[0] = sqfs->root_inode;
+	ret = sqfs_read_inode(stack[0], inode);
+
+	for (p = buf; !ret;) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+
+		comp = p;
+		while (*p && *p != '/')
+			p++;
+		if (*p)
+			*p++ = '\0';
+
+		if (!strcmp(comp, "."))
+			continue;
+
+		if (!strcmp(comp, "..")) {
+			if (depth)
+				depth--;
+			ret = sqfs_read_inode(stack[depth], inode);
+			continue;
+		}
+
+		ret = sqfs_dir_open(inode, &it);
+		while (!ret) {
+			ret = sqfs_dir_next(&it);
+			if (!ret && !strcmp(it.name, comp))
+				break;
+		}
+		if (ret)
+			break;
+
+		ret = sqfs_read_inode(it.ref, inode);
+		if (ret)
+			break;
+
+		if (inode->type == SQFS_SYMLINK_TYPE) {
+			u64 blk = inode->list_blk;
+			u32 off = inode->list_off;
+			size_t rest = strlen(p);
+			char *target;
+
+			if (++links > SQFS_MAX_SYMLINKS ||
+			    inode->size > SQFS_MAX_TARGET_LEN) {
+				ret = -ELOOP;
+				break;
+			}
+
+			/* Continue with target + "/" + remaining path */
+			target = malloc(inode->size + rest + 2);
+			if (!target) {
+				ret = -ENOMEM;
+				break;
+			}
+
+			ret = sqfs_read_meta_data(&blk, &off, target,
+						  inode->size);
+			if (ret) {
+				free(target);
+				break;
+			}
+			target[inode->size] = '/';
+			strcpy(target + inode->size + 1, p);
+
+			free(buf);
+			buf = target;
+			p = buf;
+
+			/* Absolute targets restart from the root */
+			if (*p == '/')
+				depth = 0;
+			ret = sqfs_read_inode(stack[depth], inode);
+			continue;
+		}
+
+		if (inode->type == SQFS_DIR_TYPE) {
+			if (++depth >= SQFS_MAX_DEPTH) {
+				ret = -ELOOP;
+				break;
+			}
+			stack[depth] = it.ref;
+		}
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Decompress the fragment block 'index' through the fragment cache.
+ */
+static struct sqfs_cache_entry *sqfs_read_frag(u32 index)
+{
+	struct squashfs_fragment_entry entry;
+	struct sqfs_cache_entry *e;
+	u64 blk, pos;
+	u32 off, size, len;
+	__le64 ptr;
+	bool hit;
+
+	if (index >= sqfs->fragments)
+		return NULL;
+
+	/* The fragment table is indexed by a list of metadata blocks */
+	if (sqfs_devread(sqfs->frag_table +
+			 (u64)(index / SQFS_FRAGS_PER_BLOCK) * sizeof(ptr),
+			 &ptr, sizeof(ptr)))
+		return NULL;
+
+	blk = le64_to_cpu(ptr);
+	off = (index % SQFS_FRAGS_PER_BLOCK) * sizeof(entry);
+	if (sqfs_read_meta_data(&blk, &off, &entry, sizeof(entry)))
+		return NULL;
+
+	pos = le64_to_cpu(entry.start_block);
+	size = le32_to_cpu(entry.size);
+
+	e = sqfs_cache_get(&sqfs->frag, pos, &hit);
+	if (hit)
+		return e;
+
+	len = SQFS_BLOCK_SIZE(size);
+	if (len > sqfs->block_size)
+		return NULL;
+
+	if (size & SQFS_BLOCK_UNCOMPRESSED) {
+		if (sqfs_devread(pos, e->data, len))
+			return NULL;
+	} else {
+		if (sqfs_devread(pos, sqfs->cbuf, len))
+			return NULL;
+
+		size = len;
+		len = sqfs->block_size;
+		if (sqfs_decompress(sqfs->comp, e->data, &len, sqfs->cbuf,
+				    size)) {
+			printf("SquashFS: cannot decompress fragment %u\n",
+			       index);
+			return NULL;
+		}
+	}
+
+	e->pos = pos;
+	e->len = len;
+
+	return e;
+}
+
+/*
+ * Read 'len' bytes at offset 'pos' of regular file 'inode' into 'buf'. The
+ * caller makes sure that the range lies within the file.
+ */
+static int sqfs_read_data(struct sqfs_inode *inode, u64 pos, u64 len,
+			  char *buf)
+{
+	u32 bs = sqfs->block_size;
+	u64 end = pos + len;
+	u64 nblocks, first, last, i;
+	u64 blk = inode->list_blk;
+	u32 off = inode->list_off;
+	u64 data = inode->start;
+	int ret;
+
+	if (inode->frag == SQFS_INVALID_FRAG)
+		nblocks = DIV_ROUND_UP(inode->size, bs);
+	else
+		nblocks = inode->size >> sqfs->block_log;
+
+	first = pos >> sqfs->block_log;
+	last = (end - 1) >> sqfs->block_log;
+
+	for (i = 0; i < nblocks && i <= last; i++) {
+		u64 bstart = i << sqfs->block_log;
+		u64 bend = min(bstart + bs, inode->size);
+		u64 from = max(pos, bstart), to = min(end, bend);
+		char *dst = buf + (from - pos);
+		bool whole = from == bstart && to == bend;
+		__le32 raw;
+		u32 size, clen, dlen;
+
+		ret = sqfs_read_meta_data(&blk, &off, &raw, sizeof(raw));
+		if (ret)
+			return ret;
+
+		size = le32_to_cpu(raw);
+		clen = SQFS_BLOCK_SIZE(size);
+		if (clen > bs)
+			return -EINVAL;
+
+		if (i < first) {
+			data += clen;
+			continue;
+		}
+
+		if (!clen) {
+			/* Sparse block */
+			memset(dst, 0, to - from);
+		} else if (size & SQFS_BLOCK_UNCOMPRESSED) {
+			ret = sqfs_devread(data + (from - bstart), dst,
+					   to - from);
+			if (ret)
+				return ret;
+		} else {
+			ret = sqfs_devread(data, sqfs->cbuf, clen);
+			if (ret)
+				return ret;
+
+			/* No bounce when the read covers the whole block */
+			dlen = bend - bstart;
+			ret = sqfs_decompress(sqfs->comp,
+					      whole ? dst : (char *)sqfs->bounce,
+					      &dlen, sqfs->cbuf, clen);
+			if (ret || dlen != bend - bstart) {
+				printf("SquashFS: cannot decompress block %llu\n",
+				       i);
+				return -EINVAL;
+			}
+
+			if (!whole)
+				memcpy(dst, sqfs->bounce + (from - bstart),
+				       to - from);
+		}
+
+		data += clen;
+	}
+
+	/* The file tail lives in a fragment */
+	if (last >= nblocks) {
+		u64 fstart = nblocks << sqfs->block_log;
+		u64 from = max(pos, fstart);
+		struct sqfs_cache_entry *e;
+
+		if (inode->frag == SQFS_INVALID_FRAG)
+			return -EINVAL;
+
+		e = sqfs_read_frag(inode->frag);
+		if (!e)
+			return -EIO;
+
+		if (inode->frag_off + (end - fstart) > e->len)
+			return -EINVAL;
+
+		memcpy(buf + (from - pos),
+		       e->data + inode->frag_off + (from - fstart), end - from);
+	}
+
+	return 0;
+}
+
+int sqfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct squashfs_super_block *sblk;
+	struct sqfs_ctxt *ctxt;
+	u32 cbuf_size;
+	int ret = -EINVAL;
+
+	sqfs_close();
+
+	sblk = malloc_cache_aligned(max_t(int, sizeof(*sblk),
+					  fs_dev_desc->blksz));
+	if (!sblk)
+		return -ENOMEM;
+
+	if (!fs_devread(fs_dev_desc, fs_partition, 0, 0, sizeof(*sblk),
+			(char *)sblk))
+		goto out;
+
+	if (le32_to_cpu(sblk->s_magic) != SQFS_MAGIC)
+		goto out;
+
+	if (le16_to_cpu(sblk->s_major) != SQFS_MAJOR ||
+	    le16_to_cpu(sblk->block_log) < SQFS_MIN_BLOCK_LOG ||
+	    le16_to_cpu(sblk->block_log) > SQFS_MAX_BLOCK_LOG ||
+	    le32_to_cpu(sblk->block_size) !=
+	    1 << le16_to_cpu(sblk->block_log)) {
+		printf("SquashFS: unsupported version or block size\n");
+		goto out;
+	}
+
+	ctxt = calloc(1, sizeof(*ctxt));
+	if (!ctxt) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ctxt->dev = fs_dev_desc;
+	ctxt->part = *fs_partition;
+	ctxt->comp = le16_to_cpu(sblk->compression);
+	ctxt->flags = le16_to_cpu(sblk->flags);
+	ctxt->block_size = le32_to_cpu(sblk->block_size);
+	ctxt->block_log = le16_to_cpu(sblk->block_log);
+	ctxt->fragments = le32_to_cpu(sblk->fragments);
+	ctxt->bytes_used = le64_to_cpu(sblk->bytes_used);
+	ctxt->root_inode = le64_to_cpu(sblk->root_inode);
+	ctxt->inode_table = le64_to_cpu(sblk->inode_table_start);
+	ctxt->dir_table = le64_to_cpu(sblk->directory_table_start);
+	ctxt->frag_table = le64_to_cpu(sblk->fragment_table_start);
+
+	ret = sqfs_decompressor_init(ctxt->comp);
+	if (ret)
+		goto out_ctxt;
+
+	cbuf_size = max_t(u32, ctxt->block_size,
+			  SQFS_METADATA_HDR_SIZE + SQFS_METADATA_SIZE);
+	ctxt->cbuf = malloc_cache_aligned(cbuf_size);
+	ctxt->bounce = malloc_cache_aligned(ctxt->block_size);
+	if (!ctxt->cbuf || !ctxt->bounce) {
+		ret = -ENOMEM;
+		goto out_bufs;
+	}
+
+	ret = sqfs_cache_init(&ctxt->meta, SQFS_META_CACHE_ENTRIES,
+			      SQFS_METADATA_SIZE);
+	if (ret)
+		goto out_bufs;
+
+	ret = sqfs_cache_init(&ctxt->frag, SQFS_FRAG_CACHE_ENTRIES,
+			      ctxt->block_size);
+	if (ret)
+		goto out_meta;
+
+	sqfs = ctxt;
+
+	debug("SquashFS: %llu bytes, block size %u, compression %u\n",
+	      ctxt->bytes_used, ctxt->block_size, ctxt->comp);
+
+	free(sblk);
+	return 0;
+
+out_meta:
+	sqfs_cache_free(&ctxt->meta);
+out_bufs:
+	free(ctxt->bounce);
+	free(ctxt->cbuf);
+	sqfs_decompressor_cleanup();
+out_ctxt:
+	free(ctxt);
+out:
+	free(sblk);
+	return ret;
+}
+
+int sqfs_exists(const char *filename)
+{
+	struct sqfs_inode inode;
+
+	return !sqfs_lookup(filename, &inode);
+}
+
+int sqfs_size(const char *filename, loff_t *size)
+{
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+
+	*size = inode.size;
+
+	return 0;
+}
+
+int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	      loff_t *actread)
+{
+	struct sqfs_inode inode;
+	int ret;
+
+	*actread = 0;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		goto out;
+
+	if (inode.type != SQFS_REG_TYPE) {
+		ret = -EISDIR;
+		goto out;
+	}
+
+	if (offset >= inode.size)
+		return 0;
+
+	if (!len || offset + len > inode.size)
+		len = inode.size - offset;
+
+	ret = sqfs_read_data(&inode, offset, len, buf);
+	if (!ret)
+		*actread = len;
+out:
+	if (ret)
+		printf("** Unable to read file %s **\n", filename);
+
+	return ret;
+}
+
+struct sqfs_dir_stream {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	struct sqfs_dir_iter it;
+};
+
+int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct sqfs_dir_stream *dir;
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		return -ENOMEM;
+
+	ret = sqfs_dir_open(&inode, &dir->it);
+	if (ret) {
+		free(dir);
+		return ret;
+	}
+
+	*dirsp = (struct fs_dir_stream *)dir;
+
+	return 0;
+}
+
+int sqfs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
+{
+	struct sqfs_dir_stream *dir = (struct sqfs_dir_stream *)dirs;
+	struct fs_dirent *dent = &dir->dirent;
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_dir_next(&dir->it);
+	if (ret)
+		return ret;
+
+	memset(dent, 0, sizeof(*dent));
+	strlcpy(dent->name, dir->it.name, sizeof(dent->name));
+
+	switch (dir->it.type) {
+	case SQFS_DIR_TYPE:
+		dent->type = FS_DT_DIR;
+		break;
+	case SQFS_SYMLINK_TYPE:
+		dent->type = FS_DT_LNK;
+		break;
+	case SQFS_REG_TYPE:
+		dent->type = FS_DT_REG;
+		ret = sqfs_read_inode(dir->it.ref, &inode);
+		if (ret)
+			return ret;
+		dent->size = inode.size;
+		break;
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+
+	*dentp = dent;
+
+	return 0;
+}
+
+void sqfs_closedir(struct fs_dir_stream *dirs)
+{
+	free(dirs);
+}
+
+void sqfs_close(void)
+{
+	if (!sqfs)
+		return;
+
+	sqfs_cache_free(&sqfs->frag);
+	sqfs_cache_free(&sqfs->meta);
+	free(sqfs->bounce);
+	free(sqfs->cbuf);
+	sqfs_decompressor_cleanup();
+	free(sqfs);
+	sqfs = NULL;
+}
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * Block decompression, on top of the decompressors already in lib/
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/lzo.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+#if CONFIG_IS_ENABLED(LZMA)
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <lzma/LzmaTools.h>
+#endif
+
+#include "sqfs_filesystem.h"
+
+static void *zstd_workspace;
+
+static int sqfs_zlib_decompress(void *dest, u32 *dest_len, const void *src,
+				u32 src_len)
+{
+	z_stream stream;
+	int ret;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.next_in = (u8 *)src;
+	stream.avail_in = src_len;
+	stream.next_out = dest;
+	stream.avail_out = *dest_len;
+
+	/* SquashFS uses the zlib format, header and adler32 included */
+	if (inflateInit(&stream) != Z_OK)
+		return -EINVAL;
+
+	ret = inflate(&stream, Z_FINISH);
+	*dest_len = stream.total_out;
+	inflateEnd(&stream);
+
+	return ret == Z_STREAM_END ? 0 : -EINVAL;
+}
+
+static int sqfs_lzo_decompress(void *dest, u32 *dest_len, const void *src,
+			       u32 src_len)
+{
+	size_t len = *dest_len;
+	int ret;
+
+	ret = lzo1x_decompress_safe(src, src_len, dest, &len);
+	*dest_len = len;
+
+	return ret == LZO_E_OK ? 0 : -EINVAL;
+}
+
+static int sqfs_zstd_decompress(void *dest, u32 *dest_len, const void *src,
+				u32 src_len)
+{
+	ZSTD_DCtx *ctx;
+	size_t ret;
+
+	ctx = ZSTD_initDCtx(zstd_workspace, ZSTD_DCtxWorkspaceBound());
+	if (!ctx)
+		return -EINVAL;
+
+	ret = ZSTD_decompressDCtx(ctx, dest, *dest_len, src, src_len);
+	if (ZSTD_isError(ret))
+		return -EINVAL;
+
+	*dest_len = ret;
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(LZMA)
+/* Legacy LZMA blocks carry the .lzma header, properties and length */
+static int sqfs_lzma_decompress(void *dest, u32 *dest_len, const void *src,
+				u32 src_len)
+{
+	SizeT len = *dest_len;
+	int ret;
+
+	ret = lzmaBuffToBuffDecompress(dest, &len, (unsigned char *)src,
+				       src_len);
+	*dest_len = len;
+
+	return ret == SZ_OK ? 0 : -EINVAL;
+}
+#endif
+
+int sqfs_decompressor_init(u16 comp)
+{
+	switch (comp) {
+	case SQFS_COMP_ZLIB:
+	case SQFS_COMP_LZO:
+#if CONFIG_IS_ENABLED(LZMA)
+	case SQFS_COMP_LZMA:
+#endif
+		return 0;
+	case SQFS_COMP_ZSTD:
+		zstd_workspace = malloc(ZSTD_DCtxWorkspaceBound());
+		return zstd_workspace ? 0 : -ENOMEM;
+	default:
+		printf("SquashFS: unsupported compression type %u\n", comp);
+		return -EOPNOTSUPP;
+	}
+}
+
+void sqfs_decompressor_cleanup(void)
+{
+	free(zstd_workspace);
+	zstd_workspace = NULL;
+}
+
+/*
+ * Decompress 'src_len' bytes of 'src' into 'dest'. On entry '*dest_len' is
+ * the room in 'dest', on success it is the decompressed length.
+ */
+int sqfs_decompress(u16 comp, void *dest, u32 *dest_len, const void *src,
+		    u32 src_len)
+{
+	switch (comp) {
+	case SQFS_COMP_ZLIB:
+		return sqfs_zlib_decompress(dest, dest_len, src, src_len);
+	case SQFS_COMP_LZO:
+		return sqfs_lzo_decompress(dest, dest_len, src, src_len);
+	case SQFS_COMP_ZSTD:
+		return sqfs_zstd_decompress(dest, dest_len, src, src_len);
+#if CONFIG_IS_ENABLED(LZMA)
+	case SQFS_COMP_LZMA:
+		return sqfs_lzma_decompress(dest, dest_len, src, src_len);
+#endif
+	default:
+		return -EOPNOTSUPP;
+	}
+}
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * On-disk layout of SquashFS 4.0, all fields are little endian.
+ */
+
+#ifndef __SQFS_FILESYSTEM_H__
+#define __SQFS_FILESYSTEM_H__
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+#define SQFS_MAGIC			0x73717368	/* "hsqs" */
+#define SQFS_MAJOR			4
+
+/* Metadata blocks hold up to 8 KiB behind a 16 bit length header */
+#define SQFS_METADATA_SIZE		8192
+#define SQFS_METADATA_HDR_SIZE		2
+#define SQFS_METADATA_UNCOMPRESSED	BIT(15)
+#define SQFS_METADATA_LEN(h)		(((h) & ~SQFS_METADATA_UNCOMPRESSED) ?\
+					 (h) & ~SQFS_METADATA_UNCOMPRESSED : \
+					 SQFS_METADATA_UNCOMPRESSED)
+
+/* Data block and fragment sizes, 0 for a sparse data block */
+#define SQFS_BLOCK_UNCOMPRESSED		BIT(24)
+#define SQFS_BLOCK_SIZE(s)		((s) & ~SQFS_BLOCK_UNCOMPRESSED)
+
+#define SQFS_MIN_BLOCK_LOG		12
+#define SQFS_MAX_BLOCK_LOG		20
+
+#define SQFS_INVALID_FRAG		0xffffffff
+#define SQFS_FRAGS_PER_BLOCK		(SQFS_METADATA_SIZE / \
+					 sizeof(struct squashfs_fragment_entry))
+
+#define SQFS_NAME_MAX			256
+#define SQFS_DIR_COUNT_MAX		256
+
+/* Inode references are (metadata block << 16 | offset in block) */
+#define SQFS_INODE_BLK(ref)		((u32)((ref) >> 16))
+#define SQFS_INODE_OFF(ref)		((u32)((ref) & 0xffff))
+
+/* Superblock flags */
+#define SQFS_NOI			BIT(0)	/* Uncompressed inodes */
+#define SQFS_NOD			BIT(1)	/* Uncompressed data */
+#define SQFS_NOF			BIT(3)	/* Uncompressed fragments */
+#define SQFS_NO_FRAG			BIT(4)	/* No fragments */
+#define SQFS_COMP_OPT			BIT(10)	/* Compressor options */
+
+enum squashfs_compression {
+	SQFS_COMP_ZLIB = 1,
+	SQFS_COMP_LZMA = 2,
+	SQFS_COMP_LZO = 3,
+	SQFS_COMP_XZ = 4,
+	SQFS_COMP_LZ4 = 5,
+	SQFS_COMP_ZSTD = 6,
+};
+
+enum squashfs_inode_type {
+	SQFS_DIR_TYPE = 1,
+	SQFS_REG_TYPE = 2,
+	SQFS_SYMLINK_TYPE = 3,
+	SQFS_BLKDEV_TYPE = 4,
+	SQFS_CHRDEV_TYPE = 5,
+	SQFS_FIFO_TYPE = 6,
+	SQFS_SOCKET_TYPE = 7,
+	SQFS_LDIR_TYPE = 8,
+	SQFS_LREG_TYPE = 9,
+	SQFS_LSYMLINK_TYPE = 10,
+	SQFS_LBLKDEV_TYPE = 11,
+	SQFS_LCHRDEV_TYPE = 12,
+	SQFS_LFIFO_TYPE = 13,
+	SQFS_LSOCKET_TYPE = 14,
+};
+
+struct squashfs_super_block {
+	__le32 s_magic;
+	__le32 inodes;
+	__le32 mkfs_time;
+	__le32 block_size;
+	__le32 fragments;
+	__le16 compression;
+	__le16 block_log;
+	__le16 flags;
+	__le16 no_ids;
+	__le16 s_major;
+	__le16 s_minor;
+	__le64 root_inode;
+	__le64 bytes_used;
+	__le64 id_table_start;
+	__le64 xattr_id_table_start;
+	__le64 inode_table_start;
+	__le64 directory_table_start;
+	__le64 fragment_table_start;
+	__le64 export_table_start;
+} __packed;
+
+struct squashfs_base_inode {
+	__le16 inode_type;
+	__le16 mode;
+	__le16 uid;
+	__le16 guid;
+	__le32 mtime;
+	__le32 inode_number;
+} __packed;
+
+struct squashfs_dir_inode {
+	__le32 start_block;
+	__le32 nlink;
+	__le16 file_size;
+	__le16 offset;
+	__le32 parent_inode;
+} __packed;
+
+struct squashfs_ldir_inode {
+	__le32 nlink;
+	__le32 file_size;
+	__le32 start_block;
+	__le32 parent_inode;
+	__le16 i_count;
+	__le16 offset;
+	__le32 xattr;
+} __packed;
+
+/* Followed by the block size list */
+struct squashfs_reg_inode {
+	__le32 start_block;
+	__le32 fragment;
+	__le32 offset;
+	__le32 file_size;
+} __packed;
+
+/* Followed by the block size list */
+struct squashfs_lreg_inode {
+	__le64 start_block;
+	__le64 file_size;
+	__le64 sparse;
+	__le32 nlink;
+	__le32 fragment;
+	__le32 offset;
+	__le32 xattr;
+} __packed;
+
+/* Followed by the target, not NUL terminated */
+struct squashfs_symlink_inode {
+	__le32 nlink;
+	__le32 symlink_size;
+} __packed;
+
+struct squashfs_dir_header {
+	__le32 count;		/* Entries following, minus one */
+	__le32 start;		/* Inode metadata block of the entries */
+	__le32 inode_number;
+} __packed;
+
+/* Followed by size + 1 bytes of name */
+struct squashfs_dir_entry {
+	__le16 offset;
+	__le16 inode_number;
+	__le16 type;
+	__le16 size;
+} __packed;
+
+struct squashfs_fragment_entry {
+	__le64 start_block;
+	__le32 size;
+	__le32 unused;
+} __packed;
+
+/* sqfs_decompressor.c */
+int sqfs_decompressor_init(u16 comp);
+void sqfs_decompressor_cleanup(void);
+int sqfs_decompress(u16 comp, void *dest, u32 *dest_len, const void *src,
+		    u32 src_len);
+
+#endif /* __SQFS_FILESYSTEM_H__ */
@@ -8,6 +8,7 @@
 #define _AHCI_H_
 
 #include <pci.h>
+#include <linux/list.h>
 
 #define AHCI_PCI_BAR		0x24
 #define AHCI_MAX_SG		56 /* hardware max is 64K */
@@ -35,6 +36,9 @@
 #define HOST_VERSION		0x10 /* AHCI spec. version compliancy */
 #define HOST_CAP2		0x24 /* host capabilities, extended */
 
+/* HOST_CAP bits */
+#define HOST_CAP_NCQ		(1 << 30) /* native command queuing */
+
 /* HOST_CTL bits */
 #define HOST_RESET		(1 << 0)  /* reset controller; self-clear */
 #define HOST_IRQ_EN		(1 << 1)  /* global IRQ enable */
@@ -139,6 +143,12 @@ struct ahci_ioports {
 	struct ahci_sg		*cmd_tbl_sg;
 	ulong	cmd_tbl;
 	u32	rx_fis;
+	u32	ncq_depth;	/* NCQ tags in use, 0 if NCQ is not used */
+	struct list_head reqs;	/* NCQ block requests not yet completed */
+	u32	busy;		/* NCQ tags in flight */
+	ulong	last_progress;	/* get_timer() when a tag last finished */
+	struct blk_request *tag_req[AHCI_MAX_CMD_SLOT];
+	u64	tag_lba[AHCI_MAX_CMD_SLOT];
 };
 
 /**
@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -112,42 +113,84 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/* Device accessors used by the block cache */
+typedef ulong (*blkcache_read_t)(struct blk_desc *block_dev, lbaint_t start,
+				 lbaint_t blkcnt, void *buffer);
+typedef ulong (*blkcache_write_t)(struct blk_desc *block_dev, lbaint_t start,
+				  lbaint_t blkcnt, const void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 /**
- * blkcache_read() - attempt to read a set of blocks from cache
+ * blkcache_dread() - read a set of blocks through the block cache
  *
- * @param iftype - IF_TYPE_x for type of device
- * @param dev - device index of particular type
+ * Cached blocks are copied from the cache and the others are read with
+ * @read, filling the cache. Sequential reads also read ahead into the cache.
+ *
+ * @param block_dev - block device
  * @param start - starting block number
  * @param blkcnt - number of blocks to read
- * @param blksz - size in bytes of each block
- * @param buf - buffer to contain cached data
+ * @param buffer - buffer to contain the data
+ * @param read - function reading blocks from the device
+ *
+ * @return - number of blocks read
+ */
+ulong blkcache_dread(struct blk_desc *block_dev, lbaint_t start,
+		     lbaint_t blkcnt, void *buffer, blkcache_read_t read);
+
+/**
+ * blkcache_dwrite() - write a set of blocks through the block cache
+ *
+ * With CONFIG_BLOCK_CACHE_WRITEBACK the data may stay in the cache until
+ * blkcache_flush(), blkcache_flush_all() or blkcache_invalidate() is
+ * called or the entry is evicted. Otherwise it is written with @write and the cache is updated.
+ *
+ * @param block_dev - block device
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param buffer - buffer containing the data
+ * @param write - function writing blocks to the device
  *
- * @return - '1' if block returned from cache, '0' otherwise.
+ * @return - number of blocks written
  */
-int blkcache_read(int iftype, int dev,
-		  lbaint_t start, lbaint_t blkcnt,
-		  unsigned long blksz, void *buffer);
+ulong blkcache_dwrite(struct blk_desc *block_dev, lbaint_t start,
+		      lbaint_t blkcnt, const void *buffer,
+		      blkcache_write_t write);
 
 /**
- * blkcache_fill() - make data read from a block device available
- * to the block cache
+ * blkcache_discard() - discard the cache for a range of blocks, e.g.
+ * because they are erased
+ *
+ * @param block_dev - block device
+ * @param start - starting block number
+ * @param blkcnt - number of blocks
+ */
+void blkcache_discard(struct blk_desc *block_dev, lbaint_t start,
+		      lbaint_t blkcnt);
+
+/**
+ * blkcache_flush() - write back the blocks of a device held in the cache
  *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
- * @param start - starting block number
- * @param blkcnt - number of blocks available
- * @param blksz - size in bytes of each block
- * @param buf - buffer containing data to cache
  *
+ * @return - 0 if OK, -EIO if some blocks could not be written
+ */
+int blkcache_flush(int iftype, int dev);
+
+/**
+ * blkcache_flush_all() - write back the cached blocks of all devices
+ *
+ * This is for the points where U-Boot hands over or restarts, e.g. boot
+ * and reset, after which nothing held in the cache would reach a device.
+ *
+ * @return - 0 if OK, -EIO if some blocks could not be written
  */
-void blkcache_fill(int iftype, int dev,
-		   lbaint_t start, lbaint_t blkcnt,
-		   unsigned long blksz, void const *buffer);
+int blkcache_flush_all(void);
 
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
- * because of a write or device (re)initialization.
+ * because of device (re)initialization. Blocks not written back yet are
+ * written first.
  *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
@@ -157,20 +200,32 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
+ * @param blocks - blocks per entry
  * @param entries - maximum entries in cache
+ * @param readahead - maximum blocks to read ahead, 0 to disable
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned blocks, unsigned entries,
+			unsigned readahead);
 
 /*
  * statistics of the block cache
  */
 struct block_cache_stats {
 	unsigned hits;
+	unsigned partial_hits;
 	unsigned misses;
+	unsigned evictions;
 	unsigned entries; /* current entry count */
+	unsigned entries_dirty; /* entries not written back yet */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned max_readahead;
+	/* counts in blocks */
+	lbaint_t blocks_read; /* read from the device, including read-ahead */
+	lbaint_t readahead;
+	lbaint_t readahead_hits;
+	lbaint_t readahead_wasted; /* evicted before being used */
+	lbaint_t written_back;
 };
 
 /**
@@ -182,16 +237,32 @@ void blkcache_stats(struct block_cache_stats *stats);
 
 #else
 
-static inline int blkcache_read(int iftype, int dev,
-				lbaint_t start, lbaint_t blkcnt,
-				unsigned long blksz, void *buffer)
+static inline ulong blkcache_dread(struct blk_desc *block_dev, lbaint_t start,
+				   lbaint_t blkcnt, void *buffer,
+				   blkcache_read_t read)
+{
+	return read(block_dev, start, blkcnt, buffer);
+}
+
+static inline ulong blkcache_dwrite(struct blk_desc *block_dev,
+				    lbaint_t start, lbaint_t blkcnt,
+				    const void *buffer, blkcache_write_t write)
+{
+	return write(block_dev, start, blkcnt, buffer);
+}
+
+static inline void blkcache_discard(struct blk_desc *block_dev,
+				    lbaint_t start, lbaint_t blkcnt) {}
+
+static inline int blkcache_flush(int iftype, int dev)
 {
 	return 0;
 }
 
-static inline void blkcache_fill(int iftype, int dev,
-				 lbaint_t start, lbaint_t blkcnt,
-				 unsigned long blksz, void const *buffer) {}
+static inline int blkcache_flush_all(void)
+{
+	return 0;
+}
 
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
@@ -199,6 +270,55 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
+struct blk_request;
+
+/**
+ * typedef blk_req_done_t - completion callback of a block request
+ *
+ * @req:	Request which has completed, see its @result
+ */
+typedef void (*blk_req_done_t)(struct blk_request *req);
+
+/**
+ * struct blk_request - a read or write submitted with blk_submit()
+ *
+ * The caller fills in the first fields, then the request belongs to the
+ * driver until it completes. It must stay valid (not on a stack frame which
+ * returns) and its buffer must not be touched until then.
+ *
+ * @dev:	Block device to access
+ * @write:	true to write, false to read
+ * @start:	First block
+ * @blkcnt:	Number of blocks
+ * @buffer:	Data buffer, which should be cache-aligned
+ * @done:	Called once the request has completed, or NULL
+ * @priv:	For use by the caller, e.g. in @done
+ * @result:	Set on completion to the number of blocks transferred (which
+ *		may be less than @blkcnt if the transfer failed part-way), or
+ *		-ve error
+ * @complete:	Set once the request has completed
+ * @node:	Private to the driver, e.g. to queue the request
+ * @issued:	Private to the driver, e.g. blocks sent to the device
+ * @good:	Private to the driver, e.g. blocks before the first failure
+ * @inflight:	Private to the driver, e.g. device commands in flight
+ */
+struct blk_request {
+	struct udevice *dev;
+	bool write;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	blk_req_done_t done;
+	void *priv;
+
+	long result;
+	bool complete;
+
+	struct list_head node;
+	lbaint_t issued;
+	lbaint_t good;
+	int inflight;
+};
 
 /* Operations on block devices */
 struct blk_ops {
@@ -258,10 +378,80 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start a read or write without waiting for it
+	 *
+	 * The driver calls blk_request_complete() once the request has
+	 * completed, from its poll() method. This method is optional, and
+	 * must be provided along with poll().
+	 *
+	 * @dev:	Device to access
+	 * @req:	Request to start
+	 * @return 0 if OK, -ENOSYS if the device cannot queue this request
+	 *	(it is then done synchronously with read() or write()), other
+	 *	-ve on error (the request is then not completed)
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress on requests started by submit()
+	 *
+	 * This must not wait for the device. Requests which take too long
+	 * are completed with -ETIMEDOUT.
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests still in flight, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
 
+/**
+ * blk_submit() - start a read or write without waiting for it
+ *
+ * This lets the CPU do other work, e.g. decompress or hash data already
+ * read, while the device transfers more. Call blk_poll() from time to time
+ * and blk_wait() when the data is needed.
+ *
+ * With drivers which cannot queue requests, the request completes (and
+ * @req->done is called) before this returns.
+ *
+ * @req:	Request to start
+ * @return 0 if OK, -ve on error (the request is then not completed)
+ */
+int blk_submit(struct blk_request *req);
+
+/**
+ * blk_poll() - make progress on requests started on a device
+ *
+ * This calls the @done callback of requests which have completed.
+ *
+ * @dev:	Block device
+ * @return number of requests still in flight, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - wait for a request to complete
+ *
+ * @req:	Request started by blk_submit()
+ * @return number of blocks transferred, or -ve on error
+ */
+long blk_wait(struct blk_request *req);
+
+/**
+ * blk_request_complete() - mark a request as completed
+ *
+ * This is for use by drivers: it sets the result and calls the request's
+ * @done callback.
+ *
+ * @req:	Request which has completed
+ * @result:	Number of blocks transferred, or -ve on error
+ */
+void blk_request_complete(struct blk_request *req, long result);
+
 /*
  * These functions should take struct udevice instead of struct blk_desc,
  * but this is convenient for migration to driver model. Add a 'd' prefix
@@ -417,6 +607,58 @@ int blk_get_from_parent(struct udevice *parent, struct udevice **devp);
  */
 struct blk_desc *blk_get_by_device(struct udevice *dev);
 
+/**
+ * struct blk_probe_hooks - Split bring-up of one kind of storage controller
+ *
+ * Bringing up a controller mostly means waiting: for a reset to complete,
+ * a link to train or a card to power up. These hooks let blk_probe_all()
+ * start that on all controllers first, so that the waits overlap, then
+ * enumerate each kind of device as soon as it is ready.
+ *
+ * @name:	Name of the kind of controller, for messages
+ * @start:	Start bringing up all controllers of this kind, without
+ *		waiting for them. May be NULL.
+ * @poll:	Check whether the controllers are ready to be enumerated.
+ *		Returns 0 if so, -EAGAIN if not yet, other -ve on error.
+ *		May be NULL, in which case they are always ready.
+ * @finish:	Complete the bring-up and bind the block devices. This must
+ *		work (waiting as needed) even if @poll never returned 0.
+ */
+struct blk_probe_hooks {
+	const char *name;
+	int (*start)(void);
+	int (*poll)(void);
+	int (*finish)(void);
+};
+
+/* Declare the probe hooks of a kind of storage controller */
+#define U_BOOT_BLK_PROBE(__name)					\
+	ll_entry_declare(struct blk_probe_hooks, __name, blk_probe_hooks)
+
+/**
+ * blk_probe_run() - Bring up several kinds of storage controllers at once
+ *
+ * All the @start hooks are called first. Then each kind is finished as soon
+ * as its @poll hook says it is ready, so kinds without @poll are finished
+ * first while the others make progress in hardware. A kind which does not
+ * become ready within a few seconds is finished anyway.
+ *
+ * @hooks:	Hooks of each kind of controller
+ * @count:	Number of entries in @hooks
+ * @return 0 if OK, else the first error returned by a hook
+ */
+int blk_probe_run(const struct blk_probe_hooks *hooks, int count);
+
+/**
+ * blk_probe_all() - Bring up all storage controllers at once
+ *
+ * This runs blk_probe_run() with all the hooks declared with
+ * U_BOOT_BLK_PROBE().
+ *
+ * @return 0 if OK, else the first error returned by a hook
+ */
+int blk_probe_all(void);
+
 #else
 #include <errno.h>
 /*
@@ -428,35 +670,26 @@ struct blk_desc *blk_get_by_device(struct udevice *dev);
 static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			      lbaint_t blkcnt, void *buffer)
 {
-	ulong blks_read;
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-
 	/*
 	 * We could check if block_read is NULL and return -ENOSYS. But this
 	 * bloats the code slightly (cause some board to fail to build), and
 	 * it would be an error to try an operation that does not exist.
 	 */
-	blks_read = block_dev->block_read(block_dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
-
-	return blks_read;
+	return blkcache_dread(block_dev, start, blkcnt, buffer,
+			      block_dev->block_read);
 }
 
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return block_dev->block_write(block_dev, start, blkcnt, buffer);
+	return blkcache_dwrite(block_dev, start, blkcnt, buffer,
+			       block_dev->block_write);
 }
 
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_discard(block_dev, start, blkcnt);
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
@@ -308,6 +308,15 @@ ulong	ticks2usec    (unsigned long ticks);
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/*
+ * Decompress a raw LZ4 block (no frame). On entry *dstn is the size of dst,
+ * on success the number of bytes produced. With 'stop_early' set decoding stops
+ * once dst is full instead of requiring the block to end exactly there, and
+ * trailing input is ignored.
+ */
+int ulz4_block(const void *src, size_t srcn, void *dst, size_t *dstn,
+	       bool stop_early);
+
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
 	   int(*compar)(const void *, const void *));
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * EROFS filesystem implementation for U-Boot
+ */
+
+#ifndef __U_BOOT_EROFS_H__
+#define __U_BOOT_EROFS_H__
+
+#include <fs.h>
+
+int erofs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition);
+int erofs_exists(const char *filename);
+int erofs_size(const char *filename, loff_t *size);
+int erofs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	       loff_t *actread);
+int erofs_opendir(const char *filename, struct fs_dir_stream **dirsp);
+int erofs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
+void erofs_closedir(struct fs_dir_stream *dirs);
+void erofs_close(void);
+
+#endif /* __U_BOOT_EROFS_H__ */
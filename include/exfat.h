@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * R/O exFAT filesystem implementation
+ *
+ * On-disk layout as described by the Microsoft exFAT file system
+ * specification.
+ */
+
+#ifndef _EXFAT_H_
+#define _EXFAT_H_
+
+#include <asm/byteorder.h>
+#include <fs.h>
+
+#define EXFAT_SIGN		"EXFAT   "
+#define EXFAT_SIGNLEN		8
+
+/* Cluster numbers, the cluster heap starts at cluster 2 */
+#define EXFAT_FIRST_CLUSTER	2
+#define EXFAT_BAD_CLUSTER	0xfffffff7
+#define EXFAT_EOF_CLUSTER	0xffffffff
+
+/* Directory entry types, bit 7 is set for entries in use */
+#define EXFAT_ENTRY_EOD		0x00	/* End of directory */
+#define EXFAT_ENTRY_INUSE	0x80
+#define EXFAT_ENTRY_BITMAP	0x81
+#define EXFAT_ENTRY_UPCASE	0x82
+#define EXFAT_ENTRY_LABEL	0x83
+#define EXFAT_ENTRY_FILE	0x85
+#define EXFAT_ENTRY_STREAM	0xc0
+#define EXFAT_ENTRY_NAME	0xc1
+
+/* File attributes */
+#define EXFAT_ATTR_RO		0x0001
+#define EXFAT_ATTR_HIDDEN	0x0002
+#define EXFAT_ATTR_SYS		0x0004
+#define EXFAT_ATTR_DIR		0x0010
+#define EXFAT_ATTR_ARCH		0x0020
+
+/* Stream extension flags */
+#define EXFAT_SF_ALLOC_POSSIBLE	0x01
+#define EXFAT_SF_NO_FAT_CHAIN	0x02	/* Clusters are contiguous */
+
+#define EXFAT_NAME_PER_ENTRY	15	/* UTF-16 code units per name entry */
+#define EXFAT_MAX_NAME_LEN	255	/* UTF-16 code units */
+
+struct exfat_boot_sector {
+	__u8	jump[3];		/* Bootstrap jump */
+	char	fs_name[8];		/* "EXFAT   " */
+	__u8	must_be_zero[53];	/* Where the FAT BPB would be */
+	__le64	partition_offset;	/* Media relative sector offset */
+	__le64	volume_length;		/* Size of volume in sectors */
+	__le32	fat_offset;		/* Sector of the first FAT */
+	__le32	fat_length;		/* Sectors/FAT */
+	__le32	heap_offset;		/* Sector of the cluster heap */
+	__le32	cluster_count;		/* Clusters in the cluster heap */
+	__le32	root_cluster;		/* First cluster of root directory */
+	__le32	serial;			/* Volume serial number */
+	__le16	revision;		/* Filesystem revision, 1.00 */
+	__le16	volume_flags;		/* Active FAT, dirty, media failure */
+	__u8	sect_size_bits;		/* log2 of bytes/sector */
+	__u8	clust_size_bits;	/* log2 of sectors/cluster */
+	__u8	fats;			/* Number of FATs */
+	__u8	drive_select;		/* INT 13h drive number */
+	__u8	percent_in_use;		/* Cluster heap usage */
+	__u8	reserved[7];
+	__u8	boot_code[390];
+	__le16	signature;		/* 0xaa55 */
+} __packed;
+
+/* Primary entry of a file or directory entry set */
+struct exfat_file_entry {
+	__u8	type;			/* EXFAT_ENTRY_FILE */
+	__u8	secondary_count;	/* Entries following this one */
+	__le16	checksum;		/* Entry set checksum */
+	__le16	attr;			/* EXFAT_ATTR_x */
+	__le16	reserved1;
+	__le32	create_time;
+	__le32	modify_time;
+	__le32	access_time;
+	__u8	create_time_cs;
+	__u8	modify_time_cs;
+	__u8	create_tz;
+	__u8	modify_tz;
+	__u8	access_tz;
+	__u8	reserved2[7];
+} __packed;
+
+/* First secondary entry, locates the file data */
+struct exfat_stream_entry {
+	__u8	type;			/* EXFAT_ENTRY_STREAM */
+	__u8	flags;			/* EXFAT_SF_x */
+	__u8	reserved1;
+	__u8	name_len;		/* Name length in UTF-16 code units */
+	__le16	name_hash;
+	__le16	reserved2;
+	__le64	valid_size;		/* Bytes written, the rest reads as 0 */
+	__le32	reserved3;
+	__le32	start_cluster;		/* First cluster of the data */
+	__le64	size;			/* Allocated data length in bytes */
+} __packed;
+
+/* Following secondary entries, up to 15 characters of the name each */
+struct exfat_name_entry {
+	__u8	type;			/* EXFAT_ENTRY_NAME */
+	__u8	flags;
+	__le16	name[EXFAT_NAME_PER_ENTRY];
+} __packed;
+
+int exfat_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition);
+int exfat_exists(const char *filename);
+int exfat_size(const char *filename, loff_t *size);
+int exfat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
+		    loff_t *actread);
+int exfat_uuid(char *uuid_str);
+int exfat_opendir(const char *filename, struct fs_dir_stream **dirsp);
+int exfat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
+void exfat_closedir(struct fs_dir_stream *dirs);
+void exfat_close(void);
+
+#endif /* _EXFAT_H_ */
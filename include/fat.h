@@ -25,6 +25,13 @@
 
 #define FATBUFBLOCKS	6
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+/* SPL keeps to a single window to spare its small malloc pool */
+#if defined(CONFIG_FS_FAT_FATBUF_WINDOWS) && !defined(CONFIG_SPL_BUILD)
+#define FATBUFWINDOWS	CONFIG_FS_FAT_FATBUF_WINDOWS
+#else
+#define FATBUFWINDOWS	1
+#endif
+#define FATCACHESIZE	(FATBUFSIZE * FATBUFWINDOWS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -154,6 +161,13 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/* A FATBUFBLOCKS sector window of the FAT held in the FAT cache */
+struct fat_window {
+	int	num;		/* Window number within the FAT, -1 if unused */
+	__u32	stamp;		/* Last use, the oldest window is evicted */
+	__u8	dirty;		/* Set if the window has been modified */
+};
+
 /*
  * Private filesystem parameters
  *
@@ -161,20 +175,20 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT cache, FATBUFWINDOWS windows */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	struct fat_window fatwin[FATBUFWINDOWS]; /* Init by fat_cache_init */
+	__u32	fatwin_stamp;	/* Use counter for fatwin[].stamp */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
@@ -13,6 +13,9 @@
 #define FS_TYPE_SANDBOX	3
 #define FS_TYPE_UBIFS	4
 #define FS_TYPE_BTRFS	5
+#define FS_TYPE_EXFAT	6
+#define FS_TYPE_SQUASHFS 7
+#define FS_TYPE_EROFS	8
 
 /*
  * Tell the fs layer which block device an partition to use for future
@@ -30,6 +30,7 @@
 #define DPNI_CMDID_GET_QDID			0x2101
 #define DPNI_CMDID_GET_TX_DATA_OFFSET		0x2121
 #define DPNI_CMDID_GET_LINK_STATE		0x2151
+#define DPNI_CMDID_SET_MAX_FRAME_LENGTH		0x2161
 #define DPNI_CMDID_SET_LINK_CFG			0x21A1
 
 #define DPNI_CMDID_SET_PRIM_MAC			0x2241
@@ -42,6 +43,7 @@
 #define DPNI_CMDID_GET_QUEUE			0x25F1
 #define DPNI_CMDID_SET_QUEUE			0x2601
 #define DPNI_CMDID_SET_TX_CONFIRMATION_MODE	0x2661
+#define DPNI_CMDID_SET_OFFLOAD			0x26C1
 
 /*                cmd, param, offset, width, type, arg_name */
 #define DPNI_CMD_OPEN(cmd, dpni_id) \
@@ -1259,6 +1261,61 @@ int dpni_set_tx_confirmation_mode(struct fsl_mc_io	*mc_io,
 				  uint32_t		cmd_flags,
 				  uint16_t		token,
 				  enum dpni_confirmation_mode mode);
+
+/**
+ * enum dpni_offload - Identifies a type of offload targeted by the command
+ * @DPNI_OFF_RX_L3_CSUM: Rx L3 checksum validation
+ * @DPNI_OFF_RX_L4_CSUM: Rx L4 checksum validation
+ * @DPNI_OFF_TX_L3_CSUM: Tx L3 checksum generation
+ * @DPNI_OFF_TX_L4_CSUM: Tx L4 checksum generation
+ */
+enum dpni_offload {
+	DPNI_OFF_RX_L3_CSUM,
+	DPNI_OFF_RX_L4_CSUM,
+	DPNI_OFF_TX_L3_CSUM,
+	DPNI_OFF_TX_L4_CSUM,
+};
+
+struct dpni_cmd_set_offload {
+	uint8_t pad[3];
+	uint8_t dpni_offload;
+	uint32_t config;
+};
+
+/**
+ * dpni_set_offload() - Set DPNI offload configuration
+ * @mc_io:      Pointer to MC portal's I/O object
+ * @cmd_flags:  Command flags; one or more of 'MC_CMD_FLAG_'
+ * @token:      Token of DPNI object
+ * @type:       Type of DPNI offload
+ * @config:     Offload configuration; 1 enables, 0 disables
+ *
+ * Return:      '0' on Success; Error code otherwise.
+ */
+int dpni_set_offload(struct fsl_mc_io *mc_io,
+		     uint32_t cmd_flags,
+		     uint16_t token,
+		     enum dpni_offload type,
+		     uint32_t config);
+
+struct dpni_cmd_set_max_frame_length {
+	uint16_t max_frame_length;
+};
+
+/**
+ * dpni_set_max_frame_length() - Set the maximum received frame length
+ * @mc_io:		Pointer to MC portal's I/O object
+ * @cmd_flags:		Command flags; one or more of 'MC_CMD_FLAG_'
+ * @token:		Token of DPNI object
+ * @max_frame_length:	Maximum received frame length (in bytes);
+ *			frame is discarded if its length exceeds this value
+ *
+ * Return:	'0' on Success; Error code otherwise.
+ */
+int dpni_set_max_frame_length(struct fsl_mc_io *mc_io,
+			      uint32_t cmd_flags,
+			      uint16_t token,
+			      uint16_t max_frame_length);
 struct dpni_statistics {
 	/**
 	 * Page_0 statistics structure
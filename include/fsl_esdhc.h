@@ -80,6 +80,33 @@
 
 #define ESDHCCTL		0x0002e40c
 #define ESDHCCTL_PCS		(0x00080000)
+#define ESDHCCTL_FAF		(0x00040000)
+
+/* UHS mode select and tuning control, in the upper half of AUTOC12ERR */
+#define AUTOC12ERR_UHSM_MASK	(0x00070000)
+#define AUTOC12ERR_UHSM_SDR12	(0x00000000)
+#define AUTOC12ERR_UHSM_SDR25	(0x00010000)
+#define AUTOC12ERR_UHSM_SDR50	(0x00020000)
+#define AUTOC12ERR_UHSM_SDR104	(0x00030000)	/* also HS200 */
+#define AUTOC12ERR_UHSM_DDR50	(0x00040000)
+#define AUTOC12ERR_EXECUTE_TUNING	(0x00400000)
+#define AUTOC12ERR_SMPCLKSEL	(0x00800000)
+
+#define TBCTL_TB_EN		(0x00000004)
+#define TBCTL_HS400_MODE	(0x00000010)
+#define TBCTL_HS400_WNDW_ADJUST	(0x00000040)
+
+#define SDCLKCTL_CMD_CLK_CTL	(0x00008000)
+
+#define SDTIMINGCTL_FLW_CTL_BG	(0x00008000)
+
+#define DLLCFG0_DLL_ENABLE	(0x80000000)
+#define DLLCFG0_DLL_RESET	(0x40000000)
+#define DLLCFG0_DLL_FREQ_SEL	(0x08000000)
+
+#define DLLSTAT0_SLV_LOCK	(0x08000000)
+
+#define ESDHC_MAX_TUNING_LOOP	40
 
 #define PRSSTAT			0x0002e024
 #define PRSSTAT_DAT0		(0x01000000)
@@ -99,6 +126,10 @@
 #define PROCTL_DTW_4		0x00000002
 #define PROCTL_DTW_8		0x00000004
 #define PROCTL_D3CD		0x00000008
+#define PROCTL_DMAS_MASK	0x00000300
+#define PROCTL_DMAS_SDMA	0x00000000
+#define PROCTL_DMAS_ADMA2	0x00000200
+#define PROCTL_DMAS_ADMA2_64	0x00000300
 #define PROCTL_VOLT_SEL		0x00000400
 
 #define CMDARG			0x0002e008
@@ -158,6 +189,7 @@
 #define BLKATTR_SIZE(x)	(x & 0x1fff)
 #define MAX_BLK_CNT	0x7fff	/* so malloc will have enough room with 32M */
 
+#define ESDHC_HOSTCAPBLT_BIT64	0x10000000
 #define ESDHC_HOSTCAPBLT_VS18	0x04000000
 #define ESDHC_HOSTCAPBLT_VS30	0x02000000
 #define ESDHC_HOSTCAPBLT_VS33	0x01000000
@@ -207,10 +239,6 @@ struct fsl_esdhc_cfg {
 int fsl_esdhc_mmc_init(bd_t *bis);
 int fsl_esdhc_initialize(bd_t *bis, struct fsl_esdhc_cfg *cfg);
 void fdt_fixup_esdhc(void *blob, bd_t *bd);
-#ifdef MMC_SUPPORTS_TUNING
-static inline int fsl_esdhc_execute_tuning(struct udevice *dev,
-					   uint32_t opcode) {return 0; }
-#endif
 #else
 static inline int fsl_esdhc_mmc_init(bd_t *bis) { return -ENOSYS; }
 static inline void fdt_fixup_esdhc(void *blob, bd_t *bd) {}
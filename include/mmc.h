@@ -356,9 +356,15 @@ enum mmc_voltage {
 
 /**
  * struct mmc_uclass_priv - Holds information about a device used by the uclass
+ *
+ * @mmc: MMC device
+ * @reqs: Block reads queued with blk_submit(), the first one is in progress
+ * @busy: true while a data transfer of the first of @reqs is in flight
  */
 struct mmc_uclass_priv {
 	struct mmc *mmc;
+	struct list_head reqs;
+	bool busy;
 };
 
 /**
@@ -462,6 +468,31 @@ struct dm_mmc_ops {
 	 */
 	int (*wait_dat0)(struct udevice *dev, int state, int timeout_us);
 
+	/**
+	 * send_cmd_start() - Send a command without waiting for its data
+	 *
+	 * This is like send_cmd() but returns once the response has been
+	 * received, with the data still being transferred. This method is
+	 * optional, and must be provided along with send_cmd_poll().
+	 *
+	 * @dev:	Device to receive the command
+	 * @cmd:	Command to send
+	 * @data:	Data to receive
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*send_cmd_start)(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data);
+
+	/**
+	 * send_cmd_poll() - Check for the end of a transfer
+	 *
+	 * @dev:	Device to check
+	 * @data:	Data passed to send_cmd_start()
+	 * @return 0 if the data has been transferred, -EBUSY if not yet,
+	 *	other -ve on error
+	 */
+	int (*send_cmd_poll)(struct udevice *dev, struct mmc_data *data);
+
 #if CONFIG_IS_ENABLED(MMC_HS400_ES_SUPPORT)
 	/* set_enhanced_strobe() - set HS400 enhanced strobe */
 	int (*set_enhanced_strobe)(struct udevice *dev);
@@ -477,6 +508,9 @@ int dm_mmc_get_cd(struct udevice *dev);
 int dm_mmc_get_wp(struct udevice *dev);
 int dm_mmc_execute_tuning(struct udevice *dev, uint opcode);
 int dm_mmc_wait_dat0(struct udevice *dev, int state, int timeout_us);
+int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+			  struct mmc_data *data);
+int dm_mmc_send_cmd_poll(struct udevice *dev, struct mmc_data *data);
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
@@ -650,6 +684,7 @@ struct mmc {
 				  * accessing the boot partitions
 				  */
 	u32 quirks;
+	bool hs400_tuning; /* tuning is run for the HS400 mode */
 };
 
 struct mmc_hwpart_conf {
@@ -124,8 +124,20 @@ enum eth_recv_flags {
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
- * stop: Stop the hardware from looking for packets - may be called even if
- *	 state == PASSIVE
+ * post_rx_buf: Receive the next packet into the buffer passed in "buf" of
+ *		"len" bytes rather than into a driver buffer, so that its payload
+ *		lands where the protocol wants it. recv then returns "buf" as the
+ *		packet. A NULL "buf" cancels the previous one. Return an error if
+ *		this buffer cannot be used, the packet is then received as usual.
+ *		"buf" has no particular alignment and "len" may be less than the
+ *		largest frame, so DMA engines needing aligned full-size buffers,
+ *		such as ENETC, leave this out - optional
+ * rx_csum: Report which checksums of the packet last returned by recv were
+ *	    verified by the hardware, as ETH_CSUM_... flags. With
+ *	    ETH_CSUM_COMPLETE the hardware sum of the IP datagram is returned
+ *	    in "sum". Only called before free_pkt - optional
+ * stop: Stop the hardware from looking for packets, dropping any buffer
+ *	 given by post_rx_buf - may be called even if state == PASSIVE
  * mcast: Join or leave a multicast group (for TFTP) - optional
  * write_hwaddr: Write a MAC address to the hardware (used to pass it to Linux
  *		 on some platforms like ARM). This function expects the
@@ -142,6 +154,8 @@ struct eth_ops {
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
+	int (*post_rx_buf)(struct udevice *dev, uchar *buf, int len);
+	int (*rx_csum)(struct udevice *dev, uchar *packet, int length, u16 *sum);
 	void (*stop)(struct udevice *dev);
 	int (*mcast)(struct udevice *dev, const u8 *enetaddr, int join);
 	int (*write_hwaddr)(struct udevice *dev);
@@ -158,6 +172,13 @@ struct udevice *eth_get_dev(void); /* get the current device */
 struct udevice *eth_get_dev_by_name(const char *devname);
 unsigned char *eth_get_ethaddr(void); /* get the current device MAC */
 
+/*
+ * Start and stop a device other than the current one, for protocols driving
+ * several devices at a time
+ */
+int eth_start_dev(struct udevice *dev);
+void eth_halt_dev(struct udevice *dev);
+
 /* Used only when NetConsole is enabled */
 int eth_is_active(struct udevice *dev); /* Test device for active state */
 int eth_init_state_only(void); /* Set active state */
@@ -175,6 +196,9 @@ struct eth_device {
 	int (*init)(struct eth_device *, bd_t *);
 	int (*send)(struct eth_device *, void *packet, int length);
 	int (*recv)(struct eth_device *);
+	/* Same as eth_ops.rx_csum, for the packet recv is handing over */
+	int (*rx_csum)(struct eth_device *, uchar *packet, int length,
+		       u16 *sum);
 	void (*halt)(struct eth_device *);
 	int (*mcast)(struct eth_device *, const u8 *enetaddr, int join);
 	int (*write_hwaddr)(struct eth_device *);
@@ -195,6 +219,10 @@ static __always_inline struct eth_device *eth_get_dev(void)
 struct eth_device *eth_get_dev_by_name(const char *devname);
 struct eth_device *eth_get_dev_by_index(int index); /* get dev @ index */
 
+/* Start and stop a device other than the current one, as with DM_ETH */
+int eth_start_dev(struct eth_device *dev);
+void eth_halt_dev(struct eth_device *dev);
+
 /* get the current device MAC */
 static inline unsigned char *eth_get_ethaddr(void)
 {
@@ -231,6 +259,9 @@ int eth_write_hwaddr(struct eth_device *dev, const char *base_name,
 		     int eth_number);
 
 int usb_eth_initialize(bd_t *bi);
+
+/* Fill in net_rx_csum for a packet handed over by the current device */
+void eth_rx_csum(uchar *packet, int length);
 #endif
 
 int eth_initialize(void);		/* Initialize network subsystem */
@@ -283,6 +314,37 @@ int eth_receive(void *packet, int length); /* Receive a packet*/
 extern void (*push_packet)(void *packet, int length);
 #endif
 int eth_rx(void);			/* Check for received packets */
+
+/* Largest header_len accepted by eth_post_rx_buf() */
+#define ETH_RX_POST_SAVE_MAX	128
+
+/**
+ * eth_post_rx_buf() - ask for the next packet to be received into a buffer
+ *
+ * This lets a protocol have the payload of the next packet received right at
+ * its final place, saving a copy. "buf" is then that place less the size of
+ * the headers in front of the payload. Those first header_len bytes of "buf"
+ * are saved now and put back once the packet has been processed, so they may
+ * hold data the protocol stored earlier. Whichever packet comes next lands in
+ * "buf", the protocol must check that it is the expected one.
+ *
+ * buf - buffer for the whole packet
+ * len - size of buf
+ * header_len - number of bytes at the start of buf to preserve
+ * Returns:
+ *	0 if the device will use buf, -ve if the packet will be received and
+ *	must be copied as usual
+ */
+int eth_post_rx_buf(uchar *buf, int len, int header_len);
+
+/**
+ * eth_cancel_rx_buf() - drop the buffer given to eth_post_rx_buf()
+ *
+ * The device goes back to receiving into its own buffers. This is done when
+ * the network loop ends, the device is halted or another one is selected,
+ * so that no later packet can be written to a stale place.
+ */
+void eth_cancel_rx_buf(void);
 void eth_halt(void);			/* stop SCC */
 const char *eth_get_name(void);		/* get name of current device */
 int eth_mcast_join(struct in_addr mcast_addr, int join);
@@ -346,6 +408,7 @@ struct vlan_ethernet_hdr {
 #define PROT_PPP_SES	0x8864		/* PPPoE session messages	*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -474,9 +537,19 @@ struct icmp_hdr {
  * standard including the 802.1Q tag (VLAN tagging).
  * maximum packet size =  1522
  * maximum packet size and multiple of 32 bytes =  1536
+ *
+ * With jumbo frames the MTU is 9000 bytes instead of 1500, with the
+ * same headers around it.
  */
+#ifdef CONFIG_NET_JUMBO_FRAMES
+#define NET_MTU			9000
+#define PKTSIZE			9022
+#define PKTSIZE_ALIGN		9024
+#else
+#define NET_MTU			1500
 #define PKTSIZE			1522
 #define PKTSIZE_ALIGN		1536
+#endif
 
 /*
  * Maximum receive ring size; that is, the number of packets
@@ -531,7 +604,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, WGET, TFTPSTRIPE
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -622,6 +695,120 @@ unsigned add_ip_checksums(unsigned offset, unsigned sum, unsigned new_sum);
  */
 int ip_checksum_ok(const void *addr, unsigned nbytes);
 
+/* Receive checksum offload flags, see struct net_rx_csum */
+#define ETH_CSUM_IP		(1 << 0)	/* IPv4 header checksum is good */
+#define ETH_CSUM_L4		(1 << 1)	/* UDP or TCP checksum is good */
+#define ETH_CSUM_COMPLETE	(1 << 2)	/* sum of the IP datagram is given */
+
+/**
+ * struct net_rx_csum - checksum state of the packet being processed
+ *
+ * This is filled in by the Ethernet layer from what the driver reports and
+ * cleared once the packet is processed.
+ *
+ * @flags:	ETH_CSUM_... flags
+ * @sum:	With ETH_CSUM_COMPLETE, the one's complement sum (not inverted)
+ *		of everything from the IP header to the end of the frame, in
+ *		the byte order used by compute_ip_checksum()
+ */
+struct net_rx_csum {
+	unsigned int flags;
+	u16 sum;
+};
+
+extern struct net_rx_csum net_rx_csum;
+
+/**
+ * net_rx_l4_csum_ok() - check if the hardware verified a UDP/TCP checksum
+ *
+ * @ip:		IP header of the received datagram, which must not have been
+ *		reassembled from fragments
+ * @return true if the hardware found the UDP/TCP checksum good, false if it
+ *	did not check it, in which case software has to
+ */
+bool net_rx_l4_csum_ok(struct ip_udp_hdr *ip);
+
+/**
+ * enum net_stage - parts of the network stack timed with NET_STATS
+ *
+ * @NET_STAGE_POLL:	eth_rx(), polling the driver and processing packets
+ * @NET_STAGE_RX:	processing of the received packets by the stack
+ * @NET_STAGE_TX:	eth_send(), handing packets over to the driver
+ * @NET_STAGE_CSUM:	checking IP, UDP and TCP checksums in software
+ * @NET_STAGE_COPY:	storing received file data at its destination
+ * @NET_STAGE_ARP:	waiting for ARP replies
+ */
+enum net_stage {
+	NET_STAGE_POLL,
+	NET_STAGE_RX,
+	NET_STAGE_TX,
+	NET_STAGE_CSUM,
+	NET_STAGE_COPY,
+	NET_STAGE_ARP,
+
+	NET_STAGE_COUNT,
+};
+
+/**
+ * struct net_stats - counters of the network stack, see CONFIG_NET_STATS
+ *
+ * @rx_packets:		Packets received
+ * @rx_bytes:		Bytes received, Ethernet headers included
+ * @rx_dropped:		Received packets dropped as malformed or corrupted
+ * @tx_packets:		Packets sent
+ * @tx_bytes:		Bytes sent
+ * @tx_errors:		Packets the driver failed to send
+ * @arp_requests:	ARP requests sent
+ * @timeouts:		Protocol timers that expired
+ * @retransmits:	Packets sent again after a timeout
+ * @ticks:		Time spent in each stage, in get_ticks() units
+ * @calls:		Number of times each stage was entered
+ */
+struct net_stats {
+	u64 rx_packets;
+	u64 rx_bytes;
+	u64 rx_dropped;
+	u64 tx_packets;
+	u64 tx_bytes;
+	u64 tx_errors;
+	u32 arp_requests;
+	u32 timeouts;
+	u32 retransmits;
+	u64 ticks[NET_STAGE_COUNT];
+	u64 calls[NET_STAGE_COUNT];
+};
+
+#if CONFIG_IS_ENABLED(NET_STATS)
+extern struct net_stats net_stats;
+
+#define net_stats_add(field, n)	(net_stats.field += (n))
+
+/* Start timing a stage, returns the start time for net_stats_stop() */
+static inline u64 net_stats_start(void)
+{
+	return get_ticks();
+}
+
+static inline void net_stats_stop(enum net_stage stage, u64 start)
+{
+	net_stats.ticks[stage] += get_ticks() - start;
+	net_stats.calls[stage]++;
+}
+#else
+#define net_stats_add(field, n)	do { } while (0)
+
+static inline u64 net_stats_start(void)
+{
+	return 0;
+}
+
+static inline void net_stats_stop(enum net_stage stage, u64 start)
+{
+}
+#endif
+
+#define net_stats_inc(field)	net_stats_add(field, 1)
+
 /* Callbacks */
 rxhand_f *net_get_udp_handler(void);	/* Get UDP RX packet handler */
 void net_set_udp_handler(rxhand_f *);	/* Set UDP RX packet handler */
@@ -857,6 +1044,29 @@ int is_serverip_in_cmd(void);
  */
 int net_parse_bootfile(struct in_addr *ipaddr, char *filename, int max_len);
 
+/* Number of "loading" hashes per line, for all download protocols */
+#define NET_HASHES_PER_LINE	65
+/* Bytes per hash for the protocols that count bytes rather than blocks */
+#define NET_HASH_BYTES		(64 * 1024)
+
+/**
+ * net_init_load_addr() - check where a download may be stored
+ *
+ * @addr:	Returns load_addr
+ * @size:	Returns the number of bytes free from there, or ~0 without
+ *		CONFIG_LMB
+ * @return 0 if OK, -1 if load_addr is in reserved memory
+ */
+int net_init_load_addr(ulong *addr, ulong *size);
+
+/**
+ * net_show_progress() - print a hash for each NET_HASH_BYTES loaded
+ *
+ * @num_hash:	Number of hashes printed so far, updated
+ * @bytes:	Number of bytes loaded so far
+ */
+void net_show_progress(int *num_hash, ulong bytes);
+
 /* get a random source port */
 unsigned int random_port(void);
 
@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client, enough to stream a file from a server
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include <net.h>
+
+/*
+ *	Internet Protocol (IP) + Transmission Control Protocol (TCP) header.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgment number	*/
+	u8		tcp_hlen;	/* Header length in words << 4	*/
+	u8		tcp_flags;	/* Control flags		*/
+	u16		tcp_win;	/* Receive window		*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_ugr;	/* Urgent pointer		*/
+} __attribute__((packed));
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+/* TCP control flags */
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PUSH	0x08
+#define TCP_ACK		0x10
+
+/* TCP options */
+#define TCP_O_END	0	/* End of option list */
+#define TCP_O_NOP	1	/* No operation */
+#define TCP_O_MSS	2	/* Maximum segment size */
+#define TCP_O_MSS_LEN	4
+
+/* Largest segment we can receive in an untagged frame */
+#define TCP_MSS		(NET_MTU - IP_TCP_HDR_SIZE)
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_FIN_WAIT,		/* we sent FIN, waiting for the peer's */
+	TCP_LAST_ACK,		/* peer sent FIN, waiting for ACK of ours */
+};
+
+enum tcp_event {
+	TCP_EV_CONNECTED,	/* three-way handshake done */
+	TCP_EV_DATA,		/* in-order stream data received */
+	TCP_EV_CLOSED,		/* connection closed, all data delivered */
+	TCP_EV_ABORTED,		/* reset by the peer or retries exhausted */
+};
+
+/**
+ * rxhand_tcp_f() - TCP application handler
+ *
+ * @event:	What happened on the connection
+ * @offset:	Offset of @data in the received byte stream
+ * @data:	Stream data (TCP_EV_DATA only)
+ * @len:	Length of @data
+ */
+typedef void rxhand_tcp_f(enum tcp_event event, u32 offset, uchar *data,
+			  unsigned int len);
+
+/* Set the handler called for events on the connection (NULL to clear) */
+void tcp_set_tcp_handler(rxhand_tcp_f *f);
+
+/* Get the state of the connection */
+enum tcp_state tcp_get_state(void);
+
+/**
+ * tcp_connect() - open a connection by sending a SYN
+ *
+ * The handler gets TCP_EV_CONNECTED once the server has answered.
+ *
+ * @dest:	Server IP address
+ * @dport:	Server port
+ * @return 0 if OK, -ve on error
+ */
+int tcp_connect(struct in_addr dest, int dport);
+
+/**
+ * tcp_send() - send data on an established connection
+ *
+ * Only one segment can be in flight; it is retransmitted until the peer
+ * acknowledges it.
+ *
+ * @data:	Data to send
+ * @len:	Length of @data, at most TCP_MSS
+ * @return 0 if OK, -EBUSY if a segment is still unacknowledged, -ENOTCONN
+ *	if the connection is not established, -EMSGSIZE if @len is too big
+ */
+int tcp_send(const void *data, int len);
+
+/* Close our side of the connection by sending a FIN */
+void tcp_close(void);
+
+/* Reset the connection */
+void tcp_abort(void);
+
+/**
+ * tcp_checksum() - compute the checksum of a TCP segment
+ *
+ * This covers the pseudo header built from @src, @dst and @len, so the
+ * result is zero when checking a received segment.
+ *
+ * @src:	Source IP address
+ * @dst:	Destination IP address
+ * @seg:	TCP header followed by the payload
+ * @len:	Length of @seg
+ * @return checksum to store in the header (network order)
+ */
+u16 tcp_checksum(struct in_addr src, struct in_addr dst, const void *seg,
+		 int len);
+
+/**
+ * tcp_set_tcp_header() - build the IP and TCP headers of a segment
+ *
+ * A SYN also gets our MSS option, so the header may be longer than
+ * TCP_HDR_SIZE. The payload must already be in place after a header of
+ * TCP_HDR_SIZE bytes.
+ *
+ * @pkt:	Start of the IP header
+ * @dest:	Destination IP address
+ * @dport:	Destination port
+ * @sport:	Source port
+ * @payload_len: Length of the TCP payload
+ * @action:	TCP control flags
+ * @tcp_seq_num: Sequence number
+ * @tcp_ack_num: Acknowledgment number
+ * @return size of the IP and TCP headers
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 tcp_seq_num,
+		       u32 tcp_ack_num);
+
+/**
+ * tcp_receive() - process a received TCP segment
+ *
+ * @ip:		IP header of the segment (checked by the caller)
+ * @len:	IP datagram length
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, int len);
+
+#endif /* __TCP_H__ */
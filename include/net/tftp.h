@@ -22,6 +22,13 @@ void tftp_start(enum proto_t protocol);	/* Begin TFTP get/put */
 void tftp_start_server(void);	/* Wait for incoming TFTP put */
 #endif
 
+/* tftp_stripe.c */
+#ifdef CONFIG_CMD_TFTPSTRIPE
+void tftp_stripe_start(void);	/* Begin striped TFTP get */
+void tftp_stripe_poll(void);	/* Receive on the other devices */
+void tftp_stripe_stop(void);	/* Stop the other devices */
+#endif
+
 extern ulong tftp_timeout_ms;
 extern int tftp_timeout_count_max;
 
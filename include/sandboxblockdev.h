@@ -6,12 +6,17 @@
 #ifndef __SANDBOX_BLOCK_DEV__
 #define __SANDBOX_BLOCK_DEV__
 
+#include <linux/list.h>
+
 struct host_block_dev {
 #ifndef CONFIG_BLK
 	struct blk_desc blk_dev;
 #endif
 	char *filename;
 	int fd;
+#ifdef CONFIG_BLK
+	struct list_head reqs;	/* requests queued by submit(), oldest first */
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
@@ -170,6 +170,8 @@ struct scsi_platdata {
 	unsigned long max_id;
 };
 
+struct blk_request;
+
 /* Operations for SCSI */
 struct scsi_ops {
 	/**
@@ -188,6 +190,28 @@ struct scsi_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*bus_reset)(struct udevice *dev);
+
+	/**
+	 * submit() - start a read or write without waiting for it
+	 *
+	 * This is optional. The request completes from poll(), see struct
+	 * blk_ops.
+	 *
+	 * @dev:	SCSI bus
+	 * @req:	Request to start, on a block device of this bus
+	 * @return 0 if OK, -ENOSYS if this request cannot be queued, other
+	 *	-ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress on requests started by submit()
+	 *
+	 * @dev:	SCSI bus
+	 * @return number of requests still in flight on the bus, or -ve on
+	 *	error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define scsi_get_ops(dev)        ((struct scsi_ops *)(dev)->driver->ops)
@@ -211,6 +235,23 @@ int scsi_exec(struct udevice *dev, struct scsi_cmd *cmd);
  */
 int scsi_bus_reset(struct udevice *dev);
 
+/**
+ * scsi_submit() - start a read or write without waiting for it
+ *
+ * @dev:	SCSI bus
+ * @req:	Request to start
+ * @return 0 if OK, -ENOSYS if the bus cannot queue it, other -ve on error
+ */
+int scsi_submit(struct udevice *dev, struct blk_request *req);
+
+/**
+ * scsi_poll() - make progress on requests started with scsi_submit()
+ *
+ * @dev:	SCSI bus
+ * @return number of requests still in flight, or -ve on error
+ */
+int scsi_poll(struct udevice *dev);
+
 /**
  * scsi_scan() - Scan all SCSI controllers for available devices
  *
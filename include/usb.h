@@ -663,6 +663,30 @@ struct usb_emul_platdata {
 	int port1;	/* Port number (numbered from 1) */
 };
 
+/**
+ * struct usb_bulk_req - A bulk transfer queued with usb_bulk_submit()
+ *
+ * Several of these can be in flight at once, on different endpoints or, with
+ * streams, on different streams of the same endpoint.
+ *
+ * @pipe:	Bulk pipe, see create_pipe()
+ * @stream_id:	Stream ID on an endpoint set up by usb_alloc_streams(), else 0
+ * @buffer:	Buffer to send or receive. This should be DMA-aligned.
+ * @length:	Buffer length in bytes
+ * @act_len:	Number of bytes transferred, set on completion
+ * @status:	USB_ST_... status, set on completion
+ * @done:	Set once the transfer has completed
+ */
+struct usb_bulk_req {
+	unsigned long pipe;
+	unsigned int stream_id;
+	void *buffer;
+	int length;
+	int act_len;
+	unsigned long status;
+	bool done;
+};
+
 /**
  * struct dm_usb_ops - USB controller operations
  *
@@ -785,6 +809,51 @@ struct dm_usb_ops {
 	 * in a USB transfer. USB class driver needs to be aware of this.
 	 */
 	int (*get_max_xfer_size)(struct udevice *bus, size_t *size);
+
+	/**
+	 * alloc_streams() - Set up bulk endpoints to use streams
+	 *
+	 * @pipes:	Bulk pipes of the endpoints
+	 * @num_pipes:	Number of pipes
+	 * @num_streams: Number of streams wanted, numbered from 1
+	 * @return number of streams set up on each endpoint, -ve on error
+	 */
+	int (*alloc_streams)(struct udevice *bus, struct usb_device *udev,
+			     unsigned long *pipes, int num_pipes,
+			     unsigned int num_streams);
+
+	/**
+	 * bulk_submit() - Queue a bulk transfer without waiting for it
+	 *
+	 * @req:	Transfer to queue, which must stay valid until done
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*bulk_submit)(struct udevice *bus, struct usb_device *udev,
+			   struct usb_bulk_req *req);
+
+	/**
+	 * bulk_wait() - Wait for a bulk transfer queued by bulk_submit()
+	 *
+	 * Other transfers completing meanwhile are marked as done too.
+	 *
+	 * @req:	Transfer to wait for
+	 * @return 0 once done (see req->status), -ve on error
+	 */
+	int (*bulk_wait)(struct udevice *bus, struct usb_device *udev,
+			 struct usb_bulk_req *req);
+
+	/**
+	 * bulk_cancel() - Cancel a bulk transfer queued by bulk_submit()
+	 *
+	 * The transfer is marked as done with a failed status, unless it has
+	 * already completed. Other transfers queued on the same endpoint (or
+	 * stream) may be cancelled with it.
+	 *
+	 * @req:	Transfer to cancel
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*bulk_cancel)(struct udevice *bus, struct usb_device *udev,
+			   struct usb_bulk_req *req);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -980,6 +1049,54 @@ int usb_update_hub_device(struct usb_device *dev);
  */
 int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
 
+/**
+ * usb_alloc_streams() - Set up bulk endpoints to use streams
+ *
+ * Streams are only available on SuperSpeed bulk endpoints with a host
+ * controller supporting them.
+ *
+ * @dev:		USB device
+ * @pipes:		Bulk pipes of the endpoints
+ * @num_pipes:		Number of pipes
+ * @num_streams:	Number of streams wanted, numbered from 1
+ * @return number of streams set up on each endpoint, -ve on error
+ */
+int usb_alloc_streams(struct usb_device *dev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams);
+
+/**
+ * usb_bulk_submit() - Queue a bulk transfer without waiting for it
+ *
+ * @dev:		USB device
+ * @req:		Transfer to queue, which must stay valid until done
+ * @return 0 if OK, -ENOSYS if the host controller cannot queue transfers,
+ *	other -ve on error
+ */
+int usb_bulk_submit(struct usb_device *dev, struct usb_bulk_req *req);
+
+/**
+ * usb_bulk_wait() - Wait for a bulk transfer queued by usb_bulk_submit()
+ *
+ * @dev:		USB device
+ * @req:		Transfer to wait for
+ * @return 0 once done (see req->status), -ETIMEDOUT if it timed out, other
+ *	-ve on error
+ */
+int usb_bulk_wait(struct usb_device *dev, struct usb_bulk_req *req);
+
+/**
+ * usb_bulk_cancel() - Cancel a bulk transfer queued by usb_bulk_submit()
+ *
+ * This takes the transfer off the host controller so that its buffer can be
+ * reused. Nothing is done if it has already completed.
+ *
+ * @dev:		USB device
+ * @req:		Transfer to cancel
+ * @return 0 if OK, -ENOSYS if the host controller cannot queue transfers,
+ *	other -ve on error
+ */
+int usb_bulk_cancel(struct usb_device *dev, struct usb_bulk_req *req);
+
 /**
  * usb_emul_setup_device() - Set up a new USB device emulation
  *
@@ -71,8 +71,7 @@ FORCE_INLINE int LZ4_decompress_generic(
                  int outputSize,         /* If endOnInput==endOnInputSize, this value is the max size of Output Buffer. */
 
                  int endOnInput,         /* endOnOutputSize, endOnInputSize */
-                 int partialDecoding,    /* full, partial */
-                 int targetOutputSize,   /* only used if partialDecoding==partial */
+                 int partialDecoding,    /* full, partial : stop once outputSize bytes are decoded */
                  int dict,               /* noDict, withPrefix64k, usingExtDict */
                  const BYTE* const lowPrefix,  /* == dest if dict == noDict */
                  const BYTE* const dictStart,  /* only if dict==usingExtDict */
@@ -86,7 +85,6 @@ FORCE_INLINE int LZ4_decompress_generic(
     BYTE* op = (BYTE*) dest;
     BYTE* const oend = op + outputSize;
     BYTE* cpy;
-    BYTE* oexit = op + targetOutputSize;
     const BYTE* const lowLimit = lowPrefix - dictSize;
 
     const BYTE* const dictEnd = (const BYTE*)dictStart + dictSize;
@@ -98,8 +96,7 @@ FORCE_INLINE int LZ4_decompress_generic(
 
 
     /* Special cases */
-    if ((partialDecoding) && (oexit> oend-MFLIMIT)) oexit = oend-MFLIMIT;                         /* targetOutputSize too high => decode everything */
-    if ((endOnInput) && (unlikely(outputSize==0))) return ((inputSize==1) && (*ip==0)) ? 0 : -1;  /* Empty output buffer */
+    if ((endOnInput) && (unlikely(outputSize==0))) return (partialDecoding || ((inputSize==1) && (*ip==0))) ? 0 : -1;  /* Empty output buffer */
     if ((!endOnInput) && (unlikely(outputSize==0))) return (*ip==0?1:-1);
 
 
@@ -127,26 +124,34 @@ FORCE_INLINE int LZ4_decompress_generic(
 
         /* copy literals */
         cpy = op+length;
-        if (((endOnInput) && ((cpy>(partialDecoding?oexit:oend-MFLIMIT)) || (ip+length>iend-(2+1+LASTLITERALS))) )
+        if (((endOnInput) && ((cpy>oend-MFLIMIT) || (ip+length>iend-(2+1+LASTLITERALS))) )
             || ((!endOnInput) && (cpy>oend-COPYLENGTH)))
         {
             if (partialDecoding)
             {
-                if (cpy > oend) goto _output_error;                           /* Error : write attempt beyond end of output buffer */
                 if ((endOnInput) && (ip+length > iend)) goto _output_error;   /* Error : read attempt beyond end of input buffer */
+                if (cpy > oend) { cpy = oend; length = oend-op; }             /* Output full : copy what fits */
+                memcpy(op, ip, length);
+                ip += length;
+                op += length;
+                if ((cpy == oend) || (ip >= iend-2)) break;                   /* End of output or of input */
+                /* Only the output parsing restriction was hit, go on with the match */
             }
             else
             {
                 if ((!endOnInput) && (cpy != oend)) goto _output_error;       /* Error : block decoding must stop exactly there */
                 if ((endOnInput) && ((ip+length != iend) || (cpy > oend))) goto _output_error;   /* Error : input must be consumed */
+                memcpy(op, ip, length);
+                ip += length;
+                op += length;
+                break;     /* Necessarily EOF, due to parsing restrictions */
             }
-            memcpy(op, ip, length);
-            ip += length;
-            op += length;
-            break;     /* Necessarily EOF, due to parsing restrictions */
         }
-        LZ4_wildCopy(op, ip, cpy);
-        ip += length; op = cpy;
+        else
+        {
+            LZ4_wildCopy(op, ip, cpy);
+            ip += length; op = cpy;
+        }
 
         /* get offset */
         match = cpy - LZ4_readLE16(ip); ip+=2;
@@ -200,6 +205,16 @@ FORCE_INLINE int LZ4_decompress_generic(
             continue;
         }
 
+        /* partial decoding : copy what fits near the end of output, byte by byte as it may overlap */
+        if ((partialDecoding) && (unlikely(op+length > oend-12)))
+        {
+            if (length > (size_t)(oend-op)) length = oend-op;
+            cpy = op + length;
+            while (op<cpy) *op++ = *match++;
+            if (op == oend) break;
+            continue;
+        }
+
         /* copy repeated sequence */
         cpy = op + length;
         if (unlikely((op-match)<8))
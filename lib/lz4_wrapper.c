@@ -21,7 +21,11 @@ typedef uint64_t U64;
 
 #define FORCE_INLINE static inline __attribute__((always_inline))
 
-/* Unaltered (except removing unrelated code) from github.com/Cyan4973/lz4. */
+/*
+ * From github.com/Cyan4973/lz4, with unrelated code removed and partial
+ * decoding made to stop at the end of the output buffer, as it does in
+ * later upstream releases.
+ */
 #include "lz4.c"	/* #include for inlining, do not link! */
 
 struct lz4_frame_header {
@@ -119,7 +123,7 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 			/* constant folding essential, do not touch params! */
 			ret = LZ4_decompress_generic(in, out, b.size,
 					end - out, endOnInputSize,
-					full, 0, noDict, out, NULL, 0);
+					full, noDict, out, NULL, 0);
 			if (ret < 0) {
 				ret = -EPROTO;	/* decompression error */
 				break;
@@ -135,3 +139,26 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+int ulz4_block(const void *src, size_t srcn, void *dst, size_t *dstn,
+	       bool stop_early)
+{
+	int ret;
+
+	/* constant folding essential, do not touch params! */
+	if (stop_early)
+		ret = LZ4_decompress_generic(src, dst, srcn, *dstn,
+					     endOnInputSize, partial, noDict,
+					     dst, NULL, 0);
+	else
+		ret = LZ4_decompress_generic(src, dst, srcn, *dstn,
+					     endOnInputSize, full, noDict,
+					     dst, NULL, 0);
+
+	if (ret < 0)
+		return -EPROTO;	/* decompression error */
+
+	*dstn = ret;
+
+	return 0;
+}
@@ -36,6 +36,8 @@ ulong		arp_wait_timer_start;
 int		arp_wait_try;
 uchar	       *arp_tx_packet; /* THE ARP transmit packet */
 static uchar	arp_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
+/* When the first request for the address we are waiting for went out */
+static u64	arp_wait_ticks_start;
 
 void arp_init(void)
 {
@@ -75,6 +77,7 @@ void arp_raw_request(struct in_addr source_ip, const uchar *target_ethaddr,
 	memcpy(&arp->ar_tha, target_ethaddr, ARP_HLEN);	/* target ET addr */
 	net_write_ip(&arp->ar_tpa, target_ip);		/* target IP addr */
 
+	net_stats_inc(arp_requests);
 	net_send_packet(arp_tx_packet, eth_hdr_size + ARP_HDR_SIZE);
 }
 
@@ -92,6 +95,8 @@ void arp_request(void)
 		net_arp_wait_reply_ip = net_arp_wait_packet_ip;
 	}
 
+	if (arp_wait_try == 1)
+		arp_wait_ticks_start = net_stats_start();
 	arp_raw_request(net_ip, net_null_ethaddr, net_arp_wait_reply_ip);
 }
 
@@ -207,6 +212,7 @@ void arp_receive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
 			debug_cond(DEBUG_DEV_PKT,
 				   "Got ARP REPLY, set eth addr (%pM)\n",
 				   arp->ar_data);
+			net_stats_stop(NET_STAGE_ARP, arp_wait_ticks_start);
 
 			/* save address for later use */
 			if (arp_wait_packet_ethaddr != NULL)
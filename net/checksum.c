@@ -10,6 +10,7 @@
 #include <common.h>
 #include <net.h>
 
+#if !CONFIG_IS_ENABLED(USE_ARCH_IP_CHECKSUM)
 unsigned compute_ip_checksum(const void *vptr, unsigned nbytes)
 {
 	int sum, oddbyte;
@@ -32,6 +33,7 @@ unsigned compute_ip_checksum(const void *vptr, unsigned nbytes)
 
 	return sum;
 }
+#endif
 
 unsigned add_ip_checksums(unsigned offset, unsigned sum, unsigned new)
 {
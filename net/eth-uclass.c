@@ -25,13 +25,28 @@ struct eth_device_priv {
 	enum eth_state_t state;
 };
 
+/**
+ * struct eth_rx_post - a buffer given to the device with eth_post_rx_buf()
+ *
+ * @buf: Buffer the next packet is received into, NULL if none
+ * @header_len: Number of bytes saved from the start of @buf
+ * @save: Data found at the start of @buf when it was posted
+ */
+struct eth_rx_post {
+	uchar *buf;
+	int header_len;
+	uchar save[ETH_RX_POST_SAVE_MAX];
+};
+
 /**
  * struct eth_uclass_priv - The structure attached to the uclass itself
  *
  * @current: The Ethernet device that the network functions are using
+ * @rx_post: Receive buffer posted by a protocol
  */
 struct eth_uclass_priv {
 	struct udevice *current;
+	struct eth_rx_post rx_post;
 };
 
 /* eth_errno - This stores the most recent failure code from DM functions */
@@ -50,6 +65,8 @@ void eth_set_current_to_next(void)
 {
 	struct eth_uclass_priv *uc_priv;
 
+	eth_cancel_rx_buf();
+
 	uc_priv = eth_get_uclass_priv();
 	if (uc_priv->current)
 		uclass_next_device(&uc_priv->current);
@@ -81,6 +98,10 @@ struct udevice *eth_get_dev(void)
  */
 void eth_set_dev(struct udevice *dev)
 {
+	/* A buffer posted to the previous device must not stay armed */
+	if (dev != eth_get_uclass_priv()->current)
+		eth_cancel_rx_buf();
+
 	if (dev && !device_active(dev)) {
 		eth_errno = device_probe(dev);
 		if (eth_errno)
@@ -307,6 +328,8 @@ void eth_halt(void)
 	struct udevice *current;
 	struct eth_device_priv *priv;
 
+	eth_cancel_rx_buf();
+
 	current = eth_get_dev();
 	if (!current || !eth_is_active(current))
 		return;
@@ -317,6 +340,44 @@ void eth_halt(void)
 		priv->state = ETH_STATE_PASSIVE;
 }
 
+int eth_start_dev(struct udevice *dev)
+{
+	struct eth_device_priv *priv;
+	int ret;
+
+	if (!device_active(dev)) {
+		ret = device_probe(dev);
+		if (ret)
+			return ret;
+	}
+
+	if (eth_is_active(dev))
+		return 0;
+
+	ret = eth_get_ops(dev)->start(dev);
+	if (ret < 0)
+		return ret;
+
+	priv = dev->uclass_priv;
+	priv->state = ETH_STATE_ACTIVE;
+
+	return 0;
+}
+
+void eth_halt_dev(struct udevice *dev)
+{
+	struct eth_device_priv *priv;
+
+	if (!eth_is_active(dev))
+		return;
+
+	if (dev == eth_get_uclass_priv()->current)
+		eth_cancel_rx_buf();
+	eth_get_ops(dev)->stop(dev);
+	priv = dev->uclass_priv;
+	priv->state = ETH_STATE_PASSIVE;
+}
+
 int eth_is_active(struct udevice *dev)
 {
 	struct eth_device_priv *priv;
@@ -331,6 +392,7 @@ int eth_is_active(struct udevice *dev)
 int eth_send(void *packet, int length)
 {
 	struct udevice *current;
+	u64 start;
 	int ret;
 
 	current = eth_get_dev();
@@ -340,10 +402,16 @@ int eth_send(void *packet, int length)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+	start = net_stats_start();
 	ret = eth_get_ops(current)->send(current, packet, length);
+	net_stats_stop(NET_STAGE_TX, start);
 	if (ret < 0) {
 		/* We cannot completely return the error at present */
 		debug("%s: send() returned error %d\n", __func__, ret);
+		net_stats_inc(tx_errors);
+	} else {
+		net_stats_inc(tx_packets);
+		net_stats_add(tx_bytes, length);
 	}
 #if defined(CONFIG_CMD_PCAP)
 	if (ret >= 0)
@@ -352,10 +420,75 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+int eth_post_rx_buf(uchar *buf, int len, int header_len)
+{
+	struct eth_rx_post *post = &eth_get_uclass_priv()->rx_post;
+	struct udevice *current;
+	int ret;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_is_active(current))
+		return -EINVAL;
+
+	if (!eth_get_ops(current)->post_rx_buf)
+		return -ENOSYS;
+
+	if (header_len > ETH_RX_POST_SAVE_MAX || header_len > len)
+		return -EINVAL;
+
+	/* The device may write to the buffer as soon as it has it */
+	post->buf = NULL;
+	memcpy(post->save, buf, header_len);
+	ret = eth_get_ops(current)->post_rx_buf(current, buf, len);
+	if (ret)
+		return ret;
+	post->buf = buf;
+	post->header_len = header_len;
+
+	return 0;
+}
+
+/* Fill in net_rx_csum from what the device checked of this packet */
+static void eth_rx_csum(struct udevice *dev, uchar *packet, int length)
+{
+	struct eth_ops *ops = eth_get_ops(dev);
+	u16 sum = 0;
+	int ret;
+
+	net_rx_csum.flags = 0;
+	if (!ops->rx_csum)
+		return;
+
+	ret = ops->rx_csum(dev, packet, length, &sum);
+	if (ret < 0)
+		return;
+	net_rx_csum.flags = ret;
+	net_rx_csum.sum = sum;
+}
+
+void eth_cancel_rx_buf(void)
+{
+	struct eth_rx_post *post = &eth_get_uclass_priv()->rx_post;
+	struct udevice *current = eth_get_uclass_priv()->current;
+
+	if (!post->buf)
+		return;
+
+	post->buf = NULL;
+	if (eth_is_active(current) && eth_get_ops(current)->post_rx_buf)
+		eth_get_ops(current)->post_rx_buf(current, NULL, 0);
+}
+
 int eth_rx(void)
 {
+	struct eth_rx_post *post = &eth_get_uclass_priv()->rx_post;
+	struct eth_rx_post landed;
 	struct udevice *current;
 	uchar *packet;
+	u64 start;
 	int flags;
 	int ret;
 	int i;
@@ -367,18 +500,32 @@ int eth_rx(void)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+	start = net_stats_start();
+
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < 32; i++) {
 		ret = eth_get_ops(current)->recv(current, flags, &packet);
 		flags = 0;
-		if (ret > 0)
+		/* Processing the packet may post the next buffer */
+		landed.buf = NULL;
+		if (ret > 0 && post->buf && packet == post->buf) {
+			memcpy(&landed, post, sizeof(landed));
+			post->buf = NULL;
+		}
+		if (ret > 0) {
+			eth_rx_csum(current, packet, ret);
 			net_process_received_packet(packet, ret);
+			net_rx_csum.flags = 0;
+		}
 		if (ret >= 0 && eth_get_ops(current)->free_pkt)
 			eth_get_ops(current)->free_pkt(current, packet, ret);
+		if (landed.buf)
+			memcpy(landed.buf, landed.save, landed.header_len);
 		if (ret <= 0)
 			break;
 	}
+	net_stats_stop(NET_STAGE_POLL, start);
 	if (ret == -EAGAIN)
 		ret = 0;
 	if (ret < 0) {
@@ -499,6 +646,8 @@ static int eth_post_probe(struct udevice *dev)
 			ops->recv += gd->reloc_off;
 		if (ops->free_pkt)
 			ops->free_pkt += gd->reloc_off;
+		if (ops->rx_csum)
+			ops->rx_csum += gd->reloc_off;
 		if (ops->stop)
 			ops->stop += gd->reloc_off;
 		if (ops->mcast)
@@ -351,14 +351,44 @@ int eth_is_active(struct eth_device *dev)
 	return dev && dev->state == ETH_STATE_ACTIVE;
 }
 
+int eth_start_dev(struct eth_device *dev)
+{
+	if (eth_is_active(dev))
+		return 0;
+
+	if (dev->init(dev, gd->bd) < 0)
+		return -ETIMEDOUT;
+	dev->state = ETH_STATE_ACTIVE;
+
+	return 0;
+}
+
+void eth_halt_dev(struct eth_device *dev)
+{
+	if (!eth_is_active(dev))
+		return;
+
+	dev->halt(dev);
+	dev->state = ETH_STATE_PASSIVE;
+}
+
 int eth_send(void *packet, int length)
 {
+	u64 start;
 	int ret;
 
 	if (!eth_current)
 		return -ENODEV;
 
+	start = net_stats_start();
 	ret = eth_current->send(eth_current, packet, length);
+	net_stats_stop(NET_STAGE_TX, start);
+	if (ret < 0) {
+		net_stats_inc(tx_errors);
+	} else {
+		net_stats_inc(tx_packets);
+		net_stats_add(tx_bytes, length);
+	}
 #if defined(CONFIG_CMD_PCAP)
 	if (ret >= 0)
 		pcap_post(packet, lengeth, true);
@@ -366,12 +396,44 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+void eth_rx_csum(uchar *packet, int length)
+{
+	u16 sum = 0;
+	int ret;
+
+	net_rx_csum.flags = 0;
+	if (!eth_current || !eth_current->rx_csum)
+		return;
+
+	ret = eth_current->rx_csum(eth_current, packet, length, &sum);
+	if (ret < 0)
+		return;
+	net_rx_csum.flags = ret;
+	net_rx_csum.sum = sum;
+}
+
 int eth_rx(void)
 {
+	u64 start;
+	int ret;
+
 	if (!eth_current)
 		return -ENODEV;
 
-	return eth_current->recv(eth_current);
+	start = net_stats_start();
+	ret = eth_current->recv(eth_current);
+	net_stats_stop(NET_STAGE_POLL, start);
+
+	return ret;
+}
+
+int eth_post_rx_buf(uchar *buf, int len, int header_len)
+{
+	return -ENOSYS;
+}
+
+void eth_cancel_rx_buf(void)
+{
 }
 
 #ifdef CONFIG_API
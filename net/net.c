@@ -95,6 +95,7 @@
 #include <errno.h>
 #include <net.h>
 #include <net/fastboot.h>
+#include <net/tcp.h>
 #include <net/tftp.h>
 #if defined(CONFIG_CMD_PCAP)
 #include <net/pcap.h>
@@ -118,10 +119,15 @@
 #if defined(CONFIG_CMD_SNTP)
 #include "sntp.h"
 #endif
+#if defined(CONFIG_CMD_WGET)
+#include "wget.h"
+#endif
 #if defined(CONFIG_CMD_WOL)
 #include "wol.h"
 #endif
 
+DECLARE_GLOBAL_DATA_PTR;
+
 /** BOOTP EXTENTIONS **/
 
 /* Our subnet mask (0=unknown) */
@@ -149,6 +155,14 @@ struct in_addr	net_server_ip;
 uchar *net_rx_packet;
 /* Current rx packet length */
 int		net_rx_packet_len;
+/* Checksums of the current rx packet verified by the hardware */
+struct net_rx_csum net_rx_csum;
+/* Bytes from the IP header to the end of the current rx frame */
+static int net_rx_ip_frame_len;
+#if CONFIG_IS_ENABLED(NET_STATS)
+/* Counters shown by "net stats" */
+struct net_stats net_stats;
+#endif
 /* IP packet ID */
 static unsigned	net_ip_id;
 /* Ethernet bcast address */
@@ -362,12 +376,19 @@ static void net_clear_handlers(void)
 {
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
+#if defined(CONFIG_PROT_TCP)
+	tcp_set_tcp_handler(NULL);
+#endif
 	net_set_timeout_handler(0, NULL);
 }
 
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+	eth_cancel_rx_buf();
+#if defined(CONFIG_CMD_TFTPSTRIPE)
+	tftp_stripe_stop();
+#endif
 }
 
 void net_init(void)
@@ -412,6 +433,9 @@ int net_loop(enum proto_t protocol)
 	debug_cond(DEBUG_INT_STATE, "--- net_loop Entry\n");
 
 	bootstage_mark_name(BOOTSTAGE_ID_ETH_START, "eth_start");
+#if CONFIG_IS_ENABLED(NET_STATS) && CONFIG_IS_ENABLED(BOOTSTAGE)
+	bootstage_start(BOOTSTAGE_ID_ACCUM_NET, "net_loop");
+#endif
 	net_init();
 	if (eth_is_on_demand_init() || protocol != NETCONS) {
 		eth_halt();
@@ -419,7 +443,7 @@ int net_loop(enum proto_t protocol)
 		ret = eth_init();
 		if (ret < 0) {
 			eth_halt();
-			return ret;
+			goto done;
 		}
 	} else {
 		eth_init_state_only();
@@ -442,8 +466,8 @@ restart:
 	case 1:
 		/* network not configured */
 		eth_halt();
-		net_set_state(prev_net_state);
-		return -ENODEV;
+		ret = -ENODEV;
+		goto done;
 
 	case 2:
 		/* network device not configured */
@@ -465,6 +489,11 @@ restart:
 			tftp_start_server();
 			break;
 #endif
+#ifdef CONFIG_CMD_TFTPSTRIPE
+		case TFTPSTRIPE:
+			tftp_stripe_start();
+			break;
+#endif
 #ifdef CONFIG_UDP_FUNCTION_FASTBOOT
 		case FASTBOOT:
 			fastboot_start_server();
@@ -501,6 +530,11 @@ restart:
 			nfs_start();
 			break;
 #endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_CDP)
 		case CDP:
 			cdp_start();
@@ -574,6 +608,11 @@ restart:
 		 *	errors that may have happened.
 		 */
 		eth_rx();
+#if defined(CONFIG_CMD_TFTPSTRIPE)
+		/* and the other devices a striped download is using */
+		if (protocol == TFTPSTRIPE)
+			tftp_stripe_poll();
+#endif
 
 		/*
 		 *	Abort if ctrl-c was pressed.
@@ -666,6 +705,9 @@ restart:
 	}
 
 done:
+#if CONFIG_IS_ENABLED(NET_STATS) && CONFIG_IS_ENABLED(BOOTSTAGE)
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_NET);
+#endif
 #ifdef CONFIG_USB_KEYBOARD
 	net_busy_flag = 0;
 #endif
@@ -851,6 +893,14 @@ int net_send_ip_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 				   payload_len);
 		pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 		break;
+#if defined(CONFIG_PROT_TCP)
+	case IPPROTO_TCP:
+		pkt_hdr_size = eth_hdr_size +
+			tcp_set_tcp_header(pkt + eth_hdr_size, dest, dport,
+					   sport, payload_len, action,
+					   tcp_seq_num, tcp_ack_num);
+		break;
+#endif
 	default:
 		return -EINVAL;
 	}
@@ -872,8 +922,8 @@ int net_send_ip_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		arp_request();
 		return 1;	/* waiting */
 	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
-			   &dest, ether);
+		debug_cond(DEBUG_DEV_PKT, "sending %s to %pI4/%pM\n",
+			   proto == IPPROTO_TCP ? "TCP" : "UDP", &dest, ether);
 		net_send_packet(net_tx_packet, pkt_hdr_size + payload_len);
 		return 0;	/* transmitted */
 	}
@@ -885,9 +935,6 @@ int net_send_ip_packet(uchar *ether, struct in_addr dest, int dport, int sport,
  * to the algorithm in RFC815. It returns NULL or the pointer to
  * a complete packet, in static storage
  */
-#ifndef CONFIG_NET_MAXDEFRAG
-#define CONFIG_NET_MAXDEFRAG 16384
-#endif
 #define IP_PKTSIZE (CONFIG_NET_MAXDEFRAG)
 
 #define IP_MAXUDP (IP_PKTSIZE - IP_HDR_SIZE)
@@ -904,36 +951,88 @@ struct hole {
 	u16 unused;
 };
 
+/*
+ * One datagram being reassembled. Several of them are kept so that the
+ * fragments of datagrams sent back to back can arrive interleaved.
+ */
+struct ip_defrag {
+	uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
+	u16 first_hole;
+	u16 total_len;		/* 0 if this slot is free */
+	ulong last_used;
+};
+
+static struct ip_defrag ip_defrag[CONFIG_IP_DEFRAG_SLOTS];
+static ulong ip_defrag_clock;
+
+/*
+ * Find the slot collecting the datagram "ip" is a fragment of. If there
+ * is none, start one in a free slot, or else in the one left alone longest.
+ */
+static struct ip_defrag *ip_defrag_slot(struct ip_udp_hdr *ip)
+{
+	struct ip_defrag *d, *victim = &ip_defrag[0];
+	struct ip_udp_hdr *localip;
+	struct hole *payload;
+	int i;
+
+	for (i = 0; i < CONFIG_IP_DEFRAG_SLOTS; i++) {
+		d = &ip_defrag[i];
+		localip = (struct ip_udp_hdr *)d->pkt_buff;
+		if (d->total_len && localip->ip_id == ip->ip_id &&
+		    localip->ip_p == ip->ip_p &&
+		    !memcmp(&localip->ip_src, &ip->ip_src, sizeof(ip->ip_src)) &&
+		    !memcmp(&localip->ip_dst, &ip->ip_dst, sizeof(ip->ip_dst)))
+			break;
+
+		if (!d->total_len) {
+			if (victim->total_len)
+				victim = d;
+		} else if (victim->total_len &&
+			   d->last_used < victim->last_used) {
+			victim = d;
+		}
+	}
+
+	if (i == CONFIG_IP_DEFRAG_SLOTS) {
+		/* new packet, reset structs */
+		d = victim;
+		localip = (struct ip_udp_hdr *)d->pkt_buff;
+		payload = (struct hole *)(d->pkt_buff + IP_HDR_SIZE);
+		d->total_len = 0xffff;
+		payload[0].last_byte = ~0;
+		payload[0].next_hole = 0;
+		payload[0].prev_hole = 0;
+		d->first_hole = 0;
+		/* any IP header will work, copy the first we received */
+		memcpy(localip, ip, IP_HDR_SIZE);
+	}
+	d->last_used = ++ip_defrag_clock;
+
+	return d;
+}
+
 static struct ip_udp_hdr *__net_defragment(struct ip_udp_hdr *ip, int *lenp)
 {
-	static uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
-	static u16 first_hole, total_len;
+	struct ip_defrag *d;
 	struct hole *payload, *thisfrag, *h, *newh;
-	struct ip_udp_hdr *localip = (struct ip_udp_hdr *)pkt_buff;
+	struct ip_udp_hdr *localip;
 	uchar *indata = (uchar *)ip;
 	int offset8, start, len, done = 0;
 	u16 ip_off = ntohs(ip->ip_off);
 
-	/* payload starts after IP header, this fragment is in there */
-	payload = (struct hole *)(pkt_buff + IP_HDR_SIZE);
 	offset8 =  (ip_off & IP_OFFS);
-	thisfrag = payload + offset8;
 	start = offset8 * 8;
 	len = ntohs(ip->ip_len) - IP_HDR_SIZE;
 
 	if (start + len > IP_MAXUDP) /* fragment extends too far */
 		return NULL;
 
-	if (!total_len || localip->ip_id != ip->ip_id) {
-		/* new (or different) packet, reset structs */
-		total_len = 0xffff;
-		payload[0].last_byte = ~0;
-		payload[0].next_hole = 0;
-		payload[0].prev_hole = 0;
-		first_hole = 0;
-		/* any IP header will work, copy the first we received */
-		memcpy(localip, ip, IP_HDR_SIZE);
-	}
+	d = ip_defrag_slot(ip);
+	localip = (struct ip_udp_hdr *)d->pkt_buff;
+	/* payload starts after IP header, this fragment is in there */
+	payload = (struct hole *)(d->pkt_buff + IP_HDR_SIZE);
+	thisfrag = payload + offset8;
 
 	/*
 	 * What follows is the reassembly algorithm. We use the payload
@@ -942,7 +1041,7 @@ static struct ip_udp_hdr *__net_defragment(struct ip_udp_hdr *ip, int *lenp)
 	 * so it is represented as byte count, not as 8-byte blocks.
 	 */
 
-	h = payload + first_hole;
+	h = payload + d->first_hole;
 	while (h->last_byte < start) {
 		if (!h->next_hole) {
 			/* no hole that far away */
@@ -959,7 +1058,7 @@ static struct ip_udp_hdr *__net_defragment(struct ip_udp_hdr *ip, int *lenp)
 
 	if (!(ip_off & IP_FLAGS_MFRAG)) {
 		/* no more fragmentss: truncate this (last) hole */
-		total_len = start + len;
+		d->total_len = start + len;
 		h->last_byte = start + len;
 	}
 
@@ -976,7 +1075,7 @@ static struct ip_udp_hdr *__net_defragment(struct ip_udp_hdr *ip, int *lenp)
 			done = 1;
 		} else if (!h->prev_hole) {
 			/* first hole */
-			first_hole = h->next_hole;
+			d->first_hole = h->next_hole;
 			payload[h->next_hole].prev_hole = 0;
 		} else if (!h->next_hole) {
 			/* last hole */
@@ -1001,7 +1100,7 @@ static struct ip_udp_hdr *__net_defragment(struct ip_udp_hdr *ip, int *lenp)
 		if (h->prev_hole)
 			payload[h->prev_hole].next_hole = (h - payload);
 		else
-			first_hole = (h - payload);
+			d->first_hole = (h - payload);
 
 	} else {
 		/* fragment sits in the middle: split the hole */
@@ -1019,8 +1118,10 @@ static struct ip_udp_hdr *__net_defragment(struct ip_udp_hdr *ip, int *lenp)
 	if (!done)
 		return NULL;
 
-	localip->ip_len = htons(total_len);
-	*lenp = total_len + IP_HDR_SIZE;
+	localip->ip_len = htons(d->total_len);
+	*lenp = d->total_len + IP_HDR_SIZE;
+	/* The data stays there until a new datagram takes the slot */
+	d->total_len = 0;
 	return localip;
 }
 
@@ -1078,7 +1179,46 @@ static void receive_icmp(struct ip_udp_hdr *ip, int len,
 	}
 }
 
-void net_process_received_packet(uchar *in_packet, int len)
+/* Checksum of the UDP/TCP pseudo header for a segment of 'len' bytes */
+static unsigned net_pseudo_csum(struct ip_udp_hdr *ip, unsigned len)
+{
+	u16 pseudo[6];
+
+	memcpy(&pseudo[0], &ip->ip_src, 4);
+	memcpy(&pseudo[2], &ip->ip_dst, 4);
+	pseudo[4] = htons(ip->ip_p);
+	pseudo[5] = htons(len);
+
+	return compute_ip_checksum(pseudo, sizeof(pseudo));
+}
+
+bool net_rx_l4_csum_ok(struct ip_udp_hdr *ip)
+{
+	unsigned ip_len = ntohs(ip->ip_len);
+	unsigned sum;
+
+	if (net_rx_csum.flags & ETH_CSUM_L4)
+		return true;
+	if (!(net_rx_csum.flags & ETH_CSUM_COMPLETE))
+		return false;
+
+	/*
+	 * The IP header is known to sum to zero, so the hardware sum is that
+	 * of the UDP/TCP segment plus any padding at the end of the frame.
+	 * Take the padding out and the pseudo header in.
+	 */
+	sum = ~net_rx_csum.sum & 0xffff;
+	if (net_rx_ip_frame_len > ip_len)
+		sum = add_ip_checksums(ip_len, sum, ~compute_ip_checksum(
+				(uchar *)ip + ip_len,
+				net_rx_ip_frame_len - ip_len) & 0xffff);
+	sum = add_ip_checksums(0, sum,
+			       net_pseudo_csum(ip, ip_len - IP_HDR_SIZE));
+
+	return !(sum & 0xfffe);
+}
+
+static void __net_process_received_packet(uchar *in_packet, int len)
 {
 	struct ethernet_hdr *et;
 	struct ip_udp_hdr *ip;
@@ -1203,8 +1343,10 @@ void net_process_received_packet(uchar *in_packet, int len)
 		/* Check the packet length */
 		if (len < ntohs(ip->ip_len)) {
 			debug("len bad %d < %d\n", len, ntohs(ip->ip_len));
+			net_stats_inc(rx_dropped);
 			return;
 		}
+		net_rx_ip_frame_len = len;
 		len = ntohs(ip->ip_len);
 		debug_cond(DEBUG_NET_PKT, "len=%d, v=%02x\n",
 			   len, ip->ip_hl_v & 0xff);
@@ -1216,9 +1358,16 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if ((ip->ip_hl_v & 0x0f) > 0x05)
 			return;
 		/* Check the Checksum of the header */
-		if (!ip_checksum_ok((uchar *)ip, IP_HDR_SIZE)) {
-			debug("checksum bad\n");
-			return;
+		if (!(net_rx_csum.flags & ETH_CSUM_IP)) {
+			u64 start = net_stats_start();
+			int ok = ip_checksum_ok((uchar *)ip, IP_HDR_SIZE);
+
+			net_stats_stop(NET_STAGE_CSUM, start);
+			if (!ok) {
+				debug("checksum bad\n");
+				net_stats_inc(rx_dropped);
+				return;
+			}
 		}
 		/* If it is not for us, ignore it */
 		dst_ip = net_read_ip(&ip->ip_dst);
@@ -1233,6 +1382,9 @@ void net_process_received_packet(uchar *in_packet, int len)
 		 * a fragment, and either the complete packet or NULL if
 		 * it is a fragment (if !CONFIG_IP_DEFRAG, it returns NULL)
 		 */
+		/* The hardware cannot check a datagram sent in fragments */
+		if (ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG))
+			net_rx_csum.flags &= ~(ETH_CSUM_L4 | ETH_CSUM_COMPLETE);
 		ip = net_defragment(ip, &len);
 		if (!ip)
 			return;
@@ -1260,6 +1412,14 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#if defined(CONFIG_PROT_TCP)
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			debug_cond(DEBUG_DEV_PKT,
+				   "received TCP (to=%pI4, from=%pI4, len=%d)\n",
+				   &dst_ip, &src_ip, len);
+			tcp_receive((struct ip_tcp_hdr *)ip, len);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1272,42 +1432,19 @@ void net_process_received_packet(uchar *in_packet, int len)
 			   &dst_ip, &src_ip, len);
 
 #ifdef CONFIG_UDP_CHECKSUM
-		if (ip->udp_xsum != 0) {
-			ulong   xsum;
-			ushort *sumptr;
-			ushort  sumlen;
-
-			xsum  = ip->ip_p;
-			xsum += (ntohs(ip->udp_len));
-			xsum += (ntohl(ip->ip_src.s_addr) >> 16) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_src.s_addr) >>  0) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_dst.s_addr) >> 16) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_dst.s_addr) >>  0) & 0x0000ffff;
-
-			sumlen = ntohs(ip->udp_len);
-			sumptr = (ushort *)&(ip->udp_src);
-
-			while (sumlen > 1) {
-				ushort sumdata;
-
-				sumdata = *sumptr++;
-				xsum += ntohs(sumdata);
-				sumlen -= 2;
-			}
-			if (sumlen > 0) {
-				ushort sumdata;
-
-				sumdata = *(unsigned char *)sumptr;
-				sumdata = (sumdata << 8) & 0xff00;
-				xsum += sumdata;
-			}
-			while ((xsum >> 16) != 0) {
-				xsum = (xsum & 0x0000ffff) +
-				       ((xsum >> 16) & 0x0000ffff);
-			}
-			if ((xsum != 0x00000000) && (xsum != 0x0000ffff)) {
-				printf(" UDP wrong checksum %08lx %08x\n",
-				       xsum, ntohs(ip->udp_xsum));
+		if (ip->udp_xsum != 0 && !net_rx_l4_csum_ok(ip)) {
+			u64	start = net_stats_start();
+			unsigned udp_len = ntohs(ip->udp_len);
+			unsigned sum;
+
+			sum = add_ip_checksums(0, net_pseudo_csum(ip, udp_len),
+					       compute_ip_checksum(&ip->udp_src,
+								   udp_len));
+			net_stats_stop(NET_STAGE_CSUM, start);
+			if (sum & 0xfffe) {
+				printf(" UDP wrong checksum %04x %04x\n",
+				       sum, ntohs(ip->udp_xsum));
+				net_stats_inc(rx_dropped);
 				return;
 			}
 		}
@@ -1337,6 +1474,23 @@ void net_process_received_packet(uchar *in_packet, int len)
 	}
 }
 
+void net_process_received_packet(uchar *in_packet, int len)
+{
+	u64 start = net_stats_start();
+
+	net_stats_inc(rx_packets);
+	net_stats_add(rx_bytes, len);
+#ifndef CONFIG_DM_ETH
+	/* Legacy drivers pass their packets up from within recv */
+	eth_rx_csum(in_packet, len);
+#endif
+	__net_process_received_packet(in_packet, len);
+#ifndef CONFIG_DM_ETH
+	net_rx_csum.flags = 0;
+#endif
+	net_stats_stop(NET_STAGE_RX, start);
+}
+
 /**********************************************************************/
 
 static int net_check_prereq(enum proto_t protocol)
@@ -1369,10 +1523,14 @@ static int net_check_prereq(enum proto_t protocol)
 #endif
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 		/* Fall through */
 	case TFTPGET:
 	case TFTPPUT:
+	case TFTPSTRIPE:
 		if (net_server_ip.s_addr == 0 && !is_serverip_in_cmd()) {
 			puts("*** ERROR: `serverip' not set\n");
 			return 1;
@@ -1571,6 +1729,35 @@ int net_parse_bootfile(struct in_addr *ipaddr, char *filename, int max_len)
 	return 1;
 }
 
+int net_init_load_addr(ulong *addr, ulong *size)
+{
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+	phys_size_t max_size;
+
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+
+	max_size = lmb_get_free_size(&lmb, load_addr);
+	if (!max_size)
+		return -1;
+
+	*size = max_size;
+#else
+	*size = ~0UL;
+#endif
+	*addr = load_addr;
+	return 0;
+}
+
+void net_show_progress(int *num_hash, ulong bytes)
+{
+	while (*num_hash < bytes / NET_HASH_BYTES) {
+		putc('#');
+		if (++*num_hash % NET_HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+}
+
 #if	defined(CONFIG_CMD_NFS)		|| \
 	defined(CONFIG_CMD_SNTP)	|| \
 	defined(CONFIG_CMD_DNS)
@@ -28,6 +28,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <env.h>
 #include <net.h>
 #include <malloc.h>
 #include <mapmem.h>
@@ -35,6 +36,7 @@
 #include "bootp.h"
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
+#define HASH_BYTES	((NFS_READ_SIZE / 2) * 10)	/* Bytes per hash */
 #define NFS_RETRY_COUNT 30
 #ifndef CONFIG_NFS_TIMEOUT
 # define NFS_TIMEOUT 2000UL
@@ -47,10 +49,27 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/*
+ * READ requests in flight. Each one covers its own range of the file and
+ * its reply is matched by XID, so replies may come back in any order.
+ */
+struct nfs_read_slot {
+	unsigned long xid;
+	ulong offset;
+	unsigned int len;
+	bool busy;
+};
+
+static struct nfs_read_slot nfs_read_slots[NFS_READ_WINDOW_MAX];
+static int nfs_read_window;
+static unsigned int nfs_rsize;		/* bytes asked for by each READ */
+static ulong nfs_next_offset;		/* start of the next READ to send */
+static ulong nfs_eof_offset;		/* file size, ~0 while unknown */
+static ulong nfs_received;		/* bytes received so far */
+static int nfs_num_hash;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -69,6 +88,7 @@ static int nfs_state;
 #define STATE_LOOKUP_REQ		5
 #define STATE_READ_REQ			6
 #define STATE_READLINK_REQ		7
+#define STATE_FSINFO_REQ		8
 
 static char *nfs_filename;
 static char *nfs_path;
@@ -78,7 +98,7 @@ static char nfs_path_buff[2048];
 #define NFSV3_FLAG 1 << 1
 static char supported_nfs_versions = NFSV2_FLAG | NFSV3_FLAG;
 
-static inline int store_block(uchar *src, unsigned offset, unsigned len)
+static inline int store_block(uchar *src, ulong offset, unsigned len)
 {
 	ulong newsize = offset + len;
 #ifdef CONFIG_SYS_DIRECT_FLASH_NFS
@@ -102,8 +122,10 @@ static inline int store_block(uchar *src, unsigned offset, unsigned len)
 #endif /* CONFIG_SYS_DIRECT_FLASH_NFS */
 	{
 		void *ptr = map_sysmem(load_addr + offset, len);
+		u64 start = net_stats_start();
 
 		memcpy(ptr, src, len);
+		net_stats_stop(NET_STAGE_COPY, start);
 		unmap_sysmem(ptr);
 	}
 
@@ -168,17 +190,16 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 }
 
 /**************************************************************************
-RPC_LOOKUP - Lookup RPC Port numbers
+RPC_SEND - Send an RPC call with a given XID
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static void rpc_send(unsigned long id, int rpc_prog, int rpc_proc,
+		     uint32_t *data, int datalen)
 {
 	struct rpc_t rpc_pkt;
-	unsigned long id;
 	uint32_t *p;
 	int pktlen;
 	int sport;
 
-	id = ++rpc_id;
 	rpc_pkt.u.call.id = htonl(id);
 	rpc_pkt.u.call.type = htonl(MSG_CALL);
 	rpc_pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
@@ -217,6 +238,14 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 			    nfs_our_port, pktlen);
 }
 
+/**************************************************************************
+RPC_REQ - Send an RPC call with a new XID
+**************************************************************************/
+static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+{
+	rpc_send(++rpc_id, rpc_prog, rpc_proc, data, datalen);
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
@@ -353,10 +382,31 @@ static void nfs_lookup_req(char *fname)
 	}
 }
 
+/**************************************************************************
+NFS_FSINFO - Get the transfer sizes supported by an NFSv3 server
+**************************************************************************/
+static void nfs_fsinfo_req(void)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	int len;
+
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	*p++ = htonl(filefh3_length);
+	memcpy(p, filefh, filefh3_length);
+	p += (filefh3_length / 4);
+
+	len = (uint32_t *)p - (uint32_t *)&(data[0]);
+
+	rpc_req(PROG_NFS, NFS3PROC_FSINFO, data, len);
+}
+
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static void nfs_read_req(struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -368,22 +418,99 @@ static void nfs_read_req(int offset, int readlen)
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		memcpy(p, filefh, NFS_FHSIZE);
 		p += (NFS_FHSIZE / 4);
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
 		*p++ = 0;
 	} else { /* NFSV3_FLAG */
 		*p++ = htonl(filefh3_length);
 		memcpy(p, filefh, filefh3_length);
 		p += (filefh3_length / 4);
-		*p++ = htonl(0); /* offset is 64-bit long, so fill with 0 */
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl((u64)slot->offset >> 32);
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
 		*p++ = 0;
 	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	rpc_send(slot->xid, PROG_NFS, NFS_READ, data, len);
+}
+
+/* Send READ requests for the next parts of the file into free slots */
+static void nfs_read_fill(void)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		struct nfs_read_slot *slot = &nfs_read_slots[i];
+
+		if (slot->busy)
+			continue;
+		if (nfs_next_offset >= nfs_eof_offset)
+			return;
+
+		slot->xid = ++rpc_id;
+		slot->offset = nfs_next_offset;
+		slot->len = nfs_rsize;
+		slot->busy = true;
+		nfs_next_offset += nfs_rsize;
+		nfs_read_req(slot);
+	}
+}
+
+/* Check whether every part of the file up to its end has been received */
+static bool nfs_read_done(void)
+{
+	int i;
+
+	if (nfs_eof_offset == ~0UL)
+		return false;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].busy &&
+		    nfs_read_slots[i].offset < nfs_eof_offset)
+			return false;
+	}
+
+	return true;
+}
+
+/* Largest READ reply we can reassemble, as a power of two */
+static unsigned int nfs_max_read_size(void)
+{
+	unsigned int size = NFS_READ_SIZE;
+
+#ifdef CONFIG_IP_DEFRAG
+	while (size < NFS3_MAX_READ_SIZE &&
+	       size * 2 + NFS_READ_OVERHEAD <= CONFIG_NET_MAXDEFRAG)
+		size *= 2;
+#endif
+
+	return size;
+}
+
+static void nfs_read_start(unsigned int rsize)
+{
+	char *ep;
+
+	nfs_read_window = CONFIG_NFS_READ_WINDOW;
+	ep = env_get("nfsreadwindow");
+	if (ep)
+		nfs_read_window = simple_strtol(ep, NULL, 10);
+	nfs_read_window = clamp(nfs_read_window, 1, NFS_READ_WINDOW_MAX);
+
+	nfs_rsize = rsize;
+	debug("NFS read size %u, %d requests in flight\n", nfs_rsize,
+	      nfs_read_window);
+
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+	nfs_next_offset = 0;
+	nfs_eof_offset = ~0UL;
+	nfs_received = 0;
+	nfs_num_hash = 0;
+
+	nfs_state = STATE_READ_REQ;
+	nfs_read_fill();
 }
 
 /**************************************************************************
@@ -391,6 +518,8 @@ RPC request dispatcher
 **************************************************************************/
 static void nfs_send(void)
 {
+	int i;
+
 	debug("%s\n", __func__);
 
 	switch (nfs_state) {
@@ -415,8 +544,14 @@ static void nfs_send(void)
 	case STATE_LOOKUP_REQ:
 		nfs_lookup_req(nfs_filename);
 		break;
+	case STATE_FSINFO_REQ:
+		nfs_fsinfo_req();
+		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		for (i = 0; i < nfs_read_window; i++) {
+			if (nfs_read_slots[i].busy)
+				nfs_read_req(&nfs_read_slots[i]);
+		}
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -659,21 +794,75 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+/* Return the read size to use from the FSINFO reply, 0 on error */
+static int nfs_fsinfo_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
-	uchar *data_ptr;
+	unsigned int max = nfs_max_read_size();
+	unsigned int rtmax, size;
+	int nfsv3_data_offset;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	memcpy(&rpc_pkt.u.data[0], pkt, len);
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
 	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
 		return -NFS_RPC_DROP;
 
+	if (rpc_pkt.u.reply.rstatus  ||
+	    rpc_pkt.u.reply.verifier ||
+	    rpc_pkt.u.reply.astatus  ||
+	    rpc_pkt.u.reply.data[0])
+		return 0;
+
+	nfsv3_data_offset = nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
+	if ((uchar *)&rpc_pkt.u.reply.data[2 + nfsv3_data_offset] -
+	    (uchar *)&rpc_pkt > len)
+		return 0;
+
+	/* Largest read size the server accepts, as a power of two */
+	rtmax = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+	debug("NFS server rtmax %u\n", rtmax);
+	for (size = max; size > 4 && size > rtmax; size /= 2)
+		;
+
+	return size;
+}
+
+/**
+ * nfs_read_reply() - store the data of a READ reply
+ *
+ * The reply may be larger than struct rpc_t, so only its header is copied
+ * and the data is taken from the packet.
+ *
+ * @return number of bytes stored, -NFS_RPC_DROP for a reply we do not
+ * expect, another negative value on error
+ */
+static int nfs_read_reply(uchar *pkt, unsigned len)
+{
+	struct rpc_t rpc_pkt;
+	struct nfs_read_slot *slot = NULL;
+	unsigned long id;
+	int rlen;
+	uchar *data_ptr;
+	bool eof;
+	int i;
+
+	debug("%s\n", __func__);
+
+	memcpy(&rpc_pkt.u.data[0], pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt.u.reply)));
+
+	id = ntohl(rpc_pkt.u.reply.id);
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].busy && nfs_read_slots[i].xid == id)
+			slot = &nfs_read_slots[i];
+	}
+	if (!slot)
+		return -NFS_RPC_DROP;
+
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
 	    rpc_pkt.u.reply.astatus  ||
@@ -685,34 +874,57 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
 		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		/* NFSv2 only returns less than asked for at the end */
+		eof = rlen < slot->len;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset] || !rlen;
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
 		data_ptr = (uchar *)
 			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
 	}
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	/* Point at the data in the packet rather than in our copy */
+	data_ptr = pkt + (data_ptr - (uchar *)&rpc_pkt);
+	if (rlen < 0 || rlen > slot->len || data_ptr + rlen > pkt + len)
+		return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	if (store_block(data_ptr, slot->offset, rlen))
+		return -9999;
+
+	nfs_received += rlen;
+	while (nfs_num_hash < nfs_received / HASH_BYTES) {
+		putc('#');
+		if (++nfs_num_hash % HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+
+	if (eof) {
+		nfs_eof_offset = min(nfs_eof_offset, slot->offset + rlen);
+		slot->busy = false;
+	} else if (rlen < slot->len) {
+		/*
+		 * The server sends no more than its own read size: ask again
+		 * for the rest and use that size from now on
+		 */
+		debug("NFS short read %d, rsize was %u\n", rlen, nfs_rsize);
+		nfs_rsize = min(nfs_rsize, (unsigned int)rlen);
+		slot->xid = ++rpc_id;
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_req(slot);
+	} else {
+		slot->busy = false;
+	}
 
 	return rlen;
 }
@@ -727,9 +939,11 @@ static void nfs_timeout_handler(void)
 		net_start_again();
 	} else {
 		puts("T ");
+		net_stats_inc(timeouts);
 		net_set_timeout_handler(nfs_timeout +
 					NFS_TIMEOUT * nfs_timeout_count,
 					nfs_timeout_handler);
+		net_stats_inc(retransmits);
 		nfs_send();
 	}
 }
@@ -739,10 +953,12 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 {
 	int rlen;
 	int reply;
+	int rsize;
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* READ replies are parsed in place and may be larger */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
 		return;
 
 	if (dest != nfs_our_port)
@@ -807,14 +1023,25 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			/* And retry with another supported version */
 			nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 			nfs_send();
+		} else if (supported_nfs_versions & NFSV2_FLAG) {
+			nfs_read_start(min(nfs_max_read_size(),
+					   (unsigned int)NFS2_MAX_READ_SIZE));
 		} else {
-			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			/* Ask the server for the largest read it accepts */
+			nfs_state = STATE_FSINFO_REQ;
 			nfs_send();
 		}
 		break;
 
+	case STATE_FSINFO_REQ:
+		rsize = nfs_fsinfo_reply(pkt, len);
+		if (rsize == -NFS_RPC_DROP)
+			break;
+		if (!rsize || rsize == -NFS_RPC_ERR)
+			rsize = NFS_READ_SIZE;
+		nfs_read_start(rsize);
+		break;
+
 	case STATE_READLINK_REQ:
 		reply = nfs_readlink_reply(pkt, len);
 		if (reply == -NFS_RPC_DROP) {
@@ -837,16 +1064,16 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		rlen = nfs_read_reply(pkt, len);
 		if (rlen == -NFS_RPC_DROP)
 			break;
+		nfs_timeout_count = 0;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && !nfs_read_done()) {
+			nfs_read_fill();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
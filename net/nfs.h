@@ -25,6 +25,7 @@
 #define NFS_READ        6
 
 #define NFS3PROC_LOOKUP 3
+#define NFS3PROC_FSINFO 19
 
 #define NFS_FHSIZE      32
 #define NFS3_FHSIZE     64
@@ -44,6 +45,16 @@
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
 #define NFS_MAX_ATTRS	26
 
+/* Largest read size allowed by NFSv2 (NFS_MAXDATA) and wanted with NFSv3 */
+#define NFS2_MAX_READ_SIZE	8192
+#define NFS3_MAX_READ_SIZE	32768
+
+/* Room for the IP, UDP and RPC headers in front of the data of a READ reply */
+#define NFS_READ_OVERHEAD	256
+
+/* Largest number of READ requests in flight at a time */
+#define NFS_READ_WINDOW_MAX	16
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
@@ -0,0 +1,392 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * This handles a single active connection, which is all a boot loader
+ * needs to stream a file from a server: the three-way handshake, sending
+ * a small request, receiving the byte stream in order and closing.
+ *
+ * Received data is handed to the application as soon as it arrives in
+ * order, so the receive window never fills up and we can advertise a fixed
+ * window of several segments, letting the server keep the link busy. Out of
+ * order segments are not queued: they are answered with a duplicate ACK so
+ * the server retransmits the missing data (fast retransmit).
+ */
+
+#include <common.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <asm/unaligned.h>
+
+/* Milliseconds to wait for the peer before retransmitting */
+#define TCP_TIMEOUT		2000UL
+/* Number of timeouts before giving up */
+#define TCP_RETRY_MAX		10
+
+#ifdef CONFIG_TCP_RCV_WINDOW
+#define TCP_RCV_WINDOW		CONFIG_TCP_RCV_WINDOW
+#else
+#define TCP_RCV_WINDOW		8
+#endif
+
+static enum tcp_state tcp_state;
+static rxhand_tcp_f *tcp_handler;
+static int tcp_retry;
+
+static struct in_addr tcp_remote_ip;
+static int tcp_remote_port;
+static int tcp_our_port;
+
+/* first unacknowledged and next sequence number we send */
+static u32 tcp_snd_una;
+static u32 tcp_snd_nxt;
+/* initial and next expected sequence number of the peer */
+static u32 tcp_irs;
+static u32 tcp_rcv_nxt;
+
+/* copy of the unacknowledged segment, for retransmission */
+static uchar tcp_tx_data[TCP_MSS];
+static int tcp_tx_len;
+static u8 tcp_tx_flags;
+
+static void tcp_timeout_handler(void);
+
+/* Sequence number comparisons, modulo 2^32 */
+static inline bool tcp_seq_lt(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline bool tcp_seq_le(u32 a, u32 b)
+{
+	return (s32)(a - b) <= 0;
+}
+
+static void tcp_notify(enum tcp_event event, u32 offset, uchar *data,
+		       unsigned int len)
+{
+	if (tcp_handler)
+		tcp_handler(event, offset, data, len);
+}
+
+void tcp_set_tcp_handler(rxhand_tcp_f *f)
+{
+	tcp_handler = f;
+}
+
+enum tcp_state tcp_get_state(void)
+{
+	return tcp_state;
+}
+
+u16 tcp_checksum(struct in_addr src, struct in_addr dst, const void *seg,
+		 int len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} __attribute__((packed)) pseudo;
+
+	net_copy_ip(&pseudo.src, &src);
+	net_copy_ip(&pseudo.dst, &dst);
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(len);
+
+	return add_ip_checksums(sizeof(pseudo),
+				compute_ip_checksum(&pseudo, sizeof(pseudo)),
+				compute_ip_checksum(seg, len));
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 tcp_seq_num,
+		       u32 tcp_ack_num)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)pkt;
+	uchar *opt = pkt + IP_TCP_HDR_SIZE;
+	int hdr_len = TCP_HDR_SIZE;
+
+	/* Announce the segment size we can take, only allowed in a SYN */
+	if (action & TCP_SYN) {
+		opt[0] = TCP_O_MSS;
+		opt[1] = TCP_O_MSS_LEN;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		hdr_len += TCP_O_MSS_LEN;
+	}
+
+	net_set_ip_header(pkt, dest, net_ip, IP_HDR_SIZE + hdr_len +
+			  payload_len, IPPROTO_TCP);
+
+	ip->tcp_src = htons(sport);
+	ip->tcp_dst = htons(dport);
+	ip->tcp_seq = htonl(tcp_seq_num);
+	ip->tcp_ack = htonl(tcp_ack_num);
+	ip->tcp_hlen = (hdr_len / 4) << 4;
+	ip->tcp_flags = action;
+	/* No window scaling, jumbo segments may not all fit */
+	ip->tcp_win = htons(min_t(uint, TCP_RCV_WINDOW * TCP_MSS, 0xffff));
+	ip->tcp_xsum = 0;
+	ip->tcp_ugr = 0;
+	ip->tcp_xsum = tcp_checksum(net_ip, dest, pkt + IP_HDR_SIZE,
+				    hdr_len + payload_len);
+
+	return IP_HDR_SIZE + hdr_len;
+}
+
+static void tcp_send_segment(u32 seq, u8 action, const void *data, int len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+
+	if (tcp_state != TCP_SYN_SENT)
+		action |= TCP_ACK;
+	if (len)
+		memcpy(pkt, data, len);
+
+	net_send_ip_packet(net_server_ethaddr, tcp_remote_ip, tcp_remote_port,
+			   tcp_our_port, len, IPPROTO_TCP, action, seq,
+			   tcp_rcv_nxt);
+}
+
+/* (Re)send the segment waiting for an ACK, or just our ACK */
+static void tcp_retransmit(void)
+{
+	if (tcp_seq_lt(tcp_snd_una, tcp_snd_nxt)) {
+		net_stats_inc(retransmits);
+		tcp_send_segment(tcp_snd_una, tcp_tx_flags, tcp_tx_data,
+				 tcp_tx_len);
+	} else {
+		tcp_send_segment(tcp_snd_nxt, 0, NULL, 0);
+	}
+}
+
+/* Send a segment that occupies sequence space and keep it until ACKed */
+static void tcp_queue_segment(u8 action, const void *data, int len)
+{
+	if (len)
+		memcpy(tcp_tx_data, data, len);
+	tcp_tx_len = len;
+	tcp_tx_flags = action;
+	tcp_snd_nxt = tcp_snd_una + len + !!(action & (TCP_SYN | TCP_FIN));
+	tcp_retry = 0;
+	net_set_timeout_handler(TCP_TIMEOUT, tcp_timeout_handler);
+	tcp_send_segment(tcp_snd_una, action, data, len);
+}
+
+static void tcp_timeout_handler(void)
+{
+	if (++tcp_retry > TCP_RETRY_MAX) {
+		puts("\nTCP: retry count exceeded\n");
+		tcp_abort();
+		tcp_notify(TCP_EV_ABORTED, 0, NULL, 0);
+		return;
+	}
+
+	debug("TCP: timeout, state %d, retry %d\n", tcp_state, tcp_retry);
+	net_stats_inc(timeouts);
+	net_set_timeout_handler(TCP_TIMEOUT, tcp_timeout_handler);
+	tcp_retransmit();
+}
+
+int tcp_connect(struct in_addr dest, int dport)
+{
+	tcp_remote_ip = dest;
+	tcp_remote_port = dport;
+	/* Use a pseudo-random port and initial sequence number */
+	tcp_our_port = 1024 + (get_timer(0) % 3072);
+	tcp_snd_una = (u32)get_ticks();
+	tcp_rcv_nxt = 0;
+
+	/* zero out server ether in case the server ip has changed */
+	memset(net_server_ethaddr, 0, 6);
+
+	tcp_state = TCP_SYN_SENT;
+	tcp_queue_segment(TCP_SYN, NULL, 0);
+
+	return 0;
+}
+
+int tcp_send(const void *data, int len)
+{
+	if (tcp_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+	if (len > TCP_MSS)
+		return -EMSGSIZE;
+	if (tcp_seq_lt(tcp_snd_una, tcp_snd_nxt))
+		return -EBUSY;
+
+	tcp_queue_segment(TCP_PUSH, data, len);
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp_state != TCP_ESTABLISHED)
+		return;
+
+	tcp_state = TCP_FIN_WAIT;
+	tcp_queue_segment(TCP_FIN, NULL, 0);
+}
+
+void tcp_abort(void)
+{
+	if (tcp_state != TCP_CLOSED)
+		tcp_send_segment(tcp_snd_nxt, TCP_RST, NULL, 0);
+	tcp_state = TCP_CLOSED;
+	net_set_timeout_handler(0, NULL);
+}
+
+/* Get the MSS announced by the peer, we only use it to check our sends */
+static void tcp_parse_options(uchar *opt, int len)
+{
+	while (len > 0) {
+		if (opt[0] == TCP_O_END)
+			break;
+		if (opt[0] == TCP_O_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		if (opt[0] == TCP_O_MSS && opt[1] == TCP_O_MSS_LEN)
+			debug("TCP: peer MSS %d\n", get_unaligned_be16(opt + 2));
+		len -= opt[1];
+		opt += opt[1];
+	}
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, int len)
+{
+	int tcp_len = len - IP_HDR_SIZE;
+	int hdr_len;
+	uchar *data;
+	int data_len;
+	u32 seq, ack;
+	u8 flags;
+
+	if (tcp_state == TCP_CLOSED || !tcp_handler || len < IP_TCP_HDR_SIZE)
+		return;
+
+	hdr_len = (ip->tcp_hlen >> 4) * 4;
+	if (hdr_len < TCP_HDR_SIZE || hdr_len > tcp_len)
+		return;
+
+	if (ntohs(ip->tcp_dst) != tcp_our_port ||
+	    ntohs(ip->tcp_src) != tcp_remote_port ||
+	    net_read_ip(&ip->ip_src).s_addr != tcp_remote_ip.s_addr)
+		return;
+
+	if (!net_rx_l4_csum_ok((struct ip_udp_hdr *)ip)) {
+		u64 start = net_stats_start();
+		u16 sum = tcp_checksum(net_read_ip(&ip->ip_src),
+				       net_read_ip(&ip->ip_dst),
+				       (uchar *)ip + IP_HDR_SIZE, tcp_len);
+
+		net_stats_stop(NET_STAGE_CSUM, start);
+		if (sum & 0xfffe) {
+			debug("TCP: bad checksum\n");
+			net_stats_inc(rx_dropped);
+			return;
+		}
+	}
+
+	seq = ntohl(ip->tcp_seq);
+	ack = ntohl(ip->tcp_ack);
+	flags = ip->tcp_flags;
+	data = (uchar *)ip + IP_HDR_SIZE + hdr_len;
+	data_len = tcp_len - hdr_len;
+
+	if (flags & TCP_RST) {
+		debug("TCP: connection reset\n");
+		tcp_state = TCP_CLOSED;
+		net_set_timeout_handler(0, NULL);
+		tcp_notify(TCP_EV_ABORTED, 0, NULL, 0);
+		return;
+	}
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if ((flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK) ||
+		    ack != tcp_snd_nxt)
+			return;
+
+		tcp_parse_options((uchar *)ip + IP_TCP_HDR_SIZE,
+				  hdr_len - TCP_HDR_SIZE);
+		tcp_irs = seq;
+		tcp_rcv_nxt = seq + 1;
+		tcp_snd_una = ack;
+		tcp_state = TCP_ESTABLISHED;
+		tcp_retry = 0;
+		net_set_timeout_handler(TCP_TIMEOUT, tcp_timeout_handler);
+		tcp_send_segment(tcp_snd_nxt, 0, NULL, 0);
+		tcp_notify(TCP_EV_CONNECTED, 0, NULL, 0);
+		return;
+	}
+
+	/* Anything else must carry an ACK */
+	if (!(flags & TCP_ACK))
+		return;
+
+	/* The peer is alive, restart the retransmission timer */
+	tcp_retry = 0;
+	net_set_timeout_handler(TCP_TIMEOUT, tcp_timeout_handler);
+
+	if (tcp_seq_lt(tcp_snd_una, ack) && tcp_seq_le(ack, tcp_snd_nxt))
+		tcp_snd_una = ack;
+
+	if (tcp_state == TCP_LAST_ACK) {
+		if (tcp_snd_una == tcp_snd_nxt) {
+			tcp_state = TCP_CLOSED;
+			net_set_timeout_handler(0, NULL);
+			tcp_notify(TCP_EV_CLOSED, 0, NULL, 0);
+		}
+		return;
+	}
+
+	if (!data_len && !(flags & TCP_FIN))
+		return;
+
+	if (seq != tcp_rcv_nxt) {
+		/* Trim data we already have, e.g. a partial retransmission */
+		if (tcp_seq_lt(seq, tcp_rcv_nxt) &&
+		    tcp_seq_lt(tcp_rcv_nxt, seq + data_len)) {
+			data += tcp_rcv_nxt - seq;
+			data_len -= tcp_rcv_nxt - seq;
+			seq = tcp_rcv_nxt;
+		} else {
+			/* Old duplicate or a gap: tell the peer what we need */
+			debug("TCP: unexpected seq %u, expected %u\n", seq,
+			      tcp_rcv_nxt);
+			tcp_send_segment(tcp_snd_nxt, 0, NULL, 0);
+			return;
+		}
+	}
+
+	if (data_len) {
+		tcp_rcv_nxt += data_len;
+		tcp_notify(TCP_EV_DATA, seq - tcp_irs - 1, data, data_len);
+		/* The handler may have closed or aborted the connection */
+		if (tcp_state == TCP_CLOSED)
+			return;
+	}
+
+	if (!(flags & TCP_FIN)) {
+		tcp_send_segment(tcp_snd_nxt, 0, NULL, 0);
+		return;
+	}
+
+	tcp_rcv_nxt++;
+	if (tcp_state == TCP_FIN_WAIT) {
+		/* Both sides are done; no need for TIME-WAIT in a loader */
+		tcp_send_segment(tcp_snd_nxt, 0, NULL, 0);
+		tcp_state = TCP_CLOSED;
+		net_set_timeout_handler(0, NULL);
+		tcp_notify(TCP_EV_CLOSED, 0, NULL, 0);
+	} else {
+		tcp_state = TCP_LAST_ACK;
+		tcp_queue_segment(TCP_FIN, NULL, 0);
+	}
+}
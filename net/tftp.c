@@ -14,14 +14,11 @@
 #include <net.h>
 #include <net/tftp.h>
 #include "bootp.h"
+#include "tftp_internal.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 #include <flash.h>
 #endif
 
-DECLARE_GLOBAL_DATA_PTR;
-
-/* Well known TFTP port # */
-#define WELL_KNOWN_PORT	69
 /* Millisecs to timeout for lost pkt */
 #define TIMEOUT		5000UL
 #ifndef	CONFIG_NET_RETRY_COUNT
@@ -30,19 +27,6 @@ DECLARE_GLOBAL_DATA_PTR;
 #else
 # define TIMEOUT_COUNT  (CONFIG_NET_RETRY_COUNT * 2)
 #endif
-/* Number of "loading" hashes per line (for checking the image size) */
-#define HASHES_PER_LINE	65
-
-/*
- *	TFTP operations.
- */
-#define TFTP_RRQ	1
-#define TFTP_WRQ	2
-#define TFTP_DATA	3
-#define TFTP_ACK	4
-#define TFTP_ERROR	5
-#define TFTP_OACK	6
-
 static ulong timeout_ms = TIMEOUT;
 static int timeout_count_max = TIMEOUT_COUNT;
 static ulong time_start;   /* Record time we started tftp */
@@ -85,9 +69,7 @@ static ulong	tftp_block_wrap;
 static ulong	tftp_block_wrap_offset;
 static int	tftp_state;
 static ulong	tftp_load_addr;
-#ifdef CONFIG_LMB
 static ulong	tftp_load_size;
-#endif
 #ifdef CONFIG_TFTP_TSIZE
 /* The file size reported by the server */
 static int	tftp_tsize;
@@ -111,8 +93,6 @@ static int	tftp_put_final_block_sent;
 #define STATE_RECV_WRQ	6
 #define STATE_SEND_WRQ	7
 
-/* default TFTP block size */
-#define TFTP_BLOCK_SIZE		512
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
 
@@ -127,19 +107,35 @@ static char default_filename[DEFAULT_NAME_LEN];
 
 static char tftp_filename[MAX_LEN];
 
-/* 512 is poor choice for ethernet, MTU is typically 1500.
- * Minus eth.hdrs thats 1468.  Can get 2x better throughput with
- * almost-MTU block sizes.  At least try... fall back to 512 if need be.
- * (but those using CONFIG_IP_DEFRAG may want to set a larger block in cfg file)
+static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
+static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
+
+/*
+ * RFC 7440 windowsize: the number of data blocks the server may send before
+ * waiting for an ACK. Without the option (or if the server ignores it) we
+ * stay in the RFC 1350 lock-step mode, i.e. a window of one block.
  */
-#ifdef CONFIG_TFTP_BLOCKSIZE
-#define TFTP_MTU_BLOCKSIZE CONFIG_TFTP_BLOCKSIZE
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
 #else
-#define TFTP_MTU_BLOCKSIZE 1468
+#define TFTP_WINDOWSIZE 1
 #endif
 
-static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
-static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = TFTP_WINDOWSIZE;
+/* block number at which the current window ends and must be ACKed */
+static ulong	tftp_next_ack;
+/* last block we re-ACKed because of a gap in the window, -1 if none */
+static long	tftp_last_nack;
+/* when that re-ACK was sent */
+static ulong	tftp_last_nack_time;
+/*
+ * The rest of a stale window arrives within a round trip of the re-ACK, the
+ * retransmitted window takes about as long again. Re-ACK the same block
+ * once this much time has passed, so losing the retransmission as well
+ * does not cost a full timeout.
+ */
+#define TFTP_NACK_HOLDOFF_MS	(timeout_ms / 8)
 
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
@@ -169,6 +165,7 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 #endif /* CONFIG_SYS_DIRECT_FLASH_TFTP */
 	{
 		void *ptr;
+		u64 start;
 
 #ifdef CONFIG_LMB
 		if (store_addr < tftp_load_addr ||
@@ -179,7 +176,12 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 		}
 #endif
 		ptr = map_sysmem(store_addr, len);
-		memcpy(ptr, src, len);
+		/* Nothing to do if the block was received in place */
+		if (ptr != src) {
+			start = net_stats_start();
+			memmove(ptr, src, len);
+			net_stats_stop(NET_STAGE_COPY, start);
+		}
 		unmap_sysmem(ptr);
 	}
 
@@ -189,12 +191,38 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+/*
+ * Ask the Ethernet device to receive the next packet so that its payload,
+ * if it is the DATA packet for @block, lands right where store_block()
+ * would copy it.
+ */
+static void tftp_post_block(int block)
+{
+#ifndef CONFIG_SYS_DIRECT_FLASH_TFTP
+	int header_len = net_eth_hdr_size() + IP_UDP_HDR_SIZE + 4;
+	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
+
+	/* The headers overwrite the end of the data stored so far */
+	if (offset < header_len)
+		return;
+#ifdef CONFIG_LMB
+	if (offset + tftp_block_size > tftp_load_size)
+		return;
+#endif
+	eth_post_rx_buf(map_sysmem(tftp_load_addr + offset - header_len,
+				   header_len + tftp_block_size),
+			header_len + tftp_block_size, header_len);
+#endif
+}
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_next_ack = tftp_windowsize;
+	tftp_last_nack = -1;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -246,7 +274,7 @@ static void show_block_marker(void)
 	{
 		if (((tftp_cur_block - 1) % 10) == 0)
 			putc('#');
-		else if ((tftp_cur_block % (10 * HASHES_PER_LINE)) == 0)
+		else if ((tftp_cur_block % (10 * NET_HASHES_PER_LINE)) == 0)
 			puts("\n\t ");
 	}
 }
@@ -323,30 +351,24 @@ static void tftp_send(void)
 	case STATE_SEND_RRQ:
 	case STATE_SEND_WRQ:
 		xp = pkt;
-		s = (ushort *)pkt;
 #ifdef CONFIG_CMD_TFTPPUT
-		*s++ = htons(tftp_state == STATE_SEND_RRQ ? TFTP_RRQ :
-			TFTP_WRQ);
+		pkt = tftp_put_request(pkt, tftp_state == STATE_SEND_RRQ ?
+				       TFTP_RRQ : TFTP_WRQ, tftp_filename);
 #else
-		*s++ = htons(TFTP_RRQ);
+		pkt = tftp_put_request(pkt, TFTP_RRQ, tftp_filename);
 #endif
-		pkt = (uchar *)s;
-		strcpy((char *)pkt, tftp_filename);
-		pkt += strlen(tftp_filename) + 1;
-		strcpy((char *)pkt, "octet");
-		pkt += 5 /*strlen("octet")*/ + 1;
-		strcpy((char *)pkt, "timeout");
-		pkt += 7 /*strlen("timeout")*/ + 1;
-		sprintf((char *)pkt, "%lu", timeout_ms / 1000);
-		debug("send option \"timeout %s\"\n", (char *)pkt);
-		pkt += strlen((char *)pkt) + 1;
+		pkt = tftp_put_option(pkt, "timeout", timeout_ms / 1000);
+		debug("send option \"timeout %lu\"\n", timeout_ms / 1000);
 #ifdef CONFIG_TFTP_TSIZE
-		pkt += sprintf((char *)pkt, "tsize%c%u%c",
-				0, net_boot_file_size, 0);
+		pkt = tftp_put_option(pkt, "tsize", net_boot_file_size);
 #endif
 		/* try for more effic. blk size */
-		pkt += sprintf((char *)pkt, "blksize%c%d%c",
-				0, tftp_block_size_option, 0);
+		pkt = tftp_put_option(pkt, "blksize", tftp_block_size_option);
+
+		/* try for more blocks in flight, only useful when reading */
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt = tftp_put_option(pkt, "windowsize",
+					      tftp_windowsize_option);
 		len = pkt - xp;
 		break;
 
@@ -417,7 +439,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 {
 	__be16 proto;
 	__be16 *s;
-	int i;
+	unsigned int pos;
+	char *opt;
+	ulong val;
 
 	if (dest != tftp_our_port) {
 			return;
@@ -478,25 +502,26 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		      pkt, pkt + strlen((char *)pkt) + 1);
 		tftp_state = STATE_OACK;
 		tftp_remote_port = src;
-		/*
-		 * Check for 'blksize' option.
-		 * Careful: "i" is signed, "len" is unsigned, thus
-		 * something like "len-8" may give a *huge* number
-		 */
-		for (i = 0; i+8 < len; i++) {
-			if (strcmp((char *)pkt + i, "blksize") == 0) {
-				tftp_block_size = (unsigned short)
-					simple_strtoul((char *)pkt + i + 8,
-						       NULL, 10);
-				debug("Blocksize ack: %s, %d\n",
-				      (char *)pkt + i + 8, tftp_block_size);
+		pos = 0;
+		while (tftp_next_option(pkt, len, &pos, &opt, &val)) {
+			if (strcasecmp(opt, "blksize") == 0) {
+				tftp_block_size = (unsigned short)val;
+				debug("Blocksize ack: %lu, %d\n", val,
+				      tftp_block_size);
+			}
+			if (strcasecmp(opt, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)val;
+				/* the server may only lower our request */
+				if (!tftp_windowsize ||
+				    tftp_windowsize > tftp_windowsize_option)
+					tftp_windowsize = 1;
+				debug("Windowsize ack: %lu, %d\n", val,
+				      tftp_windowsize);
 			}
 #ifdef CONFIG_TFTP_TSIZE
-			if (strcmp((char *)pkt+i, "tsize") == 0) {
-				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
-							   NULL, 10);
-				debug("size = %s, %d\n",
-				      (char *)pkt + i + 6, tftp_tsize);
+			if (strcasecmp(opt, "tsize") == 0) {
+				tftp_tsize = val;
+				debug("size = %lu, %d\n", val, tftp_tsize);
 			}
 #endif
 		}
@@ -515,8 +540,6 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		len -= 2;
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
-
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
 
@@ -542,6 +565,37 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			break;
 		}
 
+		if (tftp_cur_block !=
+		    (tftp_prev_block + 1) % TFTP_SEQUENCE_SIZE) {
+			debug("Received unexpected block: %lu, expected: %lu\n",
+			      tftp_cur_block,
+			      (tftp_prev_block + 1) % TFTP_SEQUENCE_SIZE);
+			/*
+			 * A block of the window was lost or reordered. ACK
+			 * the last block received in order so the server
+			 * restarts the window right after it. Do that only
+			 * once: the rest of the stale window would otherwise
+			 * trigger one ACK per block and flood the server.
+			 * Repeat it after a holdoff in case the
+			 * retransmitted window is lost too.
+			 */
+			tftp_cur_block = tftp_prev_block;
+			if (tftp_windowsize > 1 &&
+			    (tftp_last_nack != (long)tftp_prev_block ||
+			     get_timer(tftp_last_nack_time) >=
+			     TFTP_NACK_HOLDOFF_MS)) {
+				tftp_last_nack = tftp_prev_block;
+				tftp_last_nack_time = get_timer(0);
+				tftp_next_ack = (tftp_prev_block +
+						 tftp_windowsize) %
+						TFTP_SEQUENCE_SIZE;
+				tftp_send();
+			}
+			break;
+		}
+
+		update_block_number();
+
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
@@ -552,11 +606,19 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			break;
 		}
 
+		/* Before the ACK, which may prompt the next block at once */
+		if (len == tftp_block_size)
+			tftp_post_block(tftp_cur_block);
+
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	Acknowledge the last block of the window (or of the
+		 *	file), which will prompt the remote for the next one.
 		 */
-		tftp_send();
+		if (tftp_cur_block == tftp_next_ack || len < tftp_block_size) {
+			tftp_send();
+			tftp_next_ack = (tftp_cur_block + tftp_windowsize) %
+					TFTP_SEQUENCE_SIZE;
+		}
 
 		if (len < tftp_block_size)
 			tftp_complete();
@@ -594,32 +656,56 @@ static void tftp_timeout_handler(void)
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
+		net_stats_inc(timeouts);
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-		if (tftp_state != STATE_RECV_WRQ)
+		if (tftp_state != STATE_RECV_WRQ) {
+			/* ask for a whole new window after the last good block */
+			tftp_next_ack = (tftp_cur_block + tftp_windowsize) %
+					TFTP_SEQUENCE_SIZE;
+			tftp_last_nack = -1;
+			net_stats_inc(retransmits);
 			tftp_send();
+		}
 	}
 }
 
-/* Initialize tftp_load_addr and tftp_load_size from load_addr and lmb */
-static int tftp_init_load_addr(void)
+uchar *tftp_put_request(uchar *pkt, int opcode, const char *filename)
 {
-#ifdef CONFIG_LMB
-	struct lmb lmb;
-	phys_size_t max_size;
+	*(__be16 *)pkt = htons(opcode);
+	pkt += 2;
+	strcpy((char *)pkt, filename);
+	pkt += strlen(filename) + 1;
+	strcpy((char *)pkt, "octet");
+	pkt += 5 /*strlen("octet")*/ + 1;
+
+	return pkt;
+}
 
-	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+uchar *tftp_put_option(uchar *pkt, const char *name, ulong value)
+{
+	return pkt + sprintf((char *)pkt, "%s%c%lu%c", name, 0, value, 0);
+}
 
-	max_size = lmb_get_free_size(&lmb, load_addr);
-	if (!max_size)
-		return -1;
+bool tftp_next_option(uchar *pkt, unsigned int len, unsigned int *pos,
+		      char **name, ulong *value)
+{
+	unsigned int i = *pos, j;
 
-	tftp_load_size = max_size;
-#endif
-	tftp_load_addr = load_addr;
-	return 0;
+	if (i + 1 >= len)
+		return false;
+	j = i + strnlen((char *)pkt + i, len - i) + 1;
+	if (j >= len)
+		return false;
+
+	*name = (char *)pkt + i;
+	*value = simple_strtoul((char *)pkt + j, NULL, 10);
+	*pos = j + strnlen((char *)pkt + j, len - j) + 1;
+
+	return true;
 }
 
-void tftp_start(enum proto_t protocol)
+void tftp_env_options(unsigned short *blksize, unsigned short *windowsize,
+		      ulong *timeout)
 {
 #if CONFIG_NET_TFTP_VARS
 	char *ep;             /* Environment pointer */
@@ -631,16 +717,25 @@ void tftp_start(enum proto_t protocol)
 
 	ep = env_get("tftpblocksize");
 	if (ep != NULL)
-		tftp_block_size_option = simple_strtol(ep, NULL, 10);
+		*blksize = simple_strtol(ep, NULL, 10);
+
+	if (windowsize) {
+		ep = env_get("tftpwindowsize");
+		if (ep != NULL)
+			*windowsize = simple_strtol(ep, NULL, 10);
+
+		if (!*windowsize)
+			*windowsize = 1;
+	}
 
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
-		timeout_ms = simple_strtol(ep, NULL, 10);
+		*timeout = simple_strtol(ep, NULL, 10);
 
-	if (timeout_ms < 1000) {
+	if (*timeout < 1000) {
 		printf("TFTP timeout (%ld ms) too low, set min = 1000 ms\n",
-		       timeout_ms);
-		timeout_ms = 1000;
+		       *timeout);
+		*timeout = 1000;
 	}
 
 	ep = env_get("tftptimeoutcountmax");
@@ -653,9 +748,19 @@ void tftp_start(enum proto_t protocol)
 		tftp_timeout_count_max = 0;
 	}
 #endif
+}
+
+void tftp_start(enum proto_t protocol)
+{
+#ifdef CONFIG_TFTP_PORT
+	char *ep;             /* Environment pointer */
+#endif
+
+	tftp_env_options(&tftp_block_size_option, &tftp_windowsize_option,
+			 &timeout_ms);
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -714,7 +819,7 @@ void tftp_start(enum proto_t protocol)
 	} else
 #endif
 	{
-		if (tftp_init_load_addr()) {
+		if (net_init_load_addr(&tftp_load_addr, &tftp_load_size)) {
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			puts("\nTFTP error: ");
@@ -754,8 +859,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
@@ -769,7 +875,7 @@ void tftp_start_server(void)
 {
 	tftp_filename[0] = 0;
 
-	if (tftp_init_load_addr()) {
+	if (net_init_load_addr(&tftp_load_addr, &tftp_load_size)) {
 		eth_halt();
 		net_set_state(NETLOOP_FAIL);
 		puts("\nTFTP error: trying to overwrite reserved memory...\n");
@@ -786,8 +892,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
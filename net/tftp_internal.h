@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Parts of the TFTP client in tftp.c which tftp_stripe.c uses too
+ */
+
+#ifndef __TFTP_INTERNAL_H
+#define __TFTP_INTERNAL_H
+
+/* Well known TFTP port # */
+#define WELL_KNOWN_PORT	69
+
+/*
+ *	TFTP operations.
+ */
+#define TFTP_RRQ	1
+#define TFTP_WRQ	2
+#define TFTP_DATA	3
+#define TFTP_ACK	4
+#define TFTP_ERROR	5
+#define TFTP_OACK	6
+
+/* default TFTP block size */
+#define TFTP_BLOCK_SIZE		512
+
+/* 512 is poor choice for ethernet, MTU is typically 1500.
+ * Minus eth.hdrs thats 1468.  Can get 2x better throughput with
+ * almost-MTU block sizes.  At least try... fall back to 512 if need be.
+ * (but those using CONFIG_IP_DEFRAG may want to set a larger block in cfg file)
+ */
+#ifdef CONFIG_TFTP_BLOCKSIZE
+#define TFTP_MTU_BLOCKSIZE CONFIG_TFTP_BLOCKSIZE
+#else
+#define TFTP_MTU_BLOCKSIZE 1468
+#endif
+
+/**
+ * tftp_put_request() - start a read or write request
+ *
+ * @pkt:	Where to put the request
+ * @opcode:	TFTP_RRQ or TFTP_WRQ
+ * @filename:	Name of the file, sent in octet mode
+ * @return pointer to where the options go
+ */
+uchar *tftp_put_request(uchar *pkt, int opcode, const char *filename);
+
+/**
+ * tftp_put_option() - add an option with a number as value to a request
+ *
+ * @pkt:	Where to put the option
+ * @name:	Name of the option
+ * @value:	Value of the option
+ * @return pointer to just after the option
+ */
+uchar *tftp_put_option(uchar *pkt, const char *name, ulong value);
+
+/**
+ * tftp_next_option() - get the next option of an OACK packet
+ *
+ * @pkt:	Option list, after the opcode
+ * @len:	Length of @pkt
+ * @pos:	Offset of the option in @pkt, 0 for the first one; updated
+ *		to the offset of the next one
+ * @name:	Returns the name of the option
+ * @value:	Returns the value of the option, as a number
+ * @return true if an option was found, false at the end of the list
+ */
+bool tftp_next_option(uchar *pkt, unsigned int len, unsigned int *pos,
+		      char **name, ulong *value);
+
+/**
+ * tftp_env_options() - apply the TFTP settings from the environment
+ *
+ * With CONFIG_NET_TFTP_VARS, update the options from tftpblocksize,
+ * tftpwindowsize and tftptimeout, and tftp_timeout_count_max from
+ * tftptimeoutcountmax. Values out of range are corrected.
+ *
+ * @blksize:	Block size to ask for
+ * @windowsize:	Window size to ask for, or NULL if not used
+ * @timeout_ms:	Timeout for a lost packet
+ */
+void tftp_env_options(unsigned short *blksize, unsigned short *windowsize,
+		      ulong *timeout_ms);
+
+#endif /* __TFTP_INTERNAL_H */
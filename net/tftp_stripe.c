@@ -0,0 +1,563 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Striped TFTP download
+ *
+ * Fetch one file as several byte ranges, each over its own TFTP session.
+ * The sessions run at the same time, either all on the current Ethernet
+ * device or spread over several devices, so that a lock-step TFTP server
+ * keeps more than one block in flight and several links can be used.
+ *
+ * The first session asks for the file size (tsize) and for an "offset"
+ * option. If the server acknowledges both, the file is split into equal
+ * parts, rounded to whole blocks, and one more session is opened for each
+ * part, asking the server to start sending at that part's offset. A
+ * session whose part is complete sends an error packet to end the
+ * transfer early. If the server does not know the "offset" option, the
+ * first session fetches the whole file like a plain tftpboot.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tftp.h>
+#include "eth_internal.h"
+#include "tftp_internal.h"
+
+/* Period of the timeout handler, which checks each stripe on its own */
+#define TICK_MS		100UL
+
+#define MAX_STRIPES	16
+#define MAX_DEVS	MAX_STRIPES
+
+#define STATE_IDLE	0
+#define STATE_RRQ	1
+#define STATE_DATA	2
+#define STATE_DONE	3
+
+struct stripe_dev {
+#ifdef CONFIG_DM_ETH
+	struct udevice *dev;
+#else
+	struct eth_device *dev;
+#endif
+	struct in_addr ip;
+};
+
+struct stripe {
+	int state;
+	struct stripe_dev *sd;
+	int our_port;
+	int remote_port;	/* learned from the first reply */
+	ulong start;		/* first byte of the file in this stripe */
+	ulong end;		/* first byte after it, ~0 if unknown */
+	ulong blocks;		/* blocks received so far */
+	unsigned int blksize;
+	ulong last_time;
+	int timeout_count;
+};
+
+/* Device and addresses in use before switching to a stripe device */
+struct stripe_save {
+#ifdef CONFIG_DM_ETH
+	struct udevice *dev;
+#else
+	struct eth_device *dev;
+#endif
+	struct in_addr ip;
+	uchar ethaddr[ARP_HLEN];
+};
+
+static struct stripe_dev stripe_devs[MAX_DEVS];
+static int stripe_num_devs;
+static struct stripe stripes[MAX_STRIPES];
+static int stripe_count;
+static bool stripe_active;
+
+static char stripe_filename[128];
+static struct in_addr stripe_server_ip;
+static unsigned short stripe_blksize_option;
+static ulong stripe_timeout_ms;
+static ulong stripe_file_size;
+static ulong stripe_load_addr;
+static ulong stripe_load_size;
+static ulong stripe_received;
+static int stripe_num_hash;
+static ulong time_start;
+
+static void stripe_dev_select(struct stripe_dev *sd, struct stripe_save *save)
+{
+	save->dev = eth_get_dev();
+	save->ip = net_ip;
+	memcpy(save->ethaddr, net_ethaddr, ARP_HLEN);
+
+	eth_set_dev(sd->dev);
+	net_ip = sd->ip;
+	memcpy(net_ethaddr, eth_get_ethaddr(), ARP_HLEN);
+}
+
+static void stripe_dev_restore(struct stripe_save *save)
+{
+	eth_set_dev(save->dev);
+	net_ip = save->ip;
+	memcpy(net_ethaddr, save->ethaddr, ARP_HLEN);
+}
+
+static uchar *stripe_pkt(void)
+{
+	return net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+}
+
+/*
+ * Send the packet built at stripe_pkt() from the stripe's device. Only the
+ * first stripe starts before the server has answered, so the server MAC
+ * address it resolved through ARP is known by the time the other devices
+ * send anything, and they reuse it.
+ */
+static void stripe_send(struct stripe *st, int len)
+{
+	struct stripe_save save;
+	int port = st->remote_port ? st->remote_port : WELL_KNOWN_PORT;
+
+	st->last_time = get_timer(0);
+	if (st->sd == &stripe_devs[0]) {
+		net_send_udp_packet(net_server_ethaddr, stripe_server_ip, port,
+				    st->our_port, len);
+	} else {
+		stripe_dev_select(st->sd, &save);
+		net_send_udp_packet(net_server_ethaddr, stripe_server_ip, port,
+				    st->our_port, len);
+		stripe_dev_restore(&save);
+	}
+}
+
+static void stripe_send_rrq(struct stripe *st)
+{
+	uchar *pkt = stripe_pkt();
+	uchar *xp = pkt;
+
+	pkt = tftp_put_request(pkt, TFTP_RRQ, stripe_filename);
+	pkt = tftp_put_option(pkt, "timeout", stripe_timeout_ms / 1000);
+	pkt = tftp_put_option(pkt, "blksize", stripe_blksize_option);
+	if (st == &stripes[0])
+		pkt = tftp_put_option(pkt, "tsize", 0);
+	pkt = tftp_put_option(pkt, "offset", st->start);
+
+	stripe_send(st, pkt - xp);
+}
+
+static void stripe_send_ack(struct stripe *st)
+{
+	ushort *s = (ushort *)stripe_pkt();
+
+	s[0] = htons(TFTP_ACK);
+	s[1] = htons(st->blocks & 0xffff);
+	stripe_send(st, 4);
+}
+
+/* Tell the server we do not want the rest of the file */
+static void stripe_send_stop(struct stripe *st)
+{
+	uchar *pkt = stripe_pkt();
+	ushort *s = (ushort *)pkt;
+
+	s[0] = htons(TFTP_ERROR);
+	s[1] = htons(0);
+	strcpy((char *)(s + 2), "Range complete");
+	stripe_send(st, 4 + sizeof("Range complete"));
+}
+
+static void stripe_fail(const char *msg)
+{
+	printf("\nTFTP error: %s\n", msg);
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void stripe_complete(void)
+{
+	int i;
+
+	for (i = 0; i < stripe_count; i++) {
+		if (stripes[i].state != STATE_DONE)
+			return;
+	}
+
+	time_start = get_timer(time_start);
+	if (time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(stripe_received / time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_boot_file_size = stripe_file_size;
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+/* Open sessions for the other parts of a file of stripe_file_size bytes */
+static void stripe_split(struct stripe *st0)
+{
+	ulong chunk;
+	int i;
+
+	chunk = roundup(DIV_ROUND_UP(stripe_file_size, stripe_count),
+			st0->blksize);
+	if (!chunk)
+		chunk = st0->blksize;
+	stripe_count = max_t(ulong, 1, DIV_ROUND_UP(stripe_file_size, chunk));
+	st0->end = min(chunk, stripe_file_size);
+
+	for (i = 1; i < stripe_count; i++) {
+		struct stripe *st = &stripes[i];
+
+		st->start = i * chunk;
+		st->end = min(st->start + chunk, stripe_file_size);
+		st->state = STATE_RRQ;
+		stripe_send_rrq(st);
+	}
+	debug("%d stripes of %lu bytes\n", stripe_count, chunk);
+}
+
+/**
+ * stripe_parse_oack() - look at the options acknowledged by the server
+ *
+ * @st:		Stripe that got the OACK
+ * @pkt:	Option list
+ * @len:	Length of @pkt
+ * @return 0 if OK, -1 if the server does not support what we need
+ */
+static int stripe_parse_oack(struct stripe *st, uchar *pkt, unsigned len)
+{
+	bool have_tsize = false, have_offset = false;
+	ulong offset = 0, val;
+	unsigned int pos = 0;
+	char *opt;
+
+	st->blksize = TFTP_BLOCK_SIZE;
+	while (tftp_next_option(pkt, len, &pos, &opt, &val)) {
+		debug("got OACK: %s %lu\n", opt, val);
+
+		if (!strcasecmp(opt, "blksize")) {
+			st->blksize = val;
+		} else if (!strcasecmp(opt, "tsize")) {
+			stripe_file_size = val;
+			have_tsize = true;
+		} else if (!strcasecmp(opt, "offset")) {
+			offset = val;
+			have_offset = true;
+		}
+	}
+
+	if (!st->blksize || st->blksize > stripe_blksize_option)
+		return -1;
+
+	if (st != &stripes[0])
+		return have_offset && offset == st->start ? 0 : -1;
+
+	if (have_tsize && have_offset && !offset && stripe_count > 1) {
+		stripe_split(st);
+	} else {
+		if (stripe_count > 1)
+			puts("\nServer does not support offset, not striping");
+		stripe_count = 1;
+	}
+
+	return 0;
+}
+
+static int stripe_store(struct stripe *st, uchar *src, unsigned int len)
+{
+	ulong offset = st->start + st->blocks * st->blksize;
+	void *ptr;
+	u64 start;
+
+	if (len > st->end - offset)
+		len = st->end - offset;
+
+	if (offset + len > stripe_load_size) {
+		stripe_fail("trying to overwrite reserved memory...");
+		return -1;
+	}
+	ptr = map_sysmem(stripe_load_addr + offset, len);
+	start = net_stats_start();
+	memcpy(ptr, src, len);
+	net_stats_stop(NET_STAGE_COPY, start);
+	unmap_sysmem(ptr);
+
+	stripe_received += len;
+	if (st->end == ~0UL && offset + len > stripe_file_size)
+		stripe_file_size = offset + len;
+
+	return 0;
+}
+
+static void stripe_data(struct stripe *st, int block, uchar *pkt,
+			unsigned len)
+{
+	ulong offset;
+
+	if (st->state == STATE_RRQ) {
+		/* The server ignored our options */
+		if (st != &stripes[0]) {
+			stripe_fail("server ignored the offset option");
+			return;
+		}
+		st->blksize = TFTP_BLOCK_SIZE;
+		stripe_count = 1;
+		st->state = STATE_DATA;
+	}
+
+	if (block == ((st->blocks + 1) & 0xffff)) {
+		if (stripe_store(st, pkt, len))
+			return;
+		st->blocks++;
+		st->timeout_count = 0;
+		net_show_progress(&stripe_num_hash, stripe_received);
+	} else if (block != (st->blocks & 0xffff)) {
+		/* Neither the next block nor a repeat of the last one */
+		return;
+	}
+
+	offset = st->start + st->blocks * st->blksize;
+	if (len < st->blksize) {
+		stripe_send_ack(st);
+		st->state = STATE_DONE;
+	} else if (offset >= st->end) {
+		stripe_send_stop(st);
+		st->state = STATE_DONE;
+	} else {
+		stripe_send_ack(st);
+		return;
+	}
+
+	stripe_complete();
+}
+
+static void stripe_handler(uchar *pkt, unsigned dest, struct in_addr sip,
+			   unsigned src, unsigned len)
+{
+	struct stripe *st;
+	ushort proto;
+	int i;
+
+	if (!stripe_active || sip.s_addr != stripe_server_ip.s_addr)
+		return;
+	i = dest - stripes[0].our_port;
+	if (i < 0 || i >= stripe_count)
+		return;
+	st = &stripes[i];
+	if (st->state == STATE_IDLE || len < 2)
+		return;
+	if (st->remote_port && src != st->remote_port)
+		return;
+
+	proto = ntohs(*(ushort *)pkt);
+	pkt += 2;
+	len -= 2;
+
+	switch (proto) {
+	case TFTP_OACK:
+		st->remote_port = src;
+		if (st->state == STATE_RRQ) {
+			if (stripe_parse_oack(st, pkt, len)) {
+				stripe_fail("server does not support striping");
+				return;
+			}
+			st->state = STATE_DATA;
+		}
+		/* ACK 0, again if our first one got lost */
+		if (st->state == STATE_DATA && !st->blocks) {
+			st->timeout_count = 0;
+			stripe_send_ack(st);
+		}
+		break;
+
+	case TFTP_DATA:
+		if (len < 2 || st->state == STATE_DONE)
+			return;
+		st->remote_port = src;
+		stripe_data(st, ntohs(*(ushort *)pkt), pkt + 2, len - 2);
+		break;
+
+	case TFTP_ERROR:
+		printf("\nTFTP error: '%s' (%d)\n", pkt + 2,
+		       ntohs(*(ushort *)pkt));
+		net_set_state(NETLOOP_FAIL);
+		break;
+	}
+}
+
+static void stripe_timeout_handler(void)
+{
+	ulong now = get_timer(0);
+	int i;
+
+	for (i = 0; i < stripe_count; i++) {
+		struct stripe *st = &stripes[i];
+
+		if (st->state != STATE_RRQ && st->state != STATE_DATA)
+			continue;
+		if (now - st->last_time < stripe_timeout_ms)
+			continue;
+
+		if (++st->timeout_count > tftp_timeout_count_max) {
+			puts("\nRetry count exceeded; starting again\n");
+			net_start_again();
+			return;
+		}
+		puts("T ");
+		net_stats_inc(timeouts);
+		net_stats_inc(retransmits);
+		if (st->state == STATE_RRQ)
+			stripe_send_rrq(st);
+		else
+			stripe_send_ack(st);
+	}
+
+	net_set_timeout_handler(TICK_MS, stripe_timeout_handler);
+}
+
+/**
+ * stripe_init_devs() - find the devices to use from the environment
+ *
+ * tftpstripedev holds a list of "name[:ip]" entries for the devices to use
+ * besides the current one. Without an ip, the device uses our own address.
+ *
+ * @return 0 if OK, -ve on error
+ */
+static int stripe_init_devs(void)
+{
+	char *list = env_get("tftpstripedev");
+	char buf[128];
+	char *s, *tok, *ip;
+
+	stripe_devs[0].dev = eth_get_dev();
+	stripe_devs[0].ip = net_ip;
+	stripe_num_devs = 1;
+	if (!list)
+		return 0;
+
+	strlcpy(buf, list, sizeof(buf));
+	s = buf;
+	while ((tok = strsep(&s, " ")) && stripe_num_devs < MAX_DEVS) {
+		struct stripe_dev *sd = &stripe_devs[stripe_num_devs];
+		int ret;
+
+		if (!*tok)
+			continue;
+		ip = strchr(tok, ':');
+		if (ip)
+			*ip++ = '\0';
+
+		sd->dev = eth_get_dev_by_name(tok);
+		if (!sd->dev || sd->dev == stripe_devs[0].dev) {
+			printf("TFTP stripe: no other device '%s'\n", tok);
+			return -ENODEV;
+		}
+		sd->ip = ip ? string_to_ip(ip) : net_ip;
+
+		ret = eth_start_dev(sd->dev);
+		if (ret) {
+			printf("TFTP stripe: cannot start %s (%d)\n", tok, ret);
+			return ret;
+		}
+		stripe_num_devs++;
+	}
+
+	return 0;
+}
+
+void tftp_stripe_poll(void)
+{
+	struct stripe_save save;
+	int i;
+
+	for (i = 1; i < stripe_num_devs; i++) {
+		stripe_dev_select(&stripe_devs[i], &save);
+		eth_rx();
+		stripe_dev_restore(&save);
+	}
+}
+
+void tftp_stripe_stop(void)
+{
+	int i;
+
+	if (!stripe_active)
+		return;
+
+	for (i = 1; i < stripe_num_devs; i++)
+		eth_halt_dev(stripe_devs[i].dev);
+	stripe_num_devs = 0;
+	stripe_active = false;
+}
+
+void tftp_stripe_start(void)
+{
+	int num_stripes = CONFIG_TFTP_STRIPES;
+	int base_port;
+	char *ep;
+	int i;
+
+	tftp_stripe_stop();
+
+	ep = env_get("tftpstripes");
+	if (ep)
+		num_stripes = simple_strtol(ep, NULL, 10);
+	num_stripes = clamp(num_stripes, 1, MAX_STRIPES);
+
+	stripe_blksize_option = TFTP_MTU_BLOCKSIZE;
+	stripe_timeout_ms = tftp_timeout_ms;
+	tftp_env_options(&stripe_blksize_option, NULL, &stripe_timeout_ms);
+	if (stripe_blksize_option < 8)
+		stripe_blksize_option = TFTP_BLOCK_SIZE;
+
+	stripe_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&stripe_server_ip, stripe_filename,
+				sizeof(stripe_filename))) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	stripe_active = true;
+	if (stripe_init_devs()) {
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	printf("Using %s device", eth_get_name());
+	for (i = 1; i < stripe_num_devs; i++)
+		printf(", %s", stripe_devs[i].dev->name);
+	printf("\nTFTP from server %pI4; our IP address is %pI4\n",
+	       &stripe_server_ip, &net_ip);
+	printf("Filename '%s'.\n", stripe_filename);
+
+	if (net_init_load_addr(&stripe_load_addr, &stripe_load_size)) {
+		stripe_fail("trying to overwrite reserved memory...");
+		return;
+	}
+	printf("Load address: 0x%lx\n", stripe_load_addr);
+	puts("Loading: *\b");
+
+	base_port = 1024 + (get_timer(0) % (3072 - MAX_STRIPES));
+	memset(stripes, '\0', sizeof(stripes));
+	for (i = 0; i < num_stripes; i++) {
+		stripes[i].sd = &stripe_devs[i % stripe_num_devs];
+		stripes[i].our_port = base_port + i;
+		stripes[i].end = ~0UL;
+	}
+	stripe_count = num_stripes;
+	stripe_file_size = 0;
+	stripe_received = 0;
+	stripe_num_hash = 0;
+	time_start = get_timer(0);
+
+	/* zero out server ether in case the server ip has changed */
+	memset(net_server_ethaddr, 0, 6);
+
+	net_set_timeout_handler(TICK_MS, stripe_timeout_handler);
+	net_set_udp_handler(stripe_handler);
+
+	stripes[0].state = STATE_RRQ;
+	stripe_send_rrq(&stripes[0]);
+}
@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * HTTP GET loader
+ *
+ * Fetch a file with a plain HTTP/1.0 GET request and stream the body of
+ * the response straight to the load address as TCP delivers it.
+ */
+
+#include <common.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include "wget.h"
+
+#define STATE_CONNECT	1
+#define STATE_HEADER	2
+#define STATE_BODY	3
+
+static int wget_state;
+static struct in_addr wget_server_ip;
+static char wget_path[1024];
+static ulong wget_load_addr;
+static ulong wget_load_size;
+static ulong time_start;	/* Record time we started wget */
+
+/* The response header, collected until the empty line ending it */
+static char wget_header[WGET_HEADER_MAX + 1];
+static unsigned int wget_header_len;
+/* Body size announced by the server, -1 if it did not say */
+static long wget_content_length;
+/* Body bytes received so far */
+static ulong wget_body_len;
+static int wget_num_hash;
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget error: %s\n", msg);
+	tcp_abort();
+	eth_halt();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_complete(void)
+{
+	time_start = get_timer(time_start);
+	if (time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(wget_body_len / time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_boot_file_size = wget_body_len;
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_send_request(void)
+{
+	char buf[TCP_MSS + 1];
+	int len;
+
+	len = snprintf(buf, sizeof(buf),
+		       "GET %s%s HTTP/1.0\r\nHost: %pI4\r\n"
+		       "Connection: close\r\n\r\n",
+		       wget_path[0] == '/' ? "" : "/", wget_path,
+		       &wget_server_ip);
+	if (len >= TCP_MSS) {
+		wget_fail("file name too long");
+		return;
+	}
+
+	wget_state = STATE_HEADER;
+	tcp_send(buf, len);
+}
+
+/**
+ * wget_parse_header() - look at the complete response header
+ *
+ * @return 0 if the body follows, -1 if the server refused the request
+ */
+static int wget_parse_header(void)
+{
+	char *line, *next;
+	ulong status;
+
+	if (strncmp(wget_header, "HTTP/", 5))
+		return -1;
+
+	line = strchr(wget_header, ' ');
+	if (!line)
+		return -1;
+	status = simple_strtoul(line + 1, NULL, 10);
+	if (status != 200) {
+		next = strstr(line, "\r\n");
+		if (next)
+			*next = '\0';
+		printf("\nHTTP error:%s\n", line);
+		return -1;
+	}
+
+	wget_content_length = -1;
+	for (line = strstr(wget_header, "\r\n"); line; line = next) {
+		line += 2;
+		next = strstr(line, "\r\n");
+		if (!strncasecmp(line, "Content-Length:", 15)) {
+			wget_content_length = simple_strtoul(line + 15, NULL,
+							     10);
+			debug("Content-Length: %ld\n", wget_content_length);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * wget_header_add() - collect the header from the start of the stream
+ *
+ * @return number of bytes of @data that belong to the header, -1 on error
+ */
+static int wget_header_add(uchar *data, unsigned int len)
+{
+	unsigned int old_len = wget_header_len;
+	unsigned int start = old_len > 3 ? old_len - 3 : 0;
+	unsigned int take = min(len, WGET_HEADER_MAX - old_len);
+	char *end;
+
+	memcpy(wget_header + old_len, data, take);
+	wget_header_len += take;
+	wget_header[wget_header_len] = '\0';
+
+	/* The terminator may straddle two segments */
+	end = strstr(wget_header + start, "\r\n\r\n");
+	if (!end) {
+		if (wget_header_len == WGET_HEADER_MAX) {
+			wget_fail("HTTP header too large");
+			return -1;
+		}
+		return len;
+	}
+
+	end += 4;
+	wget_header_len = end - wget_header;
+	*end = '\0';
+	if (wget_parse_header()) {
+		wget_fail("server refused the request");
+		return -1;
+	}
+	wget_state = STATE_BODY;
+
+	return wget_header_len - old_len;
+}
+
+static int wget_store(uchar *src, unsigned int len)
+{
+	ulong store_addr = wget_load_addr + wget_body_len;
+	void *ptr;
+	u64 start;
+
+	if (wget_body_len + len > wget_load_size) {
+		wget_fail("trying to overwrite reserved memory...");
+		return -1;
+	}
+	ptr = map_sysmem(store_addr, len);
+	start = net_stats_start();
+	memcpy(ptr, src, len);
+	net_stats_stop(NET_STAGE_COPY, start);
+	unmap_sysmem(ptr);
+	wget_body_len += len;
+
+	net_show_progress(&wget_num_hash, wget_body_len);
+
+	return 0;
+}
+
+static void wget_handler(enum tcp_event event, u32 offset, uchar *data,
+			 unsigned int len)
+{
+	int used;
+
+	switch (event) {
+	case TCP_EV_CONNECTED:
+		wget_send_request();
+		break;
+
+	case TCP_EV_DATA:
+		if (wget_state == STATE_HEADER) {
+			used = wget_header_add(data, len);
+			if (used < 0)
+				return;
+			data += used;
+			len -= used;
+		}
+		if (wget_state != STATE_BODY || !len)
+			return;
+
+		if (wget_content_length >= 0 &&
+		    wget_body_len + len > wget_content_length)
+			len = wget_content_length - wget_body_len;
+		if (wget_store(data, len))
+			return;
+
+		/* No need to wait for the server to close */
+		if (wget_content_length >= 0 &&
+		    wget_body_len == wget_content_length) {
+			tcp_close();
+			wget_complete();
+		}
+		break;
+
+	case TCP_EV_CLOSED:
+		if (wget_state != STATE_BODY) {
+			wget_fail("connection closed before the response");
+			break;
+		}
+		if (wget_content_length >= 0 &&
+		    wget_body_len != wget_content_length) {
+			wget_fail("connection closed before the end of file");
+			break;
+		}
+		wget_complete();
+		break;
+
+	case TCP_EV_ABORTED:
+		puts("\nwget: connection aborted; starting again\n");
+		net_start_again();
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	wget_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&wget_server_ip, wget_path,
+				sizeof(wget_path))) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+
+	if (net_init_load_addr(&wget_load_addr, &wget_load_size)) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		puts("\nwget error: trying to overwrite reserved memory...\n");
+		return;
+	}
+	printf("Load address: 0x%lx\n", wget_load_addr);
+	puts("Loading: *\b");
+
+	wget_state = STATE_CONNECT;
+	wget_header_len = 0;
+	wget_content_length = -1;
+	wget_body_len = 0;
+	wget_num_hash = 0;
+	time_start = get_timer(0);
+
+	tcp_set_tcp_handler(wget_handler);
+	tcp_connect(wget_server_ip, WGET_SERVER_PORT);
+}
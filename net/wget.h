@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * HTTP GET loader on top of the minimal TCP client
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+#define WGET_SERVER_PORT	80
+
+/* Largest HTTP response header we accept */
+#define WGET_HEADER_MAX		2048
+
+/*
+ * Initialize wget (beginning of netloop)
+ */
+void wget_start(void);
+
+#endif /* __WGET_H__ */
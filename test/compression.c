@@ -7,6 +7,7 @@
 #include <bootm.h>
 #include <command.h>
 #include <gzip.h>
+#include <hexdump.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
@@ -437,6 +438,56 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+/* The raw LZ4 block in lz4_compressed, after the frame and block headers */
+#define LZ4_BLOCK_OFFSET	11
+#define LZ4_BLOCK_SIZE		257
+
+static int compression_test_lz4_block(struct unit_test_state *uts)
+{
+	const char *block = lz4_compressed + LZ4_BLOCK_OFFSET;
+	size_t plain_size = strlen(plain);
+	char in[LZ4_BLOCK_SIZE + 64];
+	char out[TEST_BUFFER_SIZE];
+	size_t len, i;
+
+	/* Padding after the block, as an EROFS cluster without 0PADDING has */
+	memset(in, '\0', sizeof(in));
+	memcpy(in, block, LZ4_BLOCK_SIZE);
+
+	/* The whole block must be consumed and end exactly at the output */
+	len = sizeof(out);
+	ut_assertok(ulz4_block(in, LZ4_BLOCK_SIZE, out, &len, false));
+	ut_asserteq(plain_size, len);
+	ut_asserteq_mem(plain, out, plain_size);
+
+	len = sizeof(out);
+	ut_asserteq(-EPROTO, ulz4_block(in, sizeof(in), out, &len, false));
+	len = plain_size - 1;
+	ut_asserteq(-EPROTO, ulz4_block(in, LZ4_BLOCK_SIZE, out, &len, false));
+
+	/*
+	 * Stopping early must give exactly the requested bytes, whether the
+	 * end falls in literals or in a match, and never write past them
+	 */
+	for (i = 0; i <= plain_size; i++) {
+		memset(out, 0xa5, sizeof(out));
+		len = i;
+		ut_assertok(ulz4_block(in, sizeof(in), out, &len, true));
+		ut_asserteq(i, len);
+		ut_asserteq_mem(plain, out, i);
+		ut_asserteq(0xa5, (u8)out[i]);
+		ut_asserteq(0xa5, (u8)out[sizeof(out) - 1]);
+	}
+
+	/* A block cut short runs out of input */
+	len = plain_size;
+	ut_asserteq(-EPROTO, ulz4_block(in, LZ4_BLOCK_SIZE / 2, out, &len,
+					true));
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_block, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -5,6 +5,8 @@
 
 #include <common.h>
 #include <dm.h>
+#include <os.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/state.h>
 #include <dm/test.h>
@@ -162,3 +164,315 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+#define BLKC_TEST_BLOCKS	64
+
+static u8 blkc_test_disk[BLKC_TEST_BLOCKS][512];
+static int blkc_test_reads;
+
+static ulong blkc_test_read(struct blk_desc *desc, lbaint_t start,
+			    lbaint_t blkcnt, void *buffer)
+{
+	blkc_test_reads++;
+	memcpy(buffer, blkc_test_disk[start], blkcnt * desc->blksz);
+
+	return blkcnt;
+}
+
+static ulong blkc_test_write(struct blk_desc *desc, lbaint_t start,
+			     lbaint_t blkcnt, const void *buffer)
+{
+	memcpy(blkc_test_disk[start], buffer, blkcnt * desc->blksz);
+
+	return blkcnt;
+}
+
+static int _dm_test_blk_cache(struct unit_test_state *uts,
+			      struct blk_desc *desc)
+{
+	struct block_cache_stats stats;
+	u8 buf[4 * 512];
+	int i;
+
+	for (i = 0; i < BLKC_TEST_BLOCKS; i++)
+		memset(blkc_test_disk[i], i, 512);
+
+	/* 16 entries of 4 blocks, no read-ahead */
+	blkcache_configure(4, 16, 0);
+	blkcache_stats(&stats);
+
+	/* A miss reads the whole entry */
+	ut_asserteq(2, blkcache_dread(desc, 1, 2, buf, blkc_test_read));
+	ut_asserteq(1, blkc_test_reads);
+	ut_asserteq(1, buf[0]);
+	ut_asserteq(2, buf[512]);
+
+	/* so its other blocks are now hits */
+	ut_asserteq(1, blkcache_dread(desc, 3, 1, buf, blkc_test_read));
+	ut_asserteq(1, blkc_test_reads);
+	ut_asserteq(3, buf[0]);
+
+	/* A partial hit only reads the missing entry */
+	ut_asserteq(4, blkcache_dread(desc, 2, 4, buf, blkc_test_read));
+	ut_asserteq(2, blkc_test_reads);
+	ut_asserteq(2, buf[0]);
+	ut_asserteq(5, buf[3 * 512]);
+
+	/* Writes keep the cache up to date */
+	memset(buf, 0xaa, 512);
+	ut_asserteq(1, blkcache_dwrite(desc, 3, 1, buf, blkc_test_write));
+	ut_assertok(blkcache_flush(desc->if_type, desc->devnum));
+	ut_asserteq(0xaa, blkc_test_disk[3][0]);
+	ut_asserteq(1, blkcache_dread(desc, 3, 1, buf, blkc_test_read));
+	ut_asserteq(0xaa, buf[0]);
+	ut_asserteq(2, blkc_test_reads);
+
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(1, stats.partial_hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(2, stats.entries);
+
+	/* Sequential reads bring in the next entry ahead of time */
+	blkcache_configure(4, 16, 8);
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	ut_asserteq(4, blkcache_dread(desc, 12, 4, buf, blkc_test_read));
+	ut_asserteq(4, blkcache_dread(desc, 16, 4, buf, blkc_test_read));
+	blkc_test_reads = 0;
+	ut_asserteq(4, blkcache_dread(desc, 20, 4, buf, blkc_test_read));
+	ut_asserteq(20, buf[0]);
+	/* Only the next read-ahead went to the device */
+	ut_asserteq(1, blkc_test_reads);
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.misses);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(4, stats.readahead_hits);
+
+	/* A window that is not a whole number of entries still reads them */
+	blkcache_configure(4, 16, 6);
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	for (i = 40; i < 64; i += 4) {
+		ut_asserteq(4, blkcache_dread(desc, i, 4, buf, blkc_test_read));
+		ut_asserteq(i, buf[0]);
+		ut_asserteq(i + 3, buf[3 * 512]);
+	}
+
+	return 0;
+}
+
+/* Test the block cache with a device in memory */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc desc = {
+		.if_type = IF_TYPE_HOST,
+		.devnum = 99,
+		.blksz = 512,
+		.lba = BLKC_TEST_BLOCKS,
+	};
+	int ret;
+
+	blkcache_stats(&stats);
+	blkc_test_reads = 0;
+
+	/* The asserts include a return on fail; cleanup in the caller */
+	ret = _dm_test_blk_cache(uts, &desc);
+
+	blkcache_invalidate(desc.if_type, desc.devnum);
+	blkcache_configure(stats.max_blocks_per_entry, stats.max_entries,
+			   stats.max_readahead);
+
+	return ret;
+}
+DM_TEST(dm_test_blk_cache, 0);
+#endif
+
+/* Log of the probe hooks called, one letter each */
+static char blk_probe_log[10];
+static int blk_probe_polls;
+
+static void blk_probe_record(char c)
+{
+	int len = strlen(blk_probe_log);
+
+	if (len < sizeof(blk_probe_log) - 1)
+		blk_probe_log[len] = c;
+}
+
+static int blk_probe_slow_start(void)
+{
+	blk_probe_record('s');
+	return 0;
+}
+
+static int blk_probe_slow_poll(void)
+{
+	blk_probe_record('p');
+	return ++blk_probe_polls < 3 ? -EAGAIN : 0;
+}
+
+static int blk_probe_slow_finish(void)
+{
+	blk_probe_record('S');
+	return 0;
+}
+
+static int blk_probe_fast_finish(void)
+{
+	blk_probe_record('F');
+	return -EIO;
+}
+
+/* Test that controllers are finished as they get ready */
+static int dm_test_blk_probe(struct unit_test_state *uts)
+{
+	const struct blk_probe_hooks hooks[] = {
+		{
+			.name	= "slow",
+			.start	= blk_probe_slow_start,
+			.poll	= blk_probe_slow_poll,
+			.finish	= blk_probe_slow_finish,
+		}, {
+			.name	= "fast",
+			.finish	= blk_probe_fast_finish,
+		},
+	};
+
+	memset(blk_probe_log, '\0', sizeof(blk_probe_log));
+	blk_probe_polls = 0;
+
+	/* The first error is returned, but everything is finished */
+	ut_asserteq(-EIO, blk_probe_run(hooks, ARRAY_SIZE(hooks)));
+	ut_asserteq_str("spFppS", blk_probe_log);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_probe, 0);
+
+static void blk_submit_done(struct blk_request *req)
+{
+	int *calls = req->priv;
+
+	(*calls)++;
+}
+
+/* Test that requests complete at once on devices which cannot queue them */
+static int dm_test_blk_submit(struct unit_test_state *uts)
+{
+	struct blk_desc *desc;
+	char buf[1024];
+	int calls = 0;
+	struct blk_request req = {
+		.start	= 0,
+		.blkcnt	= 2,
+		.buffer	= buf,
+		.done	= blk_submit_done,
+		.priv	= &calls,
+	};
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	req.dev = desc->bdev;
+
+	memset(buf, '\0', sizeof(buf));
+	ut_assertok(blk_submit(&req));
+	ut_assert(req.complete);
+	ut_asserteq(1, calls);
+	ut_asserteq(2, blk_wait(&req));
+	ut_asserteq_str("this is a test", buf);
+	ut_asserteq(0, blk_poll(desc->bdev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#define BLK_SUBMIT_FILE		"blk_submit.img"
+
+static int _dm_test_blk_submit_async(struct unit_test_state *uts)
+{
+	char disk[4 * 512], buf[2 * 512], wbuf[512];
+	struct udevice *dev;
+	int calls = 0;
+	struct blk_request rd = {
+		.start	= 1,
+		.blkcnt	= 2,
+		.buffer	= buf,
+		.done	= blk_submit_done,
+		.priv	= &calls,
+	};
+	struct blk_request wr = {
+		.write	= true,
+		.start	= 3,
+		.blkcnt	= 1,
+		.buffer	= wbuf,
+		.done	= blk_submit_done,
+		.priv	= &calls,
+	};
+	int fd, i;
+
+	for (i = 0; i < sizeof(disk); i++)
+		disk[i] = i / 512;
+	fd = os_open(BLK_SUBMIT_FILE, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(disk), os_write(fd, disk, sizeof(disk)));
+	os_close(fd);
+
+	ut_assertok(host_dev_bind(0, BLK_SUBMIT_FILE));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	rd.dev = dev;
+	wr.dev = dev;
+
+	/* Both requests are queued, and nothing is done until polled */
+	memset(buf, '\0', sizeof(buf));
+	memset(wbuf, 0xaa, sizeof(wbuf));
+	ut_assertok(blk_submit(&rd));
+	ut_assertok(blk_submit(&wr));
+	ut_assert(!rd.complete);
+	ut_assert(!wr.complete);
+	ut_asserteq(0, calls);
+	ut_asserteq(0, buf[0]);
+
+	/* They complete in order, one per poll */
+	ut_asserteq(1, blk_poll(dev));
+	ut_assert(rd.complete);
+	ut_assert(!wr.complete);
+	ut_asserteq(1, calls);
+	ut_asserteq(2, blk_wait(&rd));
+	ut_asserteq(1, buf[0]);
+	ut_asserteq(2, buf[512]);
+
+	ut_asserteq(1, blk_wait(&wr));
+	ut_asserteq(2, calls);
+	ut_asserteq(0, blk_poll(dev));
+
+	/* The write reached the backing file */
+	rd.start = 3;
+	rd.blkcnt = 1;
+	ut_assertok(blk_submit(&rd));
+	ut_asserteq(1, blk_wait(&rd));
+	ut_asserteq((char)0xaa, buf[0]);
+
+	/* Removing the device completes anything still queued */
+	ut_assertok(blk_submit(&rd));
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_assert(rd.complete);
+	ut_asserteq(-ENODEV, rd.result);
+	ut_asserteq(4, calls);
+
+	return 0;
+}
+
+/* Test that requests queued by the driver complete as it is polled */
+static int dm_test_blk_submit_async(struct unit_test_state *uts)
+{
+	int ret;
+
+	/* The asserts include a return on fail; cleanup in the caller */
+	ret = _dm_test_blk_submit_async(uts);
+
+	host_dev_bind(0, NULL);
+	os_unlink(BLK_SUBMIT_FILE);
+
+	return ret;
+}
+DM_TEST(dm_test_blk_submit_async, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -11,11 +11,14 @@
 #include <env.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
+#include <net/tcp.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <test/ut.h>
 
 #define DM_TEST_ETH_NUM		4
@@ -429,3 +432,1177 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, DM_TESTF_SCAN_FDT);
+
+/*
+ * The fake servers below answer what the network stack sends through the
+ * tx_handler of a sandbox device, from the address it was sent to
+ */
+#define SB_LOAD_ADDR		0x1000000
+
+/* Contents of the files the fake servers hand out */
+static u8 sb_test_file_byte(ulong offset)
+{
+	return (u8)(offset * 7 + (offset >> 9));
+}
+
+/*
+ * Start a frame from the fake host to @dest in the next receive buffer of
+ * @dev. Returns the IP header to fill in, or NULL if all buffers are in use.
+ */
+static void *sb_frame_start(struct udevice *dev, const uchar *dest)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth;
+
+	/* Don't allow the buffer to overrun */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return NULL;
+
+	eth = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth->et_dest, dest, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+
+	return (void *)eth + ETHER_HDR_SIZE;
+}
+
+/* Queue the frame started by sb_frame_start(), @len bytes from the IP header */
+static void sb_frame_queue(struct udevice *dev, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+/* Answer the UDP request @packet from UDP port @sport */
+static void sb_udp_reply(struct udevice *dev, void *packet, int sport,
+			 const void *data, int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ip_udp_hdr *ipr;
+
+	ipr = sb_frame_start(dev, eth->et_src);
+	if (!ipr)
+		return;
+
+	net_set_ip_header((uchar *)ipr, net_read_ip(&ip->ip_src),
+			  net_read_ip(&ip->ip_dst), IP_UDP_HDR_SIZE + len,
+			  IPPROTO_UDP);
+	ipr->udp_src = htons(sport);
+	ipr->udp_dst = ip->udp_src;
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+	memcpy((void *)ipr + IP_UDP_HDR_SIZE, data, len);
+
+	sb_frame_queue(dev, IP_UDP_HDR_SIZE + len);
+}
+
+/*
+ * Run @test with @handler answering on eth@10002000 as the server 1.1.2.2
+ * and @file to load to SB_LOAD_ADDR, then put the env back
+ */
+static int sb_server_test(struct unit_test_state *uts,
+			  sandbox_eth_tx_hand_f *handler, const char *file,
+			  int (*test)(struct unit_test_state *uts))
+{
+	int retval;
+
+	env_set("ethact", "eth@10002000");
+	env_set("serverip", "1.1.2.2");
+	strcpy(net_boot_file_name, file);
+	load_addr = SB_LOAD_ADDR;
+	sandbox_eth_set_tx_handler(0, handler);
+
+	retval = test(uts);
+
+	/* Restore the env */
+	sandbox_eth_set_tx_handler(0, NULL);
+	net_boot_file_name[0] = '\0';
+	env_set("serverip", NULL);
+
+	return retval;
+}
+
+/* Fake TFTP server used to check the windowsize option (RFC 7440) */
+#define SB_TFTP_SERVER_PORT	4096
+#define SB_TFTP_BLKSIZE		512
+#define SB_TFTP_FILE_SIZE	(SB_TFTP_BLKSIZE * 9 + 100)
+#define SB_TFTP_BLOCKS		(SB_TFTP_FILE_SIZE / SB_TFTP_BLKSIZE + 1)
+#define SB_TFTP_DROP_BLOCK	5
+
+/**
+ * struct sb_tftp_server - state of the fake TFTP server
+ *
+ * @windowsize: window size agreed with the client
+ * @acks: number of ACKs received, i.e. round trips
+ * @dropped: true once SB_TFTP_DROP_BLOCK has been "lost"
+ */
+struct sb_tftp_server {
+	int windowsize;
+	int acks;
+	bool dropped;
+};
+
+static struct sb_tftp_server sb_tftp;
+
+static void sb_tftp_send_block(struct udevice *dev, void *packet, int block)
+{
+	uchar buf[4 + SB_TFTP_BLKSIZE];
+	ulong offset = (block - 1) * SB_TFTP_BLKSIZE;
+	int len = min(SB_TFTP_FILE_SIZE - offset, (ulong)SB_TFTP_BLKSIZE);
+	int i;
+
+	/* Lose one block in the middle of a window, once */
+	if (sb_tftp.windowsize > 1 && block == SB_TFTP_DROP_BLOCK &&
+	    !sb_tftp.dropped) {
+		sb_tftp.dropped = true;
+		return;
+	}
+
+	put_unaligned_be16(3, buf);	/* DATA */
+	put_unaligned_be16(block, buf + 2);
+	for (i = 0; i < len; i++)
+		buf[4 + i] = sb_test_file_byte(offset + i);
+
+	sb_udp_reply(dev, packet, SB_TFTP_SERVER_PORT, buf, 4 + len);
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *data = (uchar *)ip + IP_UDP_HDR_SIZE;
+	uchar *end;
+	char buf[64];
+	char *opt;
+	int block, last, n;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	switch (get_unaligned_be16(data)) {
+	case 1:		/* RRQ */
+		sb_tftp.windowsize = 1;
+
+		/* Options follow the file name and mode */
+		end = data + ntohs(ip->udp_len) - UDP_HDR_SIZE;
+		for (opt = (char *)data + 2; (uchar *)opt < end;
+		     opt += strlen(opt) + 1) {
+			if (!strcmp(opt, "windowsize"))
+				sb_tftp.windowsize =
+					simple_strtoul(opt + 11, NULL, 10);
+		}
+
+		put_unaligned_be16(6, buf);	/* OACK */
+		n = 2;
+		n += sprintf(buf + n, "blksize%c%d%c", 0, SB_TFTP_BLKSIZE, 0);
+		if (sb_tftp.windowsize > 1)
+			n += sprintf(buf + n, "windowsize%c%d%c", 0,
+				     sb_tftp.windowsize, 0);
+		sb_udp_reply(dev, packet, SB_TFTP_SERVER_PORT, buf, n);
+		break;
+	case 4:		/* ACK */
+		sb_tftp.acks++;
+		block = get_unaligned_be16(data + 2);
+		last = min(block + sb_tftp.windowsize, SB_TFTP_BLOCKS);
+		while (++block <= last)
+			sb_tftp_send_block(dev, packet, block);
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_tftp_check_data(struct unit_test_state *uts)
+{
+	u8 *buf = map_sysmem(SB_LOAD_ADDR, SB_TFTP_FILE_SIZE);
+	int i;
+
+	for (i = 0; i < SB_TFTP_FILE_SIZE; i++)
+		ut_asserteq(sb_test_file_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_tftp_windowsize(struct unit_test_state *uts)
+{
+	int lockstep_acks;
+
+	/* Classic lock-step transfer: one round trip per block */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	env_set("tftpwindowsize", "1");
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+	ut_assertok(sb_tftp_check_data(uts));
+	ut_asserteq(1, sb_tftp.windowsize);
+	ut_asserteq(SB_TFTP_BLOCKS + 1, sb_tftp.acks);
+	lockstep_acks = sb_tftp.acks;
+
+	/* One ACK per window, recovering from a block lost in transit */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	memset(map_sysmem(SB_LOAD_ADDR, 0), '\0', SB_TFTP_FILE_SIZE);
+	env_set("tftpwindowsize", "3");
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+	ut_assertok(sb_tftp_check_data(uts));
+	ut_asserteq(3, sb_tftp.windowsize);
+	ut_assert(sb_tftp.dropped);
+	ut_assert(sb_tftp.acks <= lockstep_acks / 2);
+
+	return 0;
+}
+
+static int dm_test_net_tftp_windowsize(struct unit_test_state *uts)
+{
+	int retval;
+
+	retval = sb_server_test(uts, sb_tftp_handler, "sb-test.img",
+				_dm_test_net_tftp_windowsize);
+	env_set("tftpwindowsize", NULL);
+
+	return retval;
+}
+DM_TEST(dm_test_net_tftp_windowsize, DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(NET_STATS)
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_stats(struct unit_test_state *uts)
+{
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	memset(&net_stats, '\0', sizeof(net_stats));
+	env_set("tftpwindowsize", "1");
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+
+	/* ARP reply, OACK and every data block */
+	ut_assert(net_stats.rx_packets >= SB_TFTP_BLOCKS + 2);
+	ut_assert(net_stats.rx_bytes > SB_TFTP_FILE_SIZE);
+	ut_asserteq(net_stats.rx_packets, net_stats.calls[NET_STAGE_RX]);
+	ut_asserteq(0, net_stats.rx_dropped);
+
+	/* ARP request, RRQ and one ACK per block */
+	ut_asserteq(1, net_stats.arp_requests);
+	ut_asserteq(SB_TFTP_BLOCKS + 2, net_stats.tx_packets);
+	ut_asserteq(net_stats.tx_packets, net_stats.calls[NET_STAGE_TX]);
+	ut_asserteq(0, net_stats.tx_errors);
+	ut_asserteq(0, net_stats.timeouts);
+
+	/* Blocks not received in place were copied; the ARP reply waited for */
+	ut_assert(net_stats.calls[NET_STAGE_COPY] <= SB_TFTP_BLOCKS);
+	ut_asserteq(1, net_stats.calls[NET_STAGE_ARP]);
+	ut_assert(net_stats.calls[NET_STAGE_POLL] > 0);
+
+	return 0;
+}
+
+static int dm_test_net_stats(struct unit_test_state *uts)
+{
+	int retval;
+
+	retval = sb_server_test(uts, sb_tftp_handler, "sb-test.img",
+				_dm_test_net_stats);
+	env_set("tftpwindowsize", NULL);
+
+	return retval;
+}
+DM_TEST(dm_test_net_stats, DM_TESTF_SCAN_FDT);
+#endif
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_tftp_zerocopy(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	struct udevice *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	priv = dev_get_priv(dev);
+	priv->recv_posted = 0;
+
+	/*
+	 * Every block after the first is received in place, the headers in
+	 * front of it overwriting the end of the previous one for a while
+	 */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	memset(map_sysmem(SB_LOAD_ADDR, 0), '\0', SB_TFTP_FILE_SIZE);
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+	ut_assertok(sb_tftp_check_data(uts));
+	ut_asserteq(SB_TFTP_BLOCKS - 1, priv->recv_posted);
+	ut_assertnull(priv->post_buf);
+
+	return 0;
+}
+
+static int dm_test_net_tftp_zerocopy(struct unit_test_state *uts)
+{
+	return sb_server_test(uts, sb_tftp_handler, "sb-test.img",
+			      _dm_test_net_tftp_zerocopy);
+}
+DM_TEST(dm_test_net_tftp_zerocopy, DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_CMD_TFTPSTRIPE
+/* Fake TFTP server handing out byte ranges with the "offset" option */
+#define SB_STRIPE_MAX_SESSIONS	16
+
+/**
+ * struct sb_stripe_session - one transfer on the fake striping server
+ *
+ * @dev: device the RRQ came in on
+ * @client_port: UDP port the client sent its RRQ from
+ * @offset: byte of the file sent in block 1
+ * @stopped: true once the client ended the transfer with an error
+ */
+struct sb_stripe_session {
+	struct udevice *dev;
+	int client_port;
+	ulong offset;
+	bool stopped;
+};
+
+/**
+ * struct sb_stripe_server - state of the fake striping server
+ *
+ * @no_offset: behave like a server without the "offset" option
+ * @sessions: transfers started by the client
+ * @num_sessions: number of entries in @sessions
+ */
+struct sb_stripe_server {
+	bool no_offset;
+	struct sb_stripe_session sessions[SB_STRIPE_MAX_SESSIONS];
+	int num_sessions;
+};
+
+static struct sb_stripe_server sb_stripe;
+
+static struct sb_stripe_session *sb_stripe_find(int port)
+{
+	int i;
+
+	for (i = 0; i < sb_stripe.num_sessions; i++) {
+		if (sb_stripe.sessions[i].client_port == port)
+			return &sb_stripe.sessions[i];
+	}
+
+	return NULL;
+}
+
+static int sb_stripe_handler(struct udevice *dev, void *packet,
+			     unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *data = (uchar *)ip + IP_UDP_HDR_SIZE;
+	struct sb_stripe_session *ss;
+	uchar buf[4 + SB_TFTP_BLKSIZE];
+	ulong offset;
+	uchar *end;
+	char *opt;
+	int block, n, i;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	ss = sb_stripe_find(ntohs(ip->udp_src));
+	switch (get_unaligned_be16(data)) {
+	case 1:		/* RRQ */
+		if (!ss) {
+			if (sb_stripe.num_sessions == SB_STRIPE_MAX_SESSIONS)
+				return 0;
+			ss = &sb_stripe.sessions[sb_stripe.num_sessions++];
+		}
+		memset(ss, '\0', sizeof(*ss));
+		ss->dev = dev;
+		ss->client_port = ntohs(ip->udp_src);
+
+		put_unaligned_be16(6, buf);	/* OACK */
+		n = 2;
+		n += sprintf((char *)buf + n, "blksize%c%d%c", 0,
+			     SB_TFTP_BLKSIZE, 0);
+		end = data + ntohs(ip->udp_len) - UDP_HDR_SIZE;
+		for (opt = (char *)data + 2; (uchar *)opt < end;
+		     opt += strlen(opt) + 1) {
+			if (!strcmp(opt, "tsize")) {
+				n += sprintf((char *)buf + n, "tsize%c%d%c",
+					     0, SB_TFTP_FILE_SIZE, 0);
+			} else if (!strcmp(opt, "offset") &&
+				   !sb_stripe.no_offset) {
+				ss->offset = simple_strtoul(opt + 7, NULL, 10);
+				n += sprintf((char *)buf + n, "offset%c%lu%c",
+					     0, ss->offset, 0);
+			}
+		}
+		sb_udp_reply(dev, packet, SB_TFTP_SERVER_PORT, buf, n);
+		break;
+	case 4:		/* ACK */
+		if (!ss || ss->stopped)
+			return 0;
+		block = get_unaligned_be16(data + 2) + 1;
+		offset = ss->offset + (block - 1) * SB_TFTP_BLKSIZE;
+		if (offset > SB_TFTP_FILE_SIZE)
+			return 0;
+		n = min(SB_TFTP_FILE_SIZE - offset, (ulong)SB_TFTP_BLKSIZE);
+		put_unaligned_be16(3, buf);	/* DATA */
+		put_unaligned_be16(block, buf + 2);
+		for (i = 0; i < n; i++)
+			buf[4 + i] = sb_test_file_byte(offset + i);
+		sb_udp_reply(dev, packet, SB_TFTP_SERVER_PORT, buf, 4 + n);
+		break;
+	case 5:		/* ERROR */
+		if (ss)
+			ss->stopped = true;
+		break;
+	}
+
+	return 0;
+}
+
+/* Count the sessions started on @dev */
+static int sb_stripe_sessions(struct udevice *dev)
+{
+	int i, count = 0;
+
+	for (i = 0; i < sb_stripe.num_sessions; i++) {
+		if (sb_stripe.sessions[i].dev == dev)
+			count++;
+	}
+
+	return count;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_tftp_stripe(struct unit_test_state *uts)
+{
+	struct udevice *dev0, *dev1;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev0));
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10003000",
+					      &dev1));
+
+	/* Four parts of whole blocks, two on each device */
+	memset(&sb_stripe, '\0', sizeof(sb_stripe));
+	memset(map_sysmem(SB_LOAD_ADDR, 0), '\0', SB_TFTP_FILE_SIZE);
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPSTRIPE));
+	ut_assertok(sb_tftp_check_data(uts));
+	ut_asserteq(4, sb_stripe.num_sessions);
+	ut_asserteq(2, sb_stripe_sessions(dev0));
+	ut_asserteq(2, sb_stripe_sessions(dev1));
+	ut_asserteq(3 * SB_TFTP_BLKSIZE, sb_stripe.sessions[3].offset);
+	/* The first three parts end before the end of the file */
+	ut_assert(sb_stripe.sessions[0].stopped);
+	ut_assert(!sb_stripe.sessions[3].stopped);
+	ut_assert(!eth_is_active(dev1));
+
+	/* A server without the offset option sends the whole file at once */
+	memset(&sb_stripe, '\0', sizeof(sb_stripe));
+	memset(map_sysmem(SB_LOAD_ADDR, 0), '\0', SB_TFTP_FILE_SIZE);
+	sb_stripe.no_offset = true;
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPSTRIPE));
+	ut_assertok(sb_tftp_check_data(uts));
+	ut_asserteq(1, sb_stripe.num_sessions);
+	ut_asserteq(1, sb_stripe_sessions(dev0));
+
+	return 0;
+}
+
+static int dm_test_net_tftp_stripe(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	sandbox_eth_tx_hand_f *old;
+	struct udevice *dev;
+	int retval;
+
+	/* The second device talks to the same server */
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10003000",
+					      &dev));
+	priv = dev_get_priv(dev);
+	old = priv->tx_handler;
+	priv->tx_handler = sb_stripe_handler;
+	env_set("tftpstripes", "4");
+	env_set("tftpstripedev", "eth@10003000");
+
+	retval = sb_server_test(uts, sb_stripe_handler, "sb-test.img",
+				_dm_test_net_tftp_stripe);
+
+	priv->tx_handler = old;
+	env_set("tftpstripedev", NULL);
+	env_set("tftpstripes", NULL);
+
+	return retval;
+}
+DM_TEST(dm_test_net_tftp_stripe, DM_TESTF_SCAN_FDT);
+#endif
+
+/* A posted buffer must not stay armed once the loop is done with it */
+static int dm_test_eth_post_rx_buf_cancel(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	uchar buf[PKTSIZE_ALIGN];
+	struct udevice *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	priv = dev_get_priv(dev);
+	env_set("ethact", "eth@10002000");
+	eth_set_current();
+
+	/* Halting the device */
+	ut_assertok(eth_init());
+	ut_assertok(eth_post_rx_buf(buf, sizeof(buf), 0));
+	ut_asserteq_ptr(buf, priv->post_buf);
+	eth_halt();
+	ut_assertnull(priv->post_buf);
+
+	/* Explicit cancel, as done when the network loop ends */
+	ut_assertok(eth_init());
+	ut_assertok(eth_post_rx_buf(buf, sizeof(buf), 0));
+	eth_cancel_rx_buf();
+	ut_assertnull(priv->post_buf);
+
+	/* Switching to another device */
+	ut_assertok(eth_post_rx_buf(buf, sizeof(buf), 0));
+	env_set("ethact", "eth@10004000");
+	eth_set_current();
+	ut_assertnull(priv->post_buf);
+	ut_asserteq_str("eth@10004000", eth_get_name());
+
+	eth_halt_dev(dev);
+	env_set("ethact", NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_post_rx_buf_cancel, DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_CMD_WGET
+/* Fake HTTP server used to check the TCP stack and wget */
+#define SB_HTTP_PORT		80
+#define SB_HTTP_FILE_SIZE	10000
+#define SB_HTTP_SEG_SIZE	1000
+#define SB_HTTP_WINDOW		(4 * SB_HTTP_SEG_SIZE)
+#define SB_HTTP_DROP_OFFSET	(3 * SB_HTTP_SEG_SIZE)
+#define SB_HTTP_ISS		0xfffff000
+
+/**
+ * struct sb_http_server - state of the fake HTTP server
+ *
+ * @rcv_nxt: next sequence number expected from the client
+ * @una: first unacknowledged byte of the response
+ * @next: next byte of the response to send
+ * @rewound: value of @una we last went back to after a duplicate ACK
+ * @resp_len: length of the response (header and body)
+ * @requested: true once the GET request has been received
+ * @dropped: true once the segment at SB_HTTP_DROP_OFFSET has been "lost"
+ */
+struct sb_http_server {
+	u32 rcv_nxt;
+	u32 una;
+	u32 next;
+	u32 rewound;
+	int resp_len;
+	bool requested;
+	bool dropped;
+};
+
+static struct sb_http_server sb_http;
+static char sb_http_resp[128 + SB_HTTP_FILE_SIZE];
+
+/* Answer the TCP segment @packet, acknowledging up to @ack */
+static void sb_tcp_reply(struct udevice *dev, void *packet, u8 flags, u32 seq,
+			 u32 ack, const void *data, int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct ip_tcp_hdr *ipr;
+
+	ipr = sb_frame_start(dev, eth->et_src);
+	if (!ipr)
+		return;
+
+	net_set_ip_header((uchar *)ipr, net_read_ip(&tcp->ip_src),
+			  net_read_ip(&tcp->ip_dst), IP_TCP_HDR_SIZE + len,
+			  IPPROTO_TCP);
+	ipr->tcp_src = tcp->tcp_dst;
+	ipr->tcp_dst = tcp->tcp_src;
+	ipr->tcp_seq = htonl(seq);
+	ipr->tcp_ack = htonl(ack);
+	ipr->tcp_hlen = (TCP_HDR_SIZE / 4) << 4;
+	ipr->tcp_flags = flags;
+	ipr->tcp_win = htons(0x2000);
+	ipr->tcp_xsum = 0;
+	ipr->tcp_ugr = 0;
+	memcpy((void *)ipr + IP_TCP_HDR_SIZE, data, len);
+	ipr->tcp_xsum = tcp_checksum(net_read_ip(&ipr->ip_src),
+				     net_read_ip(&ipr->ip_dst),
+				     (void *)ipr + IP_HDR_SIZE,
+				     TCP_HDR_SIZE + len);
+
+	sb_frame_queue(dev, IP_TCP_HDR_SIZE + len);
+}
+
+/* Send as much of the response as the window and the buffers allow */
+static void sb_http_send(struct udevice *dev, void *packet)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int len;
+
+	while (sb_http.next < sb_http.resp_len &&
+	       sb_http.next < sb_http.una + SB_HTTP_WINDOW &&
+	       priv->recv_packets < PKTBUFSRX) {
+		len = min(sb_http.resp_len - (int)sb_http.next,
+			  SB_HTTP_SEG_SIZE);
+		if (sb_http.next == SB_HTTP_DROP_OFFSET && !sb_http.dropped)
+			sb_http.dropped = true;
+		else
+			sb_tcp_reply(dev, packet, TCP_ACK | TCP_PUSH,
+				     SB_HTTP_ISS + 1 + sb_http.next,
+				     sb_http.rcv_nxt, sb_http_resp + sb_http.next,
+				     len);
+		sb_http.next += len;
+	}
+}
+
+static int sb_http_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	const char *req = "GET /sb-test.img HTTP/1.0\r\n";
+	uchar *data;
+	int data_len, i, n;
+	u32 seq, acked;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || tcp->ip_p != IPPROTO_TCP)
+		return 0;
+
+	data = (uchar *)tcp + IP_HDR_SIZE + (tcp->tcp_hlen >> 4) * 4;
+	data_len = ntohs(tcp->ip_len) - (data - (uchar *)tcp);
+	seq = ntohl(tcp->tcp_seq);
+
+	if (tcp->tcp_flags & TCP_SYN) {
+		memset(&sb_http, '\0', sizeof(sb_http));
+		sb_http.rcv_nxt = seq + 1;
+		sb_http.rewound = -1;
+		sb_tcp_reply(dev, packet, TCP_SYN | TCP_ACK, SB_HTTP_ISS,
+			     sb_http.rcv_nxt, NULL, 0);
+		return 0;
+	}
+
+	if (tcp->tcp_flags & TCP_RST)
+		return 0;
+
+	if (data_len && seq == sb_http.rcv_nxt && !sb_http.requested) {
+		sb_http.rcv_nxt += data_len;
+		sb_http.requested = !strncmp((char *)data, req, strlen(req));
+		if (!sb_http.requested)
+			return 0;
+
+		n = sprintf(sb_http_resp,
+			    "HTTP/1.0 200 OK\r\nContent-Length: %d\r\n\r\n",
+			    SB_HTTP_FILE_SIZE);
+		for (i = 0; i < SB_HTTP_FILE_SIZE; i++)
+			sb_http_resp[n + i] = sb_test_file_byte(i);
+		sb_http.resp_len = n + SB_HTTP_FILE_SIZE;
+	}
+
+	if (tcp->tcp_flags & TCP_FIN) {
+		sb_http.rcv_nxt = seq + data_len + 1;
+		sb_tcp_reply(dev, packet, TCP_ACK,
+			     SB_HTTP_ISS + 1 + sb_http.resp_len, sb_http.rcv_nxt,
+			     NULL, 0);
+		return 0;
+	}
+
+	if (!sb_http.requested)
+		return 0;
+
+	/* A duplicate ACK means a segment was lost, go back to it once */
+	acked = ntohl(tcp->tcp_ack) - SB_HTTP_ISS - 1;
+	if (acked == sb_http.una && !data_len &&
+	    sb_http.next > sb_http.una && sb_http.rewound != sb_http.una) {
+		sb_http.rewound = sb_http.una;
+		sb_http.next = sb_http.una;
+	}
+	if (acked > sb_http.una && acked <= sb_http.next)
+		sb_http.una = acked;
+
+	sb_http_send(dev, packet);
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_wget(struct unit_test_state *uts)
+{
+	u8 *buf;
+	int i;
+
+	memset(map_sysmem(load_addr, 0), '\0', SB_HTTP_FILE_SIZE);
+	ut_asserteq(SB_HTTP_FILE_SIZE, net_loop(WGET));
+	ut_assert(sb_http.dropped);
+
+	buf = map_sysmem(load_addr, SB_HTTP_FILE_SIZE);
+	for (i = 0; i < SB_HTTP_FILE_SIZE; i++)
+		ut_asserteq(sb_test_file_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int dm_test_net_wget(struct unit_test_state *uts)
+{
+	return sb_server_test(uts, sb_http_handler, "sb-test.img",
+			      _dm_test_net_wget);
+}
+DM_TEST(dm_test_net_wget, DM_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_CMD_NFS
+/* Fake NFSv3 server used to check pipelined READ requests */
+#define SB_RPC_PROG_PORTMAP	100000
+#define SB_RPC_PROG_NFS		100003
+#define SB_RPC_PROG_MOUNT	100005
+#define SB_RPC_PROG_MISMATCH	2
+#define SB_MOUNT_MNT		1
+#define SB_NFS3_LOOKUP		3
+#define SB_NFS3_READ		6
+#define SB_NFS3_FSINFO		19
+#define SB_NFS_FHSIZE		32
+#define SB_NFS_MOUNT_PORT	635
+#define SB_NFS_PORT		2049
+#define SB_NFS_FILE_SIZE	10000
+#define SB_NFS_RTMAX		512
+#define SB_NFS_WINDOW		3
+
+/**
+ * struct sb_nfs_server - state of the fake NFS server
+ *
+ * The server holds back READ requests until it has a window of them, then
+ * answers them in reverse order.
+ *
+ * @pending_xid: XIDs of the READ requests held back
+ * @pending_offset: offsets of the READ requests held back
+ * @pending_count: sizes of the READ requests held back
+ * @num_pending: number of READ requests held back
+ * @max_pending: largest number of READ requests seen in flight
+ * @max_count: largest size asked for by a READ request
+ * @last_xid: XID of the last READ request
+ * @resent: number of READ requests sent again
+ */
+struct sb_nfs_server {
+	u32 pending_xid[SB_NFS_WINDOW];
+	u32 pending_offset[SB_NFS_WINDOW];
+	u32 pending_count[SB_NFS_WINDOW];
+	int num_pending;
+	int max_pending;
+	u32 max_count;
+	u32 last_xid;
+	int resent;
+};
+
+static struct sb_nfs_server sb_nfs;
+
+/* Send an accepted RPC reply with @nwords result words from @words */
+static void sb_nfs_reply(struct udevice *dev, void *packet, u32 xid,
+			 u32 astatus, const u32 *words, int nwords,
+			 const uchar *data, int len)
+{
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar buf[6 * 4 + 8 * 4 + SB_NFS_RTMAX];
+	int i, n = 0;
+
+	put_unaligned_be32(xid, buf + n);
+	put_unaligned_be32(1, buf + n + 4);	/* MSG_REPLY */
+	put_unaligned_be32(0, buf + n + 8);	/* MSG_ACCEPTED */
+	put_unaligned_be32(0, buf + n + 12);	/* AUTH_NONE verifier */
+	put_unaligned_be32(0, buf + n + 16);
+	put_unaligned_be32(astatus, buf + n + 20);
+	n += 24;
+	for (i = 0; i < nwords; i++, n += 4)
+		put_unaligned_be32(words[i], buf + n);
+	memcpy(buf + n, data, len);
+	n += roundup(len, 4);
+
+	sb_udp_reply(dev, packet, ntohs(ip->udp_dst), buf, n);
+}
+
+static void sb_nfs_send_read(struct udevice *dev, void *packet, int i)
+{
+	uchar data[SB_NFS_RTMAX];
+	u32 offset = sb_nfs.pending_offset[i];
+	u32 count = 0;
+	u32 words[5];
+	int j;
+
+	if (offset < SB_NFS_FILE_SIZE)
+		count = min(sb_nfs.pending_count[i], SB_NFS_FILE_SIZE - offset);
+	for (j = 0; j < count; j++)
+		data[j] = sb_test_file_byte(offset + j);
+
+	words[0] = 0;				/* NFS3_OK */
+	words[1] = 0;				/* no attributes */
+	words[2] = count;
+	words[3] = offset + count >= SB_NFS_FILE_SIZE;	/* eof */
+	words[4] = count;
+	sb_nfs_reply(dev, packet, sb_nfs.pending_xid[i], 0, words, 5, data,
+		     count);
+}
+
+static int sb_nfs_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *call = (uchar *)ip + IP_UDP_HDR_SIZE;
+	uchar fh[SB_NFS_FHSIZE] = { 0 };
+	u32 xid, prog, vers, proc, words[3];
+	uchar *args;
+	int i;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	xid = get_unaligned_be32(call);
+	prog = get_unaligned_be32(call + 12);
+	vers = get_unaligned_be32(call + 16);
+	proc = get_unaligned_be32(call + 20);
+	/* Skip the credential and the verifier */
+	args = call + 24;
+	args += 8 + get_unaligned_be32(args + 4);
+	args += 8 + get_unaligned_be32(args + 4);
+
+	switch (prog) {
+	case SB_RPC_PROG_PORTMAP:
+		words[0] = get_unaligned_be32(args) == SB_RPC_PROG_MOUNT ?
+			SB_NFS_MOUNT_PORT : SB_NFS_PORT;
+		sb_nfs_reply(dev, packet, xid, 0, words, 1, NULL, 0);
+		break;
+	case SB_RPC_PROG_MOUNT:
+		/* Status and a zero file handle for MOUNT, nothing else */
+		words[0] = 0;
+		sb_nfs_reply(dev, packet, xid, 0, words,
+			     proc == SB_MOUNT_MNT ? 1 : 0, fh,
+			     proc == SB_MOUNT_MNT ? SB_NFS_FHSIZE : 0);
+		break;
+	case SB_RPC_PROG_NFS:
+		if (vers != 3) {
+			words[0] = 3;		/* lowest version */
+			words[1] = 3;		/* highest version */
+			sb_nfs_reply(dev, packet, xid, SB_RPC_PROG_MISMATCH,
+				     words, 2, NULL, 0);
+			break;
+		}
+		switch (proc) {
+		case SB_NFS3_LOOKUP:
+			words[0] = 0;		/* NFS3_OK */
+			words[1] = 4;		/* file handle length */
+			words[2] = 0x5b;	/* file handle */
+			sb_nfs_reply(dev, packet, xid, 0, words, 3, NULL, 0);
+			break;
+		case SB_NFS3_FSINFO:
+			words[0] = 0;		/* NFS3_OK */
+			words[1] = 0;		/* no attributes */
+			words[2] = SB_NFS_RTMAX;
+			sb_nfs_reply(dev, packet, xid, 0, words, 3, NULL, 0);
+			break;
+		case SB_NFS3_READ:
+			/* File handle, 64-bit offset and count */
+			args += 4 + get_unaligned_be32(args);
+			if (xid <= sb_nfs.last_xid)
+				sb_nfs.resent++;
+			sb_nfs.last_xid = xid;
+			i = sb_nfs.num_pending++;
+			sb_nfs.pending_xid[i] = xid;
+			sb_nfs.pending_offset[i] = get_unaligned_be32(args + 4);
+			sb_nfs.pending_count[i] = get_unaligned_be32(args + 8);
+			sb_nfs.max_pending = max(sb_nfs.max_pending,
+						 sb_nfs.num_pending);
+			sb_nfs.max_count = max(sb_nfs.max_count,
+					       sb_nfs.pending_count[i]);
+			if (sb_nfs.num_pending < SB_NFS_WINDOW &&
+			    sb_nfs.pending_offset[i] < SB_NFS_FILE_SIZE)
+				break;
+			while (sb_nfs.num_pending)
+				sb_nfs_send_read(dev, packet,
+						 --sb_nfs.num_pending);
+			break;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_nfs_pipeline(struct unit_test_state *uts)
+{
+	u8 *buf;
+	int i;
+
+	memset(&sb_nfs, '\0', sizeof(sb_nfs));
+	memset(map_sysmem(SB_LOAD_ADDR, 0), '\0', SB_NFS_FILE_SIZE);
+	env_set("nfsreadwindow", simple_itoa(SB_NFS_WINDOW));
+	ut_asserteq(SB_NFS_FILE_SIZE, net_loop(NFS));
+
+	buf = map_sysmem(SB_LOAD_ADDR, SB_NFS_FILE_SIZE);
+	for (i = 0; i < SB_NFS_FILE_SIZE; i++)
+		ut_asserteq(sb_test_file_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	/* A window of requests, each no larger than the server allows */
+	ut_asserteq(SB_NFS_WINDOW, sb_nfs.max_pending);
+	ut_asserteq(SB_NFS_RTMAX, sb_nfs.max_count);
+	ut_asserteq(0, sb_nfs.resent);
+
+	return 0;
+}
+
+static int dm_test_net_nfs_pipeline(struct unit_test_state *uts)
+{
+	int retval;
+
+	retval = sb_server_test(uts, sb_nfs_handler, "/export/sb-test.img",
+				_dm_test_net_nfs_pipeline);
+	env_set("nfsreadwindow", NULL);
+
+	return retval;
+}
+DM_TEST(dm_test_net_nfs_pipeline, DM_TESTF_SCAN_FDT);
+#endif
+
+/* Checksums the device reports verified are not checked again */
+#define SB_CSUM_PAYLOAD		"csum!"		/* odd length on purpose */
+#define SB_CSUM_FRAME_LEN	60
+
+static int sb_csum_received;
+static bool sb_csum_hw_ok;
+
+static void sb_csum_udp_handler(uchar *pkt, unsigned dport,
+				struct in_addr sip, unsigned sport,
+				unsigned len)
+{
+	sb_csum_received++;
+	sb_csum_hw_ok = net_rx_l4_csum_ok((void *)pkt - IP_UDP_HDR_SIZE);
+}
+
+/* Queue a padded UDP frame for us, with a good or a bad checksum */
+static void sb_csum_queue(struct udevice *dev, bool good)
+{
+	int len = sizeof(SB_CSUM_PAYLOAD) - 1;
+	int udp_len = UDP_HDR_SIZE + len;
+	int frame_len = SB_CSUM_FRAME_LEN - ETHER_HDR_SIZE;
+	struct ip_udp_hdr *ip;
+	u16 pseudo[6];
+	unsigned sum;
+
+	ip = sb_frame_start(dev, net_ethaddr);
+	if (!ip)
+		return;
+
+	memset(ip, 0xa5, frame_len);
+	net_set_ip_header((uchar *)ip, net_ip, string_to_ip("1.1.2.2"),
+			  IP_HDR_SIZE + udp_len, IPPROTO_UDP);
+	ip->udp_src = htons(1234);
+	ip->udp_dst = htons(4321);
+	ip->udp_len = htons(udp_len);
+	ip->udp_xsum = 0;
+	memcpy((void *)ip + IP_UDP_HDR_SIZE, SB_CSUM_PAYLOAD, len);
+
+	memcpy(&pseudo[0], &ip->ip_src, 4);
+	memcpy(&pseudo[2], &ip->ip_dst, 4);
+	pseudo[4] = htons(IPPROTO_UDP);
+	pseudo[5] = htons(udp_len);
+	sum = add_ip_checksums(0, compute_ip_checksum(pseudo, sizeof(pseudo)),
+			       compute_ip_checksum(&ip->udp_src, udp_len));
+	ip->udp_xsum = (sum ? sum : 0xffff) ^ (good ? 0 : 0x0100);
+
+	sb_frame_queue(dev, frame_len);
+}
+
+static int sb_csum_rx(struct unit_test_state *uts, struct udevice *dev,
+		      unsigned int flags, bool good)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	priv->rx_csum = flags;
+	sb_csum_received = 0;
+	sb_csum_hw_ok = false;
+	sb_csum_queue(dev, good);
+	ut_assertok(eth_rx());
+	ut_asserteq(0, priv->recv_packets);
+	ut_asserteq(0, net_rx_csum.flags);
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_rx_csum(struct unit_test_state *uts,
+				struct udevice *dev)
+{
+	ut_assertok(eth_init());
+
+	/* Checked in software */
+	ut_assertok(sb_csum_rx(uts, dev, 0, true));
+	ut_asserteq(1, sb_csum_received);
+	ut_assert(!sb_csum_hw_ok);
+	ut_assertok(sb_csum_rx(uts, dev, 0, false));
+	ut_asserteq(0, sb_csum_received);
+
+	/* Trusted from the device */
+	ut_assertok(sb_csum_rx(uts, dev, ETH_CSUM_IP | ETH_CSUM_L4, false));
+	ut_asserteq(1, sb_csum_received);
+	ut_assert(sb_csum_hw_ok);
+
+	/* Worked out from the sum of the frame, padding left out */
+	ut_assertok(sb_csum_rx(uts, dev, ETH_CSUM_COMPLETE, true));
+	ut_asserteq(1, sb_csum_received);
+	ut_assert(sb_csum_hw_ok);
+	ut_assertok(sb_csum_rx(uts, dev, ETH_CSUM_COMPLETE, false));
+	ut_asserteq(0, sb_csum_received);
+
+	return 0;
+}
+
+static int dm_test_net_rx_csum(struct unit_test_state *uts)
+{
+	struct in_addr old_ip = net_ip;
+	struct udevice *dev;
+	int retval;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	env_set("ethact", "eth@10002000");
+	net_init();
+	net_ip = string_to_ip("1.1.2.3");
+	net_set_udp_handler(sb_csum_udp_handler);
+
+	retval = _dm_test_net_rx_csum(uts, dev);
+
+	/* Restore the env */
+	eth_halt();
+	net_set_udp_handler(NULL);
+	((struct eth_sandbox_priv *)dev_get_priv(dev))->rx_csum = 0;
+	net_ip = old_ip;
+
+	return retval;
+}
+DM_TEST(dm_test_net_rx_csum, DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_IP_DEFRAG
+/* Two datagrams whose fragments arrive interleaved are both reassembled */
+#define SB_FRAG_SPLIT		512	/* bytes of the UDP datagram in frag 1 */
+
+static int sb_frag_received;
+static int sb_frag_bad;
+
+static void sb_frag_udp_handler(uchar *pkt, unsigned dport,
+				struct in_addr sip, unsigned sport,
+				unsigned len)
+{
+	unsigned i;
+
+	sb_frag_received++;
+	/* The payload of each datagram counts up from its destination port */
+	for (i = 0; i < len; i++) {
+		if (pkt[i] != (u8)(dport + i))
+			sb_frag_bad++;
+	}
+}
+
+/* Queue one fragment of a UDP datagram with "len" bytes of payload */
+static void sb_frag_queue(struct udevice *dev, u16 id, int dport, int len,
+			  bool first)
+{
+	int udp_len = UDP_HDR_SIZE + len;
+	struct ip_udp_hdr *ip;
+	uchar *data;
+	int start, n, i;
+
+	start = first ? 0 : SB_FRAG_SPLIT;
+	n = first ? SB_FRAG_SPLIT : udp_len - SB_FRAG_SPLIT;
+
+	ip = sb_frame_start(dev, net_ethaddr);
+	if (!ip)
+		return;
+
+	net_set_ip_header((uchar *)ip, net_ip, string_to_ip("1.1.2.2"),
+			  IP_HDR_SIZE + n, IPPROTO_UDP);
+	ip->ip_id = htons(id);
+	ip->ip_off = htons((first ? IP_FLAGS_MFRAG : 0) | start / 8);
+	ip->ip_sum = 0;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+
+	/* Fill in the part of the UDP datagram in this fragment */
+	data = (uchar *)ip + IP_HDR_SIZE;
+	for (i = 0; i < n; i++)
+		data[i] = (u8)(dport + start + i - UDP_HDR_SIZE);
+	if (first) {
+		ip->udp_src = htons(1234);
+		ip->udp_dst = htons(dport);
+		ip->udp_len = htons(udp_len);
+		ip->udp_xsum = 0;
+	}
+
+	sb_frame_queue(dev, IP_HDR_SIZE + n);
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_net_defrag(struct unit_test_state *uts,
+			       struct udevice *dev)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	ut_assertok(eth_init());
+
+	sb_frag_received = 0;
+	sb_frag_bad = 0;
+	sb_frag_queue(dev, 0x100, 4000, 1000, true);
+	sb_frag_queue(dev, 0x101, 5000, 1200, true);
+	sb_frag_queue(dev, 0x101, 5000, 1200, false);
+	sb_frag_queue(dev, 0x100, 4000, 1000, false);
+	ut_assertok(eth_rx());
+	ut_asserteq(0, priv->recv_packets);
+
+	ut_asserteq(2, sb_frag_received);
+	ut_asserteq(0, sb_frag_bad);
+
+	return 0;
+}
+
+static int dm_test_net_defrag(struct unit_test_state *uts)
+{
+	struct in_addr old_ip = net_ip;
+	struct udevice *dev;
+	int retval;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	env_set("ethact", "eth@10002000");
+	net_init();
+	net_ip = string_to_ip("1.1.2.3");
+	net_set_udp_handler(sb_frag_udp_handler);
+
+	retval = _dm_test_net_defrag(uts, dev);
+
+	/* Restore the env */
+	eth_halt();
+	net_set_udp_handler(NULL);
+	net_ip = old_ip;
+
+	return retval;
+}
+DM_TEST(dm_test_net_defrag, DM_TESTF_SCAN_FDT);
+#endif
@@ -9,6 +9,7 @@
 #include <mapmem.h>
 #include <os.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <asm/state.h>
 #include <asm/test.h>
@@ -64,6 +65,94 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_spi_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/* Test reads through the spi-mem direct mapping of the flash */
+static int dm_test_spi_flash_dirmap(struct unit_test_state *uts)
+{
+	struct spi_mem_dirmap_desc *desc;
+	struct spi_flash *flash;
+	struct udevice *dev;
+	int full_size = 0x200000;
+	int size = 0x10000;
+	int offset = 0x1234;
+	u8 *src, *dst;
+	ssize_t ret;
+	int pos;
+
+	src = map_sysmem(0x20000, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	flash = dev_get_uclass_priv(dev);
+
+	/* The sandbox controller has no window, so reads fall back to ops */
+	desc = flash->dirmap_rdesc;
+	ut_assertnonnull(desc);
+	ut_asserteq(1, desc->nodirmap);
+	ut_asserteq(flash->size, desc->info.length);
+
+	dst = map_sysmem(0x20000 + full_size, full_size);
+	for (pos = 0; pos < size; pos += ret) {
+		ret = spi_mem_dirmap_read(desc, offset + pos, size - pos,
+					  dst + pos);
+		ut_assert(ret > 0);
+	}
+	ut_assertok(memcmp(src + offset, dst, size));
+
+	/* The regular read path goes through the same descriptor */
+	memset(dst, '\0', size);
+	ut_assertok(spi_flash_read_dm(dev, offset, size, dst));
+	ut_assertok(memcmp(src + offset, dst, size));
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_dirmap, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that DTR ops are only accepted where the controller allows them */
+static int dm_test_spi_flash_octal_dtr(struct unit_test_state *uts)
+{
+	struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(0xfd, 1),
+					  SPI_MEM_OP_ADDR(4, 0, 1),
+					  SPI_MEM_OP_DUMMY(20, 1),
+					  SPI_MEM_OP_DATA_IN(2, NULL, 1));
+	struct spi_flash *flash;
+	struct udevice *dev;
+
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	flash = dev_get_uclass_priv(dev);
+
+	/* The sandbox bus is single wire, the flash must stay in 1-1-1 */
+	ut_asserteq(SNOR_PROTO_1_1_1, flash->reg_proto);
+	ut_assert(!spi_nor_protocol_is_dtr(flash->read_proto));
+	ut_assert(spi_mem_supports_op(flash->spi, &op));
+
+	/* A DTR op never goes through the default spi_xfer() path */
+	op.cmd.dtr = 1;
+	op.addr.dtr = 1;
+	op.dummy.dtr = 1;
+	op.data.dtr = 1;
+	ut_assert(!spi_mem_supports_op(flash->spi, &op));
+
+	/* Octal DTR needs 2-byte opcodes and even byte counts */
+	op.cmd.buswidth = 8;
+	op.addr.buswidth = 8;
+	op.dummy.buswidth = 8;
+	op.data.buswidth = 8;
+	ut_assert(!spi_mem_dtr_supports_op(flash->spi, &op));
+	op.cmd.opcode = 0xfdfd;
+	op.cmd.nbytes = 2;
+	flash->spi->mode |= SPI_TX_OCTAL | SPI_RX_OCTAL;
+	ut_assert(spi_mem_dtr_supports_op(flash->spi, &op));
+	op.data.nbytes = 3;
+	ut_assert(!spi_mem_dtr_supports_op(flash->spi, &op));
+	flash->spi->mode &= ~(SPI_TX_OCTAL | SPI_RX_OCTAL);
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_octal_dtr, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /* Functional test that sandbox SPI flash works correctly */
 static int dm_test_spi_flash_func(struct unit_test_state *uts)
 {
@@ -6,6 +6,7 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <scsi.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <asm/state.h>
@@ -55,6 +56,80 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/* Test queueing, waiting for and cancelling bulk transfers */
+static int dm_test_usb_bulk_queue(struct unit_test_state *uts)
+{
+	struct usb_bulk_req cbw_req, csw_req, reqs[8];
+	struct umass_bbb_cbw cbw;
+	struct umass_bbb_csw csw;
+	struct usb_device *udev;
+	struct udevice *dev;
+	int i, queued, ret;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
+	udev = dev_get_parent_priv(dev);
+
+	/* A Bulk-Only TEST UNIT READY: no data, just the CBW and CSW */
+	memset(&cbw, '\0', sizeof(cbw));
+	cbw.dCBWSignature = CBWSIGNATURE;
+	cbw.dCBWTag = 0x1234;
+	cbw.bCDBLength = 6;
+	cbw.CBWCDB[0] = SCSI_TST_U_RDY;
+	memset(&cbw_req, '\0', sizeof(cbw_req));
+	cbw_req.pipe = usb_sndbulkpipe(udev, 1);
+	cbw_req.buffer = &cbw;
+	cbw_req.length = UMASS_BBB_CBW_SIZE;
+	memset(&csw_req, '\0', sizeof(csw_req));
+	csw_req.pipe = usb_rcvbulkpipe(udev, 2);
+	csw_req.buffer = &csw;
+	csw_req.length = UMASS_BBB_CSW_SIZE;
+
+	/* A cancelled transfer completes at once and never reaches the stick */
+	ut_assertok(usb_bulk_submit(udev, &cbw_req));
+	ut_assert(!cbw_req.done);
+	ut_assertok(usb_bulk_cancel(udev, &cbw_req));
+	ut_assert(cbw_req.done);
+	ut_asserteq(USB_ST_NAK_REC, cbw_req.status);
+
+	/* The queue is limited; what does not fit must be unwound */
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		reqs[i] = csw_req;
+		ret = usb_bulk_submit(udev, &reqs[i]);
+		if (ret)
+			break;
+	}
+	ut_asserteq(-EBUSY, ret);
+	queued = i;
+	ut_assert(queued > 0);
+	for (i = 0; i < queued; i++) {
+		ut_assertok(usb_bulk_cancel(udev, &reqs[i]));
+		ut_assert(reqs[i].done);
+	}
+
+	/* Waiting for the CSW does the CBW queued before it, in order */
+	ut_assertok(usb_bulk_submit(udev, &cbw_req));
+	ut_assertok(usb_bulk_submit(udev, &csw_req));
+	ut_assert(!cbw_req.done);
+	ut_assertok(usb_bulk_wait(udev, &csw_req));
+	ut_assert(cbw_req.done);
+	ut_asserteq(0, cbw_req.status);
+	ut_asserteq(0, csw_req.status);
+	ut_asserteq(UMASS_BBB_CSW_SIZE, csw_req.act_len);
+	ut_asserteq(CSWSIGNATURE, csw.dCSWSignature);
+	ut_asserteq(0x1234, csw.dCSWTag);
+	ut_asserteq(CSWSTATUS_GOOD, csw.bCSWStatus);
+
+	/* Cancelling something already done has no effect */
+	ut_assertok(usb_bulk_cancel(udev, &csw_req));
+	ut_asserteq(0, csw_req.status);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_bulk_queue, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
@@ -8,12 +8,15 @@ import pytest
 import re
 from subprocess import call, check_call, check_output, CalledProcessError
 from fstest_defs import *
+from fstest_exfat import mk_exfat_img
 
 supported_fs_basic = ['fat16', 'fat32', 'ext4']
 supported_fs_ext = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat16', 'fat32']
 supported_fs_unlink = ['fat16', 'fat32']
 supported_fs_symlink = ['ext4']
+supported_fs_squashfs = ['squashfs', 'squashfs-noF']
+supported_fs_erofs = ['erofs', 'erofs-legacy']
 
 #
 # Filesystem test specific setup
@@ -50,6 +53,8 @@ def pytest_configure(config):
     global supported_fs_mkdir
     global supported_fs_unlink
     global supported_fs_symlink
+    global supported_fs_squashfs
+    global supported_fs_erofs
 
     def intersect(listA, listB):
         return  [x for x in listA if x in listB]
@@ -62,6 +67,8 @@ def pytest_configure(config):
         supported_fs_mkdir =  intersect(supported_fs, supported_fs_mkdir)
         supported_fs_unlink =  intersect(supported_fs, supported_fs_unlink)
         supported_fs_symlink =  intersect(supported_fs, supported_fs_symlink)
+        supported_fs_squashfs =  intersect(supported_fs, supported_fs_squashfs)
+        supported_fs_erofs =  intersect(supported_fs, supported_fs_erofs)
 
 def pytest_generate_tests(metafunc):
     """Parametrize fixtures, fs_obj_xxx
@@ -90,6 +97,12 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_symlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_symlink', supported_fs_symlink,
             indirect=True, scope='module')
+    if 'fs_obj_squashfs' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_squashfs', supported_fs_squashfs,
+            indirect=True, scope='module')
+    if 'fs_obj_erofs' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_erofs', supported_fs_erofs,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -131,6 +144,22 @@ def check_ubconfig(config, fs_type):
         pytest.skip('.config feature "%s_WRITE" not enabled'
         % fs_type.upper())
 
+def check_ubconfig_ro(config, fs_type):
+    """Check whether a read-only file system is enabled in u-boot
+    configuration.
+
+    Like check_ubconfig(), but for a file system which is only reached
+    through the generic fs commands and has no write support.
+
+    Args:
+        fs_type: File system type.
+
+    Return:
+        Nothing.
+    """
+    if not config.buildconfig.get('config_fs_%s' % fs_type, None):
+        pytest.skip('.config feature "FS_%s" not enabled' % fs_type.upper())
+
 def mk_fs(config, fs_type, size, id):
     """Create a file system volume.
 
@@ -600,3 +629,169 @@ def fs_obj_symlink(request, u_boot_config):
         call('rmdir %s' % mount_dir, shell=True)
         if fs_img:
             call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for exFAT test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_exfat(request, u_boot_config):
+    """Set up an exFAT volume to be used in exFAT test.
+
+    The image is built by mk_exfat_img() rather than mkfs.exfat, so that
+    it holds both a contiguous (NoFatChain) and a fragmented file.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for exFAT test, i.e. a pair of volume file name and
+        a dictionary of file name to file contents.
+    """
+    check_ubconfig_ro(u_boot_config, 'exfat')
+
+    fs_img = u_boot_config.persistent_data_dir + '/8MB.exfat.img'
+
+    try:
+        files = mk_exfat_img(fs_img)
+    except (IOError, OSError):
+        pytest.skip('Setup failed for filesystem: exfat')
+        return
+    else:
+        yield [fs_img, files]
+    finally:
+        call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for SquashFS test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_squashfs(request, u_boot_config):
+    """Set up a SquashFS image to be used in SquashFS test.
+
+    The files hold data that gzip can shrink, so that both data blocks
+    and fragments end up compressed. 'squashfs-noF' stores the fragments
+    uncompressed.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for SquashFS test, i.e. a pair of volume file name and
+        a dictionary of file name to file contents.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    check_ubconfig_ro(u_boot_config, 'squashfs')
+    if not tool_is_in_path('mksquashfs'):
+        pytest.skip('mksquashfs not available')
+
+    src_dir = u_boot_config.persistent_data_dir + '/squashfs'
+
+    # 3.5 blocks of 128KiB, so the tail goes into a fragment, and two
+    # files that only have a tail
+    big = bytearray(os.urandom(3 * 0x20000 + 0x4000))
+    for i in range(len(big)):
+        big[i] &= 0x0f
+    files = {
+        'big.bin': bytes(big),
+        'small.txt': b''.join([b'line %d\n' % i for i in range(300)]),
+        'SUBDIR/tiny.txt': b'SquashFS tiny file\n',
+    }
+    links = {
+        'link.txt': 'small.txt',
+        'dirlink': 'SUBDIR',
+        'SUBDIR/abslink.bin': '/big.bin',
+    }
+
+    try:
+        check_call('rm -rf %s' % src_dir, shell=True)
+        check_call('mkdir -p %s/SUBDIR' % src_dir, shell=True)
+        for name, data in files.items():
+            with open(src_dir + '/' + name, 'wb') as f:
+                f.write(data)
+        for name, target in links.items():
+            os.symlink(target, src_dir + '/' + name)
+
+        fs_img = '%s/%s.img' % (u_boot_config.persistent_data_dir, fs_type)
+        mkfs_opt = '-noappend -all-root'
+        if fs_type == 'squashfs-noF':
+            mkfs_opt += ' -noF'
+        check_call('mksquashfs %s %s %s' % (src_dir, fs_img, mkfs_opt),
+            shell=True)
+    except (CalledProcessError, IOError, OSError):
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_img, files]
+    finally:
+        call('rm -rf %s' % src_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for EROFS test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_erofs(request, u_boot_config):
+    """Set up an EROFS image to be used in EROFS test.
+
+    Random data does not compress, so mkfs.erofs stores it as plain
+    blocks, with any tail inline after the inode. Text compresses and
+    is stored as LZ4 clusters, indexed with the compacted format, or
+    with the legacy one for 'erofs-legacy'.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for EROFS test, i.e. a pair of volume file name and
+        a dictionary of file name to file contents.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    check_ubconfig_ro(u_boot_config, 'erofs')
+    if not tool_is_in_path('mkfs.erofs'):
+        pytest.skip('mkfs.erofs not available')
+
+    src_dir = u_boot_config.persistent_data_dir + '/erofs'
+
+    # Enough 4KiB clusters of text for the 2B compacted indexes
+    files = {
+        'plain.bin': os.urandom(2 * 4096),
+        'inline.bin': os.urandom(3 * 4096 + 100),
+        'lz4.txt': b''.join([b'%08d: EROFS LZ4 test data\n' % i
+                             for i in range(8000)]),
+        'SUBDIR/small.txt': b'EROFS small file\n',
+    }
+
+    try:
+        check_call('rm -rf %s' % src_dir, shell=True)
+        check_call('mkdir -p %s/SUBDIR' % src_dir, shell=True)
+        for name, data in files.items():
+            with open(src_dir + '/' + name, 'wb') as f:
+                f.write(data)
+
+        fs_img = '%s/%s.img' % (u_boot_config.persistent_data_dir, fs_type)
+        mkfs_opt = '-zlz4'
+        if fs_type == 'erofs-legacy':
+            mkfs_opt += ' -E legacy-compress'
+        check_call('rm -f %s' % fs_img, shell=True)
+        check_call('mkfs.erofs %s %s %s' % (mkfs_opt, fs_img, src_dir),
+            shell=True)
+    except (CalledProcessError, IOError, OSError):
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_img, files]
+    finally:
+        call('rm -rf %s' % src_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
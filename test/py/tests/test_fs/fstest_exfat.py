@@ -0,0 +1,198 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# Build a small exFAT image with a known layout, so that the tests can rely
+# on which files are contiguous (NoFatChain) and which follow a FAT chain
+# through scattered clusters. mkfs.exfat and the kernel driver leave the
+# layout to their allocator.
+
+import hashlib
+import os
+import struct
+
+SECT_BITS = 9
+CLUST_BITS = 3				# 8 sectors, 4KiB clusters
+SECT_SIZE = 1 << SECT_BITS
+CLUST_SIZE = SECT_SIZE << CLUST_BITS
+
+VOL_SECTS = 16384			# 8MiB
+FAT_OFFSET = 128
+FAT_LENGTH = 64
+HEAP_OFFSET = 256
+CLUSTER_COUNT = (VOL_SECTS - HEAP_OFFSET) >> CLUST_BITS
+EOF_CLUSTER = 0xffffffff
+
+ATTR_DIR = 0x10
+ATTR_ARCH = 0x20
+SF_ALLOC_POSSIBLE = 0x01
+SF_NO_FAT_CHAIN = 0x02
+
+# Cluster numbers of the system areas and directories
+BITMAP_CLUSTER = 2
+UPCASE_CLUSTER = 3
+ROOT_CLUSTER = 4
+SUBDIR_CLUSTER = 5
+SMALL_CLUSTER = 6
+
+# File names, sizes and clusters; frag.bin goes backwards and forwards
+CONTIG_FILE = 'contig.bin'
+CONTIG_SIZE = 4 * CLUST_SIZE + 1000
+CONTIG_CLUSTER = 10
+FRAG_FILE = 'frag.bin'
+FRAG_SIZE = 5 * CLUST_SIZE + 123
+FRAG_CLUSTERS = [20, 21, 30, 25, 26, 40]
+SUBDIR = 'SUBDIR'
+SMALL_FILE = 'small.txt'
+SMALL_DATA = b'exFAT small file\n'
+
+def _chk16(data, chk=0, skip=()):
+    for i, b in enumerate(bytearray(data)):
+        if i in skip:
+            continue
+        chk = (((chk << 15) | (chk >> 1)) + b) & 0xffff
+    return chk
+
+def _chk32(data, chk=0, skip=()):
+    for i, b in enumerate(bytearray(data)):
+        if i in skip:
+            continue
+        chk = (((chk << 31) | (chk >> 1)) + b) & 0xffffffff
+    return chk
+
+def _upcase(c):
+    return c - 0x20 if ord('a') <= c <= ord('z') else c
+
+def _entry_set(name, attr, flags, cluster, size):
+    """Return the file, stream and name entries of a file or directory."""
+    uname = [ord(c) for c in name]
+    name_hash = 0
+    for c in uname:
+        name_hash = _chk16(struct.pack('<H', _upcase(c)), name_hash)
+    nnames = (len(uname) + 14) // 15
+
+    ents = bytearray(32 * (2 + nnames))
+    struct.pack_into('<BBHH', ents, 0, 0x85, 1 + nnames, 0, attr)
+    struct.pack_into('<BBBBHHQIIQ', ents, 32, 0xc0, flags, 0, len(uname),
+                     name_hash, 0, size, 0, cluster, size)
+    for i in range(nnames):
+        part = uname[i * 15:(i + 1) * 15]
+        part += [0] * (15 - len(part))
+        struct.pack_into('<BB15H', ents, 64 + 32 * i, 0xc1, 0, *part)
+    struct.pack_into('<H', ents, 2, _chk16(ents, skip=(2, 3)))
+
+    return ents
+
+def _boot_region():
+    """Return the 12 sectors of a boot region."""
+    region = bytearray(12 * SECT_SIZE)
+    region[0:3] = b'\xeb\x76\x90'
+    region[3:11] = b'EXFAT   '
+    struct.pack_into('<QQIIIIIIHHBBBBB', region, 64, 0, VOL_SECTS,
+                     FAT_OFFSET, FAT_LENGTH, HEAP_OFFSET, CLUSTER_COUNT,
+                     ROOT_CLUSTER, 0x12345678, 0x100, 0, SECT_BITS,
+                     CLUST_BITS, 1, 0x80, 0)
+    struct.pack_into('<H', region, 510, 0xaa55)
+    for sect in range(1, 9):
+        struct.pack_into('<I', region, (sect + 1) * SECT_SIZE - 4,
+                         0xaa550000)
+
+    # Volume flags and percent in use are left out of the checksum
+    chk = _chk32(region[:11 * SECT_SIZE], skip=(106, 107, 112))
+    for off in range(11 * SECT_SIZE, 12 * SECT_SIZE, 4):
+        struct.pack_into('<I', region, off, chk)
+
+    return region
+
+def mk_exfat_img(fs_img):
+    """Create the exFAT image.
+
+    Args:
+        fs_img: File name of the image.
+
+    Return:
+        A dictionary of file name to file data.
+    """
+    img = bytearray(VOL_SECTS * SECT_SIZE)
+    heap = HEAP_OFFSET * SECT_SIZE
+    fat = [0] * (CLUSTER_COUNT + 2)
+    fat[0] = 0xfffffff8
+    fat[1] = EOF_CLUSTER
+    used = []
+
+    def clust_pos(clust):
+        return heap + (clust - 2) * CLUST_SIZE
+
+    def put_chain(clusters, data):
+        for i, clust in enumerate(clusters):
+            fat[clust] = clusters[i + 1] if i + 1 < len(clusters) \
+                else EOF_CLUSTER
+        put_clusters(clusters, data)
+
+    def put_clusters(clusters, data):
+        used.extend(clusters)
+        for i, clust in enumerate(clusters):
+            chunk = data[i * CLUST_SIZE:(i + 1) * CLUST_SIZE]
+            img[clust_pos(clust):clust_pos(clust) + len(chunk)] = chunk
+
+    contig = bytearray(os.urandom(CONTIG_SIZE))
+    frag = bytearray(os.urandom(FRAG_SIZE))
+    nclust = (CONTIG_SIZE + CLUST_SIZE - 1) // CLUST_SIZE
+
+    # No FAT entries for NoFatChain data, just the allocation bitmap
+    put_clusters(list(range(CONTIG_CLUSTER, CONTIG_CLUSTER + nclust)),
+                 contig)
+    put_chain(FRAG_CLUSTERS, frag)
+    put_chain([SMALL_CLUSTER], SMALL_DATA)
+
+    # Up-case table covering ASCII only; the rest maps to itself
+    upcase = bytearray()
+    for c in range(128):
+        upcase += struct.pack('<H', _upcase(c))
+    put_chain([UPCASE_CLUSTER], upcase)
+
+    subdir = _entry_set(SMALL_FILE, ATTR_ARCH, SF_ALLOC_POSSIBLE,
+                        SMALL_CLUSTER, len(SMALL_DATA))
+    put_chain([SUBDIR_CLUSTER], subdir)
+
+    root = bytearray(32 * 3)
+    label = [ord(c) for c in 'UBOOT']
+    struct.pack_into('<BB11H', root, 0, 0x83, len(label),
+                     *(label + [0] * (11 - len(label))))
+    struct.pack_into('<B19xIQ', root, 32, 0x81, BITMAP_CLUSTER,
+                     (CLUSTER_COUNT + 7) // 8)
+    struct.pack_into('<B3xI12xIQ', root, 64, 0x82, _chk32(upcase),
+                     UPCASE_CLUSTER, len(upcase))
+    root += _entry_set(SUBDIR, ATTR_DIR, SF_ALLOC_POSSIBLE | SF_NO_FAT_CHAIN,
+                       SUBDIR_CLUSTER, CLUST_SIZE)
+    root += _entry_set(CONTIG_FILE, ATTR_ARCH,
+                       SF_ALLOC_POSSIBLE | SF_NO_FAT_CHAIN, CONTIG_CLUSTER,
+                       CONTIG_SIZE)
+    root += _entry_set(FRAG_FILE, ATTR_ARCH, SF_ALLOC_POSSIBLE,
+                       FRAG_CLUSTERS[0], FRAG_SIZE)
+    put_chain([ROOT_CLUSTER], root)
+
+    used.append(BITMAP_CLUSTER)
+    fat[BITMAP_CLUSTER] = EOF_CLUSTER
+    bitmap = bytearray((CLUSTER_COUNT + 7) // 8)
+    for clust in used:
+        bitmap[(clust - 2) // 8] |= 1 << ((clust - 2) % 8)
+    put_clusters([BITMAP_CLUSTER], bitmap)
+
+    fat_pos = FAT_OFFSET * SECT_SIZE
+    for i, val in enumerate(fat):
+        struct.pack_into('<I', img, fat_pos + 4 * i, val)
+
+    boot = _boot_region()
+    img[0:len(boot)] = boot
+    img[len(boot):2 * len(boot)] = boot
+
+    with open(fs_img, 'wb') as f:
+        f.write(bytes(img))
+
+    return {
+        CONTIG_FILE: bytes(contig),
+        FRAG_FILE: bytes(frag),
+        SUBDIR + '/' + SMALL_FILE: bytes(SMALL_DATA),
+    }
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
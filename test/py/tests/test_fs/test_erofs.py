@@ -0,0 +1,104 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:EROFS Test
+
+"""
+This test verifies read access to an EROFS image through the generic
+file system commands, for plain files, files with an inline tail and
+LZ4 compressed files.
+"""
+
+import hashlib
+import pytest
+from fstest_defs import *
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestErofs(object):
+    def test_erofs1(self, u_boot_console, fs_obj_erofs):
+        """
+        Test Case 1 - ls command, listing a root directory and a subdirectory
+        """
+        fs_img, files = fs_obj_erofs
+        with u_boot_console.log.section('Test Case 1 - ls'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'ls host 0:0 /'])
+            out = ''.join(output)
+            assert('SUBDIR/' in out)
+            for name in ['plain.bin', 'inline.bin', 'lz4.txt']:
+                assert(' %8d   %s' % (len(files[name]), name) in out)
+            assert('3 file(s), 1 dir(s)' in out)
+
+            output = u_boot_console.run_command('ls host 0:0 /SUBDIR')
+            assert(' %8d   small.txt' % len(files['SUBDIR/small.txt'])
+                   in output)
+            assert('1 file(s), 0 dir(s)' in output)
+
+    def test_erofs2(self, u_boot_console, fs_obj_erofs):
+        """
+        Test Case 2 - size and load of plain and inline-tail files
+        """
+        fs_img, files = fs_obj_erofs
+        with u_boot_console.log.section('Test Case 2 - load plain'):
+            for name in ['plain.bin', 'inline.bin', 'SUBDIR/small.txt']:
+                output = u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'size host 0:0 /%s' % name,
+                    'printenv filesize'])
+                assert('filesize=%x' % len(files[name]) in ''.join(output))
+
+                output = u_boot_console.run_command_list([
+                    'load host 0:0 %x /%s' % (ADDR, name),
+                    'printenv filesize',
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                out = ''.join(output)
+                assert('filesize=%x' % len(files[name]) in out)
+                assert(md5(files[name]) in out)
+
+    def test_erofs3(self, u_boot_console, fs_obj_erofs):
+        """
+        Test Case 3 - load an LZ4 compressed file
+        """
+        fs_img, files = fs_obj_erofs
+        with u_boot_console.log.section('Test Case 3 - load LZ4'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /lz4.txt' % ADDR,
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % len(files['lz4.txt']) in out)
+            assert(md5(files['lz4.txt']) in out)
+
+    def test_erofs4(self, u_boot_console, fs_obj_erofs):
+        """
+        Test Case 4 - partial loads starting and ending inside a cluster
+        """
+        fs_img, files = fs_obj_erofs
+        with u_boot_console.log.section('Test Case 4 - partial load'):
+            data = files['lz4.txt']
+            for pos, length in [(0, 0x1800), (0x1800, 0x2000),
+                                (len(data) - 0x1234, 0x1234)]:
+                output = u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'load host 0:0 %x /lz4.txt %x %x' % (ADDR, length, pos),
+                    'printenv filesize',
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                out = ''.join(output)
+                assert('filesize=%x' % length in out)
+                assert(md5(data[pos:pos + length]) in out)
+
+            data = files['inline.bin']
+            pos = len(data) - 0x200
+            output = u_boot_console.run_command_list([
+                'load host 0:0 %x /inline.bin %x %x' % (ADDR, 0x200, pos),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5(data[pos:]) in ''.join(output))
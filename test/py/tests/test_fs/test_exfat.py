@@ -0,0 +1,127 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:exFAT Test
+
+"""
+This test verifies read access to an exFAT volume through the generic
+file system commands, for both a contiguous (NoFatChain) file and a file
+whose FAT chain is scattered over the volume.
+"""
+
+import pytest
+from fstest_defs import *
+from fstest_exfat import *
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestExfat(object):
+    def test_exfat1(self, u_boot_console, fs_obj_exfat):
+        """
+        Test Case 1 - ls command, listing a root directory and a subdirectory
+        """
+        fs_img, files = fs_obj_exfat
+        with u_boot_console.log.section('Test Case 1 - ls'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'ls host 0:0 /'])
+            out = ''.join(output)
+            assert('%s/' % SUBDIR in out)
+            assert(' %8d   %s' % (CONTIG_SIZE, CONTIG_FILE) in out)
+            assert(' %8d   %s' % (FRAG_SIZE, FRAG_FILE) in out)
+            assert('2 file(s), 1 dir(s)' in out)
+
+            output = u_boot_console.run_command(
+                'ls host 0:0 /%s' % SUBDIR)
+            assert(' %8d   %s' % (len(SMALL_DATA), SMALL_FILE) in output)
+            assert('1 file(s), 0 dir(s)' in output)
+
+    def test_exfat2(self, u_boot_console, fs_obj_exfat):
+        """
+        Test Case 2 - size command of a contiguous and a fragmented file
+        """
+        fs_img, files = fs_obj_exfat
+        with u_boot_console.log.section('Test Case 2 - size'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'size host 0:0 /%s' % CONTIG_FILE,
+                'printenv filesize'])
+            assert('filesize=%x' % CONTIG_SIZE in ''.join(output))
+
+            output = u_boot_console.run_command_list([
+                'size host 0:0 /%s' % FRAG_FILE,
+                'printenv filesize'])
+            assert('filesize=%x' % FRAG_SIZE in ''.join(output))
+
+    def test_exfat3(self, u_boot_console, fs_obj_exfat):
+        """
+        Test Case 3 - load a contiguous (NoFatChain) file
+        """
+        fs_img, files = fs_obj_exfat
+        with u_boot_console.log.section('Test Case 3 - load NoFatChain'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s' % (ADDR, CONTIG_FILE),
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % CONTIG_SIZE in out)
+            assert(md5(files[CONTIG_FILE]) in out)
+
+    def test_exfat4(self, u_boot_console, fs_obj_exfat):
+        """
+        Test Case 4 - load a fragmented file, also by its upper case name
+        """
+        fs_img, files = fs_obj_exfat
+        with u_boot_console.log.section('Test Case 4 - load fragmented'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s' % (ADDR, FRAG_FILE),
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % FRAG_SIZE in out)
+            assert(md5(files[FRAG_FILE]) in out)
+
+            output = u_boot_console.run_command_list([
+                'load host 0:0 %x /%s' % (ADDR, FRAG_FILE.upper()),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5(files[FRAG_FILE]) in ''.join(output))
+
+    def test_exfat5(self, u_boot_console, fs_obj_exfat):
+        """
+        Test Case 5 - partial load across a break in the FAT chain
+        """
+        fs_img, files = fs_obj_exfat
+        with u_boot_console.log.section('Test Case 5 - partial load'):
+            # Clusters 21 and 30 hold the 2nd and 3rd 4KiB of the file
+            pos = CLUST_SIZE + CLUST_SIZE // 2
+            length = CLUST_SIZE
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s %x %x' % (ADDR, FRAG_FILE, length, pos),
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % length in out)
+            assert(md5(files[FRAG_FILE][pos:pos + length]) in out)
+
+    def test_exfat6(self, u_boot_console, fs_obj_exfat):
+        """
+        Test Case 6 - load a file from a subdirectory
+        """
+        fs_img, files = fs_obj_exfat
+        with u_boot_console.log.section('Test Case 6 - load from SUBDIR'):
+            name = SUBDIR + '/' + SMALL_FILE
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s' % (ADDR, name),
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % len(SMALL_DATA) in out)
+            assert(md5(files[name]) in out)
@@ -0,0 +1,117 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:SquashFS Test
+
+"""
+This test verifies read access to a SquashFS image through the generic
+file system commands: listing directories, loading files made of data
+blocks and a fragment tail, and following symbolic links.
+"""
+
+import hashlib
+import pytest
+from fstest_defs import *
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestSquashfs(object):
+    def test_squashfs1(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 1 - ls command, listing directories and symbolic links
+        """
+        fs_img, files = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 1 - ls'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'ls host 0:0 /'])
+            out = ''.join(output)
+            assert('SUBDIR/' in out)
+            assert(' %8d   big.bin' % len(files['big.bin']) in out)
+            assert(' %8d   small.txt' % len(files['small.txt']) in out)
+            assert('   link.txt' in out)
+            assert('   dirlink' in out)
+            assert('4 file(s), 1 dir(s)' in out)
+
+            output = u_boot_console.run_command('ls host 0:0 /dirlink')
+            assert(' %8d   tiny.txt' % len(files['SUBDIR/tiny.txt'])
+                   in output)
+            assert('   abslink.bin' in output)
+            assert('2 file(s), 0 dir(s)' in output)
+
+    def test_squashfs2(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 2 - load a file of full data blocks and a fragment tail
+        """
+        fs_img, files = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 2 - load blocks'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'size host 0:0 /big.bin',
+                'printenv filesize'])
+            assert('filesize=%x' % len(files['big.bin']) in ''.join(output))
+
+            output = u_boot_console.run_command_list([
+                'load host 0:0 %x /big.bin' % ADDR,
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % len(files['big.bin']) in out)
+            assert(md5(files['big.bin']) in out)
+
+    def test_squashfs3(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 3 - load files that live in a fragment only
+        """
+        fs_img, files = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 3 - load fragments'):
+            for name in ['small.txt', 'SUBDIR/tiny.txt']:
+                output = u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'load host 0:0 %x /%s' % (ADDR, name),
+                    'printenv filesize',
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                out = ''.join(output)
+                assert('filesize=%x' % len(files[name]) in out)
+                assert(md5(files[name]) in out)
+
+    def test_squashfs4(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 4 - partial load across the last block and the fragment
+        """
+        fs_img, files = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 4 - partial load'):
+            pos = 3 * 0x20000 - 0x1000
+            length = 0x2000
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /big.bin %x %x' % (ADDR, length, pos),
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            out = ''.join(output)
+            assert('filesize=%x' % length in out)
+            assert(md5(files['big.bin'][pos:pos + length]) in out)
+
+    def test_squashfs5(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 5 - load through relative, absolute and directory links
+        """
+        fs_img, files = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 5 - load symlinks'):
+            for link, name in [('link.txt', 'small.txt'),
+                               ('dirlink/tiny.txt', 'SUBDIR/tiny.txt'),
+                               ('SUBDIR/abslink.bin', 'big.bin')]:
+                output = u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'load host 0:0 %x /%s' % (ADDR, link),
+                    'printenv filesize',
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                out = ''.join(output)
+                assert('filesize=%x' % len(files[name]) in out)
+                assert(md5(files[name]) in out)